@@ -0,0 +1,271 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "SyntheticCorpus.h"
+
+#include "../decode/ByteArrayFlacInput.h"
+#include "../decode/DecoderPool.h"
+#include "../decode/FlacDecoder.h"
+#include "../encode/BitOutputStream.h"
+#include "../encode/FlacEncoder.h"
+#include "../encode/Presets.h"
+
+using namespace Nayuki::FLAC;
+
+/*
+ * Allocation test. Replaces the global allocation functions with counting ones and checks that decoding and encoding
+ * perform no heap allocations per frame once they reached their steady state: per-frame scratch memory has to come
+ * from buffers sized up front (see `Common::FrameArena`). Also checks that decoding many small files through a
+ * `Decode::DecoderPool` performs no heap allocations per file once every decoder has been used.
+ */
+
+namespace {
+    /**
+     * Whether allocations are currently counted.
+     */
+    bool counting = false;
+
+    /**
+     * The number of allocations counted so far.
+     */
+    uint_fast64_t allocations = 0;
+
+    /**
+     * Allocates memory for all the replacement allocation functions, counting the allocation if enabled. Kept out of
+     * line, like `freeCounted()`, so that the compiler does not see `malloc()` and `free()` paired with `operator new`
+     * and `operator delete` and warn about mismatched allocation functions.
+     * @param[in] size the number of bytes
+     * @return the memory, or `null` if it is exhausted
+     */
+    __attribute__((noinline)) void *allocateCounted(size_t size) {
+        if (counting)
+            allocations++;
+        return std::malloc(size > 0 ? size : 1);
+    }
+
+    /**
+     * Frees memory of `allocateCounted()`.
+     * @param[in] p the memory, or `null`
+     */
+    __attribute__((noinline)) void freeCounted(void *p) {
+        std::free(p);
+    }
+
+    /**
+     * Generates the given corpus entry and encodes it to an in-memory FLAC file.
+     */
+    std::vector<uint_fast8_t> makeFile(const Bench::SyntheticCorpus::Entry &entry) {
+        int_fast32_t **samples = Bench::SyntheticCorpus::generate(entry);
+        std::stringstream out(std::ios::in | std::ios::out | std::ios::binary);
+        Bench::SyntheticCorpus::writeFlac(entry, samples, Encode::SubframeEncoder::SearchOptions::SUBSET_MEDIUM, &out);
+        Bench::SyntheticCorpus::deleteSamples(samples, entry.numChannels);
+        std::string s = out.str();
+        return std::vector<uint_fast8_t>(s.begin(), s.end());
+    }
+
+    /**
+     * Returns the first entry of the default corpus for every combination of signal type and channel count, so that
+     * the mono and multichannel paths, whose scratch sizes differ from stereo, are covered too.
+     */
+    std::vector<Bench::SyntheticCorpus::Entry> getLayoutEntries() {
+        std::vector<Bench::SyntheticCorpus::Entry> result;
+        for (const Bench::SyntheticCorpus::Entry &entry : Bench::SyntheticCorpus::getDefaultEntries(1, 1)) {
+            bool seen = std::any_of(result.begin(), result.end(), [&](const Bench::SyntheticCorpus::Entry &e) {
+                return e.type == entry.type && e.numChannels == entry.numChannels;
+            });
+            if (!seen)
+                result.push_back(entry);
+        }
+        return result;
+    }
+
+    /**
+     * Decodes one file per signal type and channel count of the corpus, counting the allocations after the first
+     * audio block.
+     */
+    bool testDecode() {
+        bool ok = true;
+        std::vector<int_fast32_t> buffer(8 * 65536);
+        int_fast32_t *channels[8];
+        for (int i = 0; i < 8; i++)
+            channels[i] = buffer.data() + i * 65536;
+        for (const Bench::SyntheticCorpus::Entry &entry : getLayoutEntries()) {
+            std::vector<uint_fast8_t> file = makeFile(entry);
+            Decode::FlacDecoder dec(new Decode::ByteArrayFlacInput(file.data(), file.size()));
+            while (dec.readAndHandleMetadataBlock(nullptr, nullptr));
+            dec.readAudioBlock(channels, 0);
+            allocations = 0;
+            counting = true;
+            uint_fast64_t frames = 0;
+            while (dec.readAudioBlock(channels, 0) > 0)
+                frames++;
+            counting = false;
+            std::cout << entry.getName() << ": " << allocations << " allocations in " << frames << " frames\n";
+            ok &= allocations == 0;
+        }
+        return ok;
+    }
+
+    /**
+     * Decodes short files of every corpus entry twice through one pooled decoder, counting the allocations of the
+     * second round.
+     */
+    bool testReuse() {
+        std::vector<std::vector<uint_fast8_t>> files;
+        for (const Bench::SyntheticCorpus::Entry &entry : Bench::SyntheticCorpus::getDefaultEntries(0.05, 3))
+            files.push_back(makeFile(entry));
+        std::vector<int_fast32_t> buffer(8 * 65536);
+        int_fast32_t *channels[8];
+        for (int i = 0; i < 8; i++)
+            channels[i] = buffer.data() + i * 65536;
+        Decode::DecoderPool pool;
+        uint_fast64_t frames = 0;
+        for (int_fast32_t round = 0; round < 2; round++) {
+            allocations = 0;
+            counting = round == 1;
+            for (const std::vector<uint_fast8_t> &file : files) {
+                Decode::DecoderPool::Lease dec = pool.acquire(file.data(), file.size());
+                while (dec->readAndHandleMetadataBlock(nullptr, nullptr));
+                while (dec->readAudioBlock(channels, 0) > 0)
+                    frames += round;
+            }
+            counting = false;
+        }
+        std::cout << files.size() << " files: " << allocations << " allocations in " << frames << " frames, "
+                  << pool.getCreatedCount() << " decoder created\n";
+        return allocations == 0 && pool.getCreatedCount() == 1;
+    }
+
+    /**
+     * Counts the allocations of encoding the first given number of samples of the given entry, discarding the output.
+     */
+    uint_fast64_t countEncode(const Bench::SyntheticCorpus::Entry &entry, int_fast32_t *samples[],
+                              uint_fast64_t numSamples, const Encode::SubframeEncoder::SearchOptions &opt) {
+        Common::StreamInfo info;
+        info.sampleRate = entry.sampleRate;
+        info.numChannels = entry.numChannels;
+        info.sampleDepth = entry.sampleDepth;
+        info.numSamples = numSamples;
+        Encode::BitOutputStream out(nullptr);
+        allocations = 0;
+        counting = true;
+        Encode::FlacEncoder(&info, samples, numSamples, entry.blockSize, opt, &out);
+        counting = false;
+        return allocations;
+    }
+
+    /**
+     * Encodes a short and a long prefix of one corpus entry per signal type and channel count with several presets.
+     * Since the encoder allocates nothing per frame, both must need the same number of allocations.
+     */
+    bool testEncode() {
+        bool ok = true;
+        for (const Bench::SyntheticCorpus::Entry &entry : getLayoutEntries()) {
+            int_fast32_t **samples = Bench::SyntheticCorpus::generate(entry);
+            uint_fast64_t shortLen = std::min(entry.numSamples, (uint_fast64_t)entry.blockSize * 2);
+            for (const char *preset : {"subset-only-fixed", "subset-best", "lax-best"}) {
+                const Encode::SubframeEncoder::SearchOptions &opt = *Encode::findPreset(preset);
+                uint_fast64_t shortCount = countEncode(entry, samples, shortLen, opt);
+                uint_fast64_t longCount = countEncode(entry, samples, entry.numSamples, opt);
+                std::cout << entry.getName() << " " << preset << ": " << shortCount << " allocations for "
+                          << shortLen << " samples, " << longCount << " for " << entry.numSamples << "\n";
+                ok &= longCount == shortCount;
+            }
+            Bench::SyntheticCorpus::deleteSamples(samples, entry.numChannels);
+        }
+        return ok;
+    }
+}
+
+void *operator new(size_t size) {
+    void *result = allocateCounted(size);
+    if (result == nullptr)
+        throw std::bad_alloc();
+    return result;
+}
+
+void *operator new[](size_t size) {
+    void *result = allocateCounted(size);
+    if (result == nullptr)
+        throw std::bad_alloc();
+    return result;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return allocateCounted(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return allocateCounted(size);
+}
+
+void operator delete(void *p) noexcept {
+    freeCounted(p);
+}
+
+void operator delete[](void *p) noexcept {
+    freeCounted(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    freeCounted(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    freeCounted(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+    freeCounted(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+    freeCounted(p);
+}
+
+int main(int argc, char *argv[]) {
+    std::string name = argc == 2 ? argv[1] : "";
+    bool ok;
+    try {
+        if (name == "decode")
+            ok = testDecode();
+        else if (name == "encode")
+            ok = testEncode();
+        else if (name == "reuse")
+            ok = testReuse();
+        else {
+            std::cerr << "Usage: " << argv[0] << " {decode|encode|reuse}\n";
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << (ok ? "PASS" : "FAIL: heap allocations per frame or file in steady state") << "\n";
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
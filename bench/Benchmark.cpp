@@ -0,0 +1,394 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#include "BenchmarkReport.h"
+#include "Measurement.h"
+#include "SyntheticCorpus.h"
+
+#include "../common/ThreadPool.h"
+#include "../decode/ByteArrayFlacInput.h"
+#include "../decode/FlacDecoder.h"
+#include "../encode/Presets.h"
+
+#ifdef NAYUKI_HAVE_LIBFLAC
+#include "LibFlacCodec.h"
+#endif
+
+using namespace Nayuki::FLAC;
+using Nayuki::FLAC::Bench::BenchmarkResult;
+using Nayuki::FLAC::Encode::SubframeEncoder;
+
+namespace {
+    /**
+     * The fully decoded samples of one input file.
+     */
+    class Audio final {
+    public:
+        /**
+         * The format of the audio. Only the sample rate, channels, depth, block size and length are used.
+         */
+        Common::StreamInfo info;
+
+        /**
+         * The samples of each channel, with room for one extra block at the end.
+         */
+        std::vector<std::vector<int_fast32_t>> channels;
+
+        /**
+         * Pointers to the start of each channel, as taken by the encoder and decoder.
+         */
+        std::vector<int_fast32_t *> pointers;
+
+#ifdef NAYUKI_HAVE_LIBFLAC
+        /**
+         * The samples of each channel as 32-bit integers for libFLAC, filled on first use.
+         */
+        std::vector<std::vector<int32_t>> channels32;
+#endif
+    };
+
+    /**
+     * Prints the command line usage of this program.
+     * @param[in] program the name of the executable
+     */
+    void printUsage(const char *program) {
+        std::cerr << "Usage: " << program << " [options] INPUT...\n"
+                  << "Encodes every FLAC file (or every *.flac file in a directory) with each encoder preset,\n"
+                  << "decodes the result again, and reports size, speed and memory usage.\n\n"
+                  << "Options:\n"
+                  << "  --preset NAME  only run the given preset (repeatable; default all), one of:\n";
+        for (const auto &preset : Encode::getPresets())
+            std::cerr << "                   " << preset.first << "\n";
+        std::cerr << "  --repeat N     time each run N times and keep the fastest (default 1)\n"
+                  << "  --csv FILE     write per-file results as CSV\n"
+                  << "  --json FILE    write per-file results and the summary as JSON\n"
+                  << "  --threads N    encode the frames of each file on a pool of N threads, and decode them\n"
+                  << "                 through a pipeline on that pool which also checks the MD5 hash (0 = one\n"
+                  << "                 per hardware thread; default: on the calling thread only)\n"
+                  << "  --encoder-stats FILE\n"
+                  << "                 write per-preset stage timings and encoder decisions as JSON\n"
+                  << "                 (collected during the first repetition, which becomes slightly slower)\n";
+#ifdef NAYUKI_HAVE_LIBFLAC
+    std::cerr << "  --libflac LIST comma-separated libFLAC compression levels to compare against,\n"
+              << "                 or 'none' (default 5,8)\n";
+#endif
+    }
+
+    /**
+     * Appends the given path to the list if it is a file, or all *.flac files in it if it is a directory.
+     */
+    void collectInputs(const std::string &path, std::vector<std::string> &out) {
+#if defined(__unix__) || defined(__APPLE__)
+        struct stat st{};
+        if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+            DIR *dir = opendir(path.c_str());
+            if (dir == nullptr)
+                throw std::runtime_error("Cannot list directory " + path);
+            std::vector<std::string> names;
+            while (dirent *ent = readdir(dir)) {
+                std::string name = ent->d_name;
+                if (name.size() > 5 && name.compare(name.size() - 5, 5, ".flac") == 0)
+                    names.push_back(path + "/" + name);
+            }
+            closedir(dir);
+            std::sort(names.begin(), names.end());
+            out.insert(out.end(), names.begin(), names.end());
+            return;
+        }
+#endif
+        out.push_back(path);
+    }
+
+    /**
+     * Decodes all samples from the given decoder, whose metadata must already have been read.
+     */
+    void decodeAll(Decode::FlacDecoder &dec, Audio &audio) {
+        const Common::StreamInfo &info = *dec.streamInfo;
+        audio.channels.assign(info.numChannels, std::vector<int_fast32_t>(info.numSamples + 65536));
+        audio.pointers.clear();
+        for (auto &ch : audio.channels)
+            audio.pointers.push_back(ch.data());
+        uint_fast64_t pos = 0;
+        while (pos < info.numSamples) {
+            int_fast32_t n = dec.readAudioBlock(audio.pointers.data(), (uint_fast32_t)pos);
+            if (n == 0)
+                throw std::runtime_error("Unexpected end of audio data");
+            pos += n;
+        }
+    }
+
+    /**
+     * Reads and decodes the given FLAC file.
+     */
+    void readFile(const std::string &path, Audio &audio) {
+        Decode::FlacDecoder dec(path);
+        while (dec.readAndHandleMetadataBlock(nullptr, nullptr));
+        if (dec.streamInfo->numSamples == 0)
+            throw std::runtime_error("Unknown number of samples in " + path);
+        audio.info = *dec.streamInfo;
+        decodeAll(dec, audio);
+    }
+
+    /**
+     * Encodes the given audio with the given preset, then decodes it again and checks the result, recording the
+     * measurements into the given result.
+     */
+    void runOne(Audio &audio, const SubframeEncoder::SearchOptions &opt, int repeat, BenchmarkResult &result,
+                Encode::EncoderStats *stats, Common::ThreadPool *pool) {
+        const Common::StreamInfo &info = audio.info;
+        int_fast32_t blockSize = info.maxBlockSize >= 16 ? info.maxBlockSize : 4096;
+
+        std::string encoded;
+        result.encodeWallSeconds = result.encodeCpuSeconds = 1e300;
+        for (int i = 0; i < repeat; i++) {
+            std::stringstream out(std::ios::in | std::ios::out | std::ios::binary);
+            Bench::PeakMemory::reset();
+            Bench::Stopwatch timer;
+            Bench::SyntheticCorpus::writeFlac(info, audio.pointers.data(), blockSize, opt, &out,
+                                              i == 0 ? stats : nullptr, pool);
+            result.encodeWallSeconds = std::min(timer.getWallSeconds(), result.encodeWallSeconds);
+            result.encodeCpuSeconds = std::min(timer.getCpuSeconds(), result.encodeCpuSeconds);
+            result.encodePeakRssKib = Bench::PeakMemory::getPeakKib();
+            encoded = out.str();
+        }
+        result.flacBytes = encoded.size();
+
+        std::vector<uint_fast8_t> bytes(encoded.begin(), encoded.end());
+        Audio decoded;
+        result.decodeWallSeconds = result.decodeCpuSeconds = 1e300;
+        for (int i = 0; i < repeat; i++) {
+            Bench::Stopwatch timer;
+            Decode::FlacDecoder dec(new Decode::ByteArrayFlacInput(bytes.data(), bytes.size()));
+            while (dec.readAndHandleMetadataBlock(nullptr, nullptr));
+            if (pool != nullptr)
+                dec.startPipeline(pool);
+            decodeAll(dec, decoded);
+            result.decodeWallSeconds = std::min(timer.getWallSeconds(), result.decodeWallSeconds);
+            result.decodeCpuSeconds = std::min(timer.getCpuSeconds(), result.decodeCpuSeconds);
+        }
+        for (uint_fast8_t ch = 0; ch < info.numChannels; ch++) {
+            if (!std::equal(audio.pointers[ch], audio.pointers[ch] + info.numSamples, decoded.pointers[ch]))
+                throw std::runtime_error("Decoded samples differ from the input");
+        }
+    }
+
+#ifdef NAYUKI_HAVE_LIBFLAC
+    /**
+     * Like `runOne()`, but encodes and decodes with libFLAC at the given compression level.
+     */
+    void runLibFlac(Audio &audio, int level, int repeat, BenchmarkResult &result) {
+        const Common::StreamInfo &info = audio.info;
+        if (audio.channels32.empty()) {
+            for (int_fast32_t *ch : audio.pointers)
+                audio.channels32.emplace_back(ch, ch + info.numSamples);
+        }
+        std::vector<const int32_t *> pointers;
+        for (const std::vector<int32_t> &ch : audio.channels32)
+            pointers.push_back(ch.data());
+
+        std::string encoded;
+        result.encodeWallSeconds = result.encodeCpuSeconds = 1e300;
+        for (int i = 0; i < repeat; i++) {
+            Bench::PeakMemory::reset();
+            Bench::Stopwatch timer;
+            Bench::LibFlacCodec::encode(info, pointers.data(), level, &encoded);
+            result.encodeWallSeconds = std::min(timer.getWallSeconds(), result.encodeWallSeconds);
+            result.encodeCpuSeconds = std::min(timer.getCpuSeconds(), result.encodeCpuSeconds);
+            result.encodePeakRssKib = Bench::PeakMemory::getPeakKib();
+        }
+        result.flacBytes = encoded.size();
+
+        std::vector<std::vector<int32_t>> decoded;
+        result.decodeWallSeconds = result.decodeCpuSeconds = 1e300;
+        for (int i = 0; i < repeat; i++) {
+            Bench::Stopwatch timer;
+            Bench::LibFlacCodec::decode(encoded, &decoded);
+            result.decodeWallSeconds = std::min(timer.getWallSeconds(), result.decodeWallSeconds);
+            result.decodeCpuSeconds = std::min(timer.getCpuSeconds(), result.decodeCpuSeconds);
+        }
+        if (decoded != audio.channels32)
+            throw std::runtime_error("libFLAC decoded samples differ from the input");
+    }
+#endif
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> presetNames;
+    std::vector<std::string> inputs;
+    std::string csvPath;
+    std::string jsonPath;
+    std::string statsPath;
+    int repeat = 1;
+    int threads = -1;
+#ifdef NAYUKI_HAVE_LIBFLAC
+    std::vector<int> libFlacLevels = {5, 8};
+#endif
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--preset" || arg == "--repeat" || arg == "--csv" || arg == "--json" ||
+             arg == "--encoder-stats" || arg == "--threads") && i + 1 < argc) {
+            std::string val = argv[++i];
+            if (arg == "--preset")
+                presetNames.push_back(val);
+            else if (arg == "--repeat")
+                repeat = std::atoi(val.c_str());
+            else if (arg == "--csv")
+                csvPath = val;
+            else if (arg == "--encoder-stats")
+                statsPath = val;
+            else if (arg == "--threads")
+                threads = std::atoi(val.c_str());
+            else
+                jsonPath = val;
+#ifdef NAYUKI_HAVE_LIBFLAC
+        } else if (arg == "--libflac" && i + 1 < argc) {
+            libFlacLevels.clear();
+            std::istringstream levels(argv[++i]);
+            std::string level;
+            while (std::getline(levels, level, ',')) {
+                if (level == "none")
+                    continue;
+                char *end;
+                long val = std::strtol(level.c_str(), &end, 10);
+                if (level.empty() || *end != '\0' || val < 0 || val > 8) {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                libFlacLevels.push_back((int)val);
+            }
+#endif
+        } else if (!arg.empty() && arg[0] != '-')
+            inputs.push_back(arg);
+        else {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (presetNames.empty()) {
+        for (const auto &preset : Encode::getPresets())
+            presetNames.push_back(preset.first);
+    }
+    for (const std::string &name : presetNames) {
+        if (Encode::findPreset(name) == nullptr) {
+            std::cerr << "Unknown preset: " << name << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if (inputs.empty() || repeat < 1 || threads < -1) {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    try {
+        std::vector<std::string> files;
+        for (const std::string &input : inputs)
+            collectInputs(input, files);
+        if (files.empty())
+            throw std::runtime_error("No input files found");
+
+        std::unique_ptr<Common::ThreadPool> pool;
+        if (threads >= 0)
+            pool.reset(new Common::ThreadPool(threads));
+        Bench::BenchmarkReport report;
+        std::vector<Encode::EncoderStats> presetStats(presetNames.size());
+        for (const std::string &path : files) {
+            Audio audio;
+            readFile(path, audio);
+            const Common::StreamInfo &info = audio.info;
+            size_t slash = path.find_last_of("/\\");
+            BenchmarkResult base;
+            base.file = slash == std::string::npos ? path : path.substr(slash + 1);
+            base.sampleRate = info.sampleRate;
+            base.numChannels = info.numChannels;
+            base.sampleDepth = info.sampleDepth;
+            base.numSamples = info.numSamples;
+            base.pcmBytes = info.numSamples * info.numChannels * ((info.sampleDepth + 7) / 8);
+
+            std::vector<BenchmarkResult> fileResults;
+            for (size_t i = 0; i < presetNames.size(); i++) {
+                const std::string &name = presetNames[i];
+                BenchmarkResult result = base;
+                result.encoder = name;
+                runOne(audio, *Encode::findPreset(name), repeat, result, statsPath.empty() ? nullptr : &presetStats[i],
+                       pool.get());
+                fileResults.push_back(result);
+            }
+#ifdef NAYUKI_HAVE_LIBFLAC
+            for (int level : libFlacLevels) {
+                BenchmarkResult result = base;
+                result.encoder = "libflac-" + std::to_string(level);
+                runLibFlac(audio, level, repeat, result);
+                fileResults.push_back(result);
+            }
+#endif
+            for (const BenchmarkResult &result : fileResults) {
+                std::cerr << result.file << "\t" << result.encoder << "\t" << result.flacBytes << " bytes\t"
+                          << result.encodeWallSeconds << " s\n";
+                report.results.push_back(result);
+            }
+        }
+
+        if (!csvPath.empty()) {
+            std::ofstream out(csvPath);
+            report.writeCsv(out);
+            if (!out)
+                throw std::runtime_error("Cannot write " + csvPath);
+        }
+        if (!jsonPath.empty()) {
+            std::ofstream out(jsonPath);
+            report.writeJson(out);
+            if (!out)
+                throw std::runtime_error("Cannot write " + jsonPath);
+        }
+        if (!statsPath.empty()) {
+            std::ofstream out(statsPath);
+            out << "{";
+            for (size_t i = 0; i < presetNames.size(); i++) {
+                out << (i > 0 ? ",\n" : "\n") << "  \"" << presetNames[i] << "\": ";
+                presetStats[i].writeJson(out);
+            }
+            out << "\n}\n";
+            if (!out)
+                throw std::runtime_error("Cannot write " + statsPath);
+        }
+        report.writeSummary(std::cout);
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
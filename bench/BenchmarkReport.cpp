@@ -0,0 +1,198 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "BenchmarkReport.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Bench {
+            namespace {
+                /**
+                 * Returns the given string as a quoted JSON string literal.
+                 */
+                std::string jsonString(const std::string &s) {
+                    std::ostringstream result;
+                    result << '"';
+                    for (char c : s) {
+                        if (c == '"' || c == '\\')
+                            result << '\\' << c;
+                        else if ((unsigned char)c < 0x20)
+                            result << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec;
+                        else
+                            result << c;
+                    }
+                    result << '"';
+                    return result.str();
+                }
+
+                /**
+                 * Returns the given string as a CSV field, quoted only if necessary.
+                 */
+                std::string csvField(const std::string &s) {
+                    if (s.find_first_of(",\"\n") == std::string::npos)
+                        return s;
+                    std::string result = "\"";
+                    for (char c : s) {
+                        if (c == '"')
+                            result += '"';
+                        result += c;
+                    }
+                    return result + "\"";
+                }
+
+                /**
+                 * Returns the given amount of audio divided by the given time, or 0 if the time is not positive.
+                 */
+                double speed(double audioSeconds, double seconds) {
+                    return seconds > 0 ? audioSeconds / seconds : 0;
+                }
+            }
+
+            double BenchmarkResult::getAudioSeconds() const {
+                return sampleRate > 0 ? (double)numSamples / sampleRate : 0;
+            }
+
+            double BenchmarkResult::getRatio() const {
+                return pcmBytes > 0 ? (double)flacBytes / pcmBytes : 0;
+            }
+
+            double EncoderSummary::getRatio() const {
+                return pcmBytes > 0 ? (double)flacBytes / pcmBytes : 0;
+            }
+
+            std::vector<EncoderSummary> BenchmarkReport::summarize() const {
+                std::vector<EncoderSummary> result;
+                for (const BenchmarkResult &r : results) {
+                    auto it = std::find_if(result.begin(), result.end(),
+                                           [&r](const EncoderSummary &s) { return s.encoder == r.encoder; });
+                    if (it == result.end()) {
+                        result.emplace_back();
+                        it = result.end() - 1;
+                        it->encoder = r.encoder;
+                    }
+                    it->numFiles++;
+                    it->pcmBytes += r.pcmBytes;
+                    it->flacBytes += r.flacBytes;
+                    it->audioSeconds += r.getAudioSeconds();
+                    it->encodeWallSeconds += r.encodeWallSeconds;
+                    it->encodeCpuSeconds += r.encodeCpuSeconds;
+                    it->maxEncodePeakRssKib = std::max(it->maxEncodePeakRssKib, r.encodePeakRssKib);
+                    it->decodeWallSeconds += r.decodeWallSeconds;
+                }
+
+                // Only configurations which processed the same files are comparable, which holds for every normal run
+                for (EncoderSummary &s : result) {
+                    s.paretoOptimal = true;
+                    for (const EncoderSummary &t : result) {
+                        if (&s != &t && t.flacBytes <= s.flacBytes && t.encodeWallSeconds <= s.encodeWallSeconds &&
+                            (t.flacBytes < s.flacBytes || t.encodeWallSeconds < s.encodeWallSeconds)) {
+                            s.paretoOptimal = false;
+                            break;
+                        }
+                    }
+                }
+                return result;
+            }
+
+            void BenchmarkReport::writeCsv(std::ostream &out) const {
+                out << "file,encoder,sample_rate,channels,depth,samples,pcm_bytes,flac_bytes,ratio,"
+                       "encode_wall_s,encode_cpu_s,encode_peak_rss_kib,decode_wall_s,decode_cpu_s,"
+                       "encode_x_realtime,decode_x_realtime\n";
+                out << std::setprecision(6);
+                for (const BenchmarkResult &r : results) {
+                    out << csvField(r.file) << ',' << csvField(r.encoder) << ',' << r.sampleRate << ','
+                        << (int)r.numChannels << ',' << (int)r.sampleDepth << ',' << r.numSamples << ','
+                        << r.pcmBytes << ',' << r.flacBytes << ',' << r.getRatio() << ','
+                        << r.encodeWallSeconds << ',' << r.encodeCpuSeconds << ',' << r.encodePeakRssKib << ','
+                        << r.decodeWallSeconds << ',' << r.decodeCpuSeconds << ','
+                        << speed(r.getAudioSeconds(), r.encodeWallSeconds) << ','
+                        << speed(r.getAudioSeconds(), r.decodeWallSeconds) << '\n';
+                }
+            }
+
+            void BenchmarkReport::writeJson(std::ostream &out) const {
+                out << std::setprecision(6) << "{\n  \"results\": [";
+                for (size_t i = 0; i < results.size(); i++) {
+                    const BenchmarkResult &r = results[i];
+                    out << (i > 0 ? ",\n" : "\n") << "    {"
+                        << "\"file\": " << jsonString(r.file)
+                        << ", \"encoder\": " << jsonString(r.encoder)
+                        << ", \"sample_rate\": " << r.sampleRate
+                        << ", \"channels\": " << (int)r.numChannels
+                        << ", \"depth\": " << (int)r.sampleDepth
+                        << ", \"samples\": " << r.numSamples
+                        << ", \"pcm_bytes\": " << r.pcmBytes
+                        << ", \"flac_bytes\": " << r.flacBytes
+                        << ", \"ratio\": " << r.getRatio()
+                        << ", \"encode_wall_s\": " << r.encodeWallSeconds
+                        << ", \"encode_cpu_s\": " << r.encodeCpuSeconds
+                        << ", \"encode_peak_rss_kib\": " << r.encodePeakRssKib
+                        << ", \"decode_wall_s\": " << r.decodeWallSeconds
+                        << ", \"decode_cpu_s\": " << r.decodeCpuSeconds << "}";
+                }
+                out << "\n  ],\n  \"summary\": [";
+                std::vector<EncoderSummary> summary = summarize();
+                for (size_t i = 0; i < summary.size(); i++) {
+                    const EncoderSummary &s = summary[i];
+                    out << (i > 0 ? ",\n" : "\n") << "    {"
+                        << "\"encoder\": " << jsonString(s.encoder)
+                        << ", \"files\": " << s.numFiles
+                        << ", \"pcm_bytes\": " << s.pcmBytes
+                        << ", \"flac_bytes\": " << s.flacBytes
+                        << ", \"ratio\": " << s.getRatio()
+                        << ", \"encode_wall_s\": " << s.encodeWallSeconds
+                        << ", \"encode_cpu_s\": " << s.encodeCpuSeconds
+                        << ", \"max_encode_peak_rss_kib\": " << s.maxEncodePeakRssKib
+                        << ", \"decode_wall_s\": " << s.decodeWallSeconds
+                        << ", \"pareto_optimal\": " << (s.paretoOptimal ? "true" : "false") << "}";
+                }
+                out << "\n  ]\n}\n";
+            }
+
+            void BenchmarkReport::writeSummary(std::ostream &out) const {
+                std::vector<EncoderSummary> summary = summarize();
+                std::sort(summary.begin(), summary.end(), [](const EncoderSummary &a, const EncoderSummary &b) {
+                    return a.flacBytes < b.flacBytes;
+                });
+                std::ios::fmtflags flags = out.flags();
+                out << "  " << std::left << std::setw(20) << "encoder" << std::right
+                    << std::setw(10) << "ratio" << std::setw(14) << "flac bytes"
+                    << std::setw(12) << "encode s" << std::setw(12) << "enc x rt"
+                    << std::setw(12) << "dec x rt" << std::setw(12) << "peak KiB" << "\n";
+                out << std::fixed;
+                for (const EncoderSummary &s : summary) {
+                    out << (s.paretoOptimal ? "* " : "  ") << std::left << std::setw(20) << s.encoder << std::right
+                        << std::setw(10) << std::setprecision(4) << s.getRatio()
+                        << std::setw(14) << s.flacBytes
+                        << std::setw(12) << std::setprecision(3) << s.encodeWallSeconds
+                        << std::setw(12) << std::setprecision(1) << speed(s.audioSeconds, s.encodeWallSeconds)
+                        << std::setw(12) << std::setprecision(1) << speed(s.audioSeconds, s.decodeWallSeconds)
+                        << std::setw(12) << s.maxEncodePeakRssKib << "\n";
+                }
+                out << "* = on the Pareto frontier of size versus encoding time\n";
+                out.flags(flags);
+            }
+        }
+    }
+}
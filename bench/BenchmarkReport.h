@@ -0,0 +1,219 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_BENCHMARKREPORT_H
+#define NAYUKI_BENCHMARKREPORT_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Bench {
+            /**
+             * The measurements of encoding and then decoding one input file with one encoder configuration.
+             */
+            class BenchmarkResult final {
+            public:
+                /**
+                 * The name of the input file, without directories.
+                 */
+                std::string file;
+
+                /**
+                 * The name of the encoder configuration, such as `subset-best`.
+                 */
+                std::string encoder;
+
+                /**
+                 * The sample rate of the audio in hertz.
+                 */
+                uint_fast32_t sampleRate = 0;
+
+                /**
+                 * The number of channels of the audio.
+                 */
+                uint_fast8_t numChannels = 0;
+
+                /**
+                 * The bit depth of the audio.
+                 */
+                uint_fast8_t sampleDepth = 0;
+
+                /**
+                 * The number of samples per channel.
+                 */
+                uint_fast64_t numSamples = 0;
+
+                /**
+                 * The size of the audio as packed PCM, i.e. rounding each sample up to whole bytes.
+                 */
+                uint_fast64_t pcmBytes = 0;
+
+                /**
+                 * The size of the encoded FLAC file, including all metadata.
+                 */
+                uint_fast64_t flacBytes = 0;
+
+                /**
+                 * The wall clock time taken to encode, in seconds.
+                 */
+                double encodeWallSeconds = 0;
+
+                /**
+                 * The CPU time taken to encode, in seconds.
+                 */
+                double encodeCpuSeconds = 0;
+
+                /**
+                 * The peak resident set size of the process while encoding, in kibibytes.
+                 */
+                uint_fast64_t encodePeakRssKib = 0;
+
+                /**
+                 * The wall clock time taken to decode the encoded file, in seconds.
+                 */
+                double decodeWallSeconds = 0;
+
+                /**
+                 * The CPU time taken to decode the encoded file, in seconds.
+                 */
+                double decodeCpuSeconds = 0;
+
+                /**
+                 * Returns the duration of the audio in seconds.
+                 * @return the audio duration
+                 */
+                double getAudioSeconds() const;
+
+                /**
+                 * Returns the compressed size divided by the PCM size.
+                 * @return the compression ratio
+                 */
+                double getRatio() const;
+            };
+
+            /**
+             * The results of one encoder configuration summed over all input files.
+             */
+            class EncoderSummary final {
+            public:
+                /**
+                 * The name of the encoder configuration.
+                 */
+                std::string encoder;
+
+                /**
+                 * The number of input files processed.
+                 */
+                uint_fast32_t numFiles = 0;
+
+                /**
+                 * The total size of the audio as packed PCM.
+                 */
+                uint_fast64_t pcmBytes = 0;
+
+                /**
+                 * The total size of the encoded FLAC files.
+                 */
+                uint_fast64_t flacBytes = 0;
+
+                /**
+                 * The total duration of the audio in seconds.
+                 */
+                double audioSeconds = 0;
+
+                /**
+                 * The total wall clock time taken to encode, in seconds.
+                 */
+                double encodeWallSeconds = 0;
+
+                /**
+                 * The total CPU time taken to encode, in seconds.
+                 */
+                double encodeCpuSeconds = 0;
+
+                /**
+                 * The largest peak resident set size of any encoding run, in kibibytes.
+                 */
+                uint_fast64_t maxEncodePeakRssKib = 0;
+
+                /**
+                 * The total wall clock time taken to decode the encoded files, in seconds.
+                 */
+                double decodeWallSeconds = 0;
+
+                /**
+                 * Whether no other encoder configuration is both at least as small and at least as fast to encode
+                 * (and strictly better in one of them).
+                 */
+                bool paretoOptimal = false;
+
+                /**
+                 * Returns the total compressed size divided by the total PCM size.
+                 * @return the compression ratio
+                 */
+                double getRatio() const;
+            };
+
+            /**
+             * Collects benchmark results and writes them as CSV, JSON and a human-readable Pareto frontier summary of
+             * compression ratio versus encoding time.
+             */
+            class BenchmarkReport final {
+            public:
+                /**
+                 * All the results in the order they were measured.
+                 */
+                std::vector<BenchmarkResult> results;
+
+                /**
+                 * Sums up the results per encoder configuration, in order of first appearance, and marks the ones on
+                 * the Pareto frontier.
+                 * @return one summary per encoder configuration
+                 */
+                std::vector<EncoderSummary> summarize() const;
+
+                /**
+                 * Writes one line per result, preceded by a header line.
+                 * @param[in,out] out the stream to write to
+                 */
+                void writeCsv(std::ostream &out) const;
+
+                /**
+                 * Writes a JSON object with a `results` array and a `summary` array.
+                 * @param[in,out] out the stream to write to
+                 */
+                void writeJson(std::ostream &out) const;
+
+                /**
+                 * Writes a table with one row per encoder configuration, ordered by compression ratio, where Pareto
+                 * optimal configurations are marked with an asterisk.
+                 * @param[in,out] out the stream to write to
+                 */
+                void writeSummary(std::ostream &out) const;
+            };
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "SyntheticCorpus.h"
+
+#include "../encode/Presets.h"
+
+using Nayuki::FLAC::Bench::SyntheticCorpus;
+
+/**
+ * Prints the command line usage of this program.
+ * @param[in] program the name of the executable
+ */
+static void printUsage(const char *program) {
+    std::cerr << "Usage: " << program << " [options] OUTPUT_DIR\n"
+              << "Writes the synthetic benchmark corpus as FLAC files into an existing directory.\n\n"
+              << "Options:\n"
+              << "  --seed N       seed of the random signals (default 1)\n"
+              << "  --seconds S    duration of each file in seconds (default 5)\n"
+              << "  --preset NAME  encoder preset (default subset-medium), one of:\n";
+    for (const auto &preset : Nayuki::FLAC::Encode::getPresets())
+        std::cerr << "                   " << preset.first << "\n";
+    std::cerr << "  --list         only print the names of the corpus entries\n";
+}
+
+int main(int argc, char *argv[]) {
+    uint_fast64_t seed = 1;
+    double seconds = 5;
+    std::string presetName = "subset-medium";
+    bool listOnly = false;
+    std::string outDir;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--seed" || arg == "--seconds" || arg == "--preset") && i + 1 < argc) {
+            std::string val = argv[++i];
+            if (arg == "--seed")
+                seed = std::strtoull(val.c_str(), nullptr, 10);
+            else if (arg == "--seconds")
+                seconds = std::strtod(val.c_str(), nullptr);
+            else
+                presetName = val;
+        } else if (arg == "--list")
+            listOnly = true;
+        else if (!arg.empty() && arg[0] != '-' && outDir.empty())
+            outDir = arg;
+        else {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    const Nayuki::FLAC::Encode::SubframeEncoder::SearchOptions *opt = Nayuki::FLAC::Encode::findPreset(presetName);
+    if (opt == nullptr || !(seconds > 0) || (outDir.empty() && !listOnly)) {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (const SyntheticCorpus::Entry &entry : SyntheticCorpus::getDefaultEntries(seconds, seed)) {
+        std::string name = entry.getName() + ".flac";
+        if (listOnly) {
+            std::cout << name << "\n";
+            continue;
+        }
+        std::string path = outDir + "/" + name;
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Cannot open " << path << " for writing\n";
+            return EXIT_FAILURE;
+        }
+        int_fast32_t **samples = SyntheticCorpus::generate(entry);
+        SyntheticCorpus::writeFlac(entry, samples, *opt, &out);
+        SyntheticCorpus::deleteSamples(samples, entry.numChannels);
+        std::cout << name << "\t" << out.tellp() << " bytes\n";
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,167 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "Measurement.h"
+
+#include "../decode/FlacDecoder.h"
+#include "../decode/SeekableFileFlacInput.h"
+
+using namespace Nayuki::FLAC;
+
+/*
+ * Input buffer benchmark. Decodes FLAC files straight from the file system with a range of input buffer sizes and
+ * with the adaptive size, and reports the throughput and the final buffer size for each. Run it on files on
+ * a local disk and on a network file system to choose buffer sizes; with `--drop-cache` every run starts with the
+ * file evicted from the page cache (where supported), so that the storage itself is measured.
+ */
+
+namespace {
+    /**
+     * Prints the command line usage of this program.
+     * @param[in] program the name of the executable
+     */
+    void printUsage(const char *program) {
+        std::cerr << "Usage: " << program << " [options] FILE...\n"
+                  << "Decodes every FLAC file with several input buffer sizes and reports the throughput.\n\n"
+                  << "Options:\n"
+                  << "  --sizes LIST   comma-separated buffer sizes in bytes, 0 meaning adaptive\n"
+                  << "                 (default 4096,16384,65536,262144,1048576,0)\n"
+                  << "  --repeat N     time each size N times and keep the fastest (default 3)\n"
+                  << "  --drop-cache   evict the file from the page cache before every run\n";
+    }
+
+    /**
+     * Asks the operating system to evict the given file from the page cache, returning whether it is supported.
+     * @param[in] path the path of the file
+     * @return whether the request was made
+     */
+    bool dropCache(const std::string &path) {
+#if defined(__linux__)
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd == -1)
+            return false;
+        fdatasync(fd);
+        bool ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+        ::close(fd);
+        return ok;
+#else
+        (void)path;
+        return false;
+#endif
+    }
+
+    /**
+     * Decodes the whole given file with the given buffer size, discarding the samples.
+     * @param[in]  path       the path of the FLAC file
+     * @param[in]  bufferSize the input buffer size in bytes, or 0 for adaptive
+     * @param[out] fileBytes  the length of the file in bytes
+     * @param[out] finalSize  the buffer size at the end, after any adaptation
+     * @return the number of samples per channel decoded
+     */
+    uint_fast64_t decodeFile(const std::string &path, size_t bufferSize, uint_fast64_t *fileBytes,
+                             size_t *finalSize) {
+        auto *in = new Decode::SeekableFileFlacInput(path, bufferSize);
+        Decode::FlacDecoder dec(in);  // Owns the input, which lives as long as the decoder
+        while (dec.readAndHandleMetadataBlock(nullptr, nullptr));
+        std::vector<int_fast32_t> buffer(8 * 65536);
+        int_fast32_t *channels[8];
+        for (int i = 0; i < 8; i++)
+            channels[i] = buffer.data() + i * 65536;
+        uint_fast64_t samples = 0;
+        while (int_fast32_t n = dec.readAudioBlock(channels, 0))
+            samples += (uint_fast64_t)n;
+        *fileBytes = in->getLength();
+        *finalSize = in->getBufferSize();
+        return samples;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<size_t> sizes = {4096, 16384, 65536, 262144, 1048576, 0};
+    std::vector<std::string> files;
+    int repeat = 3;
+    bool drop = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--sizes" && i + 1 < argc) {
+            sizes.clear();
+            std::istringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ','))
+                sizes.push_back((size_t)std::strtoull(item.c_str(), nullptr, 10));
+        } else if (arg == "--repeat" && i + 1 < argc)
+            repeat = std::atoi(argv[++i]);
+        else if (arg == "--drop-cache")
+            drop = true;
+        else if (!arg.empty() && arg[0] != '-')
+            files.push_back(arg);
+        else {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (files.empty() || sizes.empty() || repeat < 1) {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    try {
+        std::cout << std::left << std::setw(40) << "file" << std::right << std::setw(10) << "buffer"
+                  << std::setw(10) << "final" << std::setw(12) << "MB/s\n";
+        for (const std::string &path : files) {
+            for (size_t bufferSize : sizes) {
+                double best = 0;
+                uint_fast64_t fileBytes = 0;
+                size_t finalSize = 0;
+                for (int r = 0; r < repeat; r++) {
+                    if (drop && !dropCache(path))
+                        throw std::runtime_error("Cannot drop the page cache on this platform");
+                    Bench::Stopwatch timer;
+                    decodeFile(path, bufferSize, &fileBytes, &finalSize);
+                    double seconds = timer.getWallSeconds();
+                    if (seconds > 0)
+                        best = std::max(best, fileBytes / seconds / 1e6);
+                }
+                std::cout << std::left << std::setw(40) << path << std::right << std::setw(10)
+                          << (bufferSize == 0 ? "adaptive" : std::to_string(bufferSize)) << std::setw(10)
+                          << finalSize << std::setw(11) << std::fixed << std::setprecision(1) << best << "\n";
+            }
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
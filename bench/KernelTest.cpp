@@ -0,0 +1,430 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../common/CpuFeatures.h"
+#include "../common/Kernels.h"
+
+using namespace Nayuki::FLAC;
+
+/*
+ * Kernel consistency test. Runs every kernel at every instruction set level the processor supports on random inputs
+ * and checks that the results are bit-identical to the portable implementations, which the level selection of
+ * `Common::Kernels` relies on.
+ */
+
+namespace {
+    /**
+     * The generator of all random inputs, seeded for reproducible failures.
+     */
+    std::mt19937_64 rng(20190521);
+
+    /**
+     * Returns a uniformly random signed integer which fits the given bit depth, in the range [1, 63].
+     */
+    int_fast64_t randomSample(int_fast32_t depth) {
+        return (int_fast64_t)(rng() >> (64 - depth)) - ((int_fast64_t)1 << (depth - 1));
+    }
+
+    /**
+     * Returns a uniformly random integer in the range [0, `bound`).
+     */
+    uint_fast32_t randomBelow(uint_fast32_t bound) {
+        return (uint_fast32_t)(rng() % bound);
+    }
+
+    /**
+     * Returns the portable kernel table.
+     */
+    const Common::Kernels &getScalar() {
+        return Common::Kernels::get(Common::CpuFeatures::Level::SCALAR);
+    }
+
+    /**
+     * Returns the kernel tables of every supported level, including the portable one.
+     */
+    std::vector<const Common::Kernels *> getTables() {
+        std::vector<const Common::Kernels *> result;
+        auto highest = (int)Common::CpuFeatures::getDetected().getHighestLevel();
+        for (int i = 0; i <= highest; i++)
+            result.push_back(&Common::Kernels::get((Common::CpuFeatures::Level)i));
+        return result;
+    }
+
+    /**
+     * Reports a mismatch of the given kernel at the level of the given table. Always returns `false`.
+     */
+    bool fail(const Common::Kernels &kernels, const char *kernel, const std::string &details) {
+        std::cout << Common::CpuFeatures::getLevelName(kernels.level) << ": " << kernel << " differs for "
+                  << details << "\n";
+        return false;
+    }
+
+    /**
+     * Checks both CRCs over every length up to a few blocks of the vector kernels, at several alignments.
+     */
+    bool testCrc() {
+        bool ok = true;
+        std::vector<uint_fast8_t> data(4096 + 16);
+        for (uint_fast8_t &b : data)
+            b = (uint_fast8_t)(rng() & 0xFF);
+        std::vector<size_t> lengths;
+        for (size_t len = 0; len <= 300; len++)
+            lengths.push_back(len);
+        lengths.push_back(4096);
+        for (const Common::Kernels *kernels : getTables()) {
+            for (size_t len : lengths) {
+                for (size_t offset = 0; offset < 16; offset += 5) {
+                    const uint_fast8_t *p = data.data() + offset;
+                    auto init8 = (uint_fast8_t)(rng() & 0xFF);
+                    auto init16 = (uint_fast16_t)(rng() & 0xFFFF);
+                    std::string details = "length " + std::to_string(len) + ", offset " + std::to_string(offset);
+                    if (kernels->crc8(init8, p, len) != getScalar().crc8(init8, p, len))
+                        ok = fail(*kernels, "crc8", details);
+                    if (kernels->crc16(init16, p, len) != getScalar().crc16(init16, p, len))
+                        ok = fail(*kernels, "crc16", details);
+                }
+            }
+        }
+        return ok;
+    }
+
+    /**
+     * Appends the given number of low bits of the given value to a big-endian bit string.
+     */
+    void appendBits(std::vector<uint_fast8_t> &bytes, uint_fast64_t &bitLen, uint_fast64_t val, int_fast32_t n) {
+        for (int_fast32_t i = n - 1; i >= 0; i--, bitLen++) {
+            if (bitLen % 8 == 0)
+                bytes.push_back(0);
+            bytes.back() |= (uint_fast8_t)(((val >> i) & 1) << (7 - bitLen % 8));
+        }
+    }
+
+    /**
+     * Encodes random values for every Rice parameter and checks that every level decodes all of them. The stream is
+     * padded, so no code runs into the end of the byte buffer.
+     */
+    bool testRice() {
+        bool ok = true;
+        const int_fast32_t count = 3000;
+        for (int_fast32_t param = 0; param <= 31; param++) {
+            std::vector<int_fast64_t> values(count);
+            std::vector<uint_fast8_t> bytes;
+            uint_fast64_t bitLen = 0;
+            for (int_fast64_t &val : values) {
+                // Mostly short codes for the table paths, with some unary prefixes longer than the tables cover; the
+                // kernels may stop at codes longer than the 57 bits a refill guarantees, so none are generated
+                auto longest = (uint_fast32_t)std::min((int_fast32_t)40, 56 - param);
+                uint_fast64_t unary = randomBelow(8) == 0 ? randomBelow(longest) : randomBelow(3);
+                uint_fast64_t zigzag = (unary << param) | (rng() & (((uint_fast64_t)1 << param) - 1));
+                val = (int_fast64_t)(zigzag >> 1) ^ -(int_fast64_t)(zigzag & 1);
+                appendBits(bytes, bitLen, 1, (int_fast32_t)unary + 1);
+                appendBits(bytes, bitLen, zigzag, param);
+            }
+            bytes.resize(bytes.size() + 16, 0xFF);
+            for (const Common::Kernels *kernels : getTables()) {
+                Common::Kernels::BitReader in = {0, 0, bytes.data(), 0, (int_fast32_t)bytes.size()};
+                std::vector<int_fast64_t> result(count);
+                int_fast32_t start = 0;
+                while (start < count) {
+                    int_fast32_t next = kernels->readRiceSignedInts(in, param, result.data(), start, count);
+                    if (next == start)
+                        break;
+                    start = next;
+                }
+                if (start != count || result != values)
+                    ok = fail(*kernels, "readRiceSignedInts", "parameter " + std::to_string(param));
+            }
+        }
+        return ok;
+    }
+
+    /**
+     * Checks the LPC residuals against the portable kernel and that restoring them gives back the samples, for random
+     * orders, shifts and bit depths.
+     */
+    bool testLpc() {
+        bool ok = true;
+        for (int_fast32_t trial = 0; trial < 400; trial++) {
+            static const int_fast32_t DEPTHS[] = {4, 8, 16, 20, 24, 32, 33};
+            int_fast32_t depth = DEPTHS[randomBelow(7)];
+            int_fast32_t order = (int_fast32_t)randomBelow(33);
+            int_fast32_t shift = (int_fast32_t)randomBelow(16);
+            auto numSamples = (uint_fast32_t)(order + randomBelow(trial % 4 == 0 ? 4096 : 64));
+            std::vector<int_fast32_t> coefs(order + 1);
+            for (int_fast32_t &c : coefs)
+                c = (int_fast32_t)randomSample(trial % 2 == 0 ? 16 : 12);
+            std::vector<int_fast64_t> samples(numSamples);
+            for (int_fast64_t &s : samples)
+                s = randomSample(depth);
+            std::vector<int_fast64_t> expected = samples;
+            getScalar().computeLpcResidual(expected.data(), numSamples, coefs.data(), order, shift, depth);
+            std::string details = "order " + std::to_string(order) + ", depth " + std::to_string(depth) +
+                                  ", length " + std::to_string(numSamples);
+            for (const Common::Kernels *kernels : getTables()) {
+                std::vector<int_fast64_t> residual = samples;
+                kernels->computeLpcResidual(residual.data(), numSamples, coefs.data(), order, shift, depth);
+                if (residual != expected)
+                    ok = fail(*kernels, "computeLpcResidual", details);
+                if (!kernels->restoreLpc(residual.data(), (int_fast32_t)numSamples, coefs.data(), order, shift, depth)
+                        || residual != samples)
+                    ok = fail(*kernels, "restoreLpc", details);
+            }
+        }
+        return ok;
+    }
+
+    /**
+     * Checks that the autocorrelation sums are exactly equal for random lengths and lags.
+     */
+    bool testAutocorrelation() {
+        bool ok = true;
+        for (int_fast32_t trial = 0; trial < 400; trial++) {
+            int_fast32_t maxLag = (int_fast32_t)randomBelow(33);
+            auto length = (uint_fast32_t)randomBelow(trial % 4 == 0 ? 4608 : 80);
+            std::vector<int_fast64_t> data(length);
+            int_fast32_t depth = trial % 2 == 0 ? 17 : 25;
+            for (int_fast64_t &d : data)
+                d = randomSample(depth);
+            std::vector<double> expected(maxLag + 1);
+            getScalar().autocorrelate(data.data(), length, maxLag, expected.data());
+            for (const Common::Kernels *kernels : getTables()) {
+                std::vector<double> result(maxLag + 1);
+                kernels->autocorrelate(data.data(), length, maxLag, result.data());
+                if (std::memcmp(result.data(), expected.data(), result.size() * sizeof(double)) != 0) {
+                    ok = fail(*kernels, "autocorrelate", "maximum lag " + std::to_string(maxLag) + ", length " +
+                                                         std::to_string(length));
+                }
+            }
+        }
+        return ok;
+    }
+
+    /**
+     * Checks the packed PCM bytes for every channel count and sample width.
+     */
+    bool testPack() {
+        bool ok = true;
+        const uint_fast32_t maxSamples = 700;
+        for (uint_fast8_t numChannels = 1; numChannels <= 8; numChannels++) {
+            for (uint_fast8_t bytesPerSample = 1; bytesPerSample <= 4; bytesPerSample++) {
+                std::vector<std::vector<int_fast32_t>> channels(numChannels, std::vector<int_fast32_t>(maxSamples));
+                std::vector<const int_fast32_t *> samples;
+                for (std::vector<int_fast32_t> &ch : channels) {
+                    for (int_fast32_t &s : ch)
+                        s = (int_fast32_t)randomSample(bytesPerSample * 8);
+                    samples.push_back(ch.data());
+                }
+                auto offset = (uint_fast64_t)randomBelow(16);
+                for (uint_fast32_t numSamples : {0u, 1u, 5u, 8u, 17u, 100u, 683u}) {
+                    size_t size = (size_t)numChannels * numSamples * bytesPerSample;
+                    std::vector<uint_fast8_t> expected(size);
+                    getScalar().packPcm(samples.data(), numChannels, offset, numSamples, bytesPerSample,
+                                        expected.data());
+                    for (const Common::Kernels *kernels : getTables()) {
+                        std::vector<uint_fast8_t> result(size);
+                        kernels->packPcm(samples.data(), numChannels, offset, numSamples, bytesPerSample,
+                                         result.data());
+                        if (result != expected) {
+                            ok = fail(*kernels, "packPcm", std::to_string(numChannels) + " channels, " +
+                                                           std::to_string(bytesPerSample) + " bytes, " +
+                                                           std::to_string(numSamples) + " samples");
+                        }
+                    }
+                }
+            }
+        }
+        return ok;
+    }
+
+    /**
+     * Checks the interleaved integers and floats for every channel count, sample width and shift.
+     */
+    bool testInterleave() {
+        bool ok = true;
+        const uint_fast32_t maxSamples = 700;
+        for (uint_fast8_t numChannels = 1; numChannels <= 8; numChannels++) {
+            for (int_fast32_t depth : {8, 12, 16, 20, 24, 32}) {
+                std::vector<std::vector<int_fast32_t>> channels(numChannels, std::vector<int_fast32_t>(maxSamples));
+                std::vector<const int_fast32_t *> samples;
+                for (std::vector<int_fast32_t> &ch : channels) {
+                    for (int_fast32_t &s : ch)
+                        s = (int_fast32_t)randomSample(depth);
+                    samples.push_back(ch.data());
+                }
+                auto offset = (uint_fast64_t)randomBelow(16);
+                float scale = 1.0f / (float)((uint_fast64_t)1 << (depth - 1));
+                for (uint_fast32_t numSamples : {0u, 1u, 7u, 8u, 17u, 100u, 683u}) {
+                    std::string details = std::to_string(numChannels) + " channels, depth " + std::to_string(depth) +
+                                          ", " + std::to_string(numSamples) + " samples";
+                    for (uint_fast8_t bytesPerSample = 2; bytesPerSample <= 4; bytesPerSample++) {
+                        int_fast32_t shift = bytesPerSample * 8 - depth;
+                        size_t size = (size_t)numChannels * numSamples * bytesPerSample;
+                        std::vector<uint_fast8_t> expected(size);
+                        getScalar().interleaveInt(samples.data(), numChannels, offset, numSamples, shift,
+                                                  bytesPerSample, expected.data());
+                        for (const Common::Kernels *kernels : getTables()) {
+                            std::vector<uint_fast8_t> result(size);
+                            kernels->interleaveInt(samples.data(), numChannels, offset, numSamples, shift,
+                                                   bytesPerSample, result.data());
+                            if (result != expected) {
+                                ok = fail(*kernels, "interleaveInt", details + ", " +
+                                                                     std::to_string(bytesPerSample) + " bytes");
+                            }
+                        }
+                    }
+                    std::vector<float> expected((size_t)numChannels * numSamples);
+                    getScalar().interleaveFloat(samples.data(), numChannels, offset, numSamples, scale,
+                                                expected.data());
+                    for (const Common::Kernels *kernels : getTables()) {
+                        std::vector<float> result(expected.size());
+                        kernels->interleaveFloat(samples.data(), numChannels, offset, numSamples, scale,
+                                                 result.data());
+                        // Empty vectors may have null data, which memcmp() must not be given even for 0 bytes
+                        if (!result.empty() &&
+                                std::memcmp(result.data(), expected.data(), result.size() * sizeof(float)) != 0)
+                            ok = fail(*kernels, "interleaveFloat", details);
+                    }
+                }
+            }
+        }
+        return ok;
+    }
+
+    /**
+     * Prints the throughput of unpacking a few common layouts at every level, to compare the vector kernels with
+     * the portable loop.
+     */
+    void timeUnpack() {
+        const uint_fast32_t numSamples = 1 << 16;
+        const struct {
+            uint_fast8_t numChannels;
+            uint_fast8_t bytesPerSample;
+        } layouts[] = {{2, 2}, {2, 3}, {6, 3}, {8, 4}};
+        std::cout << "unpackPcm throughput in MB/s of PCM:\n";
+        for (const auto &layout : layouts) {
+            std::vector<uint_fast8_t> bytes((size_t)layout.numChannels * numSamples * layout.bytesPerSample);
+            for (uint_fast8_t &b : bytes)
+                b = (uint_fast8_t)(rng() & 0xFF);
+            std::vector<std::vector<int_fast32_t>> channels(layout.numChannels,
+                                                            std::vector<int_fast32_t>(numSamples));
+            std::vector<int_fast32_t *> samples;
+            for (std::vector<int_fast32_t> &ch : channels)
+                samples.push_back(ch.data());
+            std::cout << "  " << (int)layout.numChannels << " channels, " << (int)layout.bytesPerSample << " bytes:";
+            for (const Common::Kernels *kernels : getTables()) {
+                const int repeat = 50;
+                auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < repeat; i++) {
+                    kernels->unpackPcm(bytes.data(), layout.numChannels, 0, numSamples, layout.bytesPerSample,
+                                       samples.data());
+                }
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                std::cout << " " << Common::CpuFeatures::getLevelName(kernels->level) << " " << std::fixed
+                          << std::setprecision(0) << bytes.size() * repeat / seconds / 1e6;
+            }
+            std::cout << "\n";
+        }
+    }
+
+    /**
+     * Checks the unpacked samples for every channel count and sample width, and prints the throughput.
+     */
+    bool testUnpack() {
+        bool ok = true;
+        const uint_fast32_t maxSamples = 700;
+        for (uint_fast8_t numChannels = 1; numChannels <= 8; numChannels++) {
+            for (uint_fast8_t bytesPerSample = 1; bytesPerSample <= 4; bytesPerSample++) {
+                std::vector<uint_fast8_t> bytes((size_t)numChannels * maxSamples * bytesPerSample);
+                for (uint_fast8_t &b : bytes)
+                    b = (uint_fast8_t)(rng() & 0xFF);
+                auto offset = (uint_fast64_t)randomBelow(16);
+                for (uint_fast32_t numSamples : {0u, 1u, 5u, 8u, 17u, 100u, 683u}) {
+                    // Unwritten samples keep the fill value, so writes out of bounds show up as differences too
+                    std::vector<std::vector<int_fast32_t>> expected(
+                            numChannels, std::vector<int_fast32_t>(offset + maxSamples, 12345));
+                    std::vector<int_fast32_t *> expectedPtrs;
+                    for (std::vector<int_fast32_t> &ch : expected)
+                        expectedPtrs.push_back(ch.data());
+                    getScalar().unpackPcm(bytes.data(), numChannels, offset, numSamples, bytesPerSample,
+                                          expectedPtrs.data());
+                    for (const Common::Kernels *kernels : getTables()) {
+                        std::vector<std::vector<int_fast32_t>> result(
+                                numChannels, std::vector<int_fast32_t>(offset + maxSamples, 12345));
+                        std::vector<int_fast32_t *> resultPtrs;
+                        for (std::vector<int_fast32_t> &ch : result)
+                            resultPtrs.push_back(ch.data());
+                        kernels->unpackPcm(bytes.data(), numChannels, offset, numSamples, bytesPerSample,
+                                           resultPtrs.data());
+                        if (result != expected) {
+                            ok = fail(*kernels, "unpackPcm", std::to_string(numChannels) + " channels, " +
+                                                             std::to_string(bytesPerSample) + " bytes, " +
+                                                             std::to_string(numSamples) + " samples");
+                        }
+                    }
+                }
+            }
+        }
+        timeUnpack();
+        return ok;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::string name = argc == 2 ? argv[1] : "";
+    bool ok;
+    try {
+        if (name == "crc")
+            ok = testCrc();
+        else if (name == "rice")
+            ok = testRice();
+        else if (name == "lpc")
+            ok = testLpc();
+        else if (name == "autocorrelation")
+            ok = testAutocorrelation();
+        else if (name == "pack")
+            ok = testPack();
+        else if (name == "unpack")
+            ok = testUnpack();
+        else if (name == "interleave")
+            ok = testInterleave();
+        else {
+            std::cerr << "Usage: " << argv[0] << " {crc|rice|lpc|autocorrelation|pack|unpack|interleave}\n";
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << "Levels tested:";
+    for (const Common::Kernels *kernels : getTables())
+        std::cout << " " << Common::CpuFeatures::getLevelName(kernels->level);
+    std::cout << "\n" << (ok ? "PASS" : "FAIL: kernels differ between instruction set levels") << "\n";
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,174 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "LibFlacCodec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include <FLAC/stream_decoder.h>
+#include <FLAC/stream_encoder.h>
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Bench {
+            namespace {
+                /**
+                 * The in-memory file written by the encoder callbacks.
+                 */
+                class EncodeTarget final {
+                public:
+                    std::string *data;
+
+                    uint64_t position;
+                };
+
+                FLAC__StreamEncoderWriteStatus writeEncoded(const FLAC__StreamEncoder *, const FLAC__byte buffer[],
+                                                            size_t bytes, unsigned, unsigned, void *client) {
+                    auto *target = static_cast<EncodeTarget *>(client);
+                    std::string &data = *target->data;
+                    if (target->position + bytes > data.size())
+                        data.resize((size_t)target->position + bytes);
+                    std::memcpy(&data[(size_t)target->position], buffer, bytes);
+                    target->position += bytes;
+                    return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+                }
+
+                FLAC__StreamEncoderSeekStatus seekEncoded(const FLAC__StreamEncoder *, FLAC__uint64 offset,
+                                                          void *client) {
+                    static_cast<EncodeTarget *>(client)->position = offset;
+                    return FLAC__STREAM_ENCODER_SEEK_STATUS_OK;
+                }
+
+                FLAC__StreamEncoderTellStatus tellEncoded(const FLAC__StreamEncoder *, FLAC__uint64 *offset,
+                                                          void *client) {
+                    *offset = static_cast<EncodeTarget *>(client)->position;
+                    return FLAC__STREAM_ENCODER_TELL_STATUS_OK;
+                }
+
+                /**
+                 * The in-memory file read by the decoder callbacks, and the samples it decodes to.
+                 */
+                class DecodeSource final {
+                public:
+                    const std::string *data;
+
+                    size_t position;
+
+                    std::vector<std::vector<int32_t>> *out;
+
+                    uint64_t numSamples;
+
+                    bool failed;
+                };
+
+                FLAC__StreamDecoderReadStatus readEncoded(const FLAC__StreamDecoder *, FLAC__byte buffer[],
+                                                          size_t *bytes, void *client) {
+                    auto *source = static_cast<DecodeSource *>(client);
+                    size_t n = std::min(*bytes, source->data->size() - source->position);
+                    std::memcpy(buffer, source->data->data() + source->position, n);
+                    source->position += n;
+                    *bytes = n;
+                    return n > 0 ? FLAC__STREAM_DECODER_READ_STATUS_CONTINUE
+                                 : FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+                }
+
+                FLAC__StreamDecoderWriteStatus writeDecoded(const FLAC__StreamDecoder *, const FLAC__Frame *frame,
+                                                            const FLAC__int32 *const buffer[], void *client) {
+                    auto *source = static_cast<DecodeSource *>(client);
+                    std::vector<std::vector<int32_t>> &out = *source->out;
+                    unsigned channels = frame->header.channels;
+                    unsigned blockSize = frame->header.blocksize;
+                    if (out.size() != channels)
+                        out.resize(channels);
+                    for (unsigned ch = 0; ch < channels; ch++) {
+                        std::vector<int32_t> &dest = out[ch];
+                        if (dest.size() < source->numSamples + blockSize)
+                            dest.resize((size_t)std::max(source->numSamples + blockSize, (uint64_t)dest.size() * 2));
+                        std::copy(buffer[ch], buffer[ch] + blockSize, dest.begin() + (size_t)source->numSamples);
+                    }
+                    source->numSamples += blockSize;
+                    return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+                }
+
+                void decodeError(const FLAC__StreamDecoder *, FLAC__StreamDecoderErrorStatus, void *client) {
+                    static_cast<DecodeSource *>(client)->failed = true;
+                }
+            }
+
+            void LibFlacCodec::encode(const Common::StreamInfo &format, const int32_t *const samples[], int level,
+                                      std::string *out) {
+                if (samples == nullptr || out == nullptr)
+                    throw std::invalid_argument("Samples and output cannot be null");
+                if (level < 0 || level > 8)
+                    throw std::invalid_argument("Invalid compression level");
+
+                FLAC__StreamEncoder *enc = FLAC__stream_encoder_new();
+                if (enc == nullptr)
+                    throw std::bad_alloc();
+                out->clear();
+                EncodeTarget target{out, 0};
+                bool ok = FLAC__stream_encoder_set_channels(enc, format.numChannels) &&
+                          FLAC__stream_encoder_set_bits_per_sample(enc, format.sampleDepth) &&
+                          FLAC__stream_encoder_set_sample_rate(enc, format.sampleRate) &&
+                          FLAC__stream_encoder_set_compression_level(enc, (unsigned)level) &&
+                          FLAC__stream_encoder_set_total_samples_estimate(enc, format.numSamples) &&
+                          FLAC__stream_encoder_init_stream(enc, writeEncoded, seekEncoded, tellEncoded, nullptr,
+                                                           &target) == FLAC__STREAM_ENCODER_INIT_STATUS_OK;
+
+                // Feed the samples in chunks, because the interface takes 32-bit unsigned counts
+                const uint64_t CHUNK = 1 << 20;
+                std::vector<const FLAC__int32 *> pointers(format.numChannels);
+                for (uint64_t off = 0; ok && off < format.numSamples; off += CHUNK) {
+                    for (unsigned ch = 0; ch < format.numChannels; ch++)
+                        pointers[ch] = samples[ch] + off;
+                    auto n = (unsigned)std::min(CHUNK, format.numSamples - off);
+                    ok = FLAC__stream_encoder_process(enc, pointers.data(), n);
+                }
+                ok = FLAC__stream_encoder_finish(enc) && ok;
+                FLAC__stream_encoder_delete(enc);
+                if (!ok)
+                    throw std::runtime_error("libFLAC failed to encode");
+            }
+
+            void LibFlacCodec::decode(const std::string &data, std::vector<std::vector<int32_t>> *out) {
+                if (out == nullptr)
+                    throw std::invalid_argument("Output cannot be null");
+
+                FLAC__StreamDecoder *dec = FLAC__stream_decoder_new();
+                if (dec == nullptr)
+                    throw std::bad_alloc();
+                DecodeSource source{&data, 0, out, 0, false};
+                bool ok = FLAC__stream_decoder_init_stream(
+                        dec, readEncoded, nullptr, nullptr, nullptr, nullptr, writeDecoded, nullptr, decodeError,
+                        &source) == FLAC__STREAM_DECODER_INIT_STATUS_OK &&
+                          FLAC__stream_decoder_process_until_end_of_stream(dec);
+                ok = FLAC__stream_decoder_finish(dec) && ok && !source.failed;
+                FLAC__stream_decoder_delete(dec);
+                if (!ok)
+                    throw std::runtime_error("libFLAC failed to decode");
+                for (std::vector<int32_t> &ch : *out)
+                    ch.resize((size_t)source.numSamples);
+            }
+        }
+    }
+}
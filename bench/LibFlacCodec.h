@@ -0,0 +1,64 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_LIBFLACCODEC_H
+#define NAYUKI_LIBFLACCODEC_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../common/StreamInfo.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Bench {
+            /**
+             * Encodes and decodes whole FLAC files in memory with the reference implementation (libFLAC), as a point of
+             * comparison for benchmarks. Only available when the build was configured with `NAYUKI_BENCH_LIBFLAC`.
+             */
+            class LibFlacCodec final {
+            public:
+                LibFlacCodec() = delete;
+
+                /**
+                 * Encodes the given samples as a complete FLAC file with the given libFLAC compression level, using
+                 * the block size implied by that level.
+                 * @param[in]  format  the format of the samples (sample rate, number of channels, sample depth and
+                 *                     number of samples are used)
+                 * @param[in]  samples the samples, where each subarray is a channel (all not `null`)
+                 * @param[in]  level   the compression level, in the range [0, 8]
+                 * @param[out] out     the string to store the encoded file into (not `null`)
+                 */
+                static void encode(const Common::StreamInfo &format, const int32_t *const samples[], int level,
+                                   std::string *out);
+
+                /**
+                 * Decodes the given complete FLAC file into one vector of samples per channel.
+                 * @param[in]  data the encoded file
+                 * @param[out] out  the vectors to store the channels into, which are resized as needed (not `null`)
+                 */
+                static void decode(const std::string &data, std::vector<std::vector<int32_t>> *out);
+            };
+        }
+    }
+}
+
+#endif
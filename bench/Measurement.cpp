@@ -0,0 +1,95 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "Measurement.h"
+
+#include <ctime>
+#include <fstream>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Bench {
+            Stopwatch::Stopwatch() {
+                restart();
+            }
+
+            void Stopwatch::restart() {
+                wallStart = std::chrono::steady_clock::now();
+                cpuStart = getProcessCpuSeconds();
+            }
+
+            double Stopwatch::getWallSeconds() const {
+                return std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+            }
+
+            double Stopwatch::getCpuSeconds() const {
+                return getProcessCpuSeconds() - cpuStart;
+            }
+
+            double Stopwatch::getProcessCpuSeconds() {
+#if defined(CLOCK_PROCESS_CPUTIME_ID)
+                timespec ts{};
+                if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) == 0)
+                    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+                return (double)std::clock() / CLOCKS_PER_SEC;
+            }
+
+            bool PeakMemory::reset() {
+#if defined(__linux__)
+                // Writing 5 resets the VmHWM field of /proc/self/status (Linux 4.0+)
+                std::ofstream out("/proc/self/clear_refs");
+                out << "5";
+                out.flush();
+                return static_cast<bool>(out);
+#else
+                return false;
+#endif
+            }
+
+            uint_fast64_t PeakMemory::getPeakKib() {
+#if defined(__linux__)
+                std::ifstream in("/proc/self/status");
+                std::string line;
+                while (std::getline(in, line)) {
+                    if (line.compare(0, 6, "VmHWM:") == 0)
+                        return std::stoull(line.substr(6));
+                }
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+                rusage usage{};
+                if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(__APPLE__)
+                    return (uint_fast64_t)usage.ru_maxrss / 1024;  // Bytes on macOS
+#else
+                    return (uint_fast64_t)usage.ru_maxrss;
+#endif
+                }
+#endif
+                return 0;
+            }
+        }
+    }
+}
@@ -0,0 +1,96 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_MEASUREMENT_H
+#define NAYUKI_MEASUREMENT_H
+
+#include <chrono>
+#include <cstdint>
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Bench {
+            /**
+             * Measures the elapsed wall clock time and the CPU time consumed by this process since construction or the
+             * last restart.
+             */
+            class Stopwatch final {
+            private:
+                std::chrono::steady_clock::time_point wallStart;
+
+                double cpuStart;
+
+            public:
+                /**
+                 * Constructs a running stopwatch.
+                 */
+                Stopwatch();
+
+                /**
+                 * Resets both measured times to zero.
+                 */
+                void restart();
+
+                /**
+                 * Returns the wall clock time elapsed since the start, in seconds.
+                 * @return the elapsed wall clock time
+                 */
+                double getWallSeconds() const;
+
+                /**
+                 * Returns the CPU time (user plus system, summed over all threads) consumed since the start, in
+                 * seconds.
+                 * @return the consumed CPU time
+                 */
+                double getCpuSeconds() const;
+
+                /**
+                 * Returns the CPU time consumed by this process so far, in seconds.
+                 * @return the process CPU time
+                 */
+                static double getProcessCpuSeconds();
+            };
+
+            /**
+             * Reads the peak resident set size of this process. On Linux the peak can be reset, so that the peak of
+             * each benchmark run is measured separately; elsewhere the peak is the high water mark since the process
+             * started.
+             */
+            class PeakMemory final {
+            public:
+                PeakMemory() = delete;
+
+                /**
+                 * Resets the peak resident set size to the current resident set size, if the platform supports it.
+                 * @return whether the peak was reset
+                 */
+                static bool reset();
+
+                /**
+                 * Returns the peak resident set size in kibibytes, or 0 if it cannot be determined.
+                 * @return the peak resident set size
+                 */
+                static uint_fast64_t getPeakKib();
+            };
+        }
+    }
+}
+
+#endif
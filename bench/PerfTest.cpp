@@ -0,0 +1,409 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Measurement.h"
+#include "SyntheticCorpus.h"
+
+#include "../common/CpuFeatures.h"
+#include "../common/FrameInfo.h"
+#include "../common/Kernels.h"
+#include "../decode/ByteArrayFlacInput.h"
+#include "../decode/FlacDecoder.h"
+#include "../encode/BitOutputStream.h"
+
+using namespace Nayuki::FLAC;
+
+/*
+ * Performance regression test. Each benchmark measures a throughput (units per second) and divides it by the
+ * throughput of a fixed calibration loop measured right before, which makes the score roughly independent of the
+ * speed of the machine. The calibration loop is scalar integer work, so the score still depends on which kernels
+ * the dispatcher selected; baselines are therefore kept per kernel level, as `NAME.LEVEL` (e.g. `crc.avx2`), and a
+ * score is only compared against the baseline of the active level (which `NAYUKI_CPU_LEVEL` can lower). The test
+ * fails when the score drops by more than the threshold. Exit code 77 means skipped (CTest's SKIP_RETURN_CODE), which
+ * happens in builds with assertions enabled since their timings are meaningless, and when there is no baseline for
+ * the active level.
+ */
+
+namespace {
+    /**
+     * The minimum wall clock time of one timed repetition, in seconds.
+     */
+    const double MIN_SECONDS = 0.1;
+
+    /**
+     * The number of timed repetitions; the fastest one counts.
+     */
+    const int REPETITIONS = 5;
+
+    /**
+     * Accumulates results so that the compiler cannot optimize away the benchmarked work.
+     */
+    volatile uint_fast64_t sink;
+
+    /**
+     * Runs the given workload repeatedly and returns the best throughput in units per second. The workload performs
+     * one iteration and returns the number of units it processed.
+     */
+    double measure(const std::function<uint_fast64_t()> &workload) {
+        workload();  // Warm up caches and lazily initialized tables
+        double best = 0;
+        for (int i = 0; i < REPETITIONS; i++) {
+            Bench::Stopwatch timer;
+            uint_fast64_t units = 0;
+            double elapsed;
+            do {
+                units += workload();
+                elapsed = timer.getWallSeconds();
+            } while (elapsed < MIN_SECONDS);
+            best = std::max(units / elapsed, best);
+        }
+        return best;
+    }
+
+    /**
+     * A fixed mix of integer arithmetic, shifts, branches and cache-resident memory accesses, roughly like the
+     * decoder's inner loops. Returns the number of loop iterations.
+     */
+    uint_fast64_t calibrationLoop() {
+        static uint32_t table[16384];
+        const uint_fast64_t ITERATIONS = 1 << 20;
+        uint32_t x = 1;
+        uint32_t sum = 0;
+        for (uint_fast64_t i = 0; i < ITERATIONS; i++) {
+            x = x * 1103515245U + 12345U;
+            uint32_t &t = table[(x >> 14) & 16383];
+            t += x >> 24;
+            sum += (t & 1) != 0 ? t >> 3 : t << 1;
+        }
+        sink = sink + sum;
+        return ITERATIONS;
+    }
+
+    /**
+     * Returns the given number of pseudorandom bytes (fixed seed).
+     */
+    std::vector<uint_fast8_t> randomBytes(size_t n) {
+        std::vector<uint_fast8_t> result(n);
+        uint_fast64_t state = 0x123456789ABCDEFULL;
+        for (uint_fast8_t &b : result) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            b = (uint_fast8_t)(state >> 56);
+        }
+        return result;
+    }
+
+    /**
+     * Returns the bytes written to the given string stream.
+     */
+    std::vector<uint_fast8_t> toBytes(const std::ostringstream &out) {
+        std::string s = out.str();
+        return std::vector<uint_fast8_t>(s.begin(), s.end());
+    }
+
+    /**
+     * Rice decoding: decodes partitions of 4096 values at every parameter from 0 to 14, with values distributed
+     * roughly like prediction residuals for that parameter.
+     */
+    double benchRice() {
+        const int_fast32_t COUNT = 4096;
+        const int_fast32_t MAX_PARAM = 14;
+        std::ostringstream buf;
+        {
+            Encode::BitOutputStream out(&buf);
+            std::vector<uint_fast8_t> noise = randomBytes((size_t)COUNT * (MAX_PARAM + 1) * 2);
+            size_t k = 0;
+            for (int_fast32_t param = 0; param <= MAX_PARAM; param++) {
+                for (int_fast32_t i = 0; i < COUNT; i++, k += 2) {
+                    // Geometric-ish magnitudes around 2^param, zigzag encoded
+                    uint_fast32_t mag = ((uint_fast32_t)noise[k] << param) >> 7;
+                    uint_fast32_t val = (mag << 1) ^ (noise[k + 1] & 1);
+                    for (uint_fast32_t q = val >> param; q > 0; q--)
+                        out.writeInt(1, 0);
+                    out.writeInt(1, 1);
+                    if (param > 0)
+                        out.writeInt((int_fast8_t)param, (int_fast32_t)(val & ((1U << param) - 1)));
+                }
+            }
+            out.writeInt(32, 0);  // Padding so that the input can always look ahead
+            out.flush();
+        }
+        std::vector<uint_fast8_t> data = toBytes(buf);
+        std::vector<int_fast64_t> result(COUNT);
+        Decode::ByteArrayFlacInput in(data.data(), data.size());
+        return measure([&]() {
+            in.seekTo(0);
+            for (int_fast32_t param = 0; param <= MAX_PARAM; param++)
+                in.readRiceSignedInts(param, result.data(), 0, COUNT);
+            sink = sink + (uint_fast64_t)result[COUNT - 1];
+            return (uint_fast64_t)COUNT * (MAX_PARAM + 1);
+        });
+    }
+
+    /**
+     * CRC: reads 1 MiB of bytes while updating the CRC-8 and CRC-16. Units are bytes.
+     */
+    double benchCrc() {
+        const size_t LEN = 1 << 20;
+        std::vector<uint_fast8_t> data = randomBytes(LEN);
+        std::vector<uint_fast8_t> buf(LEN);
+        Decode::ByteArrayFlacInput in(data.data(), data.size());
+        return measure([&]() {
+            in.seekTo(0);
+            in.resetCrcs();
+            in.readFully(buf.data(), LEN);
+            sink = sink + in.getCrc16() + in.getCrc8();
+            return (uint_fast64_t)LEN;
+        });
+    }
+
+    /**
+     * Frame header parsing: parses a sequence of frame headers with various block sizes, sample rates and channel
+     * assignments. Units are headers.
+     */
+    double benchFrameParse() {
+        const int_fast32_t COUNT = 4096;
+        const int_fast32_t BLOCK_SIZES[] = {192, 576, 1152, 2000, 4096, 4608, 8192};
+        const int_fast32_t SAMPLE_RATES[] = {8000, 22050, 44100, 48000, 96000, 50000, 44000};
+        std::ostringstream buf;
+        {
+            Encode::BitOutputStream out(&buf);
+            for (int_fast32_t i = 0; i < COUNT; i++) {
+                Common::FrameInfo info;
+                info.frameIndex = -1;
+                info.sampleOffset = (int_fast64_t)i * 4096;
+                info.channelAssignment = i % 11;
+                info.numChannels = info.channelAssignment < 8 ? info.channelAssignment + 1 : 2;
+                info.blockSize = BLOCK_SIZES[i % 7];
+                info.sampleRate = SAMPLE_RATES[i % 7];
+                info.sampleDepth = i % 2 == 0 ? 16 : 24;
+                info.writeHeader(&out);
+            }
+            out.writeInt(32, 0);
+            out.flush();
+        }
+        std::vector<uint_fast8_t> data = toBytes(buf);
+        Decode::ByteArrayFlacInput in(data.data(), data.size());
+        Common::FrameInfo info;
+        return measure([&]() {
+            in.seekTo(0);
+            for (int_fast32_t i = 0; i < COUNT; i++) {
+                Common::FrameInfo::readFrame(&in, &info);
+                sink = sink + (uint_fast64_t)info.blockSize;
+            }
+            return (uint_fast64_t)COUNT;
+        });
+    }
+
+    /**
+     * Full decode: decodes a few files of the synthetic corpus from memory. Units are samples (summed over channels).
+     */
+    double benchDecode() {
+        std::vector<std::vector<uint_fast8_t>> files;
+        uint_fast64_t maxSamples = 0;
+        uint_fast64_t totalSamples = 0;
+        const Bench::SyntheticCorpus::Entry *prev = nullptr;
+        std::vector<Bench::SyntheticCorpus::Entry> entries = Bench::SyntheticCorpus::getDefaultEntries(2, 1);
+        for (const Bench::SyntheticCorpus::Entry &entry : entries) {
+            // One file per signal type keeps the setup time low but covers every subframe type
+            if (prev != nullptr && prev->type == entry.type)
+                continue;
+            prev = &entry;
+            int_fast32_t **samples = Bench::SyntheticCorpus::generate(entry);
+            std::stringstream out(std::ios::in | std::ios::out | std::ios::binary);
+            Bench::SyntheticCorpus::writeFlac(entry, samples, Encode::SubframeEncoder::SearchOptions::SUBSET_MEDIUM,
+                                              &out);
+            Bench::SyntheticCorpus::deleteSamples(samples, entry.numChannels);
+            std::string s = out.str();
+            files.emplace_back(s.begin(), s.end());
+            maxSamples = std::max(entry.numSamples, maxSamples);
+            totalSamples += entry.numSamples * entry.numChannels;
+        }
+
+        std::vector<int_fast32_t> buffer(8 * (maxSamples + 65536));
+        int_fast32_t *channels[8];
+        for (int i = 0; i < 8; i++)
+            channels[i] = buffer.data() + i * (maxSamples + 65536);
+        return measure([&]() {
+            for (std::vector<uint_fast8_t> &file : files) {
+                Decode::FlacDecoder dec(new Decode::ByteArrayFlacInput(file.data(), file.size()));
+                while (dec.readAndHandleMetadataBlock(nullptr, nullptr));
+                uint_fast32_t pos = 0;
+                int_fast32_t n;
+                while ((n = dec.readAudioBlock(channels, pos)) > 0)
+                    pos += n;
+                sink = sink + pos;
+            }
+            return totalSamples;
+        });
+    }
+
+    /**
+     * Reads the baseline file, which has one `name score` pair per line. Blank lines and lines starting with `#` are
+     * ignored.
+     */
+    std::map<std::string, double> readBaselines(const std::string &path, std::vector<std::string> &lines) {
+        std::map<std::string, double> result;
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            lines.push_back(line);
+            std::istringstream fields(line);
+            std::string name;
+            double score;
+            if (line.empty() || line[0] == '#' || !(fields >> name >> score))
+                continue;
+            result[name] = score;
+        }
+        return result;
+    }
+
+    /**
+     * Replaces or appends the score of the given baseline key in the baseline file.
+     */
+    void updateBaseline(const std::string &path, std::vector<std::string> lines, const std::string &key,
+                        double score) {
+        std::ostringstream entry;
+        entry << key << " " << std::setprecision(4) << score;
+        bool found = false;
+        for (std::string &line : lines) {
+            std::istringstream fields(line);
+            std::string field;
+            if (!line.empty() && line[0] != '#' && fields >> field && field == key) {
+                line = entry.str();
+                found = true;
+            }
+        }
+        if (!found)
+            lines.push_back(entry.str());
+        std::ofstream out(path);
+        for (const std::string &line : lines)
+            out << line << "\n";
+        if (!out)
+            throw std::runtime_error("Cannot write " + path);
+    }
+
+    void printUsage(const char *program) {
+        std::cerr << "Usage: " << program << " [options] BENCHMARK\n"
+                  << "Benchmarks: rice, crc, frameparse, decode\n\n"
+                  << "Options:\n"
+                  << "  --baseline FILE  file with the baseline scores, one per benchmark and kernel level\n"
+                  << "  --threshold T    allowed relative slowdown before failing (default 0.25)\n"
+                  << "  --update         store the measured score as the new baseline of the active kernel\n"
+                  << "                   level instead of comparing\n"
+                  << "  --force          also run in builds with assertions enabled\n";
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::string baselinePath;
+    std::string name;
+    double threshold = 0.25;
+    bool update = false;
+    bool force = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--baseline" && i + 1 < argc)
+            baselinePath = argv[++i];
+        else if (arg == "--threshold" && i + 1 < argc)
+            threshold = std::strtod(argv[++i], nullptr);
+        else if (arg == "--update")
+            update = true;
+        else if (arg == "--force")
+            force = true;
+        else if (!arg.empty() && arg[0] != '-' && name.empty())
+            name = arg;
+        else {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    const std::map<std::string, std::function<double()>> benchmarks = {
+        {"rice",       benchRice},
+        {"crc",        benchCrc},
+        {"frameparse", benchFrameParse},
+        {"decode",     benchDecode}
+    };
+    auto bench = benchmarks.find(name);
+    if (bench == benchmarks.end() || !(threshold >= 0 && threshold < 1) || (update && baselinePath.empty())) {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+#ifndef NDEBUG
+    if (!force) {
+        std::cout << "Skipped: assertions are enabled, so timings are not representative\n";
+        return 77;
+    }
+#else
+    (void)force;
+#endif
+
+    try {
+        // The score depends on the vector kernels in use, so it is only comparable within one level
+        std::string key = name + "." + Common::CpuFeatures::getLevelName(Common::Kernels::getLevel());
+        double calibration = measure(calibrationLoop);
+        double throughput = bench->second();
+        double score = throughput / calibration;
+        std::cout << key << ": " << std::setprecision(4) << throughput << " units/s, calibration "
+                  << calibration << " iterations/s, score " << score << "\n";
+
+        if (baselinePath.empty())
+            return EXIT_SUCCESS;
+        std::vector<std::string> lines;
+        std::map<std::string, double> baselines = readBaselines(baselinePath, lines);
+        if (update) {
+            updateBaseline(baselinePath, lines, key, score);
+            std::cout << "Baseline updated\n";
+            return EXIT_SUCCESS;
+        }
+        auto baseline = baselines.find(key);
+        if (baseline == baselines.end()) {
+            std::cout << "Skipped: no baseline for " << key << "; rerun with --update to store one\n";
+            return 77;
+        }
+        double change = score / baseline->second - 1;
+        std::cout << "Baseline " << baseline->second << ", change " << std::showpos << std::fixed
+                  << std::setprecision(1) << change * 100 << "%\n" << std::noshowpos;
+        if (change < -threshold) {
+            std::cout << "FAILED: throughput regressed by more than " << threshold * 100 << "%\n";
+            return EXIT_FAILURE;
+        }
+        if (change > threshold)
+            std::cout << "Note: much faster than the baseline; consider updating it with --update\n";
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
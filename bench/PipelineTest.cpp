@@ -0,0 +1,724 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SyntheticCorpus.h"
+
+#include "../common/FrameInfo.h"
+#include "../common/PipelineStats.h"
+#include "../common/SampleFormat.h"
+#include "../common/SpscRing.h"
+#include "../common/ThreadPool.h"
+#include "../decode/AbstractFlacLowLevelInput.h"
+#include "../decode/BatchDecoder.h"
+#include "../decode/ByteArrayFlacInput.h"
+#include "../decode/DataFormatException.h"
+#include "../decode/FlacDecoder.h"
+
+using namespace Nayuki::FLAC;
+
+/*
+ * Pipeline test. Checks that the lock-free rings deliver every item once and in order, that decoding through the
+ * pipeline returns exactly the samples of serial decoding (also around seeks and when converted to interleaved
+ * floats), that corrupt frames and MD5 mismatches are reported after all the good frames before them, that batch
+ * decoding into a padded float tensor matches serial decoding, that neither depends on the input buffer size, and that
+ * peeking ahead in the input leaves the position and CRCs untouched, that frames are parsed without refilling the
+ * input buffer in their middle, that a frame header cut short reports the end of data, that the largest peek is
+ * never cut short before the end of the stream, and that frames scanned as handles decode to the same samples in any
+ * order.
+ */
+
+namespace {
+    /**
+     * Passes many items through small rings between two threads and checks their order.
+     */
+    bool testRing() {
+        bool ok = true;
+        for (size_t capacity : {1, 2, 64}) {
+            const uint_fast64_t count = 200000;
+            std::vector<uint_fast64_t> items(count);
+            for (uint_fast64_t i = 0; i < count; i++)
+                items[i] = i;
+            Common::SpscRing<uint_fast64_t> ring(capacity);
+            std::thread producer([&] {
+                for (uint_fast64_t &item : items)
+                    ring.push(&item);
+                ring.close();
+            });
+            uint_fast64_t received = 0;
+            uint_fast64_t wrong = 0;
+            while (uint_fast64_t *item = ring.pop()) {
+                wrong += *item != received;
+                received++;
+            }
+            producer.join();
+            std::cout << "capacity " << ring.getCapacity() << ": " << received << " items, " << wrong
+                      << " out of order, " << ring.getFullWaits() << " full waits, " << ring.getEmptyWaits()
+                      << " empty waits\n";
+            ok &= received == count && wrong == 0 && ring.getPushCount() == count;
+            ok &= !ring.push(&items[0]) && ring.pop() == nullptr;
+        }
+        return ok;
+    }
+
+    /**
+     * Returns the given entry encoded as a FLAC file.
+     */
+    std::string makeFile(const Bench::SyntheticCorpus::Entry &entry) {
+        int_fast32_t **samples = Bench::SyntheticCorpus::generate(entry);
+        std::stringstream out(std::ios::in | std::ios::out | std::ios::binary);
+        Bench::SyntheticCorpus::writeFlac(entry, samples, Encode::SubframeEncoder::SearchOptions::SUBSET_MEDIUM, &out);
+        Bench::SyntheticCorpus::deleteSamples(samples, entry.numChannels);
+        return out.str();
+    }
+
+    /**
+     * Decodes the given file into one array per channel, through a pipeline on the given pool if `pipelined` is set,
+     * and optionally seeking to the given position after the first block. Stops at the first error, whose message is
+     * stored.
+     */
+    std::vector<std::vector<int_fast32_t>> decode(std::string file, bool pipelined, Common::ThreadPool *pool,
+                                                  int_fast64_t seekPos, std::string *error, uint_fast64_t *frames) {
+        std::vector<uint_fast8_t> bytes(file.begin(), file.end());
+        Decode::FlacDecoder dec(new Decode::ByteArrayFlacInput(bytes.data(), bytes.size()));
+        while (dec.readAndHandleMetadataBlock(nullptr, nullptr));
+        int_fast32_t numChannels = dec.streamInfo->numChannels;
+        std::vector<std::vector<int_fast32_t>> result(numChannels);
+        std::vector<int_fast32_t> buffer(8 * 65536);
+        int_fast32_t *channels[8];
+        for (int i = 0; i < 8; i++)
+            channels[i] = buffer.data() + i * 65536;
+        if (pipelined)
+            dec.startPipeline(pool);
+        *frames = 0;
+        try {
+            while (true) {
+                int_fast32_t n;
+                if (seekPos != -1 && *frames == 1) {
+                    n = dec.seekAndReadAudioBlock((uint_fast64_t)seekPos, channels, 0);
+                    if (pipelined)
+                        dec.startPipeline(pool);
+                } else
+                    n = dec.readAudioBlock(channels, 0);
+                if (n == 0)
+                    break;
+                for (int_fast32_t ch = 0; ch < numChannels; ch++)
+                    result[ch].insert(result[ch].end(), channels[ch], channels[ch] + n);
+                (*frames)++;
+            }
+        } catch (const Decode::DataFormatException &e) {
+            *error = e.what();
+        }
+        if (pipelined) {
+            const Common::PipelineStats *stats = dec.getPipelineStats();
+            if (stats == nullptr || stats->getFrames(Common::PipelineStats::Stage::CODEC) == 0)
+                *error += " (no pipeline statistics)";
+        }
+        return result;
+    }
+
+    /**
+     * Decodes the given file through a pipeline on the given pool into interleaved floats.
+     */
+    std::vector<float> decodeFloats(std::string file, Common::ThreadPool *pool) {
+        std::vector<uint_fast8_t> bytes(file.begin(), file.end());
+        Decode::FlacDecoder dec(new Decode::ByteArrayFlacInput(bytes.data(), bytes.size()));
+        while (dec.readAndHandleMetadataBlock(nullptr, nullptr));
+        int_fast32_t numChannels = dec.streamInfo->numChannels;
+        std::vector<float> result;
+        std::vector<float> block((size_t)numChannels * 65536);
+        dec.startPipeline(pool);
+        while (int_fast32_t n = dec.readInterleavedBlock(Common::SampleFormat::FLOAT32, block.data()))
+            result.insert(result.end(), block.begin(), block.begin() + n * numChannels);
+        return result;
+    }
+
+    /**
+     * Decodes one file per signal type of the corpus serially and through pipelines, comparing the samples.
+     */
+    bool testDecode() {
+        bool ok = true;
+        Common::ThreadPool pool(3);
+        const Bench::SyntheticCorpus::Entry *prev = nullptr;
+        std::vector<Bench::SyntheticCorpus::Entry> entries = Bench::SyntheticCorpus::getDefaultEntries(1, 5);
+        for (const Bench::SyntheticCorpus::Entry &entry : entries) {
+            if (prev != nullptr && prev->type == entry.type)
+                continue;
+            prev = &entry;
+            std::string file = makeFile(entry);
+            for (int_fast64_t seekPos : {(int_fast64_t)-1, (int_fast64_t)(entry.numSamples / 3)}) {
+                std::string error;
+                uint_fast64_t frames;
+                std::vector<std::vector<int_fast32_t>> expected = decode(file, false, nullptr, seekPos, &error,
+                                                                         &frames);
+                for (Common::ThreadPool *p : {&pool, (Common::ThreadPool *)nullptr}) {
+                    std::string pipeError;
+                    uint_fast64_t pipeFrames;
+                    bool same = decode(file, true, p, seekPos, &pipeError, &pipeFrames) == expected &&
+                                pipeError.empty() && error.empty() && pipeFrames == frames;
+                    std::cout << entry.getName() << (seekPos != -1 ? ", seeking" : "") << ", "
+                              << (p != nullptr ? "pool" : "reader thread") << ": " << pipeFrames << " frames, "
+                              << (same ? "identical" : "DIFFERENT " + pipeError) << "\n";
+                    ok &= same;
+                }
+            }
+
+            // The interleaved floats must be the serially decoded samples divided by 2^(depth - 1)
+            std::string error;
+            uint_fast64_t frames;
+            std::vector<std::vector<int_fast32_t>> planar = decode(file, false, nullptr, -1, &error, &frames);
+            std::vector<float> expected;
+            float scale = 1.0f / (float)((uint_fast64_t)1 << (entry.sampleDepth - 1));
+            for (size_t i = 0; i < planar.at(0).size(); i++) {
+                for (const std::vector<int_fast32_t> &ch : planar)
+                    expected.push_back((float)ch[i] * scale);
+            }
+            bool same = decodeFloats(file, &pool) == expected;
+            std::cout << entry.getName() << ", interleaved floats: " << (same ? "identical" : "DIFFERENT") << "\n";
+            ok &= same;
+        }
+        return ok;
+    }
+
+    /**
+     * Corrupts a frame in the middle of a file and the MD5 hash of another, checking that the pipeline returns the
+     * same frames as serial decoding before reporting the error.
+     */
+    bool testErrors() {
+        bool ok = true;
+        Bench::SyntheticCorpus::Entry entry = Bench::SyntheticCorpus::getDefaultEntries(1, 9).at(2);
+        std::string file = makeFile(entry);
+        const size_t md5Offset = 4 + 4 + 18;  // Magic string, block header, stream info fields before the hash
+
+        std::string badFrame = file;
+        badFrame[badFrame.size() * 2 / 3] ^= 0x10;
+        std::string badHash = file;
+        badHash[md5Offset] ^= 0x01;
+        Common::ThreadPool pool(2);
+        for (const std::string *f : {&badFrame, &badHash}) {
+            std::string error;
+            uint_fast64_t frames;
+            std::vector<std::vector<int_fast32_t>> expected = decode(*f, false, nullptr, -1, &error, &frames);
+            std::string pipeError;
+            uint_fast64_t pipeFrames;
+            std::vector<std::vector<int_fast32_t>> actual = decode(*f, true, &pool, -1, &pipeError, &pipeFrames);
+            bool reported = f == &badHash ? pipeError == "MD5 hash mismatch" && error.empty() && actual == expected :
+                    !pipeError.empty() && !error.empty() && pipeFrames == frames && actual == expected;
+            std::cout << (f == &badHash ? "bad hash" : "bad frame") << ": serial " << frames << " frames ("
+                      << (error.empty() ? "no error" : error) << "), pipeline " << pipeFrames << " frames ("
+                      << (pipeError.empty() ? "no error" : pipeError) << ")\n";
+            ok &= reported;
+        }
+        return ok;
+    }
+
+    /**
+     * Decodes the given file serially with the given input buffer size (0 for adaptive), changing the size to the
+     * next of the given ones after every block, if any. Also returns the buffer size after reading the metadata.
+     */
+    std::vector<std::vector<int_fast32_t>> decodeWithBuffer(const std::string &file, size_t bufferSize,
+                                                            const std::vector<size_t> &sizes, size_t *metadataSize) {
+        std::vector<uint_fast8_t> bytes(file.begin(), file.end());
+        auto *in = new Decode::ByteArrayFlacInput(bytes.data(), bytes.size(), bufferSize);
+        Decode::FlacDecoder dec(in);  // Owns the input, which lives as long as the decoder
+        while (dec.readAndHandleMetadataBlock(nullptr, nullptr));
+        *metadataSize = in->getBufferSize();
+        int_fast32_t numChannels = dec.streamInfo->numChannels;
+        std::vector<std::vector<int_fast32_t>> result(numChannels);
+        std::vector<int_fast32_t> buffer(8 * 65536);
+        int_fast32_t *channels[8];
+        for (int i = 0; i < 8; i++)
+            channels[i] = buffer.data() + i * 65536;
+        for (size_t block = 0; int_fast32_t n = dec.readAudioBlock(channels, 0); block++) {
+            for (int_fast32_t ch = 0; ch < numChannels; ch++)
+                result[ch].insert(result[ch].end(), channels[ch], channels[ch] + n);
+            if (!sizes.empty())
+                in->setBufferSize(sizes[block % sizes.size()]);
+        }
+        return result;
+    }
+
+    /**
+     * Decodes one file per signal type of the corpus with fixed buffer sizes (including ones smaller than a frame),
+     * with sizes changing in the middle of the stream, and with the adaptive size, comparing the samples with those
+     * of the default decoder.
+     */
+    bool testBuffers() {
+        bool ok = true;
+        const Bench::SyntheticCorpus::Entry *prev = nullptr;
+        for (const Bench::SyntheticCorpus::Entry &entry : Bench::SyntheticCorpus::getDefaultEntries(0.5, 11)) {
+            if (prev != nullptr && prev->type == entry.type)
+                continue;
+            prev = &entry;
+            std::string file = makeFile(entry);
+            std::string error;
+            uint_fast64_t frames;
+            std::vector<std::vector<int_fast32_t>> expected = decode(file, false, nullptr, -1, &error, &frames);
+            const std::vector<size_t> changing = {64, 5000, 300, 70000, 4096};
+            size_t same = 0;
+            size_t runs = 0;
+            size_t adapted = 0;
+            for (size_t bufferSize : {(size_t)64, (size_t)1000, (size_t)4096, (size_t)1 << 20, (size_t)0}) {
+                for (bool change : {false, true}) {
+                    size_t metadataSize;
+                    std::vector<size_t> sizes = change ? changing : std::vector<size_t>();
+                    same += decodeWithBuffer(file, bufferSize, sizes, &metadataSize) == expected;
+                    runs++;
+                    if (bufferSize == 0)
+                        adapted = metadataSize;
+                    else
+                        ok &= metadataSize == bufferSize;
+                }
+            }
+            std::cout << entry.getName() << ": " << same << " of " << runs << " identical, adaptive buffer "
+                      << adapted << " bytes\n";
+            ok &= same == runs && error.empty() && adapted >= 4096 && adapted <= 65536;
+        }
+        return ok;
+    }
+
+    /**
+     * An input reading from a string, which records the stream position at every read from the underlying data.
+     */
+    class RecordingInput final : public Decode::AbstractFlacLowLevelInput {
+    private:
+        /**
+         * The data of the stream.
+         */
+        std::string data;
+
+        /**
+         * The offset of the next byte to read from the data.
+         */
+        uint_fast64_t offset;
+
+    protected:
+        int_fast32_t readUnderlying(uint_fast8_t buf[], uint_fast64_t off, uint_fast64_t len) override {
+            readPositions.push_back(getPosition());
+            auto n = (size_t)std::min(len, (uint_fast64_t)data.size() - offset);
+            if (n == 0)
+                return -1;
+            std::memcpy(buf + off, data.data() + offset, n);
+            offset += n;
+            return (int_fast32_t)n;
+        }
+
+    public:
+        /**
+         * The value of `getPosition()` at every read, i.e. the position up to which the stream was consumed.
+         */
+        std::vector<uint_fast64_t> readPositions;
+
+        /**
+         * Constructs an input over a copy of the given data with the given buffer size, or an adaptive one.
+         */
+        RecordingInput(const std::string &data, size_t bufferSize) :
+                AbstractFlacLowLevelInput(bufferSize), data(data), offset(0) {}
+
+        uint_fast64_t getLength() override {
+            return data.size();
+        }
+
+        void seekTo(uint_fast64_t pos) override {
+            offset = pos;
+            positionChanged(pos);
+        }
+
+        void close() override {
+            AbstractFlacLowLevelInput::close();
+        }
+    };
+
+    /**
+     * Decodes one file per signal type of the corpus through an input with an adaptive buffer and checks that the
+     * buffer is only ever refilled at the start of a frame, i.e. that every frame is parsed in one piece.
+     */
+    bool testFrames() {
+        bool ok = true;
+        const Bench::SyntheticCorpus::Entry *prev = nullptr;
+        for (const Bench::SyntheticCorpus::Entry &entry : Bench::SyntheticCorpus::getDefaultEntries(0.5, 11)) {
+            if (prev != nullptr && prev->type == entry.type)
+                continue;
+            prev = &entry;
+            auto *in = new RecordingInput(makeFile(entry), 0);
+            Decode::FlacDecoder dec(in);  // Owns the input
+            while (dec.readAndHandleMetadataBlock(nullptr, nullptr));
+            in->readPositions.clear();
+            std::vector<int_fast32_t> buffer(8 * 65536);
+            int_fast32_t *channels[8];
+            for (int i = 0; i < 8; i++)
+                channels[i] = buffer.data() + i * 65536;
+            std::vector<uint_fast64_t> frameStarts = {in->getPosition()};
+            uint_fast64_t numFrames = 0;
+            while (dec.readAudioBlock(channels, 0) != 0) {
+                frameStarts.push_back(in->getPosition());
+                numFrames++;
+            }
+            size_t inside = 0;
+            for (uint_fast64_t pos : in->readPositions)
+                inside += std::find(frameStarts.begin(), frameStarts.end(), pos) == frameStarts.end();
+            std::cout << entry.getName() << ": " << numFrames << " frames, max frame size "
+                      << dec.streamInfo->maxFrameSize << ", buffer " << in->getBufferSize() << " bytes, "
+                      << in->readPositions.size() << " reads, " << inside << " inside a frame\n";
+            ok &= inside == 0 && numFrames > 0;
+        }
+        return ok;
+    }
+
+    /**
+     * Reads a file through two inputs with the given buffer size in the same random sequence of bit reads, byte
+     * reads and CRC checks, peeking before every read on one of them, and checks that the peeked bits and bytes match
+     * the data and that peeking changes neither the position nor the CRCs.
+     */
+    bool testPeekWithBuffer(const std::string &file, size_t bufferSize) {
+        const auto *data = reinterpret_cast<const uint_fast8_t *>(file.data());
+        Decode::ByteArrayFlacInput plain(data, file.size(), bufferSize);
+        Decode::ByteArrayFlacInput peeking(data, file.size(), bufferSize);
+        std::mt19937 random((uint_fast32_t)bufferSize);
+        uint_fast64_t peeks = 0;
+        uint_fast64_t wrong = 0;
+        while (true) {
+            uint_fast64_t pos = peeking.getPosition();
+            uint_fast64_t consumed = pos * 8 + peeking.getBitPosition();
+            if (consumed + 64 > (uint_fast64_t)file.size() * 8)
+                break;
+            if (random() % 2 == 0) {  // Align both to a byte boundary
+                auto n = (uint_fast8_t)((8 - peeking.getBitPosition()) % 8);
+                wrong += plain.readUint(n) != peeking.readUint(n);
+                pos = peeking.getPosition();
+            }
+            if (peeking.getBitPosition() == 0 && random() % 3 == 0) {
+                size_t n = random() % 3000;
+                size_t left = file.size() - pos;
+                size_t available;
+                const uint_fast8_t *view = peeking.peekBytes(n, &available);
+                peeks++;
+                wrong += available < std::min(n, left) || available > left ||
+                         std::memcmp(view, data + pos, available) != 0 || peeking.getPosition() != pos;
+                if (random() % 4 == 0) {
+                    wrong += plain.getCrc8() != peeking.getCrc8() || plain.getCrc16() != peeking.getCrc16();
+                    plain.resetCrcs();
+                    peeking.resetCrcs();
+                }
+                size_t length = std::min((size_t)(random() % 300) + 1, left - 8);
+                std::vector<uint_fast8_t> expected(length + 1);  // Never empty, so the arrays are never null
+                std::vector<uint_fast8_t> actual(length + 1);
+                plain.readFully(expected.data(), length);
+                peeking.readFully(actual.data(), length);
+                wrong += expected != actual || !std::equal(actual.begin(), actual.begin() + length, data + pos);
+            } else {
+                auto n = (uint_fast8_t)(random() % 33);
+                uint_fast32_t peeked = peeking.peekBits(n);
+                peeks++;
+                uint_fast32_t read = peeking.readUint(n);
+                wrong += peeked != read || plain.readUint(n) != read;
+            }
+            wrong += plain.getPosition() != peeking.getPosition() || plain.getBitPosition() != peeking.getBitPosition();
+        }
+
+        // At the end of the stream, peeking returns what is left and then fails
+        while (peeking.getBitPosition() != 0)
+            peeking.readUint(1);
+        size_t left = file.size() - peeking.getPosition();
+        size_t available;
+        peeking.peekBytes(left + 100, &available);
+        wrong += available != left;
+        for (; left > 1; left--)
+            peeking.readUint(8);
+        wrong += peeking.peekBits(8) != data[file.size() - 1];
+        bool failed = false;
+        try {
+            peeking.peekBits(9);
+        } catch (const std::runtime_error &) {
+            failed = true;
+        }
+        std::cout << "buffer " << bufferSize << ": " << peeks << " peeks, " << wrong << " wrong\n";
+        return wrong == 0 && failed;
+    }
+
+    /**
+     * Runs the peek test on the largest file of the corpus with buffer sizes smaller and larger than a frame.
+     */
+    bool testPeek() {
+        std::string file;
+        for (const Bench::SyntheticCorpus::Entry &entry : Bench::SyntheticCorpus::getDefaultEntries(0.25, 3)) {
+            std::string candidate = makeFile(entry);
+            if (candidate.size() > file.size())
+                file = candidate;
+        }
+        bool ok = true;
+        for (size_t bufferSize : {(size_t)64, (size_t)1000, (size_t)0})
+            ok &= testPeekWithBuffer(file, bufferSize);
+
+        // A frame header of 1 to 3 bytes ends in the end-of-data error, whether or not its sync code is valid
+        const uint_fast8_t headers[][3] = {{0xFF, 0xF8, 0x69}, {0x12, 0x34, 0x56}};
+        for (const uint_fast8_t *header : headers) {
+            for (size_t length = 1; length <= 3; length++) {
+                Decode::ByteArrayFlacInput in(header, length);
+                Common::FrameInfo info;
+                std::string error;
+                try {
+                    Common::FrameInfo::readFrame(&in, &info);
+                } catch (const std::runtime_error &e) {
+                    error = e.what();
+                }
+                if (error != "End of data") {
+                    std::cout << "truncated header of " << length << " bytes: \"" << error << "\"\n";
+                    ok = false;
+                }
+            }
+        }
+
+        // Peeking the most bytes a buffer holds while the CRCs still cover earlier bytes returns the whole view
+        // (not one cut short as if the stream ended), and leaves the CRCs equal to those of plain reading
+        const size_t maxPeek = Decode::AbstractFlacLowLevelInput::MAX_BUFFER_SIZE;
+        std::vector<uint_fast8_t> data(maxPeek + (1 << 20));
+        for (size_t i = 0; i < data.size(); i++)
+            data[i] = (uint_fast8_t)((i * 2654435761U) >> 13);
+        Decode::ByteArrayFlacInput plain(data.data(), data.size());
+        Decode::ByteArrayFlacInput peeking(data.data(), data.size());
+        size_t available;
+        peeking.peekBytes(maxPeek, &available);  // Grows the buffer to the largest size
+        std::vector<uint_fast8_t> skipped(1 << 20);
+        plain.readFully(skipped.data(), skipped.size());
+        peeking.readFully(skipped.data(), skipped.size());
+        peeking.peekBytes(maxPeek, &available);
+        if (available != maxPeek || plain.getCrc8() != peeking.getCrc8() || plain.getCrc16() != peeking.getCrc16()) {
+            std::cout << "peek of " << maxPeek << " bytes after reading: " << available << " bytes\n";
+            ok = false;
+        }
+        return ok;
+    }
+
+    /**
+     * Scans one file per signal type of the corpus for frame handles and checks that they cover the stream without
+     * gaps, then decodes the handles in reverse order, and spread over several decoders on a pool, comparing the
+     * samples with those of serial decoding.
+     */
+    bool testLazy() {
+        bool ok = true;
+        Common::ThreadPool pool(3);
+        const Bench::SyntheticCorpus::Entry *prev = nullptr;
+        for (const Bench::SyntheticCorpus::Entry &entry : Bench::SyntheticCorpus::getDefaultEntries(0.5, 11)) {
+            if (prev != nullptr && prev->type == entry.type)
+                continue;
+            prev = &entry;
+            std::string file = makeFile(entry);
+            std::string error;
+            uint_fast64_t frames;
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::vector<int_fast32_t>> expected = decode(file, false, nullptr, -1, &error, &frames);
+            std::chrono::duration<double, std::milli> decodeTime = std::chrono::steady_clock::now() - start;
+
+            std::vector<uint_fast8_t> bytes(file.begin(), file.end());
+            Decode::FlacDecoder dec(new Decode::ByteArrayFlacInput(bytes.data(), bytes.size()));
+            while (dec.readAndHandleMetadataBlock(nullptr, nullptr));
+            start = std::chrono::steady_clock::now();
+            std::vector<Decode::FrameHandle> handles;
+            Decode::FrameHandle handle;
+            while (dec.scanFrame(&handle))
+                handles.push_back(handle);
+            std::chrono::duration<double, std::milli> scanTime = std::chrono::steady_clock::now() - start;
+
+            // The handles must follow each other without gaps, in bytes and in samples
+            bool tiled = handles.size() == frames && frames > 0;
+            uint_fast64_t filePos = tiled ? handles.front().filePos : 0;
+            uint_fast64_t samplePos = 0;
+            for (const Decode::FrameHandle &h : handles) {
+                tiled &= h.filePos == filePos && h.samplePos == samplePos;
+                filePos += h.info.frameSize;
+                samplePos += h.info.blockSize;
+            }
+            tiled &= filePos == bytes.size() && samplePos == expected.at(0).size();
+
+            // Decodes a handle with the given decoder and compares its samples
+            auto check = [&expected](Decode::FlacDecoder &d, const Decode::FrameHandle &h, int_fast32_t **channels) {
+                int_fast32_t n = d.decodeFrame(h, channels, 0);
+                bool same = n == h.info.blockSize;
+                for (size_t ch = 0; ch < expected.size(); ch++)
+                    same &= std::equal(channels[ch], channels[ch] + n, expected[ch].begin() + h.samplePos);
+                return same;
+            };
+            std::vector<int_fast32_t> buffer(8 * 65536);
+            int_fast32_t *channels[8];
+            for (int i = 0; i < 8; i++)
+                channels[i] = buffer.data() + i * 65536;
+            size_t reversed = 0;
+            for (size_t i = handles.size(); i-- > 0;)
+                reversed += check(dec, handles[i], channels);
+            bool continues = handles.size() < 2 || dec.readAudioBlock(channels, 0) == handles[1].info.blockSize;
+
+            std::atomic<size_t> spread(0);
+            Common::ThreadPool::TaskGroup group(&pool);
+            for (size_t task = 0; task < 3; task++) {
+                group.run([&, task] {
+                    Decode::FlacDecoder taskDec(new Decode::ByteArrayFlacInput(bytes.data(), bytes.size()));
+                    while (taskDec.readAndHandleMetadataBlock(nullptr, nullptr));
+                    std::vector<int_fast32_t> taskBuffer(8 * 65536);
+                    int_fast32_t *taskChannels[8];
+                    for (int i = 0; i < 8; i++)
+                        taskChannels[i] = taskBuffer.data() + i * 65536;
+                    for (size_t i = task; i < handles.size(); i += 3)
+                        spread += check(taskDec, handles[i], taskChannels);
+                });
+            }
+            group.wait();
+            std::cout << entry.getName() << ": " << handles.size() << " handles" << (tiled ? "" : " with gaps")
+                      << " scanned in " << scanTime.count() << " ms (decoding " << decodeTime.count() << " ms), "
+                      << reversed << " identical in reverse, " << spread << " identical on the pool\n";
+            ok &= tiled && continues && error.empty() && reversed == handles.size() && spread == handles.size();
+        }
+        return ok;
+    }
+
+    /**
+     * Decodes the corpus as batches of stereo clips of several target lengths, on a pool and serially, reusing the
+     * same batch decoder, and compares every clip with its serially decoded samples, truncated or padded with zeros.
+     * The clip with 6 channels must be rejected without affecting the others.
+     */
+    bool testBatch() {
+        bool ok = true;
+        std::vector<std::string> files;
+        std::vector<std::vector<float>> expected;  // Planar and unpadded, mono clips already copied to both channels
+        for (const Bench::SyntheticCorpus::Entry &entry : Bench::SyntheticCorpus::getDefaultEntries(0.25, 7)) {
+            files.push_back(makeFile(entry));
+            std::string error;
+            uint_fast64_t frames;
+            std::vector<std::vector<int_fast32_t>> planar = decode(files.back(), false, nullptr, -1, &error,
+                                                                   &frames);
+            float scale = 1.0f / (float)((uint_fast64_t)1 << (entry.sampleDepth - 1));
+            std::vector<float> samples;
+            for (int_fast32_t ch = 0; ch < 2 && entry.numChannels <= 2; ch++) {
+                for (int_fast32_t s : planar.at(entry.numChannels == 1 ? 0 : ch))
+                    samples.push_back((float)s * scale);
+            }
+            expected.push_back(samples);
+        }
+        const char *path = "batch-test.flac";
+        {
+            std::ofstream out(path, std::ios::out | std::ios::binary);
+            out << files.at(1);
+        }
+
+        Common::ThreadPool pool(3);
+        for (Common::ThreadPool *p : {&pool, (Common::ThreadPool *)nullptr}) {
+            for (uint_fast32_t targetLength : {(uint_fast32_t)12000, (uint_fast32_t)2000, (uint_fast32_t)30000}) {
+                Decode::BatchDecoder batch(2, targetLength, p);
+                std::vector<Decode::BatchDecoder::Clip> clips;
+                std::vector<size_t> sources;
+                for (size_t i = 0; i < files.size(); i++) {
+                    clips.emplace_back(reinterpret_cast<const uint_fast8_t *>(files[i].data()), files[i].size());
+                    sources.push_back(i);
+                }
+                clips.emplace_back(path);
+                sources.push_back(1);
+
+                // The first batch contains the clip with 6 channels, the second one does not
+                for (int_fast32_t round = 0; round < 2; round++) {
+                    std::string error;
+                    try {
+                        batch.decode(clips);
+                    } catch (const Decode::DataFormatException &e) {
+                        error = e.what();
+                    }
+                    size_t same = 0;
+                    const float *tensor = batch.getSamples();
+                    for (size_t i = 0; i < clips.size(); i++) {
+                        const std::vector<float> &samples = expected.at(sources[i]);
+                        if (samples.empty())
+                            continue;
+                        size_t length = samples.size() / 2;
+                        size_t valid = std::min(length, (size_t)targetLength);
+                        std::vector<float> want((size_t)2 * targetLength, 0.0f);
+                        for (size_t ch = 0; ch < 2; ch++)
+                            std::copy_n(samples.begin() + ch * length, valid, want.begin() + ch * targetLength);
+                        const float *actual = tensor + i * 2 * targetLength;
+                        same += batch.getLength(i) == valid && std::equal(want.begin(), want.end(), actual);
+                    }
+                    size_t numGood = clips.size() - (round == 0 ? 1 : 0);
+                    bool good = same == numGood && batch.getBatchSize() == clips.size() &&
+                                (round == 0 ? error == "Unsupported number of channels in clip" : error.empty());
+                    std::cout << (p != nullptr ? "pool" : "serial") << ", length " << targetLength << ", "
+                              << clips.size() << " clips: " << same << " identical"
+                              << (error.empty() ? "" : ", error: " + error) << ", "
+                              << batch.getMemory().getCurrentBytes() << " bytes\n";
+                    ok &= good;
+                    for (size_t i = 0; i < clips.size(); i++) {
+                        if (expected.at(sources[i]).empty()) {
+                            clips.erase(clips.begin() + i);
+                            sources.erase(sources.begin() + i);
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        std::remove(path);
+        return ok;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::string name = argc == 2 ? argv[1] : "";
+    bool ok;
+    try {
+        if (name == "ring")
+            ok = testRing();
+        else if (name == "decode")
+            ok = testDecode();
+        else if (name == "errors")
+            ok = testErrors();
+        else if (name == "batch")
+            ok = testBatch();
+        else if (name == "buffers")
+            ok = testBuffers();
+        else if (name == "peek")
+            ok = testPeek();
+        else if (name == "frames")
+            ok = testFrames();
+        else if (name == "lazy")
+            ok = testLazy();
+        else {
+            std::cerr << "Usage: " << argv[0] << " {ring|decode|errors|batch|buffers|peek|frames|lazy}\n";
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << (ok ? "PASS" : "FAIL") << "\n";
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
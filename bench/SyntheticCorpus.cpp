@@ -0,0 +1,366 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "SyntheticCorpus.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "../common/StreamInfo.h"
+#include "../encode/BitOutputStream.h"
+#include "../encode/FlacEncoder.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Bench {
+            namespace {
+                const double PI = 3.14159265358979323846;
+
+                /**
+                 * A small deterministic random number generator (SplitMix64), so that the corpus does not depend on
+                 * the standard library's distributions, which differ between implementations.
+                 */
+                class Random final {
+                private:
+                    uint_fast64_t state;
+
+                public:
+                    explicit Random(uint_fast64_t seed) : state(seed) { }
+
+                    uint_fast64_t nextLong() {
+                        uint_fast64_t z = (state += 0x9E3779B97F4A7C15ULL);
+                        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                        return z ^ (z >> 31);
+                    }
+
+                    // Uniform in [0, 1)
+                    double nextDouble() {
+                        return (double)(nextLong() >> 11) / 9007199254740992.0;
+                    }
+
+                    // Uniform in [-1, 1)
+                    double nextSigned() {
+                        return nextDouble() * 2 - 1;
+                    }
+                };
+
+                /**
+                 * Turns white noise into pink noise (-3 dB per octave), using Paul Kellet's economy filter.
+                 */
+                class PinkFilter final {
+                private:
+                    double b0 = 0, b1 = 0, b2 = 0;
+
+                public:
+                    double next(double white) {
+                        b0 = 0.99765 * b0 + white * 0.0990460;
+                        b1 = 0.96300 * b1 + white * 0.2965164;
+                        b2 = 0.57000 * b2 + white * 1.0526913;
+                        return (b0 + b1 + b2 + white * 0.1848) * 0.2;
+                    }
+                };
+
+                void fillPinkNoise(Random &rand, double out[], uint_fast64_t n, double gain) {
+                    PinkFilter filter;
+                    for (uint_fast64_t i = 0; i < n; i++)
+                        out[i] = filter.next(rand.nextSigned()) * gain;
+                }
+
+                void synthSineSweep(const SyntheticCorpus::Entry &e, double *chans[]) {
+                    double f0 = 20;
+                    double f1 = e.sampleRate * 0.45;
+                    double duration = (double)e.numSamples / e.sampleRate;
+                    double k = std::log(f1 / f0);
+                    for (uint_fast8_t ch = 0; ch < e.numChannels; ch++) {
+                        for (uint_fast64_t i = 0; i < e.numSamples; i++) {
+                            double t = (double)i / e.sampleRate;
+                            double phase = 2 * PI * f0 * duration / k * (std::exp(t / duration * k) - 1);
+                            chans[ch][i] = 0.7 * std::sin(phase + ch * PI / 7);
+                        }
+                    }
+                }
+
+                void synthPercussion(const SyntheticCorpus::Entry &e, Random &rand, double *chans[]) {
+                    double rate = e.sampleRate;
+                    for (uint_fast8_t ch = 0; ch < e.numChannels; ch++)
+                        std::fill(chans[ch], chans[ch] + e.numSamples, 0.0);
+
+                    for (auto start = (uint_fast64_t)(rand.nextDouble() * rate * 0.1); start < e.numSamples;
+                         start += (uint_fast64_t)(rate * (0.08 + 0.3 * rand.nextDouble()))) {
+                        int kind = (int)(rand.nextDouble() * 3);
+                        double amplitude = 0.3 + 0.6 * rand.nextDouble();
+                        double pan = rand.nextDouble();
+                        double lengthSecs = kind == 0 ? 0.5 : kind == 1 ? 0.3 : 0.08;
+                        auto length = std::min((uint_fast64_t)(rate * lengthSecs), e.numSamples - start);
+                        double phase = 0;
+                        double prevNoise = 0;
+                        for (uint_fast64_t i = 0; i < length; i++) {
+                            double t = i / rate;
+                            double val;
+                            if (kind == 0) {  // Kick: sine with falling pitch
+                                phase += 2 * PI * (50 + 100 * std::exp(-t / 0.05)) / rate;
+                                val = std::sin(phase) * std::exp(-t / 0.12);
+                            } else if (kind == 1) {  // Snare: noise burst plus a tone
+                                val = 0.7 * rand.nextSigned() * std::exp(-t / 0.06) +
+                                      0.5 * std::sin(2 * PI * 180 * t) * std::exp(-t / 0.08);
+                            } else {  // Hi-hat: high-passed noise with a fast decay
+                                double noise = rand.nextSigned();
+                                val = (noise - prevNoise) * 0.5 * std::exp(-t / 0.015);
+                                prevNoise = noise;
+                            }
+                            for (uint_fast8_t ch = 0; ch < e.numChannels; ch++) {
+                                double gain = e.numChannels == 1 ? 1 : (ch % 2 == 0 ? 1 - pan : pan) * 2;
+                                chans[ch][start + i] += val * amplitude * std::min(gain, 1.0);
+                            }
+                        }
+                    }
+                }
+
+                void synthUpsampled(const SyntheticCorpus::Entry &e, Random &rand, double *chans[]) {
+                    const uint_fast64_t factor = 4;
+                    uint_fast64_t baseLen = e.numSamples / factor + 2;
+                    auto *base = new double[baseLen];
+                    for (uint_fast8_t ch = 0; ch < e.numChannels; ch++) {
+                        fillPinkNoise(rand, base, baseLen, 0.6);
+                        for (uint_fast64_t i = 0; i < e.numSamples; i++) {
+                            uint_fast64_t j = i / factor;
+                            double frac = (double)(i % factor) / factor;
+                            chans[ch][i] = base[j] + (base[j + 1] - base[j]) * frac;
+                        }
+                    }
+                    delete[] base;
+                }
+
+                void synthMidHeavyStereo(const SyntheticCorpus::Entry &e, Random &rand, double *chans[]) {
+                    auto *mid = new double[e.numSamples];
+                    fillPinkNoise(rand, mid, e.numSamples, 0.5);
+                    for (uint_fast64_t i = 0; i < e.numSamples; i++)
+                        mid[i] += 0.2 * std::sin(2 * PI * 220 * i / e.sampleRate);
+                    for (uint_fast64_t i = 0; i < e.numSamples; i++) {
+                        for (uint_fast8_t ch = 0; ch < e.numChannels; ch++) {
+                            double side = 0.02 * rand.nextSigned();
+                            chans[ch][i] = mid[i] + (ch % 2 == 0 ? side : -side);
+                        }
+                    }
+                    delete[] mid;
+                }
+
+                int_fast32_t quantize(double val, uint_fast8_t depth) {
+                    auto max = (double)(((int_fast64_t)1 << (depth - 1)) - 1);
+                    double result = std::round(val * max);
+                    return (int_fast32_t)std::max(std::min(result, max), -max - 1);
+                }
+
+                uint_fast64_t hashName(const std::string &name) {
+                    uint_fast64_t result = 0xCBF29CE484222325ULL;  // FNV-1a
+                    for (char c : name) {
+                        result ^= (unsigned char)c;
+                        result *= 0x100000001B3ULL;
+                    }
+                    return result;
+                }
+            }
+
+            std::string SyntheticCorpus::Entry::getName() const {
+                return std::string(getTypeName(type)) + "_s" + std::to_string(sampleDepth) +
+                       "_c" + std::to_string(numChannels) + "_r" + std::to_string(sampleRate) +
+                       "_b" + std::to_string(blockSize);
+            }
+
+            const char *SyntheticCorpus::getTypeName(SignalType type) {
+                switch (type) {
+                    case SignalType::SILENCE:          return "silence";
+                    case SignalType::SINE_SWEEP:       return "sine-sweep";
+                    case SignalType::WHITE_NOISE:      return "white-noise";
+                    case SignalType::PINK_NOISE:       return "pink-noise";
+                    case SignalType::PERCUSSION:       return "percussion";
+                    case SignalType::UPSAMPLED:        return "upsampled";
+                    case SignalType::WASTED_BITS:      return "wasted-bits";
+                    case SignalType::MID_HEAVY_STEREO: return "mid-heavy-stereo";
+                    default:
+                        throw std::invalid_argument("Unknown signal type");
+                }
+            }
+
+            std::vector<SyntheticCorpus::Entry> SyntheticCorpus::getDefaultEntries(double seconds, uint_fast64_t seed) {
+                if (!(seconds > 0))
+                    throw std::invalid_argument("Duration must be positive");
+                struct Row {
+                    SignalType type;
+                    uint_fast32_t rate;
+                    uint_fast8_t chans;
+                    uint_fast8_t depth;
+                    int_fast32_t blockSize;
+                };
+                // Block sizes and sample rates include values with and without a dedicated header code
+                static const Row ROWS[] = {
+                    {SignalType::SILENCE,          44100, 2, 16, 4096},
+                    {SignalType::SINE_SWEEP,       44100, 2, 16, 4096},
+                    {SignalType::SINE_SWEEP,       96000, 1, 24, 4608},
+                    {SignalType::SINE_SWEEP,       22050, 1,  8, 1152},
+                    {SignalType::WHITE_NOISE,      44100, 2, 16, 4096},
+                    {SignalType::WHITE_NOISE,      48000, 2, 24, 2000},
+                    {SignalType::PINK_NOISE,       48000, 2, 16, 4096},
+                    {SignalType::PINK_NOISE,       48000, 6, 24, 4096},
+                    {SignalType::PERCUSSION,       44100, 2, 16, 4096},
+                    {SignalType::PERCUSSION,       96000, 2, 24, 8192},
+                    {SignalType::UPSAMPLED,        96000, 2, 24, 4096},
+                    {SignalType::UPSAMPLED,        11025, 1, 16,  576},
+                    {SignalType::WASTED_BITS,      48000, 2, 24, 4096},
+                    {SignalType::WASTED_BITS,      44100, 1, 16, 4096},
+                    {SignalType::MID_HEAVY_STEREO, 44100, 2, 16, 4096},
+                    {SignalType::MID_HEAVY_STEREO, 48000, 2, 24, 4096}
+                };
+                std::vector<Entry> result;
+                for (const Row &row : ROWS) {
+                    Entry e;
+                    e.type = row.type;
+                    e.sampleRate = row.rate;
+                    e.numChannels = row.chans;
+                    e.sampleDepth = row.depth;
+                    e.numSamples = std::max((uint_fast64_t)(seconds * row.rate), (uint_fast64_t)1);
+                    e.blockSize = row.blockSize;
+                    e.seed = seed;
+                    result.push_back(e);
+                }
+                return result;
+            }
+
+            int_fast32_t **SyntheticCorpus::generate(const Entry &entry) {
+                if (entry.numChannels < 1 || entry.numChannels > 8)
+                    throw std::invalid_argument("Invalid number of channels");
+                if (entry.sampleDepth != 8 && entry.sampleDepth != 16 && entry.sampleDepth != 24)
+                    throw std::invalid_argument("Unsupported sample depth");
+                if (entry.sampleRate == 0 || entry.numSamples == 0)
+                    throw std::invalid_argument("Invalid sample rate or length");
+
+                Random rand(entry.seed ^ hashName(entry.getName()));
+                auto **chans = new double *[entry.numChannels];
+                for (uint_fast8_t ch = 0; ch < entry.numChannels; ch++)
+                    chans[ch] = new double[entry.numSamples];
+
+                uint_fast8_t contentDepth = entry.sampleDepth;
+                switch (entry.type) {
+                    case SignalType::SILENCE:
+                        for (uint_fast8_t ch = 0; ch < entry.numChannels; ch++)
+                            std::fill(chans[ch], chans[ch] + entry.numSamples, 0.0);
+                        break;
+                    case SignalType::SINE_SWEEP:
+                        synthSineSweep(entry, chans);
+                        break;
+                    case SignalType::WHITE_NOISE:
+                        for (uint_fast8_t ch = 0; ch < entry.numChannels; ch++) {
+                            for (uint_fast64_t i = 0; i < entry.numSamples; i++)
+                                chans[ch][i] = rand.nextSigned();
+                        }
+                        break;
+                    case SignalType::PINK_NOISE:
+                        for (uint_fast8_t ch = 0; ch < entry.numChannels; ch++)
+                            fillPinkNoise(rand, chans[ch], entry.numSamples, 0.6);
+                        break;
+                    case SignalType::PERCUSSION:
+                        synthPercussion(entry, rand, chans);
+                        break;
+                    case SignalType::UPSAMPLED:
+                        synthUpsampled(entry, rand, chans);
+                        break;
+                    case SignalType::WASTED_BITS:
+                        contentDepth = entry.sampleDepth - entry.sampleDepth / 3;
+                        for (uint_fast8_t ch = 0; ch < entry.numChannels; ch++)
+                            fillPinkNoise(rand, chans[ch], entry.numSamples, 0.6);
+                        break;
+                    case SignalType::MID_HEAVY_STEREO:
+                        synthMidHeavyStereo(entry, rand, chans);
+                        break;
+                    default:
+                        throw std::invalid_argument("Unknown signal type");
+                }
+
+                // Quantize to the content depth, then pad with zero bits up to the container depth
+                auto **result = new int_fast32_t *[entry.numChannels];
+                for (uint_fast8_t ch = 0; ch < entry.numChannels; ch++) {
+                    result[ch] = new int_fast32_t[entry.numSamples];
+                    for (uint_fast64_t i = 0; i < entry.numSamples; i++) {
+                        int_fast32_t val = quantize(chans[ch][i], contentDepth);
+                        result[ch][i] = (int_fast32_t)((uint_fast32_t)val << (entry.sampleDepth - contentDepth));
+                    }
+                    delete[] chans[ch];
+                }
+                delete[] chans;
+                return result;
+            }
+
+            void SyntheticCorpus::deleteSamples(int_fast32_t **samples, uint_fast8_t numChannels) {
+                if (samples == nullptr)
+                    return;
+                for (uint_fast8_t ch = 0; ch < numChannels; ch++)
+                    delete[] samples[ch];
+                delete[] samples;
+            }
+
+            void SyntheticCorpus::writeFlac(const Entry &entry, int_fast32_t *samples[],
+                                            const Encode::SubframeEncoder::SearchOptions &opt, std::ostream *out) {
+                Common::StreamInfo format;
+                format.sampleRate = entry.sampleRate;
+                format.numChannels = entry.numChannels;
+                format.sampleDepth = entry.sampleDepth;
+                format.numSamples = entry.numSamples;
+                writeFlac(format, samples, entry.blockSize, opt, out);
+            }
+
+            void SyntheticCorpus::writeFlac(const Common::StreamInfo &format, int_fast32_t *samples[],
+                                            int_fast32_t blockSize, const Encode::SubframeEncoder::SearchOptions &opt,
+                                            std::ostream *out, Encode::EncoderStats *stats, Common::ThreadPool *pool) {
+                if (samples == nullptr || out == nullptr)
+                    throw std::invalid_argument("Samples and output stream cannot be null");
+
+                Common::StreamInfo info;
+                info.sampleRate = format.sampleRate;
+                info.numChannels = format.numChannels;
+                info.sampleDepth = format.sampleDepth;
+                info.numSamples = format.numSamples;
+                Common::StreamInfo::getMd5Hash(
+                        samples, info.numChannels, info.numSamples, info.sampleDepth, info.md5Hash);
+
+                // Write a placeholder stream info, then all the frames
+                std::streampos start = out->tellp();
+                Encode::BitOutputStream bout(out);
+                bout.writeInt(32, 0x664C6143);  // Magic string "fLaC"
+                info.minBlockSize = info.maxBlockSize = (uint_fast16_t)blockSize;
+                info.write(true, &bout);
+                Encode::FlacEncoder(&info, samples, info.numSamples, blockSize, opt, &bout, stats, pool);
+                bout.flush();
+                std::streampos end = out->tellp();
+
+                // Rewrite the stream info with the final frame sizes
+                out->seekp(start + (std::streamoff)4);
+                Encode::BitOutputStream infoOut(out);
+                info.write(true, &infoOut);
+                infoOut.flush();
+                out->seekp(end);
+                if (!*out)
+                    throw std::runtime_error("Failed to write FLAC data");
+            }
+        }
+    }
+}
@@ -0,0 +1,169 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_SYNTHETICCORPUS_H
+#define NAYUKI_SYNTHETICCORPUS_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../common/StreamInfo.h"
+#include "../common/ThreadPool.h"
+#include "../encode/SubframeEncoder.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Bench {
+            /**
+             * Synthesizes reproducible test signals for benchmarking, and encodes them as FLAC files. The same entry
+             * and seed always produce the same samples, so benchmark inputs can be regenerated anywhere instead of
+             * shipping audio files. The signal types are chosen to exercise every subframe type (constant, verbatim,
+             * fixed, LPC), wasted bits, all stereo modes and the whole range of Rice parameters.
+             */
+            class SyntheticCorpus final {
+            public:
+                /**
+                 * The kinds of signals that can be synthesized.
+                 */
+                enum class SignalType {
+                    SILENCE,           // Digital silence, encoded as constant subframes
+                    SINE_SWEEP,        // Exponential sine sweep, highly predictable
+                    WHITE_NOISE,       // Full scale white noise, nearly incompressible
+                    PINK_NOISE,        // Pink noise, moderately predictable
+                    PERCUSSION,        // Decaying drum hits at random times, strong transients
+                    UPSAMPLED,         // Noise at a quarter of the sample rate, interpolated up
+                    WASTED_BITS,       // Pink noise at a lower depth, padded with zero bits
+                    MID_HEAVY_STEREO   // Nearly identical channels with a quiet side signal
+                };
+
+                /**
+                 * Describes one file of the corpus. Mutable structure.
+                 */
+                class Entry final {
+                public:
+                    /**
+                     * The kind of signal to synthesize.
+                     */
+                    SignalType type;
+
+                    /**
+                     * The sample rate in hertz.
+                     */
+                    uint_fast32_t sampleRate;
+
+                    /**
+                     * The number of channels, in the range [1, 8].
+                     */
+                    uint_fast8_t numChannels;
+
+                    /**
+                     * The bit depth, one of 8, 16 or 24.
+                     */
+                    uint_fast8_t sampleDepth;
+
+                    /**
+                     * The number of samples per channel.
+                     */
+                    uint_fast64_t numSamples;
+
+                    /**
+                     * The block size to encode with, in the range [16, 65535].
+                     */
+                    int_fast32_t blockSize;
+
+                    /**
+                     * The seed of the random number generator, mixed with the other fields.
+                     */
+                    uint_fast64_t seed;
+
+                    /**
+                     * Returns a file name friendly description of this entry, such as
+                     * `pink-noise_s16_c2_r44100_b4096`.
+                     * @return the name of this entry
+                     */
+                    std::string getName() const;
+                };
+
+                /**
+                 * Returns the name of the given signal type, such as `pink-noise`.
+                 * @param[in] type the signal type
+                 * @return the name of the signal type
+                 */
+                static const char *getTypeName(SignalType type);
+
+                /**
+                 * Returns the default corpus, which covers every signal type at various depths, sample rates, channel
+                 * counts and block sizes.
+                 * @param[in] seconds the duration of each entry in seconds
+                 * @param[in] seed    the seed to use for all entries
+                 * @return the list of entries
+                 */
+                static std::vector<Entry> getDefaultEntries(double seconds, uint_fast64_t seed);
+
+                /**
+                 * Synthesizes the samples of the given entry. The result is an array of `numChannels` channels with
+                 * `numSamples` samples each, which must be released with `deleteSamples()`.
+                 * @param[in] entry the entry to synthesize
+                 * @return the new sample arrays
+                 */
+                static int_fast32_t **generate(const Entry &entry);
+
+                /**
+                 * Releases sample arrays returned by `generate()`.
+                 * @param[in] samples     the sample arrays (can be `null`)
+                 * @param[in] numChannels the number of channels
+                 */
+                static void deleteSamples(int_fast32_t **samples, uint_fast8_t numChannels);
+
+                /**
+                 * Writes the given samples as a complete FLAC file (magic string, stream info including MD5 hash, and
+                 * all frames) to the given output stream. The stream must be seekable, because the stream info is
+                 * rewritten once the frame sizes are known.
+                 * @param[in]     entry   the entry which the samples belong to
+                 * @param[in]     samples the samples, as returned by `generate()` (not `null`)
+                 * @param[in]     opt     the encoder search options to use
+                 * @param[in,out] out     the seekable output stream to write to (not `null`)
+                 */
+                static void writeFlac(const Entry &entry, int_fast32_t *samples[],
+                                      const Encode::SubframeEncoder::SearchOptions &opt, std::ostream *out);
+
+                /**
+                 * Writes the given samples as a complete FLAC file like the other overload, taking the audio format
+                 * from the given stream info (sample rate, number of channels, sample depth and number of samples)
+                 * instead of a corpus entry. Its block sizes, frame sizes and MD5 hash are ignored and recomputed.
+                 * @param[in]     format    the format of the samples
+                 * @param[in]     samples   the samples, where each subarray is a channel (all not `null`)
+                 * @param[in]     blockSize the block size to encode with, in the range [16, 65535]
+                 * @param[in]     opt       the encoder search options to use
+                 * @param[in,out] out       the seekable output stream to write to (not `null`)
+                 * @param[in,out] stats     the sink to record encoder statistics into, or `null`
+                 * @param[in,out] pool      the pool to encode frames on in parallel, or `null`
+                 */
+                static void writeFlac(const Common::StreamInfo &format, int_fast32_t *samples[], int_fast32_t blockSize,
+                                      const Encode::SubframeEncoder::SearchOptions &opt, std::ostream *out,
+                                      Encode::EncoderStats *stats = nullptr, Common::ThreadPool *pool = nullptr);
+            };
+        }
+    }
+}
+
+#endif
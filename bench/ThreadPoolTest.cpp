@@ -0,0 +1,195 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "SyntheticCorpus.h"
+
+#include "../common/ThreadPool.h"
+#include "../encode/EncoderStats.h"
+#include "../encode/Presets.h"
+
+using namespace Nayuki::FLAC;
+
+/*
+ * Thread pool test. Checks that the shared pool executes every task exactly once, that nested groups complete even
+ * when there are more waiting tasks than workers, that task exceptions reach the waiting thread, and that encoding in
+ * parallel produces exactly the same file as encoding serially.
+ */
+
+namespace {
+    /**
+     * Submits many small tasks from outside the pool and checks that each runs once.
+     */
+    bool testTasks() {
+        bool ok = true;
+        for (int_fast32_t threads : {1, 2, 5}) {
+            Common::ThreadPool pool(threads);
+            const int_fast32_t count = 20000;
+            std::vector<std::atomic<int_fast32_t>> runs(count);
+            for (std::atomic<int_fast32_t> &r : runs)
+                r = 0;
+            Common::ThreadPool::TaskGroup group(&pool);
+            for (int_fast32_t i = 0; i < count; i++)
+                group.run([&runs, i] { runs[i]++; });
+            group.wait();
+            int_fast32_t wrong = 0;
+            for (const std::atomic<int_fast32_t> &r : runs)
+                wrong += r != 1;
+            std::cout << threads << " threads: " << pool.getExecutedCount() << " tasks executed, " << wrong
+                      << " run other than once\n";
+            ok &= wrong == 0 && pool.getExecutedCount() == (uint_fast64_t)count;
+        }
+        return ok;
+    }
+
+    /**
+     * Computes the number of leaves of a binary tree of the given depth, with every inner node waiting for a nested
+     * group of its two children.
+     */
+    uint_fast64_t countLeaves(Common::ThreadPool *pool, int_fast32_t depth) {
+        if (depth == 0)
+            return 1;
+        uint_fast64_t left = 0;
+        uint_fast64_t right = 0;
+        Common::ThreadPool::TaskGroup group(pool);
+        group.run([&] { left = countLeaves(pool, depth - 1); });
+        group.run([&] { right = countLeaves(pool, depth - 1); });
+        group.wait();
+        return left + right;
+    }
+
+    /**
+     * Runs deeply nested groups on small pools, where workers must execute other tasks while waiting.
+     */
+    bool testNested() {
+        bool ok = true;
+        for (int_fast32_t threads : {1, 2, 4}) {
+            Common::ThreadPool pool(threads);
+            uint_fast64_t leaves = countLeaves(&pool, 12);
+            std::cout << threads << " threads: " << leaves << " leaves, " << pool.getStolenCount() << " tasks stolen\n";
+            ok &= leaves == 4096;
+        }
+        uint_fast64_t leaves = countLeaves(nullptr, 12);
+        std::cout << "no pool: " << leaves << " leaves\n";
+        return ok && leaves == 4096;
+    }
+
+    /**
+     * Checks that the first exception of a group is rethrown by `wait()` after all its tasks finished.
+     */
+    bool testExceptions() {
+        bool ok = true;
+        for (Common::ThreadPool *pool : {&Common::ThreadPool::getShared(), (Common::ThreadPool *)nullptr}) {
+            std::atomic<int_fast32_t> finished(0);
+            Common::ThreadPool::TaskGroup group(pool);
+            for (int_fast32_t i = 0; i < 100; i++) {
+                group.run([&finished, i] {
+                    finished++;
+                    if (i % 10 == 3)
+                        throw std::runtime_error("Task failed");
+                });
+            }
+            bool thrown = false;
+            try {
+                group.wait();
+            } catch (const std::runtime_error &) {
+                thrown = true;
+            }
+            std::cout << (pool != nullptr ? "pool" : "no pool") << ": " << (thrown ? "rethrown" : "not rethrown")
+                      << " after " << finished << " tasks\n";
+            ok &= thrown && finished == 100;
+            group.wait();  // The exception was consumed
+        }
+        return ok;
+    }
+
+    /**
+     * Encodes a few corpus entries serially and with pools of several sizes, comparing the files and statistics.
+     */
+    bool testEncode() {
+        bool ok = true;
+        const Bench::SyntheticCorpus::Entry *prev = nullptr;
+        std::vector<Bench::SyntheticCorpus::Entry> entries = Bench::SyntheticCorpus::getDefaultEntries(1, 7);
+        for (const Bench::SyntheticCorpus::Entry &entry : entries) {
+            if (prev != nullptr && prev->type == entry.type)
+                continue;
+            prev = &entry;
+            int_fast32_t **samples = Bench::SyntheticCorpus::generate(entry);
+            Common::StreamInfo format;
+            format.sampleRate = entry.sampleRate;
+            format.numChannels = entry.numChannels;
+            format.sampleDepth = entry.sampleDepth;
+            format.numSamples = entry.numSamples;
+            const Encode::SubframeEncoder::SearchOptions &opt = *Encode::findPreset("subset-best");
+
+            std::string expected;
+            uint_fast64_t expectedFrames = 0;
+            for (int_fast32_t threads : {0, 1, 3}) {
+                std::stringstream out(std::ios::in | std::ios::out | std::ios::binary);
+                Encode::EncoderStats stats;
+                if (threads == 0) {
+                    Bench::SyntheticCorpus::writeFlac(format, samples, entry.blockSize, opt, &out, &stats);
+                    expected = out.str();
+                    expectedFrames = stats.numFrames;
+                } else {
+                    Common::ThreadPool pool(threads);
+                    Bench::SyntheticCorpus::writeFlac(format, samples, entry.blockSize, opt, &out, &stats, &pool);
+                    bool same = out.str() == expected && stats.numFrames == expectedFrames;
+                    std::cout << entry.getName() << ", " << threads << " threads: "
+                              << (same ? "identical" : "DIFFERENT") << "\n";
+                    ok &= same;
+                }
+            }
+            Bench::SyntheticCorpus::deleteSamples(samples, entry.numChannels);
+        }
+        return ok;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::string name = argc == 2 ? argv[1] : "";
+    bool ok;
+    try {
+        if (name == "tasks")
+            ok = testTasks();
+        else if (name == "nested")
+            ok = testNested();
+        else if (name == "exceptions")
+            ok = testExceptions();
+        else if (name == "encode")
+            ok = testEncode();
+        else {
+            std::cerr << "Usage: " << argv[0] << " {tasks|nested|exceptions|encode}\n";
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << (ok ? "PASS" : "FAIL") << "\n";
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
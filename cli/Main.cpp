@@ -0,0 +1,568 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "PcmReader.h"
+#include "PcmWriter.h"
+
+#include "../common/Md5Hasher.h"
+#include "../common/ThreadPool.h"
+#include "../decode/ByteArrayFlacInput.h"
+#include "../decode/DataFormatException.h"
+#include "../decode/FlacDecoder.h"
+#include "../encode/BitOutputStream.h"
+#include "../encode/FlacEncoder.h"
+#include "../encode/Presets.h"
+
+using namespace Nayuki::FLAC;
+using Nayuki::FLAC::Cli::PcmAudio;
+using Nayuki::FLAC::Cli::PcmReader;
+using Nayuki::FLAC::Cli::PcmWriter;
+using Nayuki::FLAC::Encode::SubframeEncoder;
+
+namespace {
+    /**
+     * The settings given on the command line.
+     */
+    class Options final {
+    public:
+        /**
+         * The command to run, `encode` or `decode`.
+         */
+        std::string command;
+
+        /**
+         * The path of the input file, or `-` for standard input.
+         */
+        std::string input;
+
+        /**
+         * The path of the output file, or `-` for standard output.
+         */
+        std::string output;
+
+        /**
+         * The name of the encoder preset.
+         */
+        std::string preset = "subset-medium";
+
+        /**
+         * The block size strategy: a number of samples, `auto` or `search`.
+         */
+        std::string blockSize = "auto";
+
+        /**
+         * The format of a raw PCM input as `RATE:CHANNELS:DEPTH`, or empty for a WAV, RF64 or AIFF input.
+         */
+        std::string rawFormat;
+
+        /**
+         * Whether the decoder writes raw PCM rather than WAV.
+         */
+        bool raw = false;
+
+        /**
+         * Whether the decoder writes RF64 rather than WAV even if the audio fits a WAV file.
+         */
+        bool rf64 = false;
+
+        /**
+         * The number of threads of the pool, where 0 means one per hardware thread, or -1 to work on the calling
+         * thread only.
+         */
+        int_fast32_t threads = -1;
+
+        /**
+         * Whether to check the output: the encoder decodes the FLAC data again and compares the samples, and the
+         * decoder checks the MD5 hash of the stream info.
+         */
+        bool verify = false;
+
+        /**
+         * The path to write statistics as JSON to, or empty.
+         */
+        std::string statsPath;
+
+        /**
+         * Whether to suppress the summary line on standard error.
+         */
+        bool quiet = false;
+    };
+
+    /**
+     * Prints the command line usage of this program.
+     * @param[in] program the name of the executable
+     */
+    void printUsage(const char *program) {
+        std::cerr << "Usage: " << program << " encode [options] INPUT OUTPUT\n"
+                  << "       " << program << " decode [options] INPUT OUTPUT\n"
+                  << "Encodes WAV, RF64, AIFF or raw PCM audio to FLAC, or decodes FLAC to one of those. Either\n"
+                  << "path can be - for standard input or output. Input files are memory-mapped. Raw PCM is\n"
+                  << "interleaved little-endian signed samples, each in the fewest whole bytes that fit the\n"
+                  << "sample depth, and is chosen by a .raw or .pcm file extension or by the options below.\n"
+                  << "AIFF output is chosen by a .aif, .aiff or .aifc extension. WAV output becomes RF64 when\n"
+                  << "it exceeds 4 GiB.\n\n"
+                  << "Options:\n"
+                  << "  --preset NAME       encoder preset (default subset-medium), one of:\n";
+        for (const auto &preset : Encode::getPresets())
+            std::cerr << "                        " << preset.first << "\n";
+        std::cerr << "  --block-size SIZE   encoder block size: a number of samples in [16, 65535], 'auto'\n"
+                  << "                      (4096, or 8192 above 48 kHz; default), or 'search' (encode with\n"
+                  << "                      every common size and keep the smallest output)\n"
+                  << "  --raw-format R:C:D  read the encoder input as raw PCM with sample rate R, C channels\n"
+                  << "                      and D bits per sample\n"
+                  << "  --raw               write the decoder output as raw PCM\n"
+                  << "  --rf64              write the decoder output as RF64 even if it fits a WAV file\n"
+                  << "  --threads N         encode frames on a pool of N threads, or decode through a\n"
+                  << "                      pipeline on it which also checks the MD5 hash (0 = one per\n"
+                  << "                      hardware thread; default: on the calling thread only)\n"
+                  << "  --verify            decode the encoded file again and compare the samples, or check\n"
+                  << "                      the MD5 hash of the decoded samples\n"
+                  << "  --stats FILE        write timings, sizes, memory usage and encoder or pipeline\n"
+                  << "                      statistics as JSON\n"
+                  << "  --quiet             do not print the summary line\n";
+    }
+
+    /**
+     * Returns the given string as a quoted JSON string literal.
+     */
+    std::string jsonString(const std::string &s) {
+        std::ostringstream result;
+        result << '"';
+        for (char c : s) {
+            if (c == '"' || c == '\\')
+                result << '\\' << c;
+            else if ((unsigned char)c < 0x20)
+                result << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec;
+            else
+                result << c;
+        }
+        result << '"';
+        return result.str();
+    }
+
+    /**
+     * Returns whether the given path ends with the given lowercase extension, ignoring case.
+     */
+    bool hasExtension(const std::string &path, const std::string &ext) {
+        if (path.size() < ext.size())
+            return false;
+        for (size_t i = 0; i < ext.size(); i++) {
+            if (std::tolower((unsigned char)path[path.size() - ext.size() + i]) != ext[i])
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * Returns whether the given path names a raw PCM file by its extension.
+     */
+    bool isRawPath(const std::string &path) {
+        return hasExtension(path, ".raw") || hasExtension(path, ".pcm");
+    }
+
+    /**
+     * Returns the container to write the decoder output in, by the options and the extension of the output path.
+     */
+    PcmWriter::Container getOutputContainer(const Options &opts) {
+        if (opts.raw || isRawPath(opts.output))
+            return PcmWriter::Container::RAW;
+        if (hasExtension(opts.output, ".aif") || hasExtension(opts.output, ".aiff") ||
+                hasExtension(opts.output, ".aifc"))
+            return PcmWriter::Container::AIFF;
+        return opts.rf64 ? PcmWriter::Container::RF64 : PcmWriter::Container::WAV;
+    }
+
+    /**
+     * Calls the given function with a binary output stream for the given path, or standard output for `-`.
+     */
+    template<typename F>
+    void withOutput(const std::string &path, F func) {
+        if (path == "-") {
+            func(std::cout);
+            return;
+        }
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file)
+            throw std::runtime_error("Cannot open " + path + " for writing");
+        func(file);
+    }
+
+    /**
+     * Parses a raw PCM format of the form `RATE:CHANNELS:DEPTH` into the given stream info.
+     */
+    void parseRawFormat(const std::string &spec, Common::StreamInfo *format) {
+        unsigned long rate = 0, channels = 0, depth = 0;
+        char extra;
+        if (std::sscanf(spec.c_str(), "%lu:%lu:%lu%c", &rate, &channels, &depth, &extra) != 3 || rate < 1 ||
+                rate >= (1UL << 20) || channels < 1 || channels > 8 || depth < 4 || depth > 32)
+            throw std::invalid_argument("Invalid raw PCM format: " + spec);
+        format->sampleRate = (uint_fast32_t)rate;
+        format->numChannels = (uint_fast8_t)channels;
+        format->sampleDepth = (uint_fast8_t)depth;
+    }
+
+    /**
+     * Returns the block sizes to try for the given audio under the given strategy.
+     */
+    std::vector<int_fast32_t> getBlockSizes(const std::string &strategy, const Common::StreamInfo &format) {
+        bool highRate = format.sampleRate > 48000;
+        if (strategy == "auto")
+            return {highRate ? 8192 : 4096};
+        if (strategy == "search") {
+            // The sizes allowed in the FLAC subset at the given rate
+            std::vector<int_fast32_t> result = {1152, 2304, 4096, 4608};
+            if (highRate)
+                result.insert(result.end(), {8192, 16384});
+            return result;
+        }
+        char *end;
+        long size = std::strtol(strategy.c_str(), &end, 10);
+        if (strategy.empty() || *end != '\0' || size < 16 || size > 65535)
+            throw std::invalid_argument("Invalid block size: " + strategy);
+        return {(int_fast32_t)size};
+    }
+
+    /**
+     * The outcome of encoding a whole file with one block size.
+     */
+    class EncodedFile final {
+    public:
+        /**
+         * The complete FLAC file.
+         */
+        std::string bytes;
+
+        /**
+         * The block size it was encoded with.
+         */
+        int_fast32_t blockSize = 0;
+
+        /**
+         * The peak heap usage of the encoder in bytes.
+         */
+        uint_fast64_t peakMemoryBytes = 0;
+
+        /**
+         * The pipeline counters of the encoder as JSON.
+         */
+        std::string pipelineJson;
+
+        /**
+         * The per-frame encoder statistics, if collected.
+         */
+        Encode::EncoderStats stats;
+    };
+
+    /**
+     * Encodes the given audio as a complete FLAC file (magic string, stream info including the MD5 hash, and all
+     * frames) with the given block size.
+     */
+    void encodeFile(PcmAudio &audio, int_fast32_t blockSize, const SubframeEncoder::SearchOptions &opt,
+                    bool collectStats, Common::ThreadPool *pool, EncodedFile *result) {
+        Common::StreamInfo info;
+        info.sampleRate = audio.format.sampleRate;
+        info.numChannels = audio.format.numChannels;
+        info.sampleDepth = audio.format.sampleDepth;
+        info.numSamples = audio.format.numSamples;
+        int_fast32_t **channels = audio.samples.getChannels();
+        // Unlike StreamInfo::getMd5Hash(), the hasher also takes depths which are not a multiple of 8
+        Common::Md5Hasher hasher(info.numChannels, info.sampleDepth);
+        hasher.update(channels, 0, info.numSamples);
+        hasher.finish(info.md5Hash);
+
+        // Write a placeholder stream info, then all the frames, then the final stream info
+        std::stringstream out;
+        Encode::BitOutputStream bout(&out);
+        bout.writeInt(32, 0x664C6143);  // Magic string "fLaC"
+        info.minBlockSize = info.maxBlockSize = (uint_fast16_t)blockSize;
+        info.write(true, &bout);
+        Encode::FlacEncoder encoder(&info, channels, info.numSamples, blockSize, opt, &bout,
+                                    collectStats ? &result->stats : nullptr, pool);
+        bout.flush();
+        out.seekp(4);
+        Encode::BitOutputStream infoOut(&out);
+        info.write(true, &infoOut);
+        infoOut.flush();
+
+        result->bytes = out.str();
+        result->blockSize = blockSize;
+        result->peakMemoryBytes = encoder.getMemory().getPeakBytes();
+        std::ostringstream pipeline;
+        encoder.getPipelineStats().writeJson(pipeline);
+        result->pipelineJson = pipeline.str();
+    }
+
+    /**
+     * Decodes the given FLAC file and throws an exception unless it holds exactly the given audio.
+     */
+    void verifyFile(EncodedFile &file, PcmAudio &audio, Common::ThreadPool *pool) {
+        auto *data = reinterpret_cast<uint_fast8_t *>(&file.bytes[0]);
+        Decode::FlacDecoder dec(new Decode::ByteArrayFlacInput(data, file.bytes.size()));
+        while (dec.readAndHandleMetadataBlock(nullptr, nullptr));
+        if (pool != nullptr)
+            dec.startPipeline(pool);
+        int_fast32_t numChannels = audio.format.numChannels;
+        Common::PlanarBuffer<int_fast32_t> block(nullptr, numChannels, 65536);
+        uint_fast64_t pos = 0;
+        while (true) {
+            int_fast32_t n = dec.readAudioBlock(block.getChannels(), 0);
+            if (n == 0)
+                break;
+            if (pos + n > audio.format.numSamples)
+                throw std::runtime_error("Verification failed: too many samples decoded");
+            for (int_fast32_t ch = 0; ch < numChannels; ch++) {
+                if (!std::equal(block.getChannel(ch), block.getChannel(ch) + n, audio.samples.getChannel(ch) + pos))
+                    throw std::runtime_error("Verification failed: decoded samples differ from the input");
+            }
+            pos += n;
+        }
+        if (pos != audio.format.numSamples)
+            throw std::runtime_error("Verification failed: too few samples decoded");
+        dec.close();
+    }
+
+    /**
+     * Runs the `encode` command.
+     */
+    void encode(const Options &opts, Common::ThreadPool *pool) {
+        const SubframeEncoder::SearchOptions *searchOpt = Encode::findPreset(opts.preset);
+        if (searchOpt == nullptr)
+            throw std::invalid_argument("Unknown preset: " + opts.preset);
+        auto start = std::chrono::steady_clock::now();
+
+        PcmAudio audio;
+        {
+            Cli::MappedFile file(opts.input);
+            Cli::PcmView view;
+            if (!opts.rawFormat.empty() || isRawPath(opts.input)) {
+                if (opts.rawFormat.empty())
+                    throw std::invalid_argument("Raw PCM input needs --raw-format");
+                Common::StreamInfo rawFormat;
+                parseRawFormat(opts.rawFormat, &rawFormat);
+                view = PcmReader::parseRaw(file.getData(), file.getLength(), rawFormat);
+            } else
+                view = PcmReader::parse(file.getData(), file.getLength());
+            PcmReader::load(view, &audio);
+        }
+        // Input without samples is valid and becomes a stream info block without frames
+        if ((audio.format.numSamples >> 36) != 0)
+            throw std::runtime_error("The input is too long for FLAC");
+
+        // Keep the smallest encoding over all block sizes of the strategy
+        std::unique_ptr<EncodedFile> best;
+        for (int_fast32_t blockSize : getBlockSizes(opts.blockSize, audio.format)) {
+            std::unique_ptr<EncodedFile> file(new EncodedFile);
+            encodeFile(audio, blockSize, *searchOpt, !opts.statsPath.empty(), pool, file.get());
+            if (best == nullptr || file->bytes.size() < best->bytes.size())
+                best = std::move(file);
+        }
+        if (opts.verify)
+            verifyFile(*best, audio, pool);
+        withOutput(opts.output, [&](std::ostream &out) {
+            out.write(best->bytes.data(), (std::streamsize)best->bytes.size());
+            out.flush();
+            if (!out)
+                throw std::runtime_error("Failed to write " + opts.output);
+        });
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const Common::StreamInfo &format = audio.format;
+        uint_fast64_t pcmBytes = format.numSamples * format.numChannels * ((format.sampleDepth + 7) / 8);
+        double ratio = pcmBytes > 0 ? (double)best->bytes.size() / pcmBytes : 0;
+        double realtime = (double)format.numSamples / format.sampleRate / seconds;
+        if (!opts.quiet) {
+            std::cerr << opts.input << " -> " << opts.output << ": " << pcmBytes << " -> " << best->bytes.size()
+                      << " bytes (ratio " << std::fixed << std::setprecision(4) << ratio << "), "
+                      << std::setprecision(3) << seconds << " s, " << std::setprecision(1) << realtime
+                      << "x realtime, block size " << best->blockSize << (opts.verify ? ", verified" : "") << "\n";
+        }
+        if (!opts.statsPath.empty()) {
+            std::ofstream stats(opts.statsPath);
+            stats << std::setprecision(6)
+                  << "{\"command\": \"encode\", \"input\": " << jsonString(opts.input)
+                  << ", \"output\": " << jsonString(opts.output) << ", \"preset\": " << jsonString(opts.preset)
+                  << ", \"sample_rate\": " << format.sampleRate << ", \"channels\": " << (int)format.numChannels
+                  << ", \"depth\": " << (int)format.sampleDepth << ", \"samples\": " << format.numSamples
+                  << ", \"block_size\": " << best->blockSize << ", \"pcm_bytes\": " << pcmBytes
+                  << ", \"flac_bytes\": " << best->bytes.size() << ", \"ratio\": " << ratio
+                  << ", \"seconds\": " << seconds << ", \"realtime_factor\": " << realtime
+                  << ", \"peak_memory_bytes\": " << best->peakMemoryBytes
+                  << ", \"verified\": " << (opts.verify ? "true" : "false")
+                  << ", \"encoder\": ";
+            best->stats.writeJson(stats);
+            stats << ", \"pipeline\": " << best->pipelineJson << "}\n";
+            if (!stats)
+                throw std::runtime_error("Failed to write " + opts.statsPath);
+        }
+    }
+
+    /**
+     * Runs the `decode` command.
+     */
+    void decode(const Options &opts, Common::ThreadPool *pool) {
+        auto start = std::chrono::steady_clock::now();
+        Cli::MappedFile file(opts.input);
+        uint_fast64_t flacBytes = file.getLength();
+        if (flacBytes == 0)
+            throw Decode::DataFormatException("Empty FLAC file");
+        std::unique_ptr<Decode::FlacDecoder> dec(
+                new Decode::FlacDecoder(new Decode::ByteArrayFlacInput(file.getData(), file.getLength())));
+        while (dec->readAndHandleMetadataBlock(nullptr, nullptr));
+        if (dec->streamInfo == nullptr)
+            throw Decode::DataFormatException("Missing stream info");
+        const Common::StreamInfo &format = *dec->streamInfo;
+        bool haveHash = std::any_of(format.md5Hash, format.md5Hash + sizeof(format.md5Hash),
+                                    [](unsigned char b) { return b != 0; });
+
+        // The pipeline always checks the hash; otherwise it is only computed when asked for
+        std::unique_ptr<Common::Md5Hasher> hasher;
+        if (pool != nullptr)
+            dec->startPipeline(pool);
+        else if (opts.verify && haveHash)
+            hasher.reset(new Common::Md5Hasher(format.numChannels, format.sampleDepth));
+
+        uint_fast64_t numSamples = 0;
+        withOutput(opts.output, [&](std::ostream &out) {
+            PcmWriter writer(&out, getOutputContainer(opts), format);
+            Common::PlanarBuffer<int_fast32_t> block(nullptr, format.numChannels, 65536);
+            while (true) {
+                int_fast32_t n = dec->readAudioBlock(block.getChannels(), 0);
+                if (n == 0)
+                    break;
+                if (hasher != nullptr)
+                    hasher->update(block.getChannels(), 0, (uint_fast64_t)n);
+                writer.write(block.getChannels(), 0, (uint_fast32_t)n);
+                numSamples += n;
+            }
+            writer.finish();
+        });
+        if (hasher != nullptr) {
+            unsigned char actual[MD5_DIGEST_LENGTH];
+            hasher->finish(actual);
+            if (std::memcmp(actual, format.md5Hash, sizeof(actual)) != 0)
+                throw Decode::DataFormatException("MD5 hash mismatch");
+        }
+        bool verified = haveHash && (opts.verify || pool != nullptr);
+        if (opts.verify && !haveHash && !opts.quiet)
+            std::cerr << "Warning: " << opts.input << " has no MD5 hash to verify against\n";
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        uint_fast64_t pcmBytes = numSamples * format.numChannels * ((format.sampleDepth + 7) / 8);
+        double realtime = (double)numSamples / format.sampleRate / seconds;
+        if (!opts.quiet) {
+            std::cerr << opts.input << " -> " << opts.output << ": " << flacBytes << " -> " << pcmBytes
+                      << " bytes, " << std::fixed << std::setprecision(3) << seconds << " s, "
+                      << std::setprecision(1) << realtime << "x realtime" << (verified ? ", verified" : "") << "\n";
+        }
+        if (!opts.statsPath.empty()) {
+            std::ofstream stats(opts.statsPath);
+            stats << std::setprecision(6)
+                  << "{\"command\": \"decode\", \"input\": " << jsonString(opts.input)
+                  << ", \"output\": " << jsonString(opts.output)
+                  << ", \"sample_rate\": " << format.sampleRate << ", \"channels\": " << (int)format.numChannels
+                  << ", \"depth\": " << (int)format.sampleDepth << ", \"samples\": " << numSamples
+                  << ", \"flac_bytes\": " << flacBytes << ", \"pcm_bytes\": " << pcmBytes
+                  << ", \"seconds\": " << seconds << ", \"realtime_factor\": " << realtime
+                  << ", \"peak_memory_bytes\": " << dec->getMemory().getPeakBytes()
+                  << ", \"verified\": " << (verified ? "true" : "false") << ", \"pipeline\": ";
+            const Common::PipelineStats *pipeline = dec->getPipelineStats();
+            if (pipeline != nullptr)
+                pipeline->writeJson(stats);
+            else
+                stats << "null";
+            stats << "}\n";
+            if (!stats)
+                throw std::runtime_error("Failed to write " + opts.statsPath);
+        }
+        dec->close();
+    }
+}
+
+int main(int argc, char *argv[]) {
+    Options opts;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--preset" || arg == "--block-size" || arg == "--raw-format" || arg == "--threads" ||
+                arg == "--stats") && i + 1 < argc) {
+            std::string val = argv[++i];
+            if (arg == "--preset")
+                opts.preset = val;
+            else if (arg == "--block-size")
+                opts.blockSize = val;
+            else if (arg == "--raw-format")
+                opts.rawFormat = val;
+            else if (arg == "--threads")
+                opts.threads = (int_fast32_t)std::strtol(val.c_str(), nullptr, 10);
+            else
+                opts.statsPath = val;
+        } else if (arg == "--raw")
+            opts.raw = true;
+        else if (arg == "--rf64")
+            opts.rf64 = true;
+        else if (arg == "--verify")
+            opts.verify = true;
+        else if (arg == "--quiet")
+            opts.quiet = true;
+        else if (arg == "-" || (!arg.empty() && arg[0] != '-'))
+            paths.push_back(arg);
+        else {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (paths.size() != 3 || (paths[0] != "encode" && paths[0] != "decode") || opts.threads < -1) {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    opts.command = paths[0];
+    opts.input = paths[1];
+    opts.output = paths[2];
+
+    try {
+        std::unique_ptr<Common::ThreadPool> pool;
+        if (opts.threads >= 0)
+            pool.reset(new Common::ThreadPool(opts.threads));
+        if (opts.command == "encode")
+            encode(opts, pool.get());
+        else
+            decode(opts, pool.get());
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
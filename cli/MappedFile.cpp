@@ -0,0 +1,116 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "MappedFile.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <stdexcept>
+
+#include <fcntl.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Cli {
+            MappedFile::MappedFile(const std::string &path) : data(nullptr), length(0), mapped(false) {
+                if (path == "-") {
+                    readAll(fileno(stdin), path);
+                    return;
+                }
+#if defined(__unix__) || defined(__APPLE__)
+                int fd = open(path.c_str(), O_RDONLY);
+                if (fd == -1)
+                    throw std::runtime_error("Cannot open " + path);
+                struct stat st;
+                if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+                    void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (p != MAP_FAILED) {
+                        // The parsers and deinterleavers run front to back over the file
+                        posix_madvise(p, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+                        data = static_cast<const uint8_t *>(p);
+                        length = (size_t)st.st_size;
+                        mapped = true;
+                        close(fd);
+                        return;
+                    }
+                }
+                try {
+                    readAll(fd, path);
+                } catch (...) {
+                    close(fd);
+                    throw;
+                }
+                close(fd);
+#else
+                int fd = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+                if (fd == -1)
+                    throw std::runtime_error("Cannot open " + path);
+                try {
+                    readAll(fd, path);
+                } catch (...) {
+                    _close(fd);
+                    throw;
+                }
+                _close(fd);
+#endif
+            }
+
+            MappedFile::~MappedFile() {
+#if defined(__unix__) || defined(__APPLE__)
+                if (mapped)
+                    munmap(const_cast<uint8_t *>(data), length);
+#endif
+            }
+
+            void MappedFile::readAll(int fd, const std::string &path) {
+                const size_t CHUNK = 1 << 20;
+                size_t len = 0;
+                while (true) {
+                    if (buffer.size() - len < CHUNK)
+                        buffer.resize(len + CHUNK);
+#if defined(__unix__) || defined(__APPLE__)
+                    ssize_t n = read(fd, buffer.data() + len, CHUNK);
+#else
+                    int n = _read(fd, buffer.data() + len, (unsigned int)CHUNK);
+#endif
+                    if (n == 0)
+                        break;
+                    if (n < 0) {
+                        if (errno == EINTR)
+                            continue;
+                        throw std::runtime_error("Failed to read " + path);
+                    }
+                    len += (size_t)n;
+                }
+                buffer.resize(len);
+                data = len > 0 ? buffer.data() : nullptr;
+                length = len;
+            }
+        }
+    }
+}
@@ -0,0 +1,107 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_MAPPEDFILE_H
+#define NAYUKI_MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Cli {
+            /**
+             * The whole content of an input file as one read-only byte range. Regular files are memory-mapped where
+             * the platform supports it, so that parsers work on the page cache without copying; standard input,
+             * pipes and other platforms fall back to reading everything into a buffer. Not copyable.
+             */
+            class MappedFile final {
+            private:
+                /**
+                 * The first byte of the content, or `null` if the file is empty.
+                 */
+                const uint8_t *data;
+
+                /**
+                 * The length of the content in bytes.
+                 */
+                size_t length;
+
+                /**
+                 * Whether `data` is a memory mapping that has to be unmapped.
+                 */
+                bool mapped;
+
+                /**
+                 * The content, if it was read rather than mapped.
+                 */
+                std::vector<uint8_t> buffer;
+
+                /**
+                 * Reads the given stream to its end into the buffer.
+                 * @param[in] fd   the file descriptor to read from
+                 * @param[in] path the path to name in errors
+                 */
+                void readAll(int fd, const std::string &path);
+
+            public:
+                /**
+                 * Maps or reads the given file.
+                 * @param[in] path the path of the file, or `-` for standard input
+                 */
+                explicit MappedFile(const std::string &path);
+
+                MappedFile(const MappedFile &) = delete;
+
+                MappedFile &operator=(const MappedFile &) = delete;
+
+                ~MappedFile();
+
+                /**
+                 * Returns the first byte of the content, which stays valid for the lifetime of this object.
+                 * @return the content, or `null` if the file is empty
+                 */
+                const uint8_t *getData() const {
+                    return data;
+                }
+
+                /**
+                 * Returns the length of the content.
+                 * @return the length in bytes
+                 */
+                size_t getLength() const {
+                    return length;
+                }
+
+                /**
+                 * Returns whether the content is memory-mapped rather than read into a buffer.
+                 * @return whether the content is mapped
+                 */
+                bool isMapped() const {
+                    return mapped;
+                }
+            };
+        }
+    }
+}
+
+#endif
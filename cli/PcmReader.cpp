@@ -0,0 +1,378 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "PcmReader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "../common/Kernels.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Cli {
+            namespace {
+                /**
+                 * Returns the unsigned 16-bit little-endian integer at the given address.
+                 */
+                uint_fast32_t readLe16(const uint8_t *p) {
+                    return (uint_fast32_t)p[0] | (uint_fast32_t)p[1] << 8;
+                }
+
+                /**
+                 * Returns the unsigned 32-bit little-endian integer at the given address.
+                 */
+                uint_fast32_t readLe32(const uint8_t *p) {
+                    return readLe16(p) | readLe16(p + 2) << 16;
+                }
+
+                /**
+                 * Returns the unsigned 64-bit little-endian integer at the given address.
+                 */
+                uint_fast64_t readLe64(const uint8_t *p) {
+                    return (uint_fast64_t)readLe32(p) | (uint_fast64_t)readLe32(p + 4) << 32;
+                }
+
+                /**
+                 * Returns the unsigned 16-bit big-endian integer at the given address.
+                 */
+                uint_fast32_t readBe16(const uint8_t *p) {
+                    return (uint_fast32_t)p[0] << 8 | (uint_fast32_t)p[1];
+                }
+
+                /**
+                 * Returns the unsigned 32-bit big-endian integer at the given address.
+                 */
+                uint_fast32_t readBe32(const uint8_t *p) {
+                    return readBe16(p) << 16 | readBe16(p + 2);
+                }
+
+                /**
+                 * Returns the 80-bit IEEE extended precision number at the given address, which AIFF uses for the
+                 * sample rate, if it is a positive integer below 2^32, otherwise 0.
+                 */
+                uint_fast32_t readExtendedRate(const uint8_t *p) {
+                    uint_fast32_t exponent = readBe16(p);  // Including the sign bit, so negative numbers are rejected
+                    uint_fast64_t mantissa = (uint_fast64_t)readBe32(p + 2) << 32 | readBe32(p + 6);
+                    if (exponent < 16383 || exponent > 16383 + 31)
+                        return 0;
+                    int_fast32_t shift = 16383 + 63 - (int_fast32_t)exponent;  // In the range [32, 63]
+                    if ((mantissa & (((uint_fast64_t)1 << shift) - 1)) != 0)
+                        return 0;
+                    return (uint_fast32_t)(mantissa >> shift);
+                }
+
+                /**
+                 * The tail of the subformat GUID of integer PCM in `WAVE_FORMAT_EXTENSIBLE`, after the format tag.
+                 */
+                const uint8_t PCM_GUID_TAIL[14] = {
+                    0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+                };
+
+                /**
+                 * Converts interleaved samples of `Bytes` bytes each in the given byte order into planar samples, for
+                 * the layouts which `Common::Kernels::unpackPcm` does not cover (big-endian or unsigned). The
+                 * stored bits are placed at the top of a 32-bit word, so that shifting right sign-extends them and
+                 * drops the padding bits. Returns a nonzero value if any padding bit is set or any value does not fit
+                 * the sample depth.
+                 */
+                template<int_fast32_t Bytes, bool BigEndian>
+                uint_fast64_t convertFrames(const uint8_t *p, uint_fast32_t numSamples, int_fast32_t numChannels,
+                                            int_fast32_t depth, int_fast32_t shift, uint32_t bias,
+                                            int_fast32_t *const dest[]) {
+                    const int_fast32_t topShift = 32 - Bytes * 8;
+                    uint32_t paddingMask = ((uint32_t)1 << (topShift + shift)) - 1;
+                    uint_fast64_t half = (uint_fast64_t)1 << (depth - 1);
+                    uint_fast64_t badBits = 0;
+                    for (uint_fast32_t i = 0; i < numSamples; i++) {
+                        for (int_fast32_t ch = 0; ch < numChannels; ch++) {
+                            uint32_t word = 0;
+                            for (int_fast32_t j = 0; j < Bytes; j++)
+                                word |= (uint32_t)p[j] << (8 * (BigEndian ? Bytes - 1 - j : j));
+                            p += Bytes;
+                            word = (word << topShift) ^ bias;
+                            int_fast32_t val = (int32_t)word >> (topShift + shift);
+                            badBits |= (word & paddingMask) | (((uint_fast64_t)val + half) >> depth);
+                            dest[ch][i] = val;
+                        }
+                    }
+                    return badBits;
+                }
+
+                /**
+                 * The instances of `convertFrames`, indexed by big-endianness and by bytes per sample - 1.
+                 */
+                uint_fast64_t (*const CONVERTERS[2][4])(const uint8_t *, uint_fast32_t, int_fast32_t, int_fast32_t,
+                                                        int_fast32_t, uint32_t, int_fast32_t *const []) = {
+                    {convertFrames<1, false>, convertFrames<2, false>, convertFrames<3, false>,
+                     convertFrames<4, false>},
+                    {convertFrames<1, true>, convertFrames<2, true>, convertFrames<3, true>, convertFrames<4, true>},
+                };
+            }
+
+            PcmAudio::PcmAudio() : samples(nullptr) {
+                format.numChannels = 0;
+                format.sampleDepth = 0;
+            }
+
+            PcmView::PcmView() : data(nullptr), bytesPerSample(0), shift(0), isUnsigned(false), isBigEndian(false) {
+                format.numChannels = 0;
+                format.sampleDepth = 0;
+                format.numSamples = 0;
+            }
+
+            void PcmView::deinterleave(uint_fast64_t offset, uint_fast32_t numSamples,
+                                       int_fast32_t *const dest[]) const {
+                if (dest == nullptr)
+                    throw std::invalid_argument("Destination cannot be null");
+                if (offset > format.numSamples || numSamples > format.numSamples - offset)
+                    throw std::out_of_range("Sample range out of bounds");
+                if (numSamples == 0)
+                    return;
+                const uint8_t *p = data + offset * format.numChannels * bytesPerSample;
+                int_fast32_t numChannels = format.numChannels;
+                int_fast32_t depth = format.sampleDepth;
+                if (isBigEndian || isUnsigned) {
+                    uint32_t bias = isUnsigned ? (uint32_t)1 << 31 : 0;
+                    if (CONVERTERS[isBigEndian ? 1 : 0][bytesPerSample - 1](p, numSamples, numChannels, depth, shift,
+                                                                             bias, dest) != 0)
+                        throw std::runtime_error("Sample value exceeds the bit depth");
+                    return;
+                }
+
+                // Little-endian signed samples, the layout of WAV files of 16 bits and more and of raw files, go
+                // through the vector kernel; only samples narrower than their container need another pass
+                Common::Kernels::get().unpackPcm(p, (uint_fast8_t)numChannels, 0, numSamples,
+                                                 (uint_fast8_t)bytesPerSample, dest);
+                if (shift == 0 && depth == bytesPerSample * 8)
+                    return;
+                int_fast32_t paddingMask = ((int_fast32_t)1 << shift) - 1;
+                uint_fast64_t half = (uint_fast64_t)1 << (depth - 1);
+                uint_fast64_t badBits = 0;
+                for (int_fast32_t ch = 0; ch < numChannels; ch++) {
+                    int_fast32_t *samples = dest[ch];
+                    for (uint_fast32_t i = 0; i < numSamples; i++) {
+                        int_fast32_t val = samples[i] >> shift;
+                        badBits |= (uint_fast64_t)(samples[i] & paddingMask) | (((uint_fast64_t)val + half) >> depth);
+                        samples[i] = val;
+                    }
+                }
+                if (badBits != 0)
+                    throw std::runtime_error("Sample value exceeds the bit depth");
+            }
+
+            PcmView PcmReader::parse(const uint8_t data[], size_t len) {
+                if (data == nullptr && len != 0)
+                    throw std::invalid_argument("Data cannot be null");
+                if (len >= 12 && std::memcmp(data + 8, "WAVE", 4) == 0 && (std::memcmp(data, "RIFF", 4) == 0 ||
+                        std::memcmp(data, "RF64", 4) == 0 || std::memcmp(data, "BW64", 4) == 0))
+                    return parseRiff(data, len);
+                if (len >= 12 && std::memcmp(data, "FORM", 4) == 0 &&
+                        (std::memcmp(data + 8, "AIFF", 4) == 0 || std::memcmp(data + 8, "AIFC", 4) == 0))
+                    return parseAiff(data, len);
+                throw std::runtime_error("Unknown PCM container (expected WAV, RF64 or AIFF)");
+            }
+
+            PcmView PcmReader::parseRiff(const uint8_t data[], size_t len) {
+                // RF64 and BW64 files put the 64-bit sizes into a chunk of their own, which comes first
+                bool is64 = std::memcmp(data, "RIFF", 4) != 0;
+                bool haveSizes = false;
+                uint_fast64_t dataLen64 = 0;
+
+                // Walk the chunks up to the data chunk, which must come after the format chunk
+                PcmView view;
+                bool haveFormat = false;
+                size_t blockAlign = 0;
+                for (size_t pos = 12; ; ) {
+                    if (len - pos < 8)
+                        throw std::runtime_error("WAV file has no data chunk");
+                    const uint8_t *chunk = data + pos;
+                    uint_fast64_t chunkLen = readLe32(chunk + 4);
+                    pos += 8;
+                    if (std::memcmp(chunk, "ds64", 4) == 0) {
+                        if (!is64 || chunkLen < 28 || chunkLen > len - pos)
+                            throw std::runtime_error("Invalid RF64 size chunk");
+                        dataLen64 = readLe64(data + pos + 8);
+                        haveSizes = true;
+                    } else if (std::memcmp(chunk, "fmt ", 4) == 0) {
+                        if (chunkLen < 16 || chunkLen > len - pos)
+                            throw std::runtime_error("Invalid WAV format chunk");
+                        const uint8_t *fmt = data + pos;
+                        uint_fast32_t formatTag = readLe16(fmt);
+                        uint_fast32_t numChannels = readLe16(fmt + 2);
+                        uint_fast32_t sampleRate = readLe32(fmt + 4);
+                        blockAlign = readLe16(fmt + 12);
+                        uint_fast32_t containerBits = readLe16(fmt + 14);
+                        uint_fast32_t validBits = containerBits;
+                        if (formatTag == 0xFFFE) {  // WAVE_FORMAT_EXTENSIBLE
+                            if (chunkLen < 40 || readLe16(fmt + 16) < 22)
+                                throw std::runtime_error("Invalid WAV extensible format chunk");
+                            if (readLe16(fmt + 18) != 0)
+                                validBits = readLe16(fmt + 18);
+                            formatTag = readLe16(fmt + 24);
+                            if (std::memcmp(fmt + 26, PCM_GUID_TAIL, sizeof(PCM_GUID_TAIL)) != 0)
+                                throw std::runtime_error("Unsupported WAV sample format");
+                        }
+                        if (formatTag != 1)
+                            throw std::runtime_error("Unsupported WAV sample format (only integer PCM)");
+                        if (numChannels < 1 || numChannels > 8)
+                            throw std::runtime_error("Unsupported number of channels in WAV file");
+                        if (containerBits % 8 != 0 || containerBits < 8 || containerBits > 32 ||
+                                validBits < 4 || validBits > containerBits)
+                            throw std::runtime_error("Unsupported sample depth in WAV file");
+                        view.bytesPerSample = (int_fast32_t)(containerBits / 8);
+                        if (blockAlign != numChannels * view.bytesPerSample)
+                            throw std::runtime_error("Invalid block alignment in WAV file");
+                        view.shift = (int_fast32_t)(containerBits - validBits);
+                        view.isUnsigned = view.bytesPerSample == 1;
+                        view.format.sampleRate = sampleRate;
+                        view.format.numChannels = (uint_fast8_t)numChannels;
+                        view.format.sampleDepth = (uint_fast8_t)validBits;
+                        haveFormat = true;
+                    } else if (std::memcmp(chunk, "data", 4) == 0) {
+                        if (!haveFormat)
+                            throw std::runtime_error("WAV data chunk precedes the format chunk");
+                        if (is64 && chunkLen == 0xFFFFFFFF) {
+                            if (!haveSizes)
+                                throw std::runtime_error("RF64 file has no size chunk");
+                            chunkLen = dataLen64;
+                        }
+                        if (chunkLen == 0 || chunkLen > len - pos)
+                            chunkLen = len - pos;
+                        view.format.numSamples = chunkLen / blockAlign;
+                        view.data = view.format.numSamples > 0 ? data + pos : nullptr;
+                        return view;
+                    }
+                    if (chunkLen > len - pos)
+                        throw std::runtime_error("Truncated WAV chunk");
+                    pos += chunkLen + (chunkLen & 1);  // Chunks are padded to an even length
+                    if (pos > len)
+                        throw std::runtime_error("Truncated WAV chunk");
+                }
+            }
+
+            PcmView PcmReader::parseAiff(const uint8_t data[], size_t len) {
+                bool isAifc = std::memcmp(data + 8, "AIFC", 4) == 0;
+                size_t end = (size_t)std::min((uint_fast64_t)len, (uint_fast64_t)readBe32(data + 4) + 8);
+
+                // The common chunk and the sound data chunk can come in either order
+                PcmView view;
+                bool haveCommon = false;
+                const uint8_t *sound = nullptr;
+                uint_fast64_t soundLen = 0;
+                for (size_t pos = 12; end - pos >= 8; ) {
+                    const uint8_t *chunk = data + pos;
+                    uint_fast64_t chunkLen = readBe32(chunk + 4);
+                    pos += 8;
+                    if (std::memcmp(chunk, "COMM", 4) == 0) {
+                        if (chunkLen < (isAifc ? 22U : 18U) || chunkLen > end - pos)
+                            throw std::runtime_error("Invalid AIFF common chunk");
+                        const uint8_t *comm = data + pos;
+                        uint_fast32_t numChannels = readBe16(comm);
+                        uint_fast32_t sampleSize = readBe16(comm + 6);
+                        uint_fast32_t sampleRate = readExtendedRate(comm + 8);
+                        view.isBigEndian = true;
+                        if (isAifc) {
+                            if (std::memcmp(comm + 18, "sowt", 4) == 0)  // Little-endian samples
+                                view.isBigEndian = false;
+                            else if (std::memcmp(comm + 18, "NONE", 4) != 0 && std::memcmp(comm + 18, "twos", 4) != 0)
+                                throw std::runtime_error("Unsupported AIFF-C compression type");
+                        }
+                        if (numChannels < 1 || numChannels > 8)
+                            throw std::runtime_error("Unsupported number of channels in AIFF file");
+                        if (sampleSize < 4 || sampleSize > 32)
+                            throw std::runtime_error("Unsupported sample depth in AIFF file");
+                        if (sampleRate == 0)
+                            throw std::runtime_error("Unsupported sample rate in AIFF file");
+                        view.bytesPerSample = (int_fast32_t)(sampleSize + 7) / 8;
+                        view.shift = view.bytesPerSample * 8 - (int_fast32_t)sampleSize;
+                        view.format.sampleRate = sampleRate;
+                        view.format.numChannels = (uint_fast8_t)numChannels;
+                        view.format.sampleDepth = (uint_fast8_t)sampleSize;
+                        view.format.numSamples = readBe32(comm + 2);
+                        haveCommon = true;
+                    } else if (std::memcmp(chunk, "SSND", 4) == 0) {
+                        chunkLen = std::min(chunkLen, (uint_fast64_t)(end - pos));  // Tolerate a truncated file
+                        if (chunkLen < 8 || readBe32(data + pos) > chunkLen - 8)
+                            throw std::runtime_error("Invalid AIFF sound data chunk");
+                        uint_fast32_t offset = readBe32(data + pos);
+                        sound = data + pos + 8 + offset;
+                        soundLen = chunkLen - 8 - offset;
+                    }
+                    if (chunkLen > end - pos)
+                        throw std::runtime_error("Truncated AIFF chunk");
+                    pos = (size_t)std::min(pos + chunkLen + (chunkLen & 1), (uint_fast64_t)end);
+                }
+                if (!haveCommon)
+                    throw std::runtime_error("AIFF file has no common chunk");
+                if (view.format.numSamples > 0) {
+                    uint_fast64_t frameBytes = (uint_fast64_t)view.format.numChannels * view.bytesPerSample;
+                    if (sound == nullptr || view.format.numSamples > soundLen / frameBytes)
+                        throw std::runtime_error("Truncated AIFF sound data");
+                    view.data = sound;
+                }
+                return view;
+            }
+
+            PcmView PcmReader::parseRaw(const uint8_t data[], size_t len, const Common::StreamInfo &format) {
+                if (data == nullptr && len != 0)
+                    throw std::invalid_argument("Data cannot be null");
+                if (format.numChannels < 1 || format.numChannels > 8 || format.sampleDepth < 4 ||
+                        format.sampleDepth > 32)
+                    throw std::invalid_argument("Invalid raw PCM format");
+                PcmView view;
+                view.bytesPerSample = (format.sampleDepth + 7) / 8;
+                size_t frameBytes = (size_t)format.numChannels * view.bytesPerSample;
+                if (len % frameBytes != 0)
+                    throw std::runtime_error("Raw PCM length is not a whole number of sample frames");
+                view.format.sampleRate = format.sampleRate;
+                view.format.numChannels = format.numChannels;
+                view.format.sampleDepth = format.sampleDepth;
+                view.format.numSamples = len / frameBytes;
+                view.data = len > 0 ? data : nullptr;
+                return view;
+            }
+
+            void PcmReader::load(const PcmView &view, PcmAudio *audio) {
+                if (audio == nullptr)
+                    throw std::invalid_argument("Audio cannot be null");
+                int_fast32_t numChannels = view.format.numChannels;
+                uint_fast64_t numSamples = view.format.numSamples;
+                audio->format.sampleRate = view.format.sampleRate;
+                audio->format.numChannels = view.format.numChannels;
+                audio->format.sampleDepth = view.format.sampleDepth;
+                audio->format.numSamples = numSamples;
+                audio->samples.reserve(numChannels, (size_t)numSamples);
+
+                // Convert in pieces, so that the source pages are read once while the destinations stay in cache
+                const uint_fast32_t PIECE_SAMPLES = 1 << 14;
+                int_fast32_t *const *channels = audio->samples.getChannels();
+                int_fast32_t *dest[8];
+                for (uint_fast64_t pos = 0; pos < numSamples; pos += PIECE_SAMPLES) {
+                    for (int_fast32_t ch = 0; ch < numChannels; ch++)
+                        dest[ch] = channels[ch] + pos;
+                    view.deinterleave(pos, (uint_fast32_t)std::min((uint_fast64_t)PIECE_SAMPLES, numSamples - pos),
+                                      dest);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,154 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_PCMREADER_H
+#define NAYUKI_PCMREADER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../common/PlanarBuffer.h"
+#include "../common/StreamInfo.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Cli {
+            /**
+             * Uncompressed audio held in memory as planar samples, as read from a PCM file.
+             */
+            class PcmAudio final {
+            public:
+                /**
+                 * The format of the audio. Only the sample rate, number of channels, sample depth and number of
+                 * samples are used.
+                 */
+                Common::StreamInfo format;
+
+                /**
+                 * The samples, with `format.numChannels` channels of `format.numSamples` samples each.
+                 */
+                Common::PlanarBuffer<int_fast32_t> samples;
+
+                PcmAudio();
+            };
+
+            /**
+             * A zero-copy view of the interleaved samples of a PCM file held in memory (usually a `MappedFile`),
+             * describing how the samples are stored so that they can be converted to planar samples in pieces of any
+             * size. The view does not own the bytes, which must outlive it.
+             */
+            class PcmView final {
+            public:
+                /**
+                 * The format of the audio. Only the sample rate, number of channels, sample depth and number of
+                 * samples are used.
+                 */
+                Common::StreamInfo format;
+
+                /**
+                 * The first byte of the first sample frame, or `null` if there are no samples.
+                 */
+                const uint8_t *data;
+
+                /**
+                 * The size of a stored sample, in the range [1, 4].
+                 */
+                int_fast32_t bytesPerSample;
+
+                /**
+                 * The number of zero padding bits below each stored sample.
+                 */
+                int_fast32_t shift;
+
+                /**
+                 * Whether the samples are stored with an offset of half their range.
+                 */
+                bool isUnsigned;
+
+                /**
+                 * Whether the bytes of a sample are stored most significant first.
+                 */
+                bool isBigEndian;
+
+                PcmView();
+
+                /**
+                 * Converts a range of sample frames into planar samples, checking that the padding bits are zero and
+                 * that every value fits the sample depth.
+                 * @param[in]  offset     the index of the first sample frame to convert
+                 * @param[in]  numSamples the number of sample frames to convert, at most `format.numSamples - offset`
+                 * @param[out] dest       the channels to store the samples into, starting at index 0 (not `null`)
+                 */
+                void deinterleave(uint_fast64_t offset, uint_fast32_t numSamples, int_fast32_t *const dest[]) const;
+            };
+
+            /**
+             * Parses uncompressed PCM audio files that are held in memory into views of their samples. The supported
+             * containers are RIFF WAVE files with integer samples (including `WAVE_FORMAT_EXTENSIBLE`), their 64-bit
+             * RF64 and BW64 variants for files beyond 4 GiB, AIFF and uncompressed AIFF-C files, and headerless raw
+             * files of interleaved little-endian signed samples, each stored in the fewest whole bytes that fit the
+             * sample depth. Static methods only.
+             */
+            class PcmReader final {
+            public:
+                PcmReader() = delete;
+
+                /**
+                 * Parses a WAV, RF64 or AIFF file, telling the container apart by its leading bytes. Samples stored in
+                 * a wider container than their valid bits are shifted down. A WAV data chunk whose declared size is
+                 * zero or runs past the end of the file (as written by streaming tools) extends to the end of the file.
+                 * @param[in] data the bytes of the file (not `null`)
+                 * @param[in] len  the length of the file in bytes
+                 * @return a view of the samples in the given bytes
+                 */
+                static PcmView parse(const uint8_t data[], size_t len);
+
+                /**
+                 * Parses a raw PCM file of the given format.
+                 * @param[in] data   the bytes of the file (not `null` unless `len` is 0)
+                 * @param[in] len    the length of the file in bytes, a multiple of the size of one sample frame
+                 * @param[in] format the sample rate, number of channels and sample depth of the file
+                 * @return a view of the samples in the given bytes
+                 */
+                static PcmView parseRaw(const uint8_t data[], size_t len, const Common::StreamInfo &format);
+
+                /**
+                 * Converts all the samples of the given view into the given audio, and copies the format.
+                 * @param[in]  view  the samples to convert
+                 * @param[out] audio the audio to store the format and samples into (not `null`)
+                 */
+                static void load(const PcmView &view, PcmAudio *audio);
+
+            private:
+                /**
+                 * Parses a RIFF WAVE, RF64 or BW64 file.
+                 */
+                static PcmView parseRiff(const uint8_t data[], size_t len);
+
+                /**
+                 * Parses an AIFF or AIFF-C file.
+                 */
+                static PcmView parseAiff(const uint8_t data[], size_t len);
+            };
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,293 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "PcmWriter.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "../common/Kernels.h"
+#include "../common/SampleFormat.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Cli {
+            namespace {
+                /**
+                 * Appends the given integer as unsigned 16-bit little-endian.
+                 */
+                void appendLe16(std::vector<uint8_t> &out, uint_fast32_t val) {
+                    out.push_back((uint8_t)val);
+                    out.push_back((uint8_t)(val >> 8));
+                }
+
+                /**
+                 * Appends the given integer as unsigned 32-bit little-endian.
+                 */
+                void appendLe32(std::vector<uint8_t> &out, uint_fast32_t val) {
+                    appendLe16(out, val & 0xFFFF);
+                    appendLe16(out, val >> 16);
+                }
+
+                /**
+                 * Appends the given integer as unsigned 64-bit little-endian.
+                 */
+                void appendLe64(std::vector<uint8_t> &out, uint_fast64_t val) {
+                    appendLe32(out, (uint_fast32_t)(val & 0xFFFFFFFF));
+                    appendLe32(out, (uint_fast32_t)(val >> 32));
+                }
+
+                /**
+                 * Appends the given integer as unsigned 16-bit big-endian.
+                 */
+                void appendBe16(std::vector<uint8_t> &out, uint_fast32_t val) {
+                    out.push_back((uint8_t)(val >> 8));
+                    out.push_back((uint8_t)val);
+                }
+
+                /**
+                 * Appends the given integer as unsigned 32-bit big-endian.
+                 */
+                void appendBe32(std::vector<uint8_t> &out, uint_fast32_t val) {
+                    appendBe16(out, val >> 16);
+                    appendBe16(out, val & 0xFFFF);
+                }
+
+                /**
+                 * Appends the given integer as an 80-bit IEEE extended precision number, as AIFF stores the sample
+                 * rate.
+                 */
+                void appendExtended(std::vector<uint8_t> &out, uint_fast32_t val) {
+                    if (val == 0) {
+                        out.insert(out.end(), 10, 0);
+                        return;
+                    }
+                    int_fast32_t top = 31;
+                    while (((val >> top) & 1) == 0)
+                        top--;
+                    uint_fast64_t mantissa = (uint_fast64_t)val << (63 - top);  // With the explicit integer bit
+                    appendBe16(out, (uint_fast32_t)(16383 + top));
+                    appendBe32(out, (uint_fast32_t)(mantissa >> 32));
+                    appendBe32(out, (uint_fast32_t)(mantissa & 0xFFFFFFFF));
+                }
+
+                /**
+                 * The integer sample formats, indexed by bytes per sample - 2.
+                 */
+                const Common::SampleFormat INT_FORMATS[3] = {
+                    Common::SampleFormat::INT16, Common::SampleFormat::INT24, Common::SampleFormat::INT32
+                };
+
+                /**
+                 * The speaker positions of the FLAC channel orders, indexed by number of channels - 1, as
+                 * `WAVE_FORMAT_EXTENSIBLE` channel masks.
+                 */
+                const uint_fast32_t CHANNEL_MASKS[8] = {
+                    0x004, 0x003, 0x007, 0x033, 0x037, 0x03F, 0x70F, 0x63F
+                };
+
+                /**
+                 * The tail of the subformat GUID of integer PCM, after the format tag.
+                 */
+                const uint8_t PCM_GUID_TAIL[14] = {
+                    0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+                };
+            }
+
+            PcmWriter::PcmWriter(std::ostream *out, Container container, const Common::StreamInfo &format)
+                    : staging(nullptr, 1, STAGING_BYTES) {
+                if (out == nullptr)
+                    throw std::invalid_argument("Output stream cannot be null");
+                if (format.numChannels < 1 || format.numChannels > 8 || format.sampleDepth < 4 ||
+                        format.sampleDepth > 32)
+                    throw std::invalid_argument("Invalid PCM format");
+                this->out = out;
+                this->container = container;
+                numChannels = format.numChannels;
+                sampleDepth = format.sampleDepth;
+                sampleRate = format.sampleRate;
+                bytesPerSample = (sampleDepth + 7) / 8;
+                declaredSamples = format.numSamples;
+                writtenSamples = 0;
+                stagedBytes = 0;
+
+                // Leave room for the 64-bit sizes if the audio might not fit 32-bit sizes (with some headroom for
+                // the header)
+                uint_fast64_t dataLen = declaredSamples * numChannels * bytesPerSample;
+                reserveSizes = container == Container::RF64 ||
+                        (container == Container::WAV && (declaredSamples == 0 || dataLen > 0xFFFFFF00));
+
+                headerPos = out->tellp();
+                std::vector<uint8_t> header = makeHeader(declaredSamples);
+                out->write(reinterpret_cast<const char *>(header.data()), (std::streamsize)header.size());
+            }
+
+            std::vector<uint8_t> PcmWriter::makeHeader(uint_fast64_t numSamples) const {
+                switch (container) {
+                    case Container::WAV:
+                    case Container::RF64:
+                        return makeWavHeader(numSamples);
+                    case Container::AIFF:
+                        return makeAiffHeader(numSamples);
+                    default:
+                        return std::vector<uint8_t>();
+                }
+            }
+
+            std::vector<uint8_t> PcmWriter::makeWavHeader(uint_fast64_t numSamples) const {
+                uint_fast32_t blockAlign = numChannels * bytesPerSample;
+                bool extensible = numChannels > 2 || sampleDepth > 16 || sampleDepth % 8 != 0;
+                uint_fast32_t fmtLen = extensible ? 40 : 16;
+                uint_fast64_t dataLen = numSamples * blockAlign;
+                uint_fast64_t riffLen = 4 + (reserveSizes ? 36 : 0) + 8 + fmtLen + 8 + dataLen + (dataLen & 1);
+                bool rf64 = container == Container::RF64 || (riffLen >> 32) != 0;
+                if (rf64 && !reserveSizes)
+                    throw std::runtime_error("Audio is too long for a WAV file");
+                if (numSamples == 0)  // Unknown length, which readers take as "until the end of the file"
+                    riffLen = dataLen = 0;
+
+                std::vector<uint8_t> result;
+                if (rf64)
+                    result.insert(result.end(), {'R', 'F', '6', '4'});
+                else
+                    result.insert(result.end(), {'R', 'I', 'F', 'F'});
+                appendLe32(result, rf64 || numSamples == 0 ? 0xFFFFFFFF : (uint_fast32_t)riffLen);
+                result.insert(result.end(), {'W', 'A', 'V', 'E'});
+                if (reserveSizes) {
+                    // The size chunk of RF64, or a junk chunk of the same length which can become one later
+                    if (rf64)
+                        result.insert(result.end(), {'d', 's', '6', '4'});
+                    else
+                        result.insert(result.end(), {'J', 'U', 'N', 'K'});
+                    appendLe32(result, 28);
+                    appendLe64(result, rf64 ? riffLen : 0);
+                    appendLe64(result, rf64 ? dataLen : 0);
+                    appendLe64(result, rf64 ? numSamples : 0);
+                    appendLe32(result, 0);  // No table of other chunk sizes
+                }
+                result.insert(result.end(), {'f', 'm', 't', ' '});
+                appendLe32(result, fmtLen);
+                appendLe16(result, extensible ? 0xFFFE : 1);
+                appendLe16(result, numChannels);
+                appendLe32(result, sampleRate);
+                appendLe32(result, sampleRate * blockAlign);
+                appendLe16(result, blockAlign);
+                appendLe16(result, bytesPerSample * 8);
+                if (extensible) {
+                    appendLe16(result, 22);
+                    appendLe16(result, sampleDepth);
+                    appendLe32(result, CHANNEL_MASKS[numChannels - 1]);
+                    appendLe16(result, 1);  // Integer PCM
+                    result.insert(result.end(), PCM_GUID_TAIL, PCM_GUID_TAIL + sizeof(PCM_GUID_TAIL));
+                }
+                result.insert(result.end(), {'d', 'a', 't', 'a'});
+                appendLe32(result, rf64 || numSamples == 0 ? 0xFFFFFFFF : (uint_fast32_t)dataLen);
+                return result;
+            }
+
+            std::vector<uint8_t> PcmWriter::makeAiffHeader(uint_fast64_t numSamples) const {
+                uint_fast64_t dataLen = numSamples * numChannels * bytesPerSample;
+                uint_fast64_t formLen = 4 + 8 + 18 + 8 + 8 + dataLen + (dataLen & 1);
+                if ((formLen >> 32) != 0)
+                    throw std::runtime_error("Audio is too long for an AIFF file");
+
+                std::vector<uint8_t> result;
+                result.insert(result.end(), {'F', 'O', 'R', 'M'});
+                appendBe32(result, (uint_fast32_t)formLen);
+                result.insert(result.end(), {'A', 'I', 'F', 'F', 'C', 'O', 'M', 'M'});
+                appendBe32(result, 18);
+                appendBe16(result, numChannels);
+                appendBe32(result, (uint_fast32_t)numSamples);
+                appendBe16(result, sampleDepth);
+                appendExtended(result, sampleRate);
+                result.insert(result.end(), {'S', 'S', 'N', 'D'});
+                appendBe32(result, (uint_fast32_t)(8 + dataLen));
+                appendBe32(result, 0);  // Offset of the samples
+                appendBe32(result, 0);  // Block size
+                return result;
+            }
+
+            void PcmWriter::write(const int_fast32_t *const samples[], uint_fast64_t offset, uint_fast32_t numSamples) {
+                if (samples == nullptr)
+                    throw std::invalid_argument("Samples cannot be null");
+                size_t frameBytes = (size_t)numChannels * bytesPerSample;
+                int_fast32_t padding = container == Container::RAW ? 0 : bytesPerSample * 8 - sampleDepth;
+                bool isUnsigned = (container == Container::WAV || container == Container::RF64) && bytesPerSample == 1;
+                bool isBigEndian = container == Container::AIFF;
+                while (numSamples > 0) {
+                    if (STAGING_BYTES - stagedBytes < frameBytes)
+                        flushStaging();
+                    uint_fast32_t n = (uint_fast32_t)std::min((size_t)numSamples,
+                                                              (STAGING_BYTES - stagedBytes) / frameBytes);
+                    uint8_t *p = staging.getChannel(0) + stagedBytes;
+                    if (container == Container::RAW) {
+                        Common::Kernels::get().packPcm(samples, (uint_fast8_t)numChannels, offset, n,
+                                                       (uint_fast8_t)bytesPerSample, p);
+                    } else if (!isUnsigned && !isBigEndian) {
+                        // Padding below the sample is the left-justified layout of the integer sample formats
+                        Common::SampleConverter::interleave(samples, (uint_fast8_t)numChannels, offset, n,
+                                                            sampleDepth, INT_FORMATS[bytesPerSample - 2], p);
+                    } else {
+                        uint32_t bias = isUnsigned ? 0x80 : 0;
+                        for (uint_fast32_t i = 0; i < n; i++) {
+                            for (int_fast32_t ch = 0; ch < numChannels; ch++) {
+                                uint32_t word = ((uint32_t)samples[ch][offset + i] << padding) ^ bias;
+                                for (int_fast32_t j = 0; j < bytesPerSample; j++)
+                                    p[j] = (uint8_t)(word >> (8 * (isBigEndian ? bytesPerSample - 1 - j : j)));
+                                p += bytesPerSample;
+                            }
+                        }
+                    }
+                    stagedBytes += n * frameBytes;
+                    offset += n;
+                    numSamples -= n;
+                    writtenSamples += n;
+                }
+            }
+
+            void PcmWriter::flushStaging() {
+                out->write(reinterpret_cast<const char *>(staging.getChannel(0)), (std::streamsize)stagedBytes);
+                stagedBytes = 0;
+            }
+
+            void PcmWriter::finish() {
+                flushStaging();
+                if (container != Container::RAW) {
+                    uint_fast64_t dataLen = writtenSamples * numChannels * bytesPerSample;
+                    if (dataLen % 2 == 1)  // Chunks are padded to an even length
+                        out->put(0);
+                    if (writtenSamples != declaredSamples) {
+                        if (headerPos != std::streampos(-1)) {
+                            std::streampos end = out->tellp();
+                            out->seekp(headerPos);
+                            std::vector<uint8_t> header = makeHeader(writtenSamples);
+                            out->write(reinterpret_cast<const char *>(header.data()), (std::streamsize)header.size());
+                            out->seekp(end);
+                        } else if (container == Container::AIFF)
+                            throw std::runtime_error("Cannot complete the AIFF header on a non-seekable stream");
+                    }
+                }
+                out->flush();
+                if (!*out)
+                    throw std::runtime_error("Failed to write PCM data");
+            }
+        }
+    }
+}
@@ -0,0 +1,191 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_PCMWRITER_H
+#define NAYUKI_PCMWRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "../common/PlanarBuffer.h"
+#include "../common/StreamInfo.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Cli {
+            /**
+             * Writes planar samples as an uncompressed PCM file, block after block, in the containers that `PcmReader`
+             * parses. The interleaved bytes are staged in a large aligned buffer and handed to the stream in whole
+             * buffers, so that the stream passes them straight to the operating system.
+             *
+             * WAV files store each sample in the fewest whole bytes that fit it, with the padding bits below the
+             * sample, and use `WAVE_FORMAT_EXTENSIBLE` when the plain format header cannot describe the audio. When
+             * the length is unknown or too large for 32-bit sizes, a `JUNK` chunk reserves room for an RF64 size
+             * chunk, and the header becomes RF64 if the audio ends up beyond 4 GiB. AIFF files store big-endian
+             * samples padded the same way. Raw files store interleaved little-endian signed samples, the layout the
+             * FLAC MD5 hash covers.
+             */
+            class PcmWriter final {
+            public:
+                /**
+                 * The file formats that can be written.
+                 */
+                enum class Container {
+                    /**
+                     * Headerless interleaved little-endian signed samples.
+                     */
+                    RAW,
+
+                    /**
+                     * A RIFF WAVE file, which becomes RF64 if it does not fit 32-bit sizes.
+                     */
+                    WAV,
+
+                    /**
+                     * An RF64 file regardless of its size.
+                     */
+                    RF64,
+
+                    /**
+                     * An AIFF file, limited to 32-bit sizes.
+                     */
+                    AIFF
+                };
+
+            private:
+                /**
+                 * The size of the staging buffer in bytes.
+                 */
+                static const size_t STAGING_BYTES = (size_t)1 << 20;
+
+                /**
+                 * The stream to write to.
+                 */
+                std::ostream *out;
+
+                /**
+                 * The file format to write.
+                 */
+                Container container;
+
+                /**
+                 * The number of channels, in the range [1, 8].
+                 */
+                int_fast32_t numChannels;
+
+                /**
+                 * The bit depth of the samples, in the range [4, 32].
+                 */
+                int_fast32_t sampleDepth;
+
+                /**
+                 * The sample rate in hertz.
+                 */
+                uint_fast32_t sampleRate;
+
+                /**
+                 * The size of a stored sample, in the range [1, 4].
+                 */
+                int_fast32_t bytesPerSample;
+
+                /**
+                 * Whether the WAV header has room for an RF64 size chunk.
+                 */
+                bool reserveSizes;
+
+                /**
+                 * The number of samples per channel the header declares.
+                 */
+                uint_fast64_t declaredSamples;
+
+                /**
+                 * The number of samples per channel written so far.
+                 */
+                uint_fast64_t writtenSamples;
+
+                /**
+                 * The position of the header in the stream, or -1 if the stream is not seekable.
+                 */
+                std::streampos headerPos;
+
+                /**
+                 * Interleaved bytes waiting to be written, in a buffer of `STAGING_BYTES` bytes.
+                 */
+                Common::PlanarBuffer<uint8_t> staging;
+
+                /**
+                 * The number of bytes at the start of the staging buffer.
+                 */
+                size_t stagedBytes;
+
+                /**
+                 * Returns the header that declares the given number of samples per channel, which always has the same
+                 * length for a given writer.
+                 * @param[in] numSamples the number of samples per channel, or 0 if unknown
+                 * @return the bytes of the header, empty for raw files
+                 */
+                std::vector<uint8_t> makeHeader(uint_fast64_t numSamples) const;
+
+                /**
+                 * Returns the WAV or RF64 header, see `makeHeader`.
+                 */
+                std::vector<uint8_t> makeWavHeader(uint_fast64_t numSamples) const;
+
+                /**
+                 * Returns the AIFF header, see `makeHeader`.
+                 */
+                std::vector<uint8_t> makeAiffHeader(uint_fast64_t numSamples) const;
+
+                /**
+                 * Writes the staged bytes to the stream and empties the staging buffer.
+                 */
+                void flushStaging();
+
+            public:
+                /**
+                 * Starts a PCM file of the given format on the given stream, writing the header if applicable.
+                 * @param[in,out] out       the stream to write to (not `null`)
+                 * @param[in]     container the file format to write
+                 * @param[in]     format    the format of the audio; the sample rate, number of channels and sample
+                 * depth must be valid, and a number of samples of 0 means that it is unknown
+                 */
+                PcmWriter(std::ostream *out, Container container, const Common::StreamInfo &format);
+
+                /**
+                 * Appends a block of samples.
+                 * @param[in] samples    the channels to take the samples from (not `null`)
+                 * @param[in] offset     the index of the first sample to write in every channel
+                 * @param[in] numSamples the number of samples per channel to write
+                 */
+                void write(const int_fast32_t *const samples[], uint_fast64_t offset, uint_fast32_t numSamples);
+
+                /**
+                 * Completes the file. If the header declared a different number of samples than were written and the
+                 * stream is seekable, the header is rewritten. Flushes the stream and checks it for errors.
+                 */
+                void finish();
+            };
+        }
+    }
+}
+
+#endif
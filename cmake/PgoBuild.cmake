@@ -0,0 +1,43 @@
+# Builds the library and tools with profile-guided optimization in one go: an instrumented build, the training
+# workload (the pgo-train target), and the optimized rebuild, all in the same build directory.
+#
+# Usage: cmake -D BUILD_DIR=<dir> [-D LTO=ON] [-D GENERATOR=<generator>] -P cmake/PgoBuild.cmake
+# The optimized build is left configured with NAYUKI_PGO=USE, so later builds in that directory keep using the profile.
+
+if(CMAKE_VERSION VERSION_LESS 3.13)
+    message(FATAL_ERROR "PgoBuild.cmake requires CMake 3.13 or later")
+endif()
+if(NOT BUILD_DIR)
+    message(FATAL_ERROR "Usage: cmake -D BUILD_DIR=<dir> [-D LTO=ON] [-D GENERATOR=<generator>] -P PgoBuild.cmake")
+endif()
+if(NOT LTO)
+    set(LTO OFF)
+endif()
+get_filename_component(SOURCE_DIR ${CMAKE_CURRENT_LIST_DIR} DIRECTORY)
+get_filename_component(BUILD_DIR ${BUILD_DIR} ABSOLUTE)
+if(GENERATOR)
+    set(GENERATOR_ARGS -G ${GENERATOR})
+endif()
+
+include(ProcessorCount)
+ProcessorCount(JOBS)
+if(JOBS EQUAL 0)
+    set(JOBS 1)
+endif()
+
+# Runs a command and stops the script if it fails.
+function(run_step description)
+    message(STATUS "PGO: ${description}")
+    execute_process(COMMAND ${ARGN} RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "PGO: ${description} failed")
+    endif()
+endfunction()
+
+run_step("configuring the instrumented build"
+    ${CMAKE_COMMAND} -S ${SOURCE_DIR} -B ${BUILD_DIR} ${GENERATOR_ARGS} -D CMAKE_BUILD_TYPE=Release
+    -D NAYUKI_BUILD_BENCHMARKS=ON -D NAYUKI_ENABLE_LTO=${LTO} -D NAYUKI_PGO=GENERATE)
+run_step("building the instrumented build" ${CMAKE_COMMAND} --build ${BUILD_DIR} --parallel ${JOBS})
+run_step("running the training workload" ${CMAKE_COMMAND} --build ${BUILD_DIR} --target pgo-train)
+run_step("configuring the optimized build" ${CMAKE_COMMAND} -S ${SOURCE_DIR} -B ${BUILD_DIR} -D NAYUKI_PGO=USE)
+run_step("building the optimized build" ${CMAKE_COMMAND} --build ${BUILD_DIR} --parallel ${JOBS})
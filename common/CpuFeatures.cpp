@@ -0,0 +1,127 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "CpuFeatures.h"
+
+#include <cctype>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#define NAYUKI_X86_CPUID
+#endif
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Common {
+            namespace {
+                const char *const LEVEL_NAMES[] = {"scalar", "sse4.1", "avx2", "avx512"};
+
+#ifdef NAYUKI_X86_CPUID
+                /**
+                 * Returns the register state the operating system saves on context switches (XCR0). Must only be
+                 * called if `cpuid` reports OSXSAVE.
+                 */
+                uint64_t readXcr0() {
+                    uint32_t eax, edx;
+                    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+                    return ((uint64_t)edx << 32) | eax;
+                }
+#endif
+            }
+
+            CpuFeatures::CpuFeatures() {
+                sse41 = false;
+                avx2 = false;
+                avx512 = false;
+                bmi2 = false;
+                pclmul = false;
+            }
+
+            const CpuFeatures &CpuFeatures::getDetected() {
+                static const CpuFeatures detected = detect();
+                return detected;
+            }
+
+            CpuFeatures CpuFeatures::detect() {
+                CpuFeatures result;
+#ifdef NAYUKI_X86_CPUID
+                unsigned int eax, ebx, ecx, edx;
+                if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+                    return result;
+                bool ssse3 = (ecx >> 9 & 1) != 0;
+                result.sse41 = ssse3 && (ecx >> 19 & 1) != 0;
+                result.pclmul = (ecx >> 1 & 1) != 0;
+                bool osxsave = (ecx >> 27 & 1) != 0;
+                bool avx = (ecx >> 28 & 1) != 0;
+                uint64_t xcr0 = osxsave ? readXcr0() : 0;
+                bool ymmSaved = (xcr0 & 0x06) == 0x06;  // SSE and AVX state
+                bool zmmSaved = (xcr0 & 0xE6) == 0xE6;  // Additionally opmask, ZMM0-15 upper halves and ZMM16-31
+
+                bool lzcnt = false;
+                if (__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx))
+                    lzcnt = (ecx >> 5 & 1) != 0;
+                if (__get_cpuid_max(0, nullptr) >= 7) {
+                    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+                    result.bmi2 = (ebx >> 3 & 1) != 0 && (ebx >> 8 & 1) != 0 && lzcnt;
+                    result.avx2 = result.sse41 && avx && ymmSaved && (ebx >> 5 & 1) != 0;
+                    bool avx512Subsets = (ebx >> 16 & 1) != 0 && (ebx >> 17 & 1) != 0 &&  // F, DQ
+                                         (ebx >> 30 & 1) != 0 && (ebx >> 31 & 1) != 0;    // BW, VL
+                    result.avx512 = result.avx2 && zmmSaved && avx512Subsets;
+                }
+#endif
+                return result;
+            }
+
+            CpuFeatures::Level CpuFeatures::getHighestLevel() const {
+                if (avx512)
+                    return Level::AVX512;
+                if (avx2)
+                    return Level::AVX2;
+                if (sse41)
+                    return Level::SSE41;
+                return Level::SCALAR;
+            }
+
+            bool CpuFeatures::supports(Level level) const {
+                return level <= getHighestLevel();
+            }
+
+            const char *CpuFeatures::getLevelName(Level level) {
+                return LEVEL_NAMES[(int)level];
+            }
+
+            bool CpuFeatures::parseLevel(const char *name, Level *result) {
+                for (int i = 0; i < 4; i++) {
+                    const char *s = name;
+                    const char *t = LEVEL_NAMES[i];
+                    while (*s != '\0' && std::tolower((unsigned char)*s) == *t) {
+                        s++;
+                        t++;
+                    }
+                    if (*s == '\0' && *t == '\0') {
+                        *result = (Level)i;
+                        return true;
+                    }
+                }
+                return false;
+            }
+        }
+    }
+}
@@ -0,0 +1,139 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_CPUFEATURES_H
+#define NAYUKI_CPUFEATURES_H
+
+#include <cstdint>
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Common {
+            /**
+             * The instruction set extensions of the processor the program runs on, as far as they matter to the
+             * kernels in `Kernels`. Immutable structure; the features of the running processor are detected once
+             * through `cpuid` (see `getDetected()`). On compilers or processors without x86 support, every feature
+             * is reported as missing.
+             */
+            class CpuFeatures final {
+            public:
+                /**
+                 * The vector instruction set levels the kernels are compiled for, in increasing order. Every level
+                 * includes the ones below it.
+                 */
+                enum class Level {
+                    /**
+                     * Portable C++ only.
+                     */
+                    SCALAR = 0,
+
+                    /**
+                     * SSE4.1 (and everything up to SSSE3).
+                     */
+                    SSE41 = 1,
+
+                    /**
+                     * AVX2.
+                     */
+                    AVX2 = 2,
+
+                    /**
+                     * AVX-512 with the F, DQ, BW and VL subsets.
+                     */
+                    AVX512 = 3
+                };
+
+                /**
+                 * Whether SSE4.1 and SSSE3 are available.
+                 */
+                bool sse41;
+
+                /**
+                 * Whether AVX2 is available and the operating system saves the YMM registers.
+                 */
+                bool avx2;
+
+                /**
+                 * Whether AVX-512 F, DQ, BW and VL are available and the operating system saves the ZMM registers.
+                 */
+                bool avx512;
+
+                /**
+                 * Whether BMI1, BMI2 and LZCNT are available.
+                 */
+                bool bmi2;
+
+                /**
+                 * Whether carry-less multiplication (PCLMULQDQ) is available.
+                 */
+                bool pclmul;
+
+                /**
+                 * Returns the features of the processor the program runs on.
+                 * @return the detected features
+                 */
+                static const CpuFeatures &getDetected();
+
+                /**
+                 * Returns the highest level all of whose instructions are available.
+                 * @return the highest supported level
+                 */
+                Level getHighestLevel() const;
+
+                /**
+                 * Returns whether all instructions of the given level are available.
+                 * @param[in] level the level to check
+                 * @return whether the level is supported
+                 */
+                bool supports(Level level) const;
+
+                /**
+                 * Returns the name of the given level, which `parseLevel()` accepts: "scalar", "sse4.1", "avx2" or
+                 * "avx512".
+                 * @param[in] level the level
+                 * @return the name of the level
+                 */
+                static const char *getLevelName(Level level);
+
+                /**
+                 * Parses the name of a level, as returned by `getLevelName()`, ignoring case.
+                 * @param[in]  name   the name to parse (not `null`)
+                 * @param[out] result the parsed level (not `null`)
+                 * @return whether the name is valid
+                 */
+                static bool parseLevel(const char *name, Level *result);
+
+            private:
+                /**
+                 * Constructs a feature set with every feature missing.
+                 */
+                CpuFeatures();
+
+                /**
+                 * Queries the running processor through `cpuid` and `xgetbv`.
+                 * @return the detected features
+                 */
+                static CpuFeatures detect();
+            };
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Common {
+            thread_local FrameArena *FrameArena::current = nullptr;
+
+            FrameArena::Scope::Scope(FrameArena *arena) {
+                previous = current;
+                current = arena;
+            }
+
+            FrameArena::Scope::~Scope() {
+                current = previous;
+            }
+
+            FrameArena::FrameArena(size_t capacity, MemoryAccount *account) {
+                if (account == nullptr)
+                    throw std::invalid_argument("Account cannot be null");
+                this->account = account;
+                allocation = nullptr;
+                base = nullptr;
+                this->capacity = 0;
+                highWater = 0;
+                demand = 0;
+                overflows = 0;
+                reserve(capacity);
+                reset();
+            }
+
+            FrameArena::~FrameArena() {
+                MemoryAccount::deallocate(allocation);
+            }
+
+            void FrameArena::reserve(size_t newCapacity) {
+                newCapacity = (newCapacity + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+                MemoryAccount::deallocate(allocation);
+                allocation = nullptr;
+                allocation = account->allocate<unsigned char>(newCapacity + ALIGNMENT - 1);
+                auto addr = reinterpret_cast<uintptr_t>(allocation);
+                base = allocation + ((ALIGNMENT - addr % ALIGNMENT) % ALIGNMENT);
+                capacity = newCapacity;
+            }
+
+            void *FrameArena::allocate(size_t bytes) {
+                size_t size = HEADER_SIZE + (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+                if (size > capacity - top) {
+                    overflows++;
+                    demand = std::max(demand, top + size);
+                    highWater = std::max(highWater, top + size);
+                    return nullptr;
+                }
+                BlockHeader *header = getHeader(top);
+                header->previousTop = top;
+                header->previousBlock = lastBlock;
+                header->freed = false;
+                lastBlock = top;
+                top += size;
+                highWater = std::max(highWater, top);
+                return base + lastBlock + HEADER_SIZE;
+            }
+
+            bool FrameArena::release(const void *p) {
+                auto *q = static_cast<const unsigned char *>(p);
+                if (q < base || q >= base + capacity)
+                    return false;
+                getHeader((size_t)(q - base) - HEADER_SIZE)->freed = true;
+                while (lastBlock != NONE && getHeader(lastBlock)->freed) {
+                    BlockHeader *header = getHeader(lastBlock);
+                    top = header->previousTop;
+                    lastBlock = header->previousBlock;
+                }
+                return true;
+            }
+
+            void FrameArena::reset() {
+                if (demand > capacity)
+                    reserve(std::max(demand, capacity * 2));
+                top = 0;
+                lastBlock = NONE;
+                demand = 0;
+            }
+
+            size_t FrameArena::getCapacity() const {
+                return capacity;
+            }
+
+            size_t FrameArena::getHighWater() const {
+                return highWater;
+            }
+
+            uint_fast64_t FrameArena::getOverflows() const {
+                return overflows;
+            }
+
+            FrameArena *FrameArena::getCurrent() {
+                return current;
+            }
+
+            FrameArena::BlockHeader *FrameArena::getHeader(size_t offset) {
+                return reinterpret_cast<BlockHeader *>(base + offset);
+            }
+        }
+    }
+}
@@ -0,0 +1,238 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_FRAMEARENA_H
+#define NAYUKI_FRAMEARENA_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "MemoryAccount.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Common {
+            /**
+             * A stack-like bump allocator for scratch memory whose lifetime is one frame. While a `Scope` for an arena
+             * is active, `MemoryAccount::allocateCurrent()`, `MemoryAccount::allocateObject()` and
+             * `MemoryAccount::deallocate()` are served by it, so code written against the accounting allocator uses
+             * the arena without changes.
+             *
+             * Blocks are 64-byte aligned. Freeing the topmost block (and any freed blocks directly below it) returns
+             * the space immediately, so nested temporaries don't accumulate; other freed blocks are reclaimed when the
+             * blocks above them are, or at the latest by `reset()`. A request which doesn't fit is served from the
+             * heap instead, and the next `reset()` grows the arena so that it fits from then on. Thus in steady state
+             * no heap allocations happen at all. Not thread-safe.
+             */
+            class FrameArena final {
+            public:
+                /**
+                 * Makes an arena serve the accounting allocator on the calling thread for the lifetime of this object,
+                 * restoring the previous arena afterwards.
+                 */
+                class Scope final {
+                private:
+                    /**
+                     * The arena which was current before this scope, or `null`.
+                     */
+                    FrameArena *previous;
+
+                public:
+                    /**
+                     * Makes the given arena current on the calling thread.
+                     * @param[in,out] arena the arena to allocate from, or `null` to use the heap
+                     */
+                    explicit Scope(FrameArena *arena);
+
+                    Scope(const Scope &) = delete;
+
+                    Scope &operator=(const Scope &) = delete;
+
+                    /**
+                     * Restores the arena which was current before.
+                     */
+                    ~Scope();
+                };
+
+                /**
+                 * The alignment of every block, and the granularity of block sizes.
+                 */
+                static const size_t ALIGNMENT = 64;
+
+                /**
+                 * Constructs an arena with the given initial capacity, charged to the given account.
+                 * @param[in]     capacity the initial capacity in bytes
+                 * @param[in,out] account  the account to charge the arena's memory to (not `null`)
+                 */
+                FrameArena(size_t capacity, MemoryAccount *account);
+
+                FrameArena(const FrameArena &) = delete;
+
+                FrameArena &operator=(const FrameArena &) = delete;
+
+                /**
+                 * Frees the arena's memory. Blocks still allocated from it become invalid.
+                 */
+                ~FrameArena();
+
+                /**
+                 * Allocates a block of the given size from this arena, or returns `null` if it doesn't fit.
+                 * @param[in] bytes the size of the block
+                 * @return the new block, or `null`
+                 */
+                void *allocate(size_t bytes);
+
+                /**
+                 * Frees the given block if it belongs to this arena.
+                 * @param[in] p the block to free
+                 * @return whether the block belongs to this arena
+                 */
+                bool release(const void *p);
+
+                /**
+                 * Frees all blocks at once, and grows the arena if a request didn't fit since the last reset. To be
+                 * called at every frame boundary, when no block is in use anymore.
+                 */
+                void reset();
+
+                /**
+                 * Returns the current capacity in bytes.
+                 * @return the capacity
+                 */
+                size_t getCapacity() const;
+
+                /**
+                 * Returns the highest number of bytes in use at any time, including requests that didn't fit.
+                 * @return the high-water mark in bytes
+                 */
+                size_t getHighWater() const;
+
+                /**
+                 * Returns the number of requests that didn't fit and were served from the heap.
+                 * @return the number of overflows
+                 */
+                uint_fast64_t getOverflows() const;
+
+                /**
+                 * Returns the arena serving the accounting allocator on the calling thread.
+                 * @return the current arena, or `null`
+                 */
+                static FrameArena *getCurrent();
+
+            private:
+                /**
+                 * Precedes every block, linking it to the block below.
+                 */
+                struct BlockHeader {
+                    /**
+                     * The value of `top` before this block was allocated.
+                     */
+                    size_t previousTop;
+
+                    /**
+                     * The offset of the header of the block below, or `NONE`.
+                     */
+                    size_t previousBlock;
+
+                    /**
+                     * Whether the block was freed while other blocks were above it.
+                     */
+                    bool freed;
+                };
+
+                /**
+                 * The space taken by a block header, rounded up to keep the blocks aligned.
+                 */
+                static const size_t HEADER_SIZE = (sizeof(BlockHeader) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+                /**
+                 * Marks the absence of a block.
+                 */
+                static const size_t NONE = SIZE_MAX;
+
+                /**
+                 * The account the memory is charged to (not `null`).
+                 */
+                MemoryAccount *account;
+
+                /**
+                 * The allocation holding the arena, as returned by the accounting allocator.
+                 */
+                unsigned char *allocation;
+
+                /**
+                 * The start of the arena, `ALIGNMENT`-aligned.
+                 */
+                unsigned char *base;
+
+                /**
+                 * The size of the arena in bytes, a multiple of `ALIGNMENT`.
+                 */
+                size_t capacity;
+
+                /**
+                 * The offset of the first free byte.
+                 */
+                size_t top;
+
+                /**
+                 * The offset of the header of the topmost block, or `NONE` if the arena is empty.
+                 */
+                size_t lastBlock;
+
+                /**
+                 * The highest `top` reached, plus the sizes of the requests that didn't fit at that point.
+                 */
+                size_t highWater;
+
+                /**
+                 * The capacity needed to serve every request since the last reset without overflowing, or 0 if none
+                 * overflowed.
+                 */
+                size_t demand;
+
+                /**
+                 * The number of requests served from the heap.
+                 */
+                uint_fast64_t overflows;
+
+                /**
+                 * The arena serving the accounting allocator on this thread, or `null`.
+                 */
+                static thread_local FrameArena *current;
+
+                /**
+                 * Replaces the arena's memory with a new allocation of the given capacity.
+                 * @param[in] newCapacity the new capacity in bytes
+                 */
+                void reserve(size_t newCapacity);
+
+                /**
+                 * Returns the header of the block at the given offset.
+                 * @param[in] offset the offset of the header
+                 * @return the header
+                 */
+                BlockHeader *getHeader(size_t offset);
+            };
+        }
+    }
+}
+
+#endif
@@ -24,6 +24,7 @@
 #include "FrameInfo.h"
 
 #include <cassert>
+#include <cstddef>
 
 #include "Utilities.h"
 
@@ -82,26 +83,38 @@ namespace Nayuki {
             }
 
             FrameInfo* FrameInfo::readFrame(Decode::FlacLowLevelInput *in) {
+                auto result = new FrameInfo();
+                try {
+                    if (readFrame(in, result))
+                        return result;
+                } catch (...) {
+                    delete result;
+                    throw;
+                }
+                delete result;
+                return nullptr;
+            }
+
+            bool FrameInfo::readFrame(Decode::FlacLowLevelInput *in, FrameInfo *result) {
                 // Preliminaries
                 in->resetCrcs();
-                int_fast16_t temp = in->readByte();
-                if (temp == -1)
-                    return nullptr;
-                auto result = new FrameInfo();
+                size_t available;
+                const uint_fast8_t *bytes = in->peekBytes(4, &available);
+                if (available == 0)
+                    return false;
                 result->frameSize = -1;
 
-                // Read sync bits
-                auto sync = (uint_fast16_t )(temp << 6 | in->readUint(6)); // Uint14
-                if (sync != 0x3FFE)
+                // Check the sync bits before consuming anything, then read the fixed-size part of the header in one go.
+                // A header cut short within these bytes fails in readUint() with the usual end-of-data error.
+                if (available >= 4 && (bytes[0] << 6 | bytes[1] >> 2) != 0x3FFE)  // Uint14
                     throw Decode::DataFormatException("Sync code expected");
-
-                // Read various simple fields
-                if (in->readUint(1) != 0)
+                uint_fast32_t head = in->readUint(32);
+                if (((head >> 17) & 1) != 0)
                     throw Decode::DataFormatException("Reserved bit");
-                uint_fast32_t blockStrategy  = in->readUint(1);
-                uint_fast32_t blockSizeCode  = in->readUint(4);
-                uint_fast32_t sampleRateCode = in->readUint(4);
-                uint_fast32_t chanAsgn       = in->readUint(4);
+                uint_fast32_t blockStrategy  = (head >> 16) & 1;
+                uint_fast32_t blockSizeCode  = (head >> 12) & 0xF;
+                uint_fast32_t sampleRateCode = (head >> 8) & 0xF;
+                uint_fast32_t chanAsgn       = (head >> 4) & 0xF;
                 result->channelAssignment = chanAsgn;
                 if (chanAsgn < 8)
                     result->numChannels = chanAsgn + 1;
@@ -109,8 +122,8 @@ namespace Nayuki {
                     result->numChannels = 2;
                 else
                     throw Decode::DataFormatException("Reserved channel assignment");
-                result->sampleDepth = decodeSampleDepth((uint_fast8_t)in->readUint(3));
-                if (in->readUint(1) != 0)
+                result->sampleDepth = decodeSampleDepth((uint_fast8_t)((head >> 1) & 7));
+                if ((head & 1) != 0)
                     throw Decode::DataFormatException("Reserved bit");
 
                 // Read and check the frame/sample position field
@@ -129,10 +142,18 @@ namespace Nayuki {
                 // Read variable-length data for some fields
                 result->blockSize = decodeBlockSize((uint_fast8_t)blockSizeCode, in);
                 result->sampleRate = decodeSampleRate((uint_fast8_t)sampleRateCode, in);
+                NAYUKI_STAT(
+                    Decode::InputStats *stats = in->getStats();
+                    if (stats != nullptr) {
+                        stats->frameHeaders++;
+                        if (blockSizeCode != 6 && blockSizeCode != 7 && (sampleRateCode < 12 || sampleRateCode > 14))
+                            stats->headerFastPath++;
+                    }
+                );
                 uint_fast8_t computedCrc8 = in->getCrc8();
                 if (in->readUint(8) != computedCrc8)
                     throw Decode::DataFormatException("CRC-8 mismatch");
-                return result;
+                return true;
             }
 
             uint_fast64_t FrameInfo::readUtf8Integer(Decode::FlacLowLevelInput *in) {
@@ -305,7 +326,8 @@ namespace Nayuki {
                 return (uint_fast8_t)result;
             }
 
-            int_fast32_t FrameInfo::searchFirst(std::vector<std::array<int_fast32_t, 2>> table, int_fast32_t key) {
+            int_fast32_t FrameInfo::searchFirst(const std::vector<std::array<int_fast32_t, 2>> &table,
+                                                int_fast32_t key) {
                 for (const auto pair : table) {
                     if (pair[0] == key)
                         return pair[1]; 
@@ -313,8 +335,8 @@ namespace Nayuki {
                 return -1;
             }
 
-            int_fast32_t FrameInfo::searchSecond(std::vector<std::array<int_fast32_t, 2>> table, int_fast32_t key)
-            {
+            int_fast32_t FrameInfo::searchSecond(const std::vector<std::array<int_fast32_t, 2>> &table,
+                                                 int_fast32_t key) {
                 for (const auto pair : table) {
                     if (pair[1] == key)
                         return pair[0];
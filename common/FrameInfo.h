@@ -28,6 +28,8 @@
 #include <cstdint>
 #include <vector>
 
+#include "MemoryAccount.h"
+
 #include "../decode/FlacLowLevelInput.h"
 
 #include "../encode/BitOutputStream.h"
@@ -122,7 +124,8 @@ namespace Nayuki {
                  * @param[in] key   the key to search for
                  * @return the result of the lookup or -1 if nothing was found
                  */
-                static int_fast32_t searchFirst(std::vector<std::array<int_fast32_t, 2>> table, int_fast32_t key);
+                static int_fast32_t searchFirst(const std::vector<std::array<int_fast32_t, 2>> &table,
+                                                int_fast32_t key);
 
                 /**
                  * Does a lookup in one of the code tables and tries to get the value in index 0 for the corresponding
@@ -131,7 +134,8 @@ namespace Nayuki {
                  * @param[in] key   the key to search for
                  * @return the result of the lookup or -1 if nothing was found
                  */
-                static int_fast32_t searchSecond(std::vector<std::array<int_fast32_t, 2>> table, int_fast32_t key);
+                static int_fast32_t searchSecond(const std::vector<std::array<int_fast32_t, 2>> &table,
+                                                 int_fast32_t key);
 
             public:
                 /**
@@ -190,6 +194,25 @@ namespace Nayuki {
                  */
                 FrameInfo();
 
+                /**
+                 * Allocates frame info objects through the accounting allocator, charging the account current on the
+                 * calling thread (see `MemoryAccount::Scope`). This covers the objects returned by the allocating
+                 * `readFrame()` overloads here and in `Decode::FrameDecoder`.
+                 * @param[in] size the size of the object
+                 * @return the memory for the object
+                 */
+                static void *operator new(size_t size) {
+                    return MemoryAccount::allocateObject(size);
+                }
+
+                /**
+                 * Frees an object allocated by `operator new`.
+                 * @param[in] p the object's memory, or `null`
+                 */
+                static void operator delete(void *p) {
+                    MemoryAccount::deallocate(p);
+                }
+
                 /**
                  * Reads the next FLAC frame header from the specified input stream, either returning a new frame info
                  * object or `null`. The stream must be aligned to a byte boundary and start at a sync sequence. If EOF
@@ -205,6 +228,15 @@ namespace Nayuki {
                  */
                 static FrameInfo* readFrame(Decode::FlacLowLevelInput *in);
 
+                /**
+                 * Reads the next FLAC frame header like `readFrame(Decode::FlacLowLevelInput*)`, but stores the parsed
+                 * fields into the given existing object instead of allocating a new one.
+                 * @param[in,out] in     the input stream to read from (not `null`)
+                 * @param[out]    result the frame info object to overwrite (not `null`)
+                 * @return `true` if a frame header was read, or `false` at the end of stream
+                 */
+                static bool readFrame(Decode::FlacLowLevelInput *in, FrameInfo *result);
+
                 /**
                  * Writes the current state of this object as a frame header to the specified output stream, from the
                  * sync field through to the CRC-8 field (inclusive). This does not write the data of subframes, the bit
@@ -0,0 +1,450 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "Kernels.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "MemoryAccount.h"
+#include "Utilities.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Common {
+            namespace {
+                /**
+                 * The number of bits the Rice decoding tables are indexed by. Must be positive.
+                 */
+                const int_fast32_t RICE_TABLE_BITS = 13;
+
+                /**
+                 * The number of Rice codes decoded between two bit buffer refills. Must be positive, and
+                 * `RICE_CHUNK * RICE_TABLE_BITS <= 64`.
+                 */
+                const int_fast32_t RICE_CHUNK = 4;
+
+                /**
+                 * The number of Rice parameters with decoding tables; higher parameters never fit a table entry.
+                 */
+                const int_fast32_t RICE_TABLE_LEN = 31;
+
+                /**
+                 * The lookup tables of the portable kernels, allocated from the shared account on first use.
+                 */
+                class ScalarTables final {
+                public:
+                    /**
+                     * `crc8[k][i]` is the CRC-8 of the byte `i` followed by `k` zero bytes, for slicing by 8 bytes.
+                     */
+                    uint8_t crc8[8][256];
+
+                    /**
+                     * `crc16[k][i]` is the CRC-16 of the byte `i` followed by `k` zero bytes, for slicing by 8 bytes.
+                     */
+                    uint16_t crc16[8][256];
+
+                    /**
+                     * For every Rice parameter and every `RICE_TABLE_BITS`-bit prefix of the input, the number of bits
+                     * of the code starting there, or 0 if the code is longer than the prefix.
+                     */
+                    uint_fast8_t riceConsumed[RICE_TABLE_LEN][1 << RICE_TABLE_BITS];
+
+                    /**
+                     * For every Rice parameter and every prefix with a non-zero `riceConsumed` entry, the signed value
+                     * of the code starting there.
+                     */
+                    int_fast32_t riceValues[RICE_TABLE_LEN][1 << RICE_TABLE_BITS];
+
+                    ScalarTables() {
+                        for (uint_fast32_t i = 0; i < 256; i++) {
+                            uint_fast32_t temp8 = i;
+                            uint_fast32_t temp16 = i << 8;
+                            for (int j = 0; j < 8; j++) {
+                                temp8 = (temp8 << 1) ^ ((temp8 >> 7) * 0x107);
+                                temp16 = (temp16 << 1) ^ ((temp16 >> 15) * 0x18005);
+                            }
+                            crc8[0][i] = (uint8_t)temp8;
+                            crc16[0][i] = (uint16_t)temp16;
+                        }
+                        for (int k = 1; k < 8; k++) {
+                            for (int i = 0; i < 256; i++) {
+                                crc8[k][i] = crc8[0][crc8[k - 1][i]];
+                                crc16[k][i] = (uint16_t)(crc16[0][crc16[k - 1][i] >> 8] ^ (crc16[k - 1][i] << 8));
+                            }
+                        }
+
+                        for (int_fast32_t param = 0; param < RICE_TABLE_LEN; param++) {
+                            for (int_fast32_t i = 0; i < (1 << RICE_TABLE_BITS); i++) {
+                                riceConsumed[param][i] = 0;
+                                riceValues[param][i] = 0;
+                            }
+                            for (uint_fast32_t i = 0;; i++) {
+                                uint_fast32_t numBits = (i >> param) + 1 + param;
+                                if (numBits > (uint_fast32_t)RICE_TABLE_BITS)
+                                    break;
+                                uint_fast32_t bits = ((1 << param) | (i & ((1 << param) - 1)));
+                                uint_fast32_t shift = RICE_TABLE_BITS - numBits;
+                                for (int_fast32_t j = 0; j < (1 << shift); j++) {
+                                    riceConsumed[param][(bits << shift) | j] = (uint_fast8_t)numBits;
+                                    riceValues[param][(bits << shift) | j] =
+                                            (int_fast32_t)((i >> 1) ^ -(int_fast32_t)(i & 1));
+                                }
+                            }
+                        }
+                    }
+
+                    static void *operator new(size_t size) {
+                        return MemoryAccount::getShared().allocate<uint_fast8_t>(size);
+                    }
+
+                    static void operator delete(void *p) {
+                        MemoryAccount::deallocate(p);
+                    }
+                };
+
+                const ScalarTables &getScalarTables() {
+                    static const ScalarTables *tables = new ScalarTables();
+                    return *tables;
+                }
+
+                // Both CRCs process 8 bytes per step with independent table lookups, instead of one long chain of
+                // dependent lookups per byte
+
+                uint_fast8_t crc8Scalar(uint_fast8_t crc, const uint_fast8_t data[], size_t len) {
+                    const ScalarTables &tables = getScalarTables();
+                    for (; len >= 8; data += 8, len -= 8) {
+                        crc = tables.crc8[7][crc ^ data[0]] ^ tables.crc8[6][data[1]] ^ tables.crc8[5][data[2]] ^
+                              tables.crc8[4][data[3]] ^ tables.crc8[3][data[4]] ^ tables.crc8[2][data[5]] ^
+                              tables.crc8[1][data[6]] ^ tables.crc8[0][data[7]];
+                    }
+                    for (size_t i = 0; i < len; i++)
+                        crc = tables.crc8[0][crc ^ (data[i] & 0xFF)];
+                    return crc;
+                }
+
+                uint_fast16_t crc16Scalar(uint_fast16_t crc, const uint_fast8_t data[], size_t len) {
+                    const ScalarTables &tables = getScalarTables();
+                    for (; len >= 8; data += 8, len -= 8) {
+                        crc = tables.crc16[7][(crc >> 8) ^ data[0]] ^ tables.crc16[6][(crc & 0xFF) ^ data[1]] ^
+                              tables.crc16[5][data[2]] ^ tables.crc16[4][data[3]] ^ tables.crc16[3][data[4]] ^
+                              tables.crc16[2][data[5]] ^ tables.crc16[1][data[6]] ^ tables.crc16[0][data[7]];
+                    }
+                    for (size_t i = 0; i < len; i++)
+                        crc = tables.crc16[0][(crc >> 8) ^ (data[i] & 0xFF)] ^ ((crc & 0xFF) << 8);
+                    return crc;
+                }
+
+                // Decodes up to `RICE_CHUNK` codes of at most `RICE_TABLE_BITS` bits each through the tables while
+                // the bit buffer is full enough, and longer codes one at a time by counting the unary prefix
+                int_fast32_t readRiceSignedIntsScalar(Kernels::BitReader &in, int_fast32_t param,
+                                                      int_fast64_t result[], int_fast32_t start, int_fast32_t end) {
+                    const ScalarTables &tables = getScalarTables();
+                    const uint_fast8_t *consumeTable = param < RICE_TABLE_LEN ? tables.riceConsumed[param] : nullptr;
+                    const int_fast32_t *valueTable = param < RICE_TABLE_LEN ? tables.riceValues[param] : nullptr;
+                    uint_fast64_t bitBuffer = in.bitBuffer;
+                    uint_fast8_t bitBufferLen = in.bitBufferLen;
+                    while (start < end) {
+                        if (bitBufferLen < RICE_CHUNK * RICE_TABLE_BITS && in.byteIndex <= in.byteLen - 8) {
+                            for (; bitBufferLen <= 56; bitBufferLen += 8, in.byteIndex++)
+                                bitBuffer = (bitBuffer << 8) | (in.bytes[in.byteIndex] & 0xFF);
+                        }
+                        if (consumeTable != nullptr && start <= end - RICE_CHUNK &&
+                                bitBufferLen >= RICE_CHUNK * RICE_TABLE_BITS) {
+                            int_fast32_t i = 0;
+                            for (; i < RICE_CHUNK; i++, start++) {
+                                int_fast32_t extractedBits =
+                                        (int_fast32_t)(bitBuffer >> (bitBufferLen - RICE_TABLE_BITS)) &
+                                        ((1 << RICE_TABLE_BITS) - 1);
+                                uint_fast8_t consumed = consumeTable[extractedBits];
+                                if (consumed == 0)
+                                    break;
+                                bitBufferLen -= consumed;
+                                result[start] = valueTable[extractedBits];
+                            }
+                            if (i == RICE_CHUNK)
+                                continue;
+                        }
+
+                        if (bitBufferLen == 0)
+                            break;
+                        uint64_t window = (uint64_t)bitBuffer << (64 - bitBufferLen);
+                        if (window == 0)
+                            break;
+                        auto unary = (uint_fast32_t)numberOfLeadingZeros(window);
+                        uint_fast32_t consumed = unary + 1 + param;
+                        if (consumed > bitBufferLen)
+                            break;
+                        bitBufferLen -= consumed;
+                        uint_fast64_t val = ((uint_fast64_t)unary << param) |
+                                            ((bitBuffer >> bitBufferLen) & (((uint_fast64_t)1 << param) - 1));
+                        result[start] = (int_fast64_t)((val >> 1) ^ -(val & 1));
+                        start++;
+                    }
+                    in.bitBuffer = bitBuffer;
+                    in.bitBufferLen = bitBufferLen;
+                    return start;
+                }
+
+                /**
+                 * Restores samples like `restoreLpcScalar()` for a prediction order known at compile time, so that the
+                 * prediction loop is fully unrolled. The products are summed in the type `Acc`, which the caller only
+                 * makes 32 bits wide if no partial sum can overflow it, so the result is the same either way.
+                 * @tparam Acc   the type to accumulate the prediction in, `int32_t` or `int_fast64_t`
+                 * @tparam Order the prediction order, in the range [1, 32]
+                 */
+                template<typename Acc, int_fast32_t Order>
+                bool restoreLpcOrder(int_fast64_t result[], int_fast32_t blockSize, const int_fast32_t coefs[],
+                                     int_fast32_t shift, int_fast32_t sampleDepth) {
+                    Acc c[Order];
+                    for (int_fast32_t j = 0; j < Order; j++)
+                        c[j] = (Acc)coefs[j];
+                    int_fast64_t lowerBound = -((int_fast64_t)1 << (sampleDepth - 1));
+                    int_fast64_t upperBound = -(lowerBound + 1);
+                    for (int_fast32_t i = Order; i < blockSize; i++) {
+                        Acc sum = 0;
+                        for (int_fast32_t j = 0; j < Order; j++)
+                            sum += (Acc)result[i - 1 - j] * c[j];
+                        int_fast64_t val = result[i] + ((int_fast64_t)sum >> shift);
+                        if (val < lowerBound || val > upperBound)
+                            return false;
+                        result[i] = val;
+                    }
+                    return true;
+                }
+
+                /**
+                 * The type of the order-specialized restoration functions.
+                 */
+                using RestoreLpcOrderFunc = bool (*)(int_fast64_t[], int_fast32_t, const int_fast32_t[], int_fast32_t,
+                                                     int_fast32_t);
+
+                /**
+                 * The highest prediction order with a specialized restoration function, which is the highest order
+                 * allowed in the FLAC subset.
+                 */
+                const int_fast32_t RESTORE_LPC_MAX_ORDER = 12;
+
+                /**
+                 * The restoration functions for orders [1, `RESTORE_LPC_MAX_ORDER`], indexed by order - 1, with
+                 * 32-bit accumulators in row 0 and 64-bit accumulators in row 1.
+                 */
+                const RestoreLpcOrderFunc RESTORE_LPC_ORDERS[2][RESTORE_LPC_MAX_ORDER] = {
+                    {
+                        restoreLpcOrder<int32_t, 1>, restoreLpcOrder<int32_t, 2>, restoreLpcOrder<int32_t, 3>,
+                        restoreLpcOrder<int32_t, 4>, restoreLpcOrder<int32_t, 5>, restoreLpcOrder<int32_t, 6>,
+                        restoreLpcOrder<int32_t, 7>, restoreLpcOrder<int32_t, 8>, restoreLpcOrder<int32_t, 9>,
+                        restoreLpcOrder<int32_t, 10>, restoreLpcOrder<int32_t, 11>, restoreLpcOrder<int32_t, 12>
+                    }, {
+                        restoreLpcOrder<int_fast64_t, 1>, restoreLpcOrder<int_fast64_t, 2>,
+                        restoreLpcOrder<int_fast64_t, 3>, restoreLpcOrder<int_fast64_t, 4>,
+                        restoreLpcOrder<int_fast64_t, 5>, restoreLpcOrder<int_fast64_t, 6>,
+                        restoreLpcOrder<int_fast64_t, 7>, restoreLpcOrder<int_fast64_t, 8>,
+                        restoreLpcOrder<int_fast64_t, 9>, restoreLpcOrder<int_fast64_t, 10>,
+                        restoreLpcOrder<int_fast64_t, 11>, restoreLpcOrder<int_fast64_t, 12>
+                    }
+                };
+
+                bool restoreLpcScalar(int_fast64_t result[], int_fast32_t blockSize, const int_fast32_t coefs[],
+                                      int_fast32_t order, int_fast32_t shift, int_fast32_t sampleDepth) {
+                    if (1 <= order && order <= RESTORE_LPC_MAX_ORDER) {
+                        // Every partial sum is bounded by the sum of the coefficient magnitudes times the largest
+                        // sample magnitude, because all the samples being predicted from fit the bit depth
+                        uint_fast64_t coefSum = 0;
+                        for (int_fast32_t j = 0; j < order; j++)
+                            coefSum += (uint_fast64_t)std::abs((int_fast64_t)coefs[j]);
+                        bool narrow = sampleDepth <= 32 && (coefSum << (sampleDepth - 1)) <= INT32_MAX;
+                        return RESTORE_LPC_ORDERS[narrow ? 0 : 1][order - 1](result, blockSize, coefs, shift,
+                                                                             sampleDepth);
+                    }
+                    int_fast64_t lowerBound = -((int_fast64_t)1 << (sampleDepth - 1));
+                    int_fast64_t upperBound = -(lowerBound + 1);
+                    for (int_fast32_t i = order; i < blockSize; i++) {
+                        int_fast64_t sum = 0;
+                        for (int_fast32_t j = 0; j < order; j++)
+                            sum += result[i - 1 - j] * coefs[j];
+                        assert((sum >> 53) == 0 || (sum >> 53) == -1);  // Fits in signed int54
+                        sum = result[i] + (sum >> shift);
+                        // Check that sum fits in a sampleDepth-bit signed integer,
+                        // i.e. -(2^(sampleDepth-1)) <= sum < 2^(sampleDepth-1)
+                        if (sum < lowerBound || sum > upperBound)
+                            return false;
+                        result[i] = sum;
+                    }
+                    return true;
+                }
+
+                void computeLpcResidualScalar(int_fast64_t data[], uint_fast32_t numSamples,
+                                              const int_fast32_t coefs[], int_fast32_t order, int_fast32_t shift,
+                                              int_fast32_t) {
+                    // Two samples per pass share the coefficient loads; both sums are formed before either sample is
+                    // overwritten
+                    uint_fast32_t i = numSamples;
+                    for (; i >= (uint_fast32_t)order + 2; i -= 2) {
+                        int_fast64_t sum0 = 0;
+                        int_fast64_t sum1 = 0;
+                        for (int_fast32_t j = 0; j < order; j++) {
+                            int_fast64_t coef = coefs[j];
+                            sum0 += data[i - 2 - j] * coef;
+                            sum1 += data[i - 3 - j] * coef;
+                        }
+                        data[i - 1] -= sum0 >> shift;
+                        data[i - 2] -= sum1 >> shift;
+                    }
+                    for (; i-- > (uint_fast32_t)order; ) {
+                        int_fast64_t sum = 0;
+                        for (int_fast32_t j = 0; j < order; j++)
+                            sum += data[i - 1 - j] * coefs[j];
+                        data[i] -= sum >> shift;
+                    }
+                }
+
+                void autocorrelateScalar(const int_fast64_t data[], uint_fast32_t length, int_fast32_t maxLag,
+                                         double result[]) {
+                    for (int_fast32_t i = 0; i <= maxLag; i++) {
+                        double sum = 0;
+                        for (uint_fast32_t j = 0; j + i < length; j++)
+                            sum += (double)data[j] * data[j + i];
+                        result[i] = sum;
+                    }
+                }
+
+                void packPcmScalar(const int_fast32_t *const samples[], uint_fast8_t numChannels,
+                                   uint_fast64_t offset, uint_fast32_t numSamples, uint_fast8_t bytesPerSample,
+                                   uint_fast8_t out[]) {
+                    for (uint_fast32_t i = 0; i < numSamples; i++) {
+                        for (uint_fast8_t ch = 0; ch < numChannels; ch++) {
+                            auto val = (uint_fast32_t)samples[ch][offset + i];
+                            for (uint_fast8_t k = 0; k < bytesPerSample; k++, out++)
+                                *out = (uint_fast8_t)(val >> (k << 3));
+                        }
+                    }
+                }
+
+                void unpackPcmScalar(const uint_fast8_t in[], uint_fast8_t numChannels, uint_fast64_t offset,
+                                     uint_fast32_t numSamples, uint_fast8_t bytesPerSample,
+                                     int_fast32_t *const samples[]) {
+                    // Place the bytes at the top of a 32-bit word, so that shifting right sign-extends them
+                    int_fast32_t topShift = 32 - bytesPerSample * 8;
+                    for (uint_fast32_t i = 0; i < numSamples; i++) {
+                        for (uint_fast8_t ch = 0; ch < numChannels; ch++) {
+                            uint32_t word = 0;
+                            for (uint_fast8_t k = 0; k < bytesPerSample; k++, in++)
+                                word |= (uint32_t)*in << (k << 3);
+                            samples[ch][offset + i] = (int32_t)(word << topShift) >> topShift;
+                        }
+                    }
+                }
+
+                void interleaveIntScalar(const int_fast32_t *const samples[], uint_fast8_t numChannels,
+                                         uint_fast64_t offset, uint_fast32_t numSamples, int_fast32_t shift,
+                                         uint_fast8_t bytesPerSample, uint_fast8_t out[]) {
+                    for (uint_fast32_t i = 0; i < numSamples; i++) {
+                        for (uint_fast8_t ch = 0; ch < numChannels; ch++) {
+                            int_fast32_t val = samples[ch][offset + i];
+                            auto word = (uint_fast32_t)(shift >= 0 ? (int_fast32_t)((uint_fast32_t)val << shift)
+                                                                   : val >> -shift);
+                            for (uint_fast8_t k = 0; k < bytesPerSample; k++, out++)
+                                *out = (uint_fast8_t)(word >> (k << 3));
+                        }
+                    }
+                }
+
+                void interleaveFloatScalar(const int_fast32_t *const samples[], uint_fast8_t numChannels,
+                                           uint_fast64_t offset, uint_fast32_t numSamples, float scale, float out[]) {
+                    for (uint_fast32_t i = 0; i < numSamples; i++) {
+                        for (uint_fast8_t ch = 0; ch < numChannels; ch++, out++)
+                            *out = (float)(int32_t)samples[ch][offset + i] * scale;
+                    }
+                }
+
+                /**
+                 * Returns the level the active table starts with: the highest supported one, lowered by the
+                 * environment variable `NAYUKI_CPU_LEVEL` if it names a valid level.
+                 */
+                CpuFeatures::Level getInitialLevel() {
+                    CpuFeatures::Level highest = CpuFeatures::getDetected().getHighestLevel();
+                    const char *name = std::getenv("NAYUKI_CPU_LEVEL");
+                    CpuFeatures::Level requested;
+                    if (name != nullptr && CpuFeatures::parseLevel(name, &requested) && requested < highest)
+                        return requested;
+                    return highest;
+                }
+            }
+
+            void Kernels::bindScalar(Kernels &kernels) {
+                kernels.level = CpuFeatures::Level::SCALAR;
+                kernels.crc8 = crc8Scalar;
+                kernels.crc16 = crc16Scalar;
+                kernels.readRiceSignedInts = readRiceSignedIntsScalar;
+                kernels.restoreLpc = restoreLpcScalar;
+                kernels.computeLpcResidual = computeLpcResidualScalar;
+                kernels.autocorrelate = autocorrelateScalar;
+                kernels.packPcm = packPcmScalar;
+                kernels.unpackPcm = unpackPcmScalar;
+                kernels.interleaveInt = interleaveIntScalar;
+                kernels.interleaveFloat = interleaveFloatScalar;
+            }
+
+            const Kernels *Kernels::getTables() {
+                static const Kernels *tables = [] {
+                    static Kernels result[4];
+                    const CpuFeatures &features = CpuFeatures::getDetected();
+                    for (int i = 0; i < 4; i++) {
+                        auto level = (CpuFeatures::Level)i;
+                        bindScalar(result[i]);
+                        result[i].level = level;
+                        if (features.supports(level))
+                            bindX86(result[i], level, features);
+                    }
+                    return result;
+                }();
+                return tables;
+            }
+
+            namespace {
+                std::atomic<const Kernels *> &getActive() {
+                    static std::atomic<const Kernels *> active(&Kernels::get(getInitialLevel()));
+                    return active;
+                }
+            }
+
+            const Kernels &Kernels::get() {
+                return *getActive().load(std::memory_order_relaxed);
+            }
+
+            const Kernels &Kernels::get(CpuFeatures::Level level) {
+                if (!CpuFeatures::getDetected().supports(level))
+                    throw std::invalid_argument("CPU level not supported by this processor");
+                return getTables()[(int)level];
+            }
+
+            void Kernels::setLevel(CpuFeatures::Level level) {
+                getActive().store(&get(level), std::memory_order_relaxed);
+            }
+
+            CpuFeatures::Level Kernels::getLevel() {
+                return get().level;
+            }
+        }
+    }
+}
@@ -0,0 +1,265 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_KERNELS_H
+#define NAYUKI_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "CpuFeatures.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Common {
+            /**
+             * A table of the hot inner loops of the decoder and encoder, bound to the best implementation for a given
+             * instruction set level. All implementations of a kernel compute bit-identical results, so the level only
+             * affects speed, never the decoded samples or the encoded stream.
+             *
+             * The active table is chosen once, on first use: the highest level the processor supports, unless the
+             * environment variable `NAYUKI_CPU_LEVEL` names a lower one (see `CpuFeatures::parseLevel()`; unknown
+             * names are ignored, higher levels are clamped). `setLevel()` switches the table at run time, e.g. to
+             * benchmark every variant on the same machine; it must not be called while other threads decode or
+             * encode. Kernels which need BMI2 or PCLMULQDQ are only bound when the processor has them and the level
+             * is at least `AVX2` respectively `SSE41`.
+             */
+            class Kernels final {
+            public:
+                /**
+                 * The bit reader state of an input, handed to `readRiceSignedInts` and updated by it.
+                 */
+                class BitReader final {
+                public:
+                    /**
+                     * The buffered bits, of which only the bottom `bitBufferLen` ones are valid.
+                     */
+                    uint_fast64_t bitBuffer;
+
+                    /**
+                     * The number of valid bits in `bitBuffer`, in the range [0, 64].
+                     */
+                    uint_fast8_t bitBufferLen;
+
+                    /**
+                     * The bytes which may be moved into `bitBuffer` (not `null`).
+                     */
+                    const uint_fast8_t *bytes;
+
+                    /**
+                     * The index of the next byte to move into `bitBuffer`.
+                     */
+                    int_fast32_t byteIndex;
+
+                    /**
+                     * The number of valid bytes in `bytes`.
+                     */
+                    int_fast32_t byteLen;
+                };
+
+                /**
+                 * The level this table was bound for.
+                 */
+                CpuFeatures::Level level;
+
+                /**
+                 * Updates a FLAC frame header CRC-8 (polynomial 0x107) with the given bytes.
+                 * @param[in] crc  the current CRC, in the range [0, 255]
+                 * @param[in] data the bytes to add (not `null` unless `len` is 0)
+                 * @param[in] len  the number of bytes
+                 * @return the updated CRC
+                 */
+                uint_fast8_t (*crc8)(uint_fast8_t crc, const uint_fast8_t data[], size_t len);
+
+                /**
+                 * Updates a FLAC frame footer CRC-16 (polynomial 0x18005) with the given bytes.
+                 * @param[in] crc  the current CRC, in the range [0, 65535]
+                 * @param[in] data the bytes to add (not `null` unless `len` is 0)
+                 * @param[in] len  the number of bytes
+                 * @return the updated CRC
+                 */
+                uint_fast16_t (*crc16)(uint_fast16_t crc, const uint_fast8_t data[], size_t len);
+
+                /**
+                 * Decodes signed Rice codes with the given parameter into `result[start, end)` for as long as every
+                 * code is completely available in the reader's bit buffer and byte buffer, stopping early at the
+                 * first code which is not (e.g. at the end of the byte buffer or for a very long unary prefix). Never
+                 * reads beyond `bytes[byteLen]`.
+                 * @param[in,out] in     the bit reader state to decode from and update
+                 * @param[in]     param  the Rice parameter, in the range [0, 31]
+                 * @param[out]    result the array to decode into (not `null`)
+                 * @param[in]     start  the index of the first value to decode
+                 * @param[in]     end    the index after the last value to decode
+                 * @return the index after the last value decoded, in the range [`start`, `end`]
+                 */
+                int_fast32_t (*readRiceSignedInts)(BitReader &in, int_fast32_t param, int_fast64_t result[],
+                                                   int_fast32_t start, int_fast32_t end);
+
+                /**
+                 * Restores samples from their linear prediction residuals in place, i.e. adds to every sample from
+                 * index `order` onwards the prediction computed from the restored samples before it, checking that
+                 * each restored sample fits the bit depth.
+                 * @param[in,out] result      the warm-up samples (which must fit the bit depth) followed by the
+                 *                            residuals (not `null`)
+                 * @param[in]     blockSize   the number of samples
+                 * @param[in]     coefs       the prediction coefficients, each fitting a signed 16-bit integer
+                 * @param[in]     order       the number of coefficients, in the range [0, 32]
+                 * @param[in]     shift       the right shift of the prediction, in the range [0, 63]
+                 * @param[in]     sampleDepth the bit depth of the samples, in the range [1, 33]
+                 * @return `false` if a restored sample does not fit the bit depth, in which case `result` holds
+                 * unspecified values; `true` otherwise
+                 */
+                bool (*restoreLpc)(int_fast64_t result[], int_fast32_t blockSize, const int_fast32_t coefs[],
+                                   int_fast32_t order, int_fast32_t shift, int_fast32_t sampleDepth);
+
+                /**
+                 * Replaces samples from index `order` onwards with their linear prediction residuals in place, i.e.
+                 * subtracts from every sample the prediction computed from the original samples before it.
+                 * @param[in,out] data        the samples (not `null`)
+                 * @param[in]     numSamples  the number of samples
+                 * @param[in]     coefs       the prediction coefficients, each fitting a signed 16-bit integer
+                 * @param[in]     order       the number of coefficients, in the range [0, 32]
+                 * @param[in]     shift       the right shift of the prediction, in the range [0, 63]
+                 * @param[in]     sampleDepth the bit depth of the samples, in the range [1, 33]
+                 */
+                void (*computeLpcResidual)(int_fast64_t data[], uint_fast32_t numSamples, const int_fast32_t coefs[],
+                                           int_fast32_t order, int_fast32_t shift, int_fast32_t sampleDepth);
+
+                /**
+                 * Computes the autocorrelation `result[i] = sum(data[j] * data[j + i])` for every lag `i` in
+                 * [0, `maxLag`], summing in double precision in increasing order of `j`.
+                 * @param[in]  data   the samples (not `null`), each of magnitude less than 2^51
+                 * @param[in]  length the number of samples
+                 * @param[in]  maxLag the highest lag, in the range [0, 32]
+                 * @param[out] result the array of `maxLag + 1` sums to write (not `null`)
+                 */
+                void (*autocorrelate)(const int_fast64_t data[], uint_fast32_t length, int_fast32_t maxLag,
+                                      double result[]);
+
+                /**
+                 * Converts planar samples to interleaved little-endian PCM bytes, the layout the FLAC MD5 hash is
+                 * computed over.
+                 * @param[in]  samples        the channels (not `null`)
+                 * @param[in]  numChannels    the number of channels, in the range [1, 8]
+                 * @param[in]  offset         the index of the first sample to convert in every channel
+                 * @param[in]  numSamples     the number of samples per channel to convert
+                 * @param[in]  bytesPerSample the number of bytes per sample, in the range [1, 4]
+                 * @param[out] out            the `numChannels * numSamples * bytesPerSample` bytes to write
+                 */
+                void (*packPcm)(const int_fast32_t *const samples[], uint_fast8_t numChannels, uint_fast64_t offset,
+                                uint_fast32_t numSamples, uint_fast8_t bytesPerSample, uint_fast8_t out[]);
+
+                /**
+                 * Converts interleaved little-endian PCM bytes to planar samples, sign-extending every sample from
+                 * its `8 * bytesPerSample` bits; the inverse of `packPcm`.
+                 * @param[in]  in             the `numChannels * numSamples * bytesPerSample` bytes to read
+                 * @param[in]  numChannels    the number of channels, in the range [1, 8]
+                 * @param[in]  offset         the index of the first sample to write in every channel
+                 * @param[in]  numSamples     the number of samples per channel to convert
+                 * @param[in]  bytesPerSample the number of bytes per sample, in the range [1, 4]
+                 * @param[out] samples        the channels to write (not `null`)
+                 */
+                void (*unpackPcm)(const uint_fast8_t in[], uint_fast8_t numChannels, uint_fast64_t offset,
+                                  uint_fast32_t numSamples, uint_fast8_t bytesPerSample, int_fast32_t *const samples[]);
+
+                /**
+                 * Converts planar samples to interleaved little-endian integers of another width: every sample is
+                 * shifted left by `shift` bits, or arithmetically right by `-shift` bits if negative, and stored in
+                 * `bytesPerSample` bytes.
+                 * @param[in]  samples        the channels (not `null`), with samples which fit 32 bits
+                 * @param[in]  numChannels    the number of channels, in the range [1, 8]
+                 * @param[in]  offset         the index of the first sample to convert in every channel
+                 * @param[in]  numSamples     the number of samples per channel to convert
+                 * @param[in]  shift          the left shift, in the range [-31, 31], after which every sample must
+                 *                            fit `8 * bytesPerSample` bits
+                 * @param[in]  bytesPerSample the number of bytes per sample, in the range [2, 4]
+                 * @param[out] out            the `numChannels * numSamples * bytesPerSample` bytes to write
+                 */
+                void (*interleaveInt)(const int_fast32_t *const samples[], uint_fast8_t numChannels,
+                                      uint_fast64_t offset, uint_fast32_t numSamples, int_fast32_t shift,
+                                      uint_fast8_t bytesPerSample, uint_fast8_t out[]);
+
+                /**
+                 * Converts planar samples to interleaved floats, multiplying every sample by the given scale after
+                 * converting it to single precision.
+                 * @param[in]  samples     the channels (not `null`), with samples which fit 32 bits
+                 * @param[in]  numChannels the number of channels, in the range [1, 8]
+                 * @param[in]  offset      the index of the first sample to convert in every channel
+                 * @param[in]  numSamples  the number of samples per channel to convert
+                 * @param[in]  scale       the factor to multiply by
+                 * @param[out] out         the `numChannels * numSamples` floats to write
+                 */
+                void (*interleaveFloat)(const int_fast32_t *const samples[], uint_fast8_t numChannels,
+                                        uint_fast64_t offset, uint_fast32_t numSamples, float scale, float out[]);
+
+                /**
+                 * Returns the active kernel table.
+                 * @return the active table
+                 */
+                static const Kernels &get();
+
+                /**
+                 * Returns the kernel table for the given level.
+                 * @param[in] level the level, which the processor must support
+                 * @return the table for the level
+                 * @throws std::invalid_argument if the processor does not support the level
+                 */
+                static const Kernels &get(CpuFeatures::Level level);
+
+                /**
+                 * Makes the table for the given level the active one.
+                 * @param[in] level the level, which the processor must support
+                 * @throws std::invalid_argument if the processor does not support the level
+                 */
+                static void setLevel(CpuFeatures::Level level);
+
+                /**
+                 * Returns the level of the active kernel table.
+                 * @return the active level
+                 */
+                static CpuFeatures::Level getLevel();
+
+            private:
+                /**
+                 * Binds every kernel of the given table to its portable implementation.
+                 * @param[out] kernels the table to fill
+                 */
+                static void bindScalar(Kernels &kernels);
+
+                /**
+                 * Rebinds the kernels of the given table which have a faster implementation at the given level and
+                 * with the given features. Does nothing on compilers without x86 intrinsics.
+                 * @param[in,out] kernels  the table to update
+                 * @param[in]     level    the level to bind for
+                 * @param[in]     features the features of the processor
+                 */
+                static void bindX86(Kernels &kernels, CpuFeatures::Level level, const CpuFeatures &features);
+
+                /**
+                 * Returns the tables for every level the processor supports, indexed by level.
+                 * @return the array of tables
+                 */
+                static const Kernels *getTables();
+            };
+        }
+    }
+}
+
+#endif
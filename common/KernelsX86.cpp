@@ -0,0 +1,819 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "Kernels.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define NAYUKI_X86_KERNELS
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstring>
+#endif
+
+// The vector kernels must round exactly like the portable ones, so this file is compiled without floating-point
+// contraction (see CMakeLists.txt); a fused multiply-add would change the autocorrelation sums.
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Common {
+#ifdef NAYUKI_X86_KERNELS
+            namespace {
+                /**
+                 * Returns the low 64 bits of the quotient `x^(64 + degree) / poly` over GF(2), the constant for a
+                 * Barrett reduction of 64-bit blocks modulo the given CRC polynomial.
+                 * @param[in] poly   the polynomial including its leading term
+                 * @param[in] degree the degree of the polynomial
+                 */
+                uint64_t computeBarrettConstant(uint64_t poly, int degree) {
+                    // Long division of the 65 + degree bit dividend, of which the quotient keeps the low 64 bits
+                    uint64_t remainder = 0;
+                    uint64_t quotient = 0;
+                    for (int bit = 64 + degree; bit >= 0; bit--) {
+                        remainder = (remainder << 1) | (bit == 64 + degree ? 1 : 0);
+                        quotient <<= 1;
+                        if ((remainder >> degree) & 1) {
+                            remainder ^= poly;
+                            quotient |= 1;
+                        }
+                    }
+                    return quotient;
+                }
+
+                /**
+                 * Returns `x^power mod poly` over GF(2), a folding constant for the given CRC polynomial.
+                 * @param[in] power  the exponent
+                 * @param[in] poly   the polynomial including its leading term
+                 * @param[in] degree the degree of the polynomial
+                 */
+                uint64_t computePowerMod(int power, uint64_t poly, int degree) {
+                    uint64_t result = 1;
+                    for (int i = 0; i < power; i++) {
+                        result <<= 1;
+                        if ((result >> degree) & 1)
+                            result ^= poly;
+                    }
+                    return result;
+                }
+
+                /**
+                 * The constants for computing one CRC with carry-less multiplication.
+                 */
+                struct ClmulCrc {
+                    int degree;
+                    uint64_t low;      // The polynomial without its leading term
+                    uint64_t barrett;  // See computeBarrettConstant()
+                    __m128i fold128;   // x^192 mod P in the high lane and x^128 mod P in the low lane
+                    __m128i fold256;   // x^320 mod P in the high lane and x^256 mod P in the low lane
+
+                    ClmulCrc(uint64_t poly, int deg) :
+                            degree(deg),
+                            low(poly ^ ((uint64_t)1 << deg)),
+                            barrett(computeBarrettConstant(poly, deg)),
+                            fold128(_mm_set_epi64x((long long)computePowerMod(192, poly, deg),
+                                                   (long long)computePowerMod(128, poly, deg))),
+                            fold256(_mm_set_epi64x((long long)computePowerMod(320, poly, deg),
+                                                   (long long)computePowerMod(256, poly, deg))) {}
+                };
+
+                // Built on first use, so that the kernels also work during static initialization
+                const ClmulCrc &getCrc8Clmul() {
+                    static const ClmulCrc result(0x107, 8);
+                    return result;
+                }
+
+                const ClmulCrc &getCrc16Clmul() {
+                    static const ClmulCrc result(0x18005, 16);
+                    return result;
+                }
+
+                /**
+                 * Returns `(d * x^degree) mod poly` for the polynomial `x^degree + low`, where `barrett` is the
+                 * matching constant from `computeBarrettConstant()`. Only the low `degree` bits of the result are
+                 * meaningful.
+                 */
+                __attribute__((target("sse4.1,pclmul")))
+                inline uint64_t reduceClmul(uint64_t d, uint64_t barrett, uint64_t low) {
+                    __m128i q = _mm_clmulepi64_si128(_mm_cvtsi64_si128((long long)d),
+                                                     _mm_cvtsi64_si128((long long)barrett), 0x00);
+                    uint64_t quotient = d ^ (uint64_t)_mm_extract_epi64(q, 1);
+                    __m128i r = _mm_clmulepi64_si128(_mm_cvtsi64_si128((long long)quotient),
+                                                     _mm_cvtsi64_si128((long long)low), 0x00);
+                    return (uint64_t)_mm_cvtsi128_si64(r);
+                }
+
+                /**
+                 * Reads `n` bytes, in the range [1, 8], as a big-endian number.
+                 */
+                inline uint64_t loadBigEndian(const uint_fast8_t data[], size_t n) {
+                    uint64_t result = 0;
+                    if (n == 8) {
+                        std::memcpy(&result, data, 8);
+                        return __builtin_bswap64(result);
+                    }
+                    for (size_t i = 0; i < n; i++)
+                        result = (result << 8) | data[i];
+                    return result;
+                }
+
+                /**
+                 * Reads 16 bytes as one big-endian 128-bit polynomial.
+                 */
+                __attribute__((target("sse4.1,pclmul")))
+                inline __m128i loadBigEndian128(const uint_fast8_t data[]) {
+                    const __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+                    return _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data)), reverse);
+                }
+
+                /**
+                 * Returns a 128-bit polynomial congruent to `x * x^distance` modulo the CRC polynomial, where the
+                 * constants hold `x^(distance + 64) mod P` in the high lane and `x^distance mod P` in the low lane.
+                 */
+                __attribute__((target("sse4.1,pclmul")))
+                inline __m128i fold(__m128i x, __m128i constants) {
+                    return _mm_xor_si128(_mm_clmulepi64_si128(x, constants, 0x11),
+                                         _mm_clmulepi64_si128(x, constants, 0x00));
+                }
+
+                // The message bits are multiplied by x^degree and the old CRC by x^(8 * len). Long inputs are folded
+                // 16 bytes at a time into two independent 128-bit accumulators, each product of a 64-bit half with a
+                // constant below x^16 fitting back into 128 bits; the final accumulator and any tail are then reduced
+                // in blocks of n bytes as `((crc << (8 * n - degree)) ^ bytes) * x^degree mod P`.
+                __attribute__((target("sse4.1,pclmul")))
+                uint64_t crcClmul(uint64_t crc, const uint_fast8_t data[], size_t len, const ClmulCrc &c) {
+                    const uint64_t mask = ((uint64_t)1 << c.degree) - 1;
+                    if (len >= 32) {
+                        __m128i x0 = _mm_xor_si128(loadBigEndian128(data),
+                                                   _mm_set_epi64x((long long)(crc << (64 - c.degree)), 0));
+                        __m128i x1 = loadBigEndian128(data + 16);
+                        data += 32;
+                        len -= 32;
+                        for (; len >= 32; data += 32, len -= 32) {
+                            x0 = _mm_xor_si128(fold(x0, c.fold256), loadBigEndian128(data));
+                            x1 = _mm_xor_si128(fold(x1, c.fold256), loadBigEndian128(data + 16));
+                        }
+                        x0 = _mm_xor_si128(fold(x0, c.fold128), x1);
+                        if (len >= 16) {
+                            x0 = _mm_xor_si128(fold(x0, c.fold128), loadBigEndian128(data));
+                            data += 16;
+                            len -= 16;
+                        }
+                        crc = reduceClmul((uint64_t)_mm_extract_epi64(x0, 1), c.barrett, c.low) & mask;
+                        crc = reduceClmul((crc << (64 - c.degree)) ^ (uint64_t)_mm_cvtsi128_si64(x0), c.barrett,
+                                          c.low) & mask;
+                    }
+                    while (len > 0) {
+                        size_t n = std::min(len, (size_t)8);
+                        if ((int)(8 * n) >= c.degree)
+                            crc = reduceClmul((crc << (8 * n - c.degree)) ^ loadBigEndian(data, n), c.barrett,
+                                              c.low) & mask;
+                        else {
+                            // A lone byte of a CRC-16 has fewer bits than the CRC, so the low CRC byte is added after
+                            // reducing
+                            uint64_t r = reduceClmul((crc >> 8) ^ data[0], c.barrett, c.low);
+                            crc = (r ^ ((crc & 0xFF) << 8)) & mask;
+                        }
+                        data += n;
+                        len -= n;
+                    }
+                    return crc;
+                }
+
+                uint_fast8_t crc8Clmul(uint_fast8_t crc, const uint_fast8_t data[], size_t len) {
+                    return (uint_fast8_t)crcClmul(crc, data, len, getCrc8Clmul());
+                }
+
+                uint_fast16_t crc16Clmul(uint_fast16_t crc, const uint_fast8_t data[], size_t len) {
+                    return (uint_fast16_t)crcClmul(crc, data, len, getCrc16Clmul());
+                }
+
+                // Decodes one code per iteration without tables: LZCNT finds the unary prefix and BZHI extracts the
+                // binary suffix, so every parameter takes the fast path, not just codes of up to 13 bits.
+                __attribute__((target("bmi,bmi2,lzcnt")))
+                int_fast32_t readRiceSignedIntsBmi2(Kernels::BitReader &in, int_fast32_t param, int_fast64_t result[],
+                                                   int_fast32_t start, int_fast32_t end) {
+                    uint64_t bitBuffer = in.bitBuffer;
+                    uint32_t bitBufferLen = in.bitBufferLen;
+                    const uint_fast8_t *bytes = in.bytes;
+                    int_fast32_t byteIndex = in.byteIndex;
+                    int_fast32_t refillLimit = in.byteLen - 8;
+                    while (start < end) {
+                        if (bitBufferLen <= 56 && byteIndex <= refillLimit) {
+                            uint32_t n = (64 - bitBufferLen) >> 3;
+                            uint64_t word = loadBigEndian(bytes + byteIndex, 8);
+                            bitBuffer = n == 8 ? word : (bitBuffer << (n * 8)) | (word >> (64 - n * 8));
+                            bitBufferLen += n * 8;
+                            byteIndex += n;
+                        }
+                        if (bitBufferLen == 0)
+                            break;
+                        uint64_t window = bitBuffer << (64 - bitBufferLen);
+                        if (window == 0)
+                            break;
+                        auto unary = (uint32_t)_lzcnt_u64(window);
+                        uint32_t consumed = unary + 1 + (uint32_t)param;
+                        if (consumed > bitBufferLen)
+                            break;
+                        bitBufferLen -= consumed;
+                        uint64_t val = ((uint64_t)unary << param) |
+                                       _bzhi_u64(bitBuffer >> bitBufferLen, (uint32_t)param);
+                        result[start] = (int_fast64_t)((val >> 1) ^ -(val & 1));
+                        start++;
+                    }
+                    in.bitBuffer = bitBuffer;
+                    in.bitBufferLen = (uint_fast8_t)bitBufferLen;
+                    in.byteIndex = byteIndex;
+                    return start;
+                }
+
+                /**
+                 * Arithmetic right shift of 64-bit lanes, which SSE and AVX2 lack: a logical shift followed by sign
+                 * extension from the shifted-down sign bit.
+                 */
+                __attribute__((target("sse4.1")))
+                inline __m128i shiftRightArithmetic(__m128i x, __m128i count, __m128i signBit) {
+                    __m128i t = _mm_srl_epi64(x, count);
+                    return _mm_sub_epi64(_mm_xor_si128(t, signBit), signBit);
+                }
+
+                __attribute__((target("avx2")))
+                inline __m256i shiftRightArithmetic(__m256i x, __m128i count, __m256i signBit) {
+                    __m256i t = _mm256_srl_epi64(x, count);
+                    return _mm256_sub_epi64(_mm256_xor_si256(t, signBit), signBit);
+                }
+
+                // The residual of every sample only depends on the original samples before it, so several samples
+                // are predicted at once, walking backwards so that the samples still needed are not yet overwritten.
+                // PMULDQ only multiplies the low 32 bits of each lane, which suffices for depths up to 32.
+                __attribute__((target("sse4.1")))
+                void computeLpcResidualSse41(int_fast64_t data[], uint_fast32_t numSamples, const int_fast32_t coefs[],
+                                             int_fast32_t order, int_fast32_t shift, int_fast32_t sampleDepth) {
+                    if (sampleDepth > 32) {
+                        Kernels::get(CpuFeatures::Level::SCALAR).computeLpcResidual(
+                                data, numSamples, coefs, order, shift, sampleDepth);
+                        return;
+                    }
+                    __m128i count = _mm_cvtsi32_si128((int)shift);
+                    __m128i signBit = _mm_set1_epi64x((long long)((uint64_t)1 << (63 - shift)));
+                    uint_fast32_t i = numSamples;
+                    for (; i >= (uint_fast32_t)order + 2; i -= 2) {
+                        int_fast64_t *block = data + i - 2;
+                        __m128i sum = _mm_setzero_si128();
+                        for (int_fast32_t j = 0; j < order; j++) {
+                            __m128i x = _mm_loadu_si128((const __m128i *)(block - 1 - j));
+                            sum = _mm_add_epi64(sum, _mm_mul_epi32(x, _mm_set1_epi64x(coefs[j])));
+                        }
+                        __m128i x = _mm_loadu_si128((const __m128i *)block);
+                        _mm_storeu_si128((__m128i *)block, _mm_sub_epi64(x, shiftRightArithmetic(sum, count, signBit)));
+                    }
+                    for (; i-- > (uint_fast32_t)order; ) {
+                        int_fast64_t sum = 0;
+                        for (int_fast32_t j = 0; j < order; j++)
+                            sum += data[i - 1 - j] * coefs[j];
+                        data[i] -= sum >> shift;
+                    }
+                }
+
+                __attribute__((target("avx2")))
+                void computeLpcResidualAvx2(int_fast64_t data[], uint_fast32_t numSamples, const int_fast32_t coefs[],
+                                            int_fast32_t order, int_fast32_t shift, int_fast32_t sampleDepth) {
+                    if (sampleDepth > 32) {
+                        Kernels::get(CpuFeatures::Level::SCALAR).computeLpcResidual(
+                                data, numSamples, coefs, order, shift, sampleDepth);
+                        return;
+                    }
+                    __m128i count = _mm_cvtsi32_si128((int)shift);
+                    __m256i signBit = _mm256_set1_epi64x((long long)((uint64_t)1 << (63 - shift)));
+                    uint_fast32_t i = numSamples;
+                    for (; i >= (uint_fast32_t)order + 4; i -= 4) {
+                        int_fast64_t *block = data + i - 4;
+                        __m256i sum = _mm256_setzero_si256();
+                        for (int_fast32_t j = 0; j < order; j++) {
+                            __m256i x = _mm256_loadu_si256((const __m256i *)(block - 1 - j));
+                            sum = _mm256_add_epi64(sum, _mm256_mul_epi32(x, _mm256_set1_epi64x(coefs[j])));
+                        }
+                        __m256i x = _mm256_loadu_si256((const __m256i *)block);
+                        _mm256_storeu_si256((__m256i *)block,
+                                            _mm256_sub_epi64(x, shiftRightArithmetic(sum, count, signBit)));
+                    }
+                    for (; i-- > (uint_fast32_t)order; ) {
+                        int_fast64_t sum = 0;
+                        for (int_fast32_t j = 0; j < order; j++)
+                            sum += data[i - 1 - j] * coefs[j];
+                        data[i] -= sum >> shift;
+                    }
+                }
+
+                // AVX-512 has a full 64-bit multiply and arithmetic shift, so this variant covers every depth.
+                __attribute__((target("avx512f,avx512dq")))
+                void computeLpcResidualAvx512(int_fast64_t data[], uint_fast32_t numSamples,
+                                              const int_fast32_t coefs[], int_fast32_t order, int_fast32_t shift,
+                                              int_fast32_t) {
+                    __m128i count = _mm_cvtsi32_si128((int)shift);
+                    uint_fast32_t i = numSamples;
+                    for (; i >= (uint_fast32_t)order + 8; i -= 8) {
+                        int_fast64_t *block = data + i - 8;
+                        __m512i sum = _mm512_setzero_si512();
+                        for (int_fast32_t j = 0; j < order; j++) {
+                            __m512i x = _mm512_loadu_si512(block - 1 - j);
+                            sum = _mm512_add_epi64(sum, _mm512_mullo_epi64(x, _mm512_set1_epi64(coefs[j])));
+                        }
+                        __m512i x = _mm512_loadu_si512(block);
+                        _mm512_storeu_si512(block, _mm512_sub_epi64(x, _mm512_maskz_sra_epi64(0xFF, sum, count)));
+                    }
+                    for (; i-- > (uint_fast32_t)order; ) {
+                        int_fast64_t sum = 0;
+                        for (int_fast32_t j = 0; j < order; j++)
+                            sum += data[i - 1 - j] * coefs[j];
+                        data[i] -= sum >> shift;
+                    }
+                }
+
+                // Every lane accumulates one lag, so each sum is still formed in increasing order of `j` and rounds
+                // exactly like the portable kernel. The lags are handled in groups of up to four vectors whose
+                // accumulators stay in registers; the last few terms of each lag, which would read past the end of
+                // the data in a vector load, are added one at a time afterwards.
+
+                /**
+                 * Adds the remaining terms of every lag in [`lag0`, `lagEnd`) from index `j0` on, one at a time.
+                 */
+                inline void finishLags(const int_fast64_t data[], uint_fast32_t length, int_fast32_t lag0,
+                                       int_fast32_t lagEnd, uint_fast32_t j0, const double sums[], double result[]) {
+                    for (int_fast32_t lag = lag0; lag < lagEnd; lag++) {
+                        double sum = sums[lag - lag0];
+                        for (uint_fast32_t j = j0; j + lag < length; j++)
+                            sum += (double)data[j] * data[j + lag];
+                        result[lag] = sum;
+                    }
+                }
+
+                /**
+                 * Converts 64-bit integer lanes of magnitude less than 2^51 to doubles exactly, through the bit
+                 * pattern of 1.5 * 2^52.
+                 */
+                __attribute__((target("sse4.1")))
+                inline __m128d toDouble(__m128i x) {
+                    return _mm_sub_pd(_mm_castsi128_pd(_mm_add_epi64(x, _mm_set1_epi64x(0x4338000000000000LL))),
+                                      _mm_set1_pd(6755399441055744.0));
+                }
+
+                __attribute__((target("avx2")))
+                inline __m256d toDouble(__m256i x) {
+                    return _mm256_sub_pd(
+                            _mm256_castsi256_pd(_mm256_add_epi64(x, _mm256_set1_epi64x(0x4338000000000000LL))),
+                            _mm256_set1_pd(6755399441055744.0));
+                }
+
+                template<int G>
+                __attribute__((target("sse4.1")))
+                void autocorrelateGroupsSse41(const int_fast64_t data[], uint_fast32_t length, int_fast32_t lag0,
+                                              int_fast32_t lagEnd, double result[]) {
+                    const int_fast32_t lanes = 2;
+                    auto lastLag = (uint_fast32_t)(lag0 + G * lanes - 1);
+                    uint_fast32_t mainEnd = length > lastLag ? length - lastLag : 0;
+                    __m128d sums[G];
+                    for (int g = 0; g < G; g++)
+                        sums[g] = _mm_setzero_pd();
+                    for (uint_fast32_t j = 0; j < mainEnd; j++) {
+                        __m128d x = _mm_set1_pd((double)data[j]);
+                        for (int g = 0; g < G; g++) {
+                            __m128i y = _mm_loadu_si128((const __m128i *)(data + j + lag0 + g * lanes));
+                            sums[g] = _mm_add_pd(sums[g], _mm_mul_pd(x, toDouble(y)));
+                        }
+                    }
+                    double lanesOut[G * lanes];
+                    for (int g = 0; g < G; g++)
+                        _mm_storeu_pd(lanesOut + g * lanes, sums[g]);
+                    finishLags(data, length, lag0, lagEnd, mainEnd, lanesOut, result);
+                }
+
+                template<int G>
+                __attribute__((target("avx2")))
+                void autocorrelateGroupsAvx2(const int_fast64_t data[], uint_fast32_t length, int_fast32_t lag0,
+                                             int_fast32_t lagEnd, double result[]) {
+                    const int_fast32_t lanes = 4;
+                    auto lastLag = (uint_fast32_t)(lag0 + G * lanes - 1);
+                    uint_fast32_t mainEnd = length > lastLag ? length - lastLag : 0;
+                    __m256d sums[G];
+                    for (int g = 0; g < G; g++)
+                        sums[g] = _mm256_setzero_pd();
+                    for (uint_fast32_t j = 0; j < mainEnd; j++) {
+                        __m256d x = _mm256_set1_pd((double)data[j]);
+                        for (int g = 0; g < G; g++) {
+                            __m256i y = _mm256_loadu_si256((const __m256i *)(data + j + lag0 + g * lanes));
+                            sums[g] = _mm256_add_pd(sums[g], _mm256_mul_pd(x, toDouble(y)));
+                        }
+                    }
+                    double lanesOut[G * lanes];
+                    for (int g = 0; g < G; g++)
+                        _mm256_storeu_pd(lanesOut + g * lanes, sums[g]);
+                    finishLags(data, length, lag0, lagEnd, mainEnd, lanesOut, result);
+                }
+
+                template<int G>
+                __attribute__((target("avx512f,avx512dq")))
+                void autocorrelateGroupsAvx512(const int_fast64_t data[], uint_fast32_t length, int_fast32_t lag0,
+                                               int_fast32_t lagEnd, double result[]) {
+                    const int_fast32_t lanes = 8;
+                    auto lastLag = (uint_fast32_t)(lag0 + G * lanes - 1);
+                    uint_fast32_t mainEnd = length > lastLag ? length - lastLag : 0;
+                    __m512d sums[G];
+                    for (int g = 0; g < G; g++)
+                        sums[g] = _mm512_setzero_pd();
+                    for (uint_fast32_t j = 0; j < mainEnd; j++) {
+                        __m512d x = _mm512_set1_pd((double)data[j]);
+                        for (int g = 0; g < G; g++) {
+                            __m512i y = _mm512_loadu_si512(data + j + lag0 + g * lanes);
+                            sums[g] = _mm512_add_pd(sums[g], _mm512_mul_pd(x, _mm512_cvtepi64_pd(y)));
+                        }
+                    }
+                    double lanesOut[G * lanes];
+                    for (int g = 0; g < G; g++)
+                        _mm512_storeu_pd(lanesOut + g * lanes, sums[g]);
+                    finishLags(data, length, lag0, lagEnd, mainEnd, lanesOut, result);
+                }
+
+                /**
+                 * Splits the lags into chunks of at most four vectors and calls the matching instantiation of the
+                 * group kernel for each.
+                 */
+                template<int Lanes, void (*Group1)(const int_fast64_t *, uint_fast32_t, int_fast32_t, int_fast32_t,
+                                                   double *),
+                        void (*Group2)(const int_fast64_t *, uint_fast32_t, int_fast32_t, int_fast32_t, double *),
+                        void (*Group3)(const int_fast64_t *, uint_fast32_t, int_fast32_t, int_fast32_t, double *),
+                        void (*Group4)(const int_fast64_t *, uint_fast32_t, int_fast32_t, int_fast32_t, double *)>
+                void autocorrelateVector(const int_fast64_t data[], uint_fast32_t length, int_fast32_t maxLag,
+                                         double result[]) {
+                    for (int_fast32_t lag0 = 0; lag0 <= maxLag; lag0 += 4 * Lanes) {
+                        int_fast32_t lagEnd = std::min(maxLag + 1, lag0 + 4 * Lanes);
+                        switch ((lagEnd - lag0 + Lanes - 1) / Lanes) {
+                            case 1:  Group1(data, length, lag0, lagEnd, result);  break;
+                            case 2:  Group2(data, length, lag0, lagEnd, result);  break;
+                            case 3:  Group3(data, length, lag0, lagEnd, result);  break;
+                            default:  Group4(data, length, lag0, lagEnd, result);  break;
+                        }
+                    }
+                }
+
+                // Narrows the samples of one or two channels to 16 bits and interleaves them: each 64-bit lane holds
+                // one frame in its low bytes, which a shuffle gathers into consecutive bytes.
+                __attribute__((target("sse4.1")))
+                void packPcmSse41(const int_fast32_t *const samples[], uint_fast8_t numChannels, uint_fast64_t offset,
+                                  uint_fast32_t numSamples, uint_fast8_t bytesPerSample, uint_fast8_t out[]) {
+                    uint_fast32_t i = 0;
+                    if (bytesPerSample == 2 && numChannels == 2) {
+                        const int_fast32_t *left = samples[0] + offset;
+                        const int_fast32_t *right = samples[1] + offset;
+                        __m128i mask = _mm_set1_epi64x(0xFFFF);
+                        for (; i + 2 <= numSamples; i += 2, out += 8) {
+                            __m128i l = _mm_and_si128(_mm_loadu_si128((const __m128i *)(left + i)), mask);
+                            __m128i r = _mm_slli_epi64(_mm_loadu_si128((const __m128i *)(right + i)), 16);
+                            __m128i frames = _mm_shuffle_epi32(_mm_or_si128(l, r), 0x08);
+                            _mm_storel_epi64((__m128i *)out, frames);
+                        }
+                    }
+                    if (i < numSamples) {
+                        const int_fast32_t *rest[8];
+                        for (uint_fast8_t ch = 0; ch < numChannels; ch++)
+                            rest[ch] = samples[ch] + offset + i;
+                        Kernels::get(CpuFeatures::Level::SCALAR).packPcm(rest, numChannels, 0, numSamples - i,
+                                                                        bytesPerSample, out);
+                    }
+                }
+
+                __attribute__((target("avx2")))
+                void packPcmAvx2(const int_fast32_t *const samples[], uint_fast8_t numChannels, uint_fast64_t offset,
+                                 uint_fast32_t numSamples, uint_fast8_t bytesPerSample, uint_fast8_t out[]) {
+                    uint_fast32_t i = 0;
+                    const int_fast32_t *first = samples[0] + offset;
+                    if (bytesPerSample == 2 && numChannels == 2) {
+                        const int_fast32_t *second = samples[1] + offset;
+                        __m256i mask = _mm256_set1_epi64x(0xFFFF);
+                        __m256i gather = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+                        for (; i + 4 <= numSamples; i += 4, out += 16) {
+                            __m256i l = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(first + i)), mask);
+                            __m256i r = _mm256_slli_epi64(_mm256_loadu_si256((const __m256i *)(second + i)), 16);
+                            __m256i frames = _mm256_permutevar8x32_epi32(_mm256_or_si256(l, r), gather);
+                            _mm_storeu_si128((__m128i *)out, _mm256_castsi256_si128(frames));
+                        }
+                    } else if (bytesPerSample == 2 && numChannels == 1) {
+                        __m256i mask = _mm256_set1_epi64x(0xFFFF);
+                        __m256i gather = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+                        for (; i + 8 <= numSamples; i += 8, out += 16) {
+                            __m256i a = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(first + i)), mask);
+                            __m256i b = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(first + i + 4)), mask);
+                            __m128i lo = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(a, gather));
+                            __m128i hi = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(b, gather));
+                            _mm_storeu_si128((__m128i *)out, _mm_packus_epi32(lo, hi));
+                        }
+                    } else if (bytesPerSample == 3 && numChannels == 2) {
+                        // Each lane holds a 6-byte frame; a 16-byte store per 128-bit half writes 4 bytes too many,
+                        // which the next iteration overwrites, so the loop stops while at least one frame is left.
+                        const int_fast32_t *second = samples[1] + offset;
+                        __m256i mask = _mm256_set1_epi64x(0xFFFFFF);
+                        __m256i compact = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1,
+                                                           0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1);
+                        for (; i + 4 < numSamples; i += 4, out += 24) {
+                            __m256i l = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(first + i)), mask);
+                            __m256i r = _mm256_slli_epi64(_mm256_loadu_si256((const __m256i *)(second + i)), 24);
+                            __m256i frames = _mm256_shuffle_epi8(_mm256_or_si256(l, r), compact);
+                            _mm_storeu_si128((__m128i *)out, _mm256_castsi256_si128(frames));
+                            _mm_storeu_si128((__m128i *)(out + 12), _mm256_extracti128_si256(frames, 1));
+                        }
+                    }
+                    if (i < numSamples) {
+                        const int_fast32_t *rest[8];
+                        for (uint_fast8_t ch = 0; ch < numChannels; ch++)
+                            rest[ch] = samples[ch] + offset + i;
+                        Kernels::get(CpuFeatures::Level::SCALAR).packPcm(rest, numChannels, 0, numSamples - i,
+                                                                        bytesPerSample, out);
+                    }
+                }
+
+                /**
+                 * Sets lane `lane` of the given byte shuffle to move the sample of `bytesPerSample` bytes at byte
+                 * `source` into the top bytes of that 32-bit lane, zeroing the bytes below it, so that an arithmetic
+                 * right shift by `32 - 8 * bytesPerSample` sign-extends the sample.
+                 */
+                void setUnpackLane(int8_t mask[16], int_fast32_t lane, size_t source, int_fast32_t bytesPerSample) {
+                    for (int_fast32_t k = 0; k < 4; k++) {
+                        int_fast32_t byte = k - (4 - bytesPerSample);
+                        mask[lane * 4 + k] = byte < 0 ? (int8_t)-1 : (int8_t)(source + byte);
+                    }
+                }
+
+                /**
+                 * Converts the samples after the vector loop of an unpacking kernel with the portable kernel.
+                 */
+                void unpackPcmRest(const uint_fast8_t in[], uint_fast8_t numChannels, uint_fast64_t offset,
+                                   uint_fast32_t start, uint_fast32_t numSamples, uint_fast8_t bytesPerSample,
+                                   int_fast32_t *const samples[]) {
+                    if (start < numSamples) {
+                        Kernels::get(CpuFeatures::Level::SCALAR).unpackPcm(
+                                in + (size_t)start * numChannels * bytesPerSample, numChannels, offset + start,
+                                numSamples - start, bytesPerSample, samples);
+                    }
+                }
+
+                // Shuffles the samples of each channel out of four frames of at most 4 bytes, which one 16-byte load
+                // covers, into the tops of 32-bit lanes, then sign-extends them with an arithmetic shift.
+                __attribute__((target("sse4.1")))
+                void unpackPcmSse41(const uint_fast8_t in[], uint_fast8_t numChannels, uint_fast64_t offset,
+                                    uint_fast32_t numSamples, uint_fast8_t bytesPerSample,
+                                    int_fast32_t *const samples[]) {
+                    uint_fast32_t i = 0;
+                    size_t frameBytes = (size_t)numChannels * bytesPerSample;
+                    size_t totalBytes = frameBytes * numSamples;
+                    if (frameBytes <= 4) {
+                        __m128i masks[4];
+                        for (uint_fast8_t ch = 0; ch < numChannels; ch++) {
+                            int8_t mask[16];
+                            for (int_fast32_t j = 0; j < 4; j++)
+                                setUnpackLane(mask, j, j * frameBytes + ch * bytesPerSample, bytesPerSample);
+                            masks[ch] = _mm_loadu_si128((const __m128i *)mask);
+                        }
+                        __m128i shift = _mm_cvtsi32_si128(32 - 8 * bytesPerSample);
+                        for (; i * frameBytes + 16 <= totalBytes; i += 4) {
+                            __m128i bytes = _mm_loadu_si128((const __m128i *)(in + i * frameBytes));
+                            for (uint_fast8_t ch = 0; ch < numChannels; ch++) {
+                                __m128i v = _mm_sra_epi32(_mm_shuffle_epi8(bytes, masks[ch]), shift);
+                                int_fast32_t *out = samples[ch] + offset + i;
+                                _mm_storeu_si128((__m128i *)out, _mm_cvtepi32_epi64(v));
+                                _mm_storeu_si128((__m128i *)(out + 2), _mm_cvtepi32_epi64(_mm_srli_si128(v, 8)));
+                            }
+                        }
+                    }
+                    unpackPcmRest(in, numChannels, offset, i, numSamples, bytesPerSample, samples);
+                }
+
+                // Three strategies by frame size: frames of at most 4 bytes are shuffled like in the SSE4.1 kernel,
+                // eight frames per iteration; stereo frames of 24 or 32-bit samples are shuffled two frames per
+                // 128-bit half and then permuted across the halves; all other layouts gather each channel's samples
+                // with 32-bit loads at the frame stride.
+                __attribute__((target("avx2")))
+                void unpackPcmAvx2(const uint_fast8_t in[], uint_fast8_t numChannels, uint_fast64_t offset,
+                                   uint_fast32_t numSamples, uint_fast8_t bytesPerSample,
+                                   int_fast32_t *const samples[]) {
+                    uint_fast32_t i = 0;
+                    size_t frameBytes = (size_t)numChannels * bytesPerSample;
+                    size_t totalBytes = frameBytes * numSamples;
+                    __m128i shift = _mm_cvtsi32_si128(32 - 8 * bytesPerSample);
+                    if (frameBytes <= 4) {
+                        __m256i masks[4];
+                        for (uint_fast8_t ch = 0; ch < numChannels; ch++) {
+                            int8_t mask[16];
+                            for (int_fast32_t j = 0; j < 4; j++)
+                                setUnpackLane(mask, j, j * frameBytes + ch * bytesPerSample, bytesPerSample);
+                            masks[ch] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)mask));
+                        }
+                        for (; (i + 4) * frameBytes + 16 <= totalBytes; i += 8) {
+                            const uint_fast8_t *p = in + i * frameBytes;
+                            __m256i bytes = _mm256_inserti128_si256(
+                                    _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p)),
+                                    _mm_loadu_si128((const __m128i *)(p + 4 * frameBytes)), 1);
+                            for (uint_fast8_t ch = 0; ch < numChannels; ch++) {
+                                __m256i v = _mm256_sra_epi32(_mm256_shuffle_epi8(bytes, masks[ch]), shift);
+                                int_fast32_t *out = samples[ch] + offset + i;
+                                _mm256_storeu_si256((__m256i *)out, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+                                _mm256_storeu_si256((__m256i *)(out + 4),
+                                                    _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+                            }
+                        }
+                    } else if (numChannels == 2 && frameBytes <= 8) {
+                        // Each half yields the left and then the right samples of two frames
+                        int8_t mask[16];
+                        for (int_fast32_t j = 0; j < 4; j++)
+                            setUnpackLane(mask, j, (j & 1) * frameBytes + (j >> 1) * bytesPerSample, bytesPerSample);
+                        __m256i shuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)mask));
+                        __m256i gather = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+                        int_fast32_t *left = samples[0] + offset;
+                        int_fast32_t *right = samples[1] + offset;
+                        for (; (i + 2) * frameBytes + 16 <= totalBytes; i += 4) {
+                            const uint_fast8_t *p = in + i * frameBytes;
+                            __m256i bytes = _mm256_inserti128_si256(
+                                    _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p)),
+                                    _mm_loadu_si128((const __m128i *)(p + 2 * frameBytes)), 1);
+                            __m256i v = _mm256_sra_epi32(_mm256_shuffle_epi8(bytes, shuffle), shift);
+                            v = _mm256_permutevar8x32_epi32(v, gather);
+                            _mm256_storeu_si256((__m256i *)(left + i),
+                                                _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+                            _mm256_storeu_si256((__m256i *)(right + i),
+                                                _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+                        }
+                    } else {
+                        // The gathers read 4 bytes per sample, so the loop stops while a few bytes are left
+                        __m256i stride = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                                            _mm256_set1_epi32((int)frameBytes));
+                        for (; (i + 8) * frameBytes + 4 <= totalBytes; i += 8) {
+                            const uint_fast8_t *p = in + i * frameBytes;
+                            for (uint_fast8_t ch = 0; ch < numChannels; ch++) {
+                                __m256i v = _mm256_i32gather_epi32((const int *)(p + ch * bytesPerSample), stride, 1);
+                                v = _mm256_sra_epi32(_mm256_sll_epi32(v, shift), shift);
+                                int_fast32_t *out = samples[ch] + offset + i;
+                                _mm256_storeu_si256((__m256i *)out, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+                                _mm256_storeu_si256((__m256i *)(out + 4),
+                                                    _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+                            }
+                        }
+                    }
+                    unpackPcmRest(in, numChannels, offset, i, numSamples, bytesPerSample, samples);
+                }
+
+                /**
+                 * Loads eight consecutive 64-bit samples which fit 32 bits and narrows them to 32-bit lanes.
+                 */
+                __attribute__((target("avx2")))
+                inline __m256i loadNarrow8(const int_fast32_t *p) {
+                    __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+                    __m256i a = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)p), even);
+                    __m256i b = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)(p + 4)), even);
+                    return _mm256_blend_epi32(a, b, 0xF0);
+                }
+
+                // Converts eight samples of every channel per iteration in vector registers. Mono and stereo are
+                // interleaved with vector shuffles; other channel counts go through a small tile on the stack, from
+                // which the already converted values are copied to their interleaved positions.
+                __attribute__((target("avx2")))
+                void interleaveIntAvx2(const int_fast32_t *const samples[], uint_fast8_t numChannels,
+                                       uint_fast64_t offset, uint_fast32_t numSamples, int_fast32_t shift,
+                                       uint_fast8_t bytesPerSample, uint_fast8_t out[]) {
+                    __m128i left = _mm_cvtsi32_si128(shift > 0 ? shift : 0);
+                    __m128i right = _mm_cvtsi32_si128(shift < 0 ? -shift : 0);
+                    size_t frameBytes = (size_t)numChannels * bytesPerSample;
+                    uint_fast32_t i = 0;
+                    for (; i + 8 <= numSamples; i += 8) {
+                        __m256i v[8];
+                        for (uint_fast8_t ch = 0; ch < numChannels; ch++)
+                            v[ch] = _mm256_sra_epi32(_mm256_sll_epi32(loadNarrow8(samples[ch] + offset + i), left),
+                                                     right);
+                        uint_fast8_t *o = out + i * frameBytes;
+                        if (numChannels == 1 && bytesPerSample == 4)
+                            _mm256_storeu_si256((__m256i *)o, v[0]);
+                        else if (numChannels == 2 && bytesPerSample == 4) {
+                            __m256i lo = _mm256_unpacklo_epi32(v[0], v[1]);
+                            __m256i hi = _mm256_unpackhi_epi32(v[0], v[1]);
+                            _mm256_storeu_si256((__m256i *)o, _mm256_permute2x128_si256(lo, hi, 0x20));
+                            _mm256_storeu_si256((__m256i *)(o + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+                        } else if (numChannels == 1 && bytesPerSample == 2) {
+                            __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(v[0], v[0]), 0x08);
+                            _mm_storeu_si128((__m128i *)o, _mm256_castsi256_si128(packed));
+                        } else if (numChannels == 2 && bytesPerSample == 2) {
+                            __m256i frames = _mm256_or_si256(_mm256_and_si256(v[0], _mm256_set1_epi32(0xFFFF)),
+                                                             _mm256_slli_epi32(v[1], 16));
+                            _mm256_storeu_si256((__m256i *)o, frames);
+                        } else {
+                            alignas(32) uint32_t tile[8][8];
+                            for (uint_fast8_t ch = 0; ch < numChannels; ch++)
+                                _mm256_store_si256((__m256i *)tile[ch], v[ch]);
+                            for (int_fast32_t j = 0; j < 8; j++) {
+                                for (uint_fast8_t ch = 0; ch < numChannels; ch++, o += bytesPerSample)
+                                    std::memcpy(o, &tile[ch][j], bytesPerSample);  // The low bytes, little-endian
+                            }
+                        }
+                    }
+                    if (i < numSamples) {
+                        Kernels::get(CpuFeatures::Level::SCALAR).interleaveInt(
+                                samples, numChannels, offset + i, numSamples - i, shift, bytesPerSample,
+                                out + i * frameBytes);
+                    }
+                }
+
+                // Like interleaveIntAvx2(), with a conversion to single precision and a multiplication by the scale.
+                __attribute__((target("avx2")))
+                void interleaveFloatAvx2(const int_fast32_t *const samples[], uint_fast8_t numChannels,
+                                         uint_fast64_t offset, uint_fast32_t numSamples, float scale, float out[]) {
+                    __m256 factor = _mm256_set1_ps(scale);
+                    uint_fast32_t i = 0;
+                    for (; i + 8 <= numSamples; i += 8) {
+                        __m256 v[8];
+                        for (uint_fast8_t ch = 0; ch < numChannels; ch++)
+                            v[ch] = _mm256_mul_ps(_mm256_cvtepi32_ps(loadNarrow8(samples[ch] + offset + i)), factor);
+                        float *o = out + (size_t)i * numChannels;
+                        if (numChannels == 1)
+                            _mm256_storeu_ps(o, v[0]);
+                        else if (numChannels == 2) {
+                            __m256 lo = _mm256_unpacklo_ps(v[0], v[1]);
+                            __m256 hi = _mm256_unpackhi_ps(v[0], v[1]);
+                            _mm256_storeu_ps(o, _mm256_permute2f128_ps(lo, hi, 0x20));
+                            _mm256_storeu_ps(o + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+                        } else {
+                            alignas(32) float tile[8][8];
+                            for (uint_fast8_t ch = 0; ch < numChannels; ch++)
+                                _mm256_store_ps(tile[ch], v[ch]);
+                            for (int_fast32_t j = 0; j < 8; j++) {
+                                for (uint_fast8_t ch = 0; ch < numChannels; ch++, o++)
+                                    *o = tile[ch][j];
+                            }
+                        }
+                    }
+                    if (i < numSamples) {
+                        Kernels::get(CpuFeatures::Level::SCALAR).interleaveFloat(
+                                samples, numChannels, offset + i, numSamples - i, scale,
+                                out + (size_t)i * numChannels);
+                    }
+                }
+            }
+#endif
+
+            void Kernels::bindX86(Kernels &kernels, CpuFeatures::Level level, const CpuFeatures &features) {
+#ifdef NAYUKI_X86_KERNELS
+                using Level = CpuFeatures::Level;
+                // The vector packing and unpacking kernels treat samples as 64-bit lanes
+                const bool wideSamples = sizeof(int_fast32_t) == 8;
+                if (level >= Level::SSE41) {
+                    if (features.pclmul) {
+                        kernels.crc8 = crc8Clmul;
+                        kernels.crc16 = crc16Clmul;
+                    }
+                    kernels.computeLpcResidual = computeLpcResidualSse41;
+                    kernels.autocorrelate = autocorrelateVector<2, autocorrelateGroupsSse41<1>,
+                            autocorrelateGroupsSse41<2>, autocorrelateGroupsSse41<3>, autocorrelateGroupsSse41<4>>;
+                    if (wideSamples) {
+                        kernels.packPcm = packPcmSse41;
+                        kernels.unpackPcm = unpackPcmSse41;
+                    }
+                }
+                if (level >= Level::AVX2) {
+                    if (features.bmi2)
+                        kernels.readRiceSignedInts = readRiceSignedIntsBmi2;
+                    kernels.computeLpcResidual = computeLpcResidualAvx2;
+                    kernels.autocorrelate = autocorrelateVector<4, autocorrelateGroupsAvx2<1>,
+                            autocorrelateGroupsAvx2<2>, autocorrelateGroupsAvx2<3>, autocorrelateGroupsAvx2<4>>;
+                    if (wideSamples) {
+                        kernels.packPcm = packPcmAvx2;
+                        kernels.unpackPcm = unpackPcmAvx2;
+                        kernels.interleaveInt = interleaveIntAvx2;
+                        kernels.interleaveFloat = interleaveFloatAvx2;
+                    }
+                }
+                if (level >= Level::AVX512) {
+                    kernels.computeLpcResidual = computeLpcResidualAvx512;
+                    kernels.autocorrelate = autocorrelateVector<8, autocorrelateGroupsAvx512<1>,
+                            autocorrelateGroupsAvx512<2>, autocorrelateGroupsAvx512<3>, autocorrelateGroupsAvx512<4>>;
+                }
+#else
+                (void)kernels;
+                (void)level;
+                (void)features;
+#endif
+            }
+        }
+    }
+}
@@ -0,0 +1,66 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "Md5Hasher.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "Kernels.h"
+#include "MemoryAccount.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Common {
+            Md5Hasher::Md5Hasher(uint_fast8_t chans, uint_fast8_t depth) {
+                if (chans < 1 || chans > 8)
+                    throw std::invalid_argument("Invalid number of channels");
+                if (depth < 1 || depth > 32)
+                    throw std::invalid_argument("Invalid sample depth");
+                MD5_Init(&context);
+                numChannels = chans;
+                bytesPerSample = (uint_fast8_t)((depth + 7) / 8);
+                buffer = MemoryAccount::allocateCurrent<uint_fast8_t>(CHUNK_SAMPLES * chans * bytesPerSample);
+            }
+
+            Md5Hasher::~Md5Hasher() {
+                MemoryAccount::deallocate(buffer);
+            }
+
+            void Md5Hasher::update(const int_fast32_t *const samples[], uint_fast64_t off, uint_fast64_t numSamples) {
+                if (samples == nullptr)
+                    throw std::invalid_argument("Samples cannot be null");
+                const Kernels &kernels = Kernels::get();
+                for (uint_fast64_t i = 0; i < numSamples; ) {
+                    auto n = (uint_fast32_t)std::min(numSamples - i, (uint_fast64_t)CHUNK_SAMPLES);
+                    kernels.packPcm(samples, numChannels, off + i, n, bytesPerSample, buffer);
+                    MD5_Update(&context, buffer, (size_t)n * numChannels * bytesPerSample);
+                    i += n;
+                }
+            }
+
+            void Md5Hasher::finish(unsigned char result[MD5_DIGEST_LENGTH]) {
+                if (result == nullptr)
+                    throw std::invalid_argument("Result cannot be null");
+                MD5_Final(result, &context);
+            }
+        }
+    }
+}
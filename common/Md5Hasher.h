@@ -0,0 +1,96 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_MD5HASHER_H
+#define NAYUKI_MD5HASHER_H
+
+#include <cstdint>
+
+#include <openssl/md5.h>
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Common {
+            /**
+             * Computes the MD5 hash of audio samples the way the stream info block defines it, one block of samples
+             * after another: the samples are interleaved and each one is written as a little-endian signed integer of
+             * the sample depth rounded up to whole bytes. Not thread-safe.
+             */
+            class Md5Hasher final {
+            private:
+                /**
+                 * The number of samples per channel packed into `buffer` at once.
+                 */
+                static const uint_fast32_t CHUNK_SAMPLES = 2048;
+
+                /**
+                 * The hash state.
+                 */
+                MD5_CTX context;
+
+                /**
+                 * The number of audio channels.
+                 */
+                uint_fast8_t numChannels;
+
+                /**
+                 * The number of bytes per sample, in the range [1, 4].
+                 */
+                uint_fast8_t bytesPerSample;
+
+                /**
+                 * Scratch space for `CHUNK_SAMPLES` interleaved samples per channel, charged to the account current
+                 * on the constructing thread.
+                 */
+                uint_fast8_t *buffer;
+
+            public:
+                /**
+                 * Constructs a hasher of an empty sequence of samples.
+                 * @param[in] chans the number of audio channels, in the range [1, 8]
+                 * @param[in] depth the bit depth of the samples, in the range [1, 32]
+                 */
+                Md5Hasher(uint_fast8_t chans, uint_fast8_t depth);
+
+                ~Md5Hasher();
+
+                Md5Hasher(const Md5Hasher &) = delete;
+
+                Md5Hasher &operator=(const Md5Hasher &) = delete;
+
+                /**
+                 * Adds the given samples to the hash.
+                 * @param[in] samples    the samples to add, one array per channel (all not `null`)
+                 * @param[in] off        the index of the first sample to add in every array
+                 * @param[in] numSamples the number of samples per channel to add
+                 */
+                void update(const int_fast32_t *const samples[], uint_fast64_t off, uint_fast64_t numSamples);
+
+                /**
+                 * Returns the hash of all the samples added so far. The hasher must not be used afterwards.
+                 * @param[out] result the array to store the `MD5_DIGEST_LENGTH` bytes of the hash into (not `null`)
+                 */
+                void finish(unsigned char result[MD5_DIGEST_LENGTH]);
+            };
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,163 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "MemoryAccount.h"
+
+#include <atomic>
+#include <new>
+
+#include "FrameArena.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Common {
+            namespace {
+                /**
+                 * Precedes every block allocated through `MemoryAccount`, keeping the usable part aligned like a block
+                 * returned by `operator new`.
+                 */
+                struct alignas(std::max_align_t) BlockHeader {
+                    MemoryAccount *account;
+                    size_t bytes;
+                };
+
+                std::atomic<uint_fast64_t> processCurrentBytes(0);
+                std::atomic<uint_fast64_t> processPeakBytes(0);
+                std::atomic<uint_fast64_t> processLiveAccounts(0);
+            }
+
+            thread_local MemoryAccount *MemoryAccount::current = nullptr;
+
+            MemoryAccount::Scope::Scope(MemoryAccount *account) {
+                previous = current;
+                current = account;
+            }
+
+            MemoryAccount::Scope::~Scope() {
+                current = previous;
+            }
+
+            MemoryAccount::MemoryAccount() {
+                currentBytes = 0;
+                peakBytes = 0;
+                parent = nullptr;
+                processLiveAccounts++;
+            }
+
+            MemoryAccount::~MemoryAccount() {
+                setParent(nullptr);
+                processLiveAccounts--;
+            }
+
+            uint_fast64_t MemoryAccount::getCurrentBytes() const {
+                return currentBytes;
+            }
+
+            uint_fast64_t MemoryAccount::getPeakBytes() const {
+                return peakBytes;
+            }
+
+            void MemoryAccount::resetPeak() {
+                peakBytes = currentBytes;
+            }
+
+            void MemoryAccount::setParent(MemoryAccount *parent) {
+                if (this->parent != nullptr)
+                    this->parent->adjust(-(int_fast64_t)currentBytes);
+                this->parent = parent;
+                if (parent != nullptr)
+                    parent->adjust((int_fast64_t)currentBytes);
+            }
+
+            void MemoryAccount::charge(uint_fast64_t bytes) {
+                adjust((int_fast64_t)bytes);
+            }
+
+            void MemoryAccount::release(uint_fast64_t bytes) {
+                adjust(-(int_fast64_t)bytes);
+            }
+
+            void MemoryAccount::adjust(int_fast64_t delta) {
+                for (MemoryAccount *acc = this; acc != nullptr; acc = acc->parent) {
+                    acc->currentBytes += delta;
+                    if (acc->currentBytes > acc->peakBytes)
+                        acc->peakBytes = acc->currentBytes;
+                }
+            }
+
+            void *MemoryAccount::allocateBytes(MemoryAccount *account, size_t bytes) {
+                auto *header = static_cast<BlockHeader *>(::operator new(sizeof(BlockHeader) + bytes));
+                header->account = account;
+                header->bytes = bytes;
+                if (account != nullptr)
+                    account->adjust((int_fast64_t)bytes);
+                uint_fast64_t now = processCurrentBytes += bytes;
+                uint_fast64_t peak = processPeakBytes.load(std::memory_order_relaxed);
+                while (now > peak && !processPeakBytes.compare_exchange_weak(peak, now, std::memory_order_relaxed));
+                return header + 1;
+            }
+
+            void *MemoryAccount::allocateScratch(size_t bytes) {
+                FrameArena *arena = FrameArena::getCurrent();
+                if (arena != nullptr) {
+                    void *result = arena->allocate(bytes);
+                    if (result != nullptr)
+                        return result;
+                }
+                return allocateBytes(current, bytes);
+            }
+
+            void *MemoryAccount::allocateObject(size_t bytes) {
+                return allocateScratch(bytes);
+            }
+
+            void MemoryAccount::deallocate(const void *p) {
+                if (p == nullptr)
+                    return;
+                FrameArena *arena = FrameArena::getCurrent();
+                if (arena != nullptr && arena->release(p))
+                    return;
+                auto *header = const_cast<BlockHeader *>(static_cast<const BlockHeader *>(p) - 1);
+                if (header->account != nullptr)
+                    header->account->adjust(-(int_fast64_t)header->bytes);
+                processCurrentBytes -= header->bytes;
+                ::operator delete(header);
+            }
+
+            MemoryAccount &MemoryAccount::getShared() {
+                static MemoryAccount *shared = [] {
+                    auto *result = new MemoryAccount();  // Never deleted, since the shared tables live forever
+                    processLiveAccounts--;
+                    return result;
+                }();
+                return *shared;
+            }
+
+            MemoryAccount::Summary MemoryAccount::getProcessSummary() {
+                Summary result;
+                result.currentBytes = processCurrentBytes;
+                result.peakBytes = processPeakBytes;
+                result.sharedBytes = getShared().getCurrentBytes();
+                result.liveAccounts = processLiveAccounts;
+                return result;
+            }
+        }
+    }
+}
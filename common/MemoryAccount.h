@@ -0,0 +1,253 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_MEMORYACCOUNT_H
+#define NAYUKI_MEMORYACCOUNT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Common {
+            /**
+             * Tracks the current and peak heap usage of one decoder or encoder object. Memory is charged to an account
+             * either explicitly, by allocating through `allocate()`, or implicitly, by allocating through
+             * `allocateCurrent()` while a `Scope` for the account is active on the calling thread. Every block
+             * remembers the account it was charged to, so the static `deallocate()` always credits the right account.
+             *
+             * Accounts may be nested: charges to an account with a parent are also charged to the parent, so the
+             * parent's peak is the true peak of the sum. The process-wide totals (see `getProcessSummary()`) include
+             * every accounted block. An account itself is not thread-safe; the process-wide totals are.
+             */
+            class MemoryAccount final {
+            public:
+                /**
+                 * Makes an account the target of `allocateCurrent()` on the calling thread for the lifetime of this
+                 * object, restoring the previous target afterwards.
+                 */
+                class Scope final {
+                private:
+                    /**
+                     * The account which was current before this scope, or `null`.
+                     */
+                    MemoryAccount *previous;
+
+                public:
+                    /**
+                     * Makes the given account current on the calling thread.
+                     * @param[in,out] account the account to charge, or `null` to charge none
+                     */
+                    explicit Scope(MemoryAccount *account);
+
+                    Scope(const Scope &) = delete;
+
+                    Scope &operator=(const Scope &) = delete;
+
+                    /**
+                     * Restores the account which was current before.
+                     */
+                    ~Scope();
+                };
+
+                /**
+                 * A snapshot of the accounted heap usage of the whole process.
+                 */
+                class Summary final {
+                public:
+                    /**
+                     * The number of bytes currently allocated through any account, including shared tables.
+                     */
+                    uint_fast64_t currentBytes;
+
+                    /**
+                     * The highest value `currentBytes` has reached since the program started.
+                     */
+                    uint_fast64_t peakBytes;
+
+                    /**
+                     * The number of bytes currently used by tables shared by all objects (see `getShared()`).
+                     */
+                    uint_fast64_t sharedBytes;
+
+                    /**
+                     * The number of accounts currently alive, not counting the shared one.
+                     */
+                    uint_fast64_t liveAccounts;
+                };
+
+                /**
+                 * Constructs an empty account without a parent.
+                 */
+                MemoryAccount();
+
+                MemoryAccount(const MemoryAccount &) = delete;
+
+                MemoryAccount &operator=(const MemoryAccount &) = delete;
+
+                /**
+                 * Detaches this account from its parent. All memory charged to it should have been freed by now.
+                 */
+                ~MemoryAccount();
+
+                /**
+                 * Returns the number of bytes currently charged to this account and its children.
+                 * @return the current usage in bytes
+                 */
+                uint_fast64_t getCurrentBytes() const;
+
+                /**
+                 * Returns the highest number of bytes charged to this account and its children at any time since its
+                 * construction or the last call to `resetPeak()`.
+                 * @return the peak usage in bytes
+                 */
+                uint_fast64_t getPeakBytes() const;
+
+                /**
+                 * Sets the peak usage to the current usage.
+                 */
+                void resetPeak();
+
+                /**
+                 * Makes the given account the parent of this one, moving the current usage of this account from the
+                 * old parent (if any) to the new parent.
+                 * @param[in,out] parent the new parent, or `null` to detach
+                 */
+                void setParent(MemoryAccount *parent);
+
+                /**
+                 * Charges memory which is not allocated through this class (e.g. held by a standard container) to
+                 * this account. Must be balanced by a call to `release()` with the same size.
+                 * @param[in] bytes the number of bytes to charge
+                 */
+                void charge(uint_fast64_t bytes);
+
+                /**
+                 * Credits memory previously charged with `charge()`.
+                 * @param[in] bytes the number of bytes to credit
+                 */
+                void release(uint_fast64_t bytes);
+
+                /**
+                 * Allocates an uninitialized array charged to this account. It must be freed with `deallocate()`.
+                 * @tparam T the trivial element type
+                 * @param[in] n the number of elements
+                 * @return the new array (not `null`)
+                 */
+                template<typename T>
+                T *allocate(size_t n) {
+                    static_assert(std::is_trivial<T>::value, "Only trivial types can be allocated");
+                    static_assert(alignof(T) <= alignof(std::max_align_t), "Over-aligned types are not supported");
+                    return static_cast<T *>(allocateBytes(this, n * sizeof(T)));
+                }
+
+                /**
+                 * Allocates an uninitialized array charged to the account current on the calling thread (see
+                 * `Scope`), or only to the process-wide totals if there is none. If a `FrameArena` is current, the
+                 * array comes from the arena instead. It must be freed with `deallocate()`.
+                 * @tparam T the trivial element type
+                 * @param[in] n the number of elements
+                 * @return the new array (not `null`)
+                 */
+                template<typename T>
+                static T *allocateCurrent(size_t n) {
+                    static_assert(std::is_trivial<T>::value, "Only trivial types can be allocated");
+                    static_assert(alignof(T) <= alignof(std::max_align_t), "Over-aligned types are not supported");
+                    return static_cast<T *>(allocateScratch(n * sizeof(T)));
+                }
+
+                /**
+                 * Frees an array allocated with `allocate()` or `allocateCurrent()`, crediting the account it was
+                 * charged to, or returning it to the current `FrameArena` it came from. Does nothing if the pointer is
+                 * `null`.
+                 * @param[in] p the array to free, or `null`
+                 */
+                static void deallocate(const void *p);
+
+                /**
+                 * Allocates a block of raw memory for an object charged like `allocateCurrent()`. Suitable for
+                 * implementing a class-specific `operator new`.
+                 * @param[in] bytes the size of the object
+                 * @return the new block (not `null`)
+                 */
+                static void *allocateObject(size_t bytes);
+
+                /**
+                 * Returns the account for tables shared by all decoders and encoders, which are attributed separately
+                 * from the objects using them.
+                 * @return the shared account
+                 */
+                static MemoryAccount &getShared();
+
+                /**
+                 * Returns a snapshot of the accounted heap usage of the whole process.
+                 * @return the process-wide summary
+                 */
+                static Summary getProcessSummary();
+
+            private:
+                /**
+                 * The number of bytes currently charged to this account and its children.
+                 */
+                uint_fast64_t currentBytes;
+
+                /**
+                 * The peak of `currentBytes`.
+                 */
+                uint_fast64_t peakBytes;
+
+                /**
+                 * The account which is charged along with this one, or `null`.
+                 */
+                MemoryAccount *parent;
+
+                /**
+                 * The account charged by `allocateCurrent()` on this thread, or `null`.
+                 */
+                static thread_local MemoryAccount *current;
+
+                /**
+                 * Allocates a block with a header remembering the account and size, and charges it.
+                 * @param[in,out] account the account to charge, or `null`
+                 * @param[in]     bytes   the usable size of the block
+                 * @return the usable part of the new block
+                 */
+                static void *allocateBytes(MemoryAccount *account, size_t bytes);
+
+                /**
+                 * Allocates a block from the current frame arena if there is one and it has room, otherwise from the
+                 * heap charged to the current account.
+                 * @param[in] bytes the size of the block
+                 * @return the new block
+                 */
+                static void *allocateScratch(size_t bytes);
+
+                /**
+                 * Adds the given signed amount to the usage of this account and all its ancestors.
+                 * @param[in] delta the number of bytes to add
+                 */
+                void adjust(int_fast64_t delta);
+            };
+        }
+    }
+}
+
+#endif
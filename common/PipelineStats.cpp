@@ -0,0 +1,105 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "PipelineStats.h"
+
+#include <stdexcept>
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Common {
+            namespace {
+                /**
+                 * Converts the given duration to whole nanoseconds, clamping negative values to zero.
+                 */
+                uint_fast64_t toNanos(std::chrono::steady_clock::duration time) {
+                    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+                    return nanos > 0 ? (uint_fast64_t)nanos : 0;
+                }
+            }
+
+            PipelineStats::PipelineStats() {
+                reset();
+            }
+
+            void PipelineStats::reset() {
+                for (int_fast32_t i = 0; i < NUM_STAGES; i++) {
+                    frames[i] = 0;
+                    bytes[i] = 0;
+                    busyNanos[i] = 0;
+                    stallNanos[i] = 0;
+                }
+            }
+
+            void PipelineStats::addWork(Stage stage, uint_fast64_t numBytes, std::chrono::steady_clock::duration time) {
+                frames[(int)stage].fetch_add(1, std::memory_order_relaxed);
+                bytes[(int)stage].fetch_add(numBytes, std::memory_order_relaxed);
+                busyNanos[(int)stage].fetch_add(toNanos(time), std::memory_order_relaxed);
+            }
+
+            void PipelineStats::addStall(Stage stage, std::chrono::steady_clock::duration time) {
+                stallNanos[(int)stage].fetch_add(toNanos(time), std::memory_order_relaxed);
+            }
+
+            uint_fast64_t PipelineStats::getFrames(Stage stage) const {
+                return frames[(int)stage].load(std::memory_order_relaxed);
+            }
+
+            uint_fast64_t PipelineStats::getBytes(Stage stage) const {
+                return bytes[(int)stage].load(std::memory_order_relaxed);
+            }
+
+            double PipelineStats::getBusySeconds(Stage stage) const {
+                return busyNanos[(int)stage].load(std::memory_order_relaxed) / 1e9;
+            }
+
+            double PipelineStats::getStallSeconds(Stage stage) const {
+                return stallNanos[(int)stage].load(std::memory_order_relaxed) / 1e9;
+            }
+
+            double PipelineStats::getThroughput(Stage stage) const {
+                double seconds = getBusySeconds(stage);
+                return seconds > 0 ? getBytes(stage) / seconds : 0;
+            }
+
+            void PipelineStats::writeJson(std::ostream &out) const {
+                out << "{";
+                for (int_fast32_t i = 0; i < NUM_STAGES; i++) {
+                    auto stage = (Stage)i;
+                    out << (i > 0 ? ", " : "") << "\"" << getStageName(stage) << "\": {\"frames\": "
+                        << getFrames(stage) << ", \"bytes\": " << getBytes(stage) << ", \"busy_seconds\": "
+                        << getBusySeconds(stage) << ", \"stall_seconds\": " << getStallSeconds(stage)
+                        << ", \"bytes_per_second\": " << getThroughput(stage) << "}";
+                }
+                out << "}";
+            }
+
+            const char *PipelineStats::getStageName(Stage stage) {
+                switch (stage) {
+                    case Stage::INPUT:  return "input";
+                    case Stage::CODEC:  return "codec";
+                    case Stage::OUTPUT: return "output";
+                    default:
+                        throw std::invalid_argument("Unknown stage");
+                }
+            }
+        }
+    }
+}
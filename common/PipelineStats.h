@@ -0,0 +1,171 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_PIPELINESTATS_H
+#define NAYUKI_PIPELINESTATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Common {
+            /**
+             * Counters of a decoding or encoding pipeline, per stage: the frames and bytes each stage processed, the
+             * time it spent working on them, and the time it spent stalled waiting for a neighbouring stage. A stage
+             * whose stall time is low while the others' is high is the bottleneck. All methods are thread-safe; the
+             * counters may be read while the pipeline runs.
+             */
+            class PipelineStats final {
+            public:
+                /**
+                 * The stages of a pipeline, in the order frames pass through them.
+                 */
+                enum class Stage {
+                    /**
+                     * Reading the input: splitting the compressed stream into frames, or handing out blocks of samples
+                     * to encode. Its bytes are the compressed or uncompressed input consumed.
+                     */
+                    INPUT,
+
+                    /**
+                     * Decoding or encoding individual frames, on many threads at once, so its time is summed over
+                     * them. Its bytes are the compressed size of the frames.
+                     */
+                    CODEC,
+
+                    /**
+                     * Putting frames back in order and delivering them: hashing the decoded samples for the MD5 check,
+                     * or writing encoded frames. Its bytes are the data delivered.
+                     */
+                    OUTPUT
+                };
+
+                /**
+                 * The number of stages.
+                 */
+                static const int_fast32_t NUM_STAGES = 3;
+
+                /**
+                 * Constructs statistics with all counters zero.
+                 */
+                PipelineStats();
+
+                PipelineStats(const PipelineStats &) = delete;
+
+                PipelineStats &operator=(const PipelineStats &) = delete;
+
+                /**
+                 * Sets all counters to zero.
+                 */
+                void reset();
+
+                /**
+                 * Records one frame processed by the given stage.
+                 * @param[in] stage the stage
+                 * @param[in] bytes the number of bytes processed
+                 * @param[in] time  the time spent working on the frame
+                 */
+                void addWork(Stage stage, uint_fast64_t bytes, std::chrono::steady_clock::duration time);
+
+                /**
+                 * Records a time the given stage spent waiting for another one.
+                 * @param[in] stage the stage
+                 * @param[in] time  the time spent waiting
+                 */
+                void addStall(Stage stage, std::chrono::steady_clock::duration time);
+
+                /**
+                 * Returns the number of frames processed by the given stage.
+                 * @param[in] stage the stage
+                 * @return the number of frames
+                 */
+                uint_fast64_t getFrames(Stage stage) const;
+
+                /**
+                 * Returns the number of bytes processed by the given stage.
+                 * @param[in] stage the stage
+                 * @return the number of bytes
+                 */
+                uint_fast64_t getBytes(Stage stage) const;
+
+                /**
+                 * Returns the time the given stage spent working.
+                 * @param[in] stage the stage
+                 * @return the busy time in seconds
+                 */
+                double getBusySeconds(Stage stage) const;
+
+                /**
+                 * Returns the time the given stage spent waiting for other stages.
+                 * @param[in] stage the stage
+                 * @return the stall time in seconds
+                 */
+                double getStallSeconds(Stage stage) const;
+
+                /**
+                 * Returns the rate at which the given stage processes data while busy, i.e. the throughput the whole
+                 * pipeline could reach if this stage were the bottleneck.
+                 * @param[in] stage the stage
+                 * @return the throughput in bytes per second, or 0 if the stage did no work
+                 */
+                double getThroughput(Stage stage) const;
+
+                /**
+                 * Writes all counters as a JSON object with one member per stage.
+                 * @param[in,out] out the stream to write to
+                 */
+                void writeJson(std::ostream &out) const;
+
+                /**
+                 * Returns the name of the given stage in lowercase, such as `codec`.
+                 * @param[in] stage the stage
+                 * @return the name of the stage
+                 */
+                static const char *getStageName(Stage stage);
+
+            private:
+                /**
+                 * The number of frames processed per stage.
+                 */
+                std::atomic<uint_fast64_t> frames[NUM_STAGES];
+
+                /**
+                 * The number of bytes processed per stage.
+                 */
+                std::atomic<uint_fast64_t> bytes[NUM_STAGES];
+
+                /**
+                 * The time spent working per stage, in nanoseconds.
+                 */
+                std::atomic<uint_fast64_t> busyNanos[NUM_STAGES];
+
+                /**
+                 * The time spent waiting per stage, in nanoseconds.
+                 */
+                std::atomic<uint_fast64_t> stallNanos[NUM_STAGES];
+            };
+        }
+    }
+}
+
+#endif
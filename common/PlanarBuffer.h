@@ -0,0 +1,243 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_PLANARBUFFER_H
+#define NAYUKI_PLANARBUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "MemoryAccount.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Common {
+            /**
+             * Planar sample storage for up to 8 channels, laid out for vectorized kernels. Every channel starts on a
+             * 64-byte boundary, its usable length is padded up to a multiple of 64 bytes, and it is followed by at
+             * least `GUARD_BYTES` of zeroed guard space. So a kernel may process whole vectors of up to 512 bits with
+             * aligned loads and stores, never needing a scalar tail, and may read (but not rely on) up to
+             * `GUARD_BYTES` past the padded end.
+             *
+             * The memory is charged to the given account, or, without an account, taken from the current
+             * `FrameArena` or account like `MemoryAccount::allocateCurrent()`. In the latter case the buffer must be
+             * destroyed while the same arena is current. Not thread-safe.
+             * @tparam T the trivial sample type
+             */
+            template<typename T>
+            class PlanarBuffer final {
+                static_assert(std::is_trivial<T>::value, "Only trivial sample types are supported");
+
+            public:
+                /**
+                 * The alignment of every channel and the granularity of its padded length, in bytes.
+                 */
+                static const size_t ALIGNMENT = 64;
+
+                /**
+                 * The minimum number of zeroed bytes after the padded end of every channel.
+                 */
+                static const size_t GUARD_BYTES = 64;
+
+                /**
+                 * The maximum number of channels.
+                 */
+                static const int_fast32_t MAX_CHANNELS = 8;
+
+            private:
+                /**
+                 * The account to charge, or `null` for scratch memory.
+                 */
+                MemoryAccount *account;
+
+                /**
+                 * The block returned by the accounting allocator, or `null` if nothing is allocated.
+                 */
+                unsigned char *allocation;
+
+                /**
+                 * The start of every channel; only the first `numChannels` entries are valid.
+                 */
+                T *channels[MAX_CHANNELS];
+
+                /**
+                 * The number of channels, in the range [0, 8].
+                 */
+                int_fast32_t numChannels;
+
+                /**
+                 * The usable length of every channel, in samples.
+                 */
+                size_t capacity;
+
+                /**
+                 * The distance between the starts of consecutive channels, in samples.
+                 */
+                size_t stride;
+
+            public:
+                /**
+                 * Constructs an empty buffer which will charge the given account.
+                 * @param[in,out] account the account to charge, or `null` for scratch memory
+                 */
+                explicit PlanarBuffer(MemoryAccount *account) {
+                    this->account = account;
+                    allocation = nullptr;
+                    std::memset(channels, 0, sizeof(channels));
+                    numChannels = 0;
+                    capacity = 0;
+                    stride = 0;
+                }
+
+                /**
+                 * Constructs a buffer with the given shape, charged to the given account.
+                 * @param[in,out] account     the account to charge, or `null` for scratch memory
+                 * @param[in]     numChannels the number of channels, in the range [1, 8]
+                 * @param[in]     capacity    the usable length of every channel, in samples
+                 */
+                PlanarBuffer(MemoryAccount *account, int_fast32_t numChannels, size_t capacity)
+                        : PlanarBuffer(account) {
+                    reserve(numChannels, capacity);
+                }
+
+                PlanarBuffer(const PlanarBuffer &) = delete;
+
+                PlanarBuffer &operator=(const PlanarBuffer &) = delete;
+
+                ~PlanarBuffer() {
+                    MemoryAccount::deallocate(allocation);
+                }
+
+                /**
+                 * Replaces the storage with new storage of the given shape. The previous contents are discarded, and
+                 * the new samples are uninitialized (but the guard space is zeroed).
+                 * @param[in] numChannels the number of channels, in the range [1, 8]
+                 * @param[in] capacity    the usable length of every channel, in samples
+                 */
+                void reserve(int_fast32_t numChannels, size_t capacity) {
+                    if (numChannels < 1 || numChannels > MAX_CHANNELS)
+                        throw std::invalid_argument("Invalid number of channels");
+                    size_t paddedBytes = (capacity * sizeof(T) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+                    size_t strideBytes = paddedBytes + GUARD_BYTES;
+                    static_assert(ALIGNMENT % sizeof(T) == 0, "Sample size must divide the alignment");
+
+                    MemoryAccount::deallocate(allocation);
+                    allocation = nullptr;
+                    size_t bytes = (size_t)numChannels * strideBytes + ALIGNMENT - 1;
+                    allocation = account != nullptr ? account->allocate<unsigned char>(bytes)
+                                                    : MemoryAccount::allocateCurrent<unsigned char>(bytes);
+                    auto addr = reinterpret_cast<uintptr_t>(allocation);
+                    unsigned char *base = allocation + (ALIGNMENT - addr % ALIGNMENT) % ALIGNMENT;
+                    for (int_fast32_t ch = 0; ch < numChannels; ch++) {
+                        unsigned char *start = base + (size_t)ch * strideBytes;
+                        std::memset(start + capacity * sizeof(T), 0, strideBytes - capacity * sizeof(T));
+                        channels[ch] = reinterpret_cast<T *>(start);
+                    }
+                    this->numChannels = numChannels;
+                    this->capacity = capacity;
+                    stride = strideBytes / sizeof(T);
+                }
+
+                /**
+                 * Exchanges the storage and accounts of this buffer and the given one.
+                 * @param[in,out] other the buffer to swap with
+                 */
+                void swap(PlanarBuffer &other) noexcept {
+                    std::swap(account, other.account);
+                    std::swap(allocation, other.allocation);
+                    for (int_fast32_t ch = 0; ch < MAX_CHANNELS; ch++)
+                        std::swap(channels[ch], other.channels[ch]);
+                    std::swap(numChannels, other.numChannels);
+                    std::swap(capacity, other.capacity);
+                    std::swap(stride, other.stride);
+                }
+
+                /**
+                 * Frees the storage, leaving the buffer empty.
+                 */
+                void clear() {
+                    MemoryAccount::deallocate(allocation);
+                    allocation = nullptr;
+                    numChannels = 0;
+                    capacity = 0;
+                    stride = 0;
+                }
+
+                /**
+                 * Returns the start of the given channel, which is `ALIGNMENT`-aligned.
+                 * @param[in] ch the channel index, in the range [0, `getNumChannels()`)
+                 * @return the samples of the channel
+                 */
+                T *getChannel(int_fast32_t ch) {
+                    if (ch < 0 || ch >= numChannels)
+                        throw std::out_of_range("Channel index out of range");
+                    return channels[ch];
+                }
+
+                /**
+                 * Returns the array of channel starts, suitable for the `samples[]` parameters throughout the codec.
+                 * @return the channel pointers (valid until the next `reserve()`)
+                 */
+                T **getChannels() {
+                    return channels;
+                }
+
+                /**
+                 * Returns the number of channels, or 0 if nothing was reserved yet.
+                 * @return the number of channels
+                 */
+                int_fast32_t getNumChannels() const {
+                    return numChannels;
+                }
+
+                /**
+                 * Returns the usable length of every channel, in samples.
+                 * @return the capacity
+                 */
+                size_t getCapacity() const {
+                    return capacity;
+                }
+
+                /**
+                 * Returns the usable length rounded up to a multiple of `ALIGNMENT` bytes, in samples. Kernels may
+                 * process this many samples per channel without a scalar tail.
+                 * @return the padded capacity
+                 */
+                size_t getPaddedCapacity() const {
+                    return stride - GUARD_BYTES / sizeof(T);
+                }
+
+                /**
+                 * Returns the distance between the starts of consecutive channels, in samples.
+                 * @return the stride
+                 */
+                size_t getStride() const {
+                    return stride;
+                }
+            };
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_PROBES_H
+#define NAYUKI_PROBES_H
+
+/*
+ * User-space statically defined tracing (USDT) probes, compatible with SystemTap, perf and bpftrace. They are only
+ * compiled in with the CMake option `NAYUKI_ENABLE_USDT`, which requires the `<sys/sdt.h>` header (no library).
+ * Otherwise, the probe macros expand to nothing and their arguments are not evaluated.
+ *
+ * Even when compiled in, an unattached probe is a single `nop` instruction, so the overhead is negligible. All probes
+ * belong to the provider `nayuki`; list them with `perf list 'sdt_nayuki:*'` or `bpftrace -l 'usdt:PATH:nayuki:*'`.
+ *
+ * Probe name           | Arguments
+ * -------------------- | ----------------------------------------------------------------------------------------
+ * decode_frame_start   | byte position of the frame
+ * decode_frame_done    | frame index (or -1), sample offset (or -1), block size, byte position, frame size in bytes
+ * encode_frame_start   | sample offset, block size
+ * encode_frame_done    | sample offset, block size, frame size in bytes
+ * buffer_refill        | byte position of the refilled data, number of bytes read (0 or -1 at end of stream)
+ * input_seek           | new byte position
+ * seek_start           | requested sample position
+ * seek_done            | requested sample position, sample position of the frame, byte position of the frame
+ * metadata_block       | block type, block length in bytes, last-block flag
+ * md5_done             | number of samples hashed, number of channels, bit depth
+ */
+#ifdef NAYUKI_USDT
+#include <sys/sdt.h>
+#define NAYUKI_PROBE1(name, a) DTRACE_PROBE1(nayuki, name, a)
+#define NAYUKI_PROBE2(name, a, b) DTRACE_PROBE2(nayuki, name, a, b)
+#define NAYUKI_PROBE3(name, a, b, c) DTRACE_PROBE3(nayuki, name, a, b, c)
+#define NAYUKI_PROBE5(name, a, b, c, d, e) DTRACE_PROBE5(nayuki, name, a, b, c, d, e)
+#else
+#define NAYUKI_PROBE1(name, a) do { } while (false)
+#define NAYUKI_PROBE2(name, a, b) do { } while (false)
+#define NAYUKI_PROBE3(name, a, b, c) do { } while (false)
+#define NAYUKI_PROBE5(name, a, b, c, d, e) do { } while (false)
+#endif
+
+#endif
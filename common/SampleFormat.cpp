@@ -0,0 +1,65 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "SampleFormat.h"
+
+#include <stdexcept>
+
+#include "Kernels.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Common {
+            size_t SampleConverter::getBytesPerSample(SampleFormat format) {
+                switch (format) {
+                    case SampleFormat::INT16:
+                        return 2;
+                    case SampleFormat::INT24:
+                        return 3;
+                    case SampleFormat::INT32:
+                    case SampleFormat::FLOAT32:
+                        return 4;
+                    default:
+                        throw std::invalid_argument("Unknown sample format");
+                }
+            }
+
+            void SampleConverter::interleave(const int_fast32_t *const samples[], uint_fast8_t numChannels,
+                                             uint_fast64_t offset, uint_fast32_t numSamples, int_fast32_t sampleDepth,
+                                             SampleFormat format, void *out) {
+                if (samples == nullptr || (out == nullptr && numSamples > 0))
+                    throw std::invalid_argument("Samples and output cannot be null");
+                if (numChannels < 1 || numChannels > 8)
+                    throw std::invalid_argument("Invalid number of channels");
+                if (sampleDepth < 1 || sampleDepth > 32)
+                    throw std::invalid_argument("Invalid sample depth");
+                const Kernels &kernels = Kernels::get();
+                if (format == SampleFormat::FLOAT32) {
+                    float scale = 1.0f / (float)((uint_fast64_t)1 << (sampleDepth - 1));  // Exact, a power of 2
+                    kernels.interleaveFloat(samples, numChannels, offset, numSamples, scale, static_cast<float *>(out));
+                } else {
+                    auto bytesPerSample = (uint_fast8_t)getBytesPerSample(format);
+                    kernels.interleaveInt(samples, numChannels, offset, numSamples, bytesPerSample * 8 - sampleDepth,
+                                          bytesPerSample, static_cast<uint_fast8_t *>(out));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,91 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_SAMPLEFORMAT_H
+#define NAYUKI_SAMPLEFORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Common {
+            /**
+             * The interleaved sample layouts that decoded audio can be converted to (see `SampleConverter`).
+             */
+            enum class SampleFormat {
+                /**
+                 * Signed 16-bit integers, little-endian.
+                 */
+                INT16,
+
+                /**
+                 * Signed 24-bit integers packed into 3 bytes each, little-endian.
+                 */
+                INT24,
+
+                /**
+                 * Signed 32-bit integers, little-endian.
+                 */
+                INT32,
+
+                /**
+                 * Single precision floats normalized to the range [-1, 1).
+                 */
+                FLOAT32
+            };
+
+            /**
+             * Converts planar samples of a given bit depth to the interleaved layouts of `SampleFormat` with the
+             * vector kernels of `Kernels`. The integer formats keep the samples left-justified: a sample is shifted
+             * left if its depth is smaller than the format's width, and right (dropping the low bits) if it is larger.
+             * The float format divides by 2^(depth - 1). Static methods only.
+             */
+            class SampleConverter final {
+            public:
+                SampleConverter() = delete;
+
+                /**
+                 * Returns the size of one sample in the given format.
+                 * @param[in] format the sample format
+                 * @return the size in bytes, in the range [2, 4]
+                 */
+                static size_t getBytesPerSample(SampleFormat format);
+
+                /**
+                 * Converts planar samples to interleaved samples of the given format.
+                 * @param[in]  samples     the channels (not `null`)
+                 * @param[in]  numChannels the number of channels, in the range [1, 8]
+                 * @param[in]  offset      the index of the first sample to convert in every channel
+                 * @param[in]  numSamples  the number of samples per channel to convert
+                 * @param[in]  sampleDepth the bit depth of the samples, in the range [1, 32]
+                 * @param[in]  format      the layout to convert to
+                 * @param[out] out         the `numChannels * numSamples` samples of the format to write (not `null`
+                 *                         unless `numSamples` is 0)
+                 */
+                static void interleave(const int_fast32_t *const samples[], uint_fast8_t numChannels,
+                                       uint_fast64_t offset, uint_fast32_t numSamples, int_fast32_t sampleDepth,
+                                       SampleFormat format, void *out);
+            };
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,303 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_SPSCRING_H
+#define NAYUKI_SPSCRING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Common {
+            /**
+             * Waits for a condition polled by the caller, first yielding the processor and then sleeping briefly, so
+             * that a stage waiting for its neighbour neither burns a core nor adds much latency. Not thread-safe.
+             */
+            class Backoff final {
+            private:
+                /**
+                 * The number of times `pause()` was called since the last reset.
+                 */
+                uint_fast32_t rounds = 0;
+
+            public:
+                /**
+                 * Waits a little, longer after many calls than after few.
+                 */
+                void pause() {
+                    if (rounds < 64)
+                        std::this_thread::yield();
+                    else
+                        std::this_thread::sleep_for(std::chrono::microseconds(50));
+                    rounds++;
+                }
+
+                /**
+                 * Makes the next `pause()` short again, after the condition was met.
+                 */
+                void reset() {
+                    rounds = 0;
+                }
+            };
+
+            /**
+             * A bounded lock-free queue of object pointers between exactly one producer thread and one consumer
+             * thread. Pushing a pointer hands the ownership of the object to the consumer without copying it; the
+             * release store of the index publishes everything the producer wrote to the object before. The blocking
+             * `push()` and `pop()` spin with a `Backoff`, and `close()` makes them give up, which is how a pipeline is
+             * shut down or cancelled. Pointers still in the ring when it is destroyed are not deleted.
+             * @tparam T the type of the objects passed through the ring
+             */
+            template<typename T>
+            class SpscRing final {
+            private:
+                /**
+                 * The size of the padding between the fields written by different threads, so that the producer and
+                 * the consumer do not contend for a cache line. Padding instead of `alignas` works with any allocator.
+                 */
+                static const size_t CACHE_LINE = 64;
+
+                /**
+                 * The slots, a power of two in number.
+                 */
+                T **slots;
+
+                /**
+                 * The number of slots minus 1.
+                 */
+                size_t mask;
+
+                char padding0[CACHE_LINE];
+
+                /**
+                 * The number of items ever pushed, written by the producer only.
+                 */
+                std::atomic<size_t> tail;
+
+                /**
+                 * The producer's copy of `head`, reloaded only when the ring looks full.
+                 */
+                size_t cachedHead;
+
+                /**
+                 * The number of `push()` calls which found the ring full and had to wait.
+                 */
+                std::atomic<uint_fast64_t> fullWaits;
+
+                char padding1[CACHE_LINE];
+
+                /**
+                 * The number of items ever popped, written by the consumer only.
+                 */
+                std::atomic<size_t> head;
+
+                /**
+                 * The consumer's copy of `tail`, reloaded only when the ring looks empty.
+                 */
+                size_t cachedTail;
+
+                /**
+                 * The number of `pop()` calls which found the ring empty and had to wait.
+                 */
+                std::atomic<uint_fast64_t> emptyWaits;
+
+                char padding2[CACHE_LINE];
+
+                /**
+                 * Whether `close()` was called.
+                 */
+                std::atomic<bool> closed;
+
+            public:
+                /**
+                 * Constructs an empty ring.
+                 * @param[in] capacity the minimum number of items the ring can hold, at least 1; rounded up to a power
+                 * of two
+                 */
+                explicit SpscRing(size_t capacity) {
+                    if (capacity < 1 || capacity > ((size_t)1 << 30))
+                        throw std::invalid_argument("Invalid ring capacity");
+                    size_t size = 1;
+                    while (size < capacity)
+                        size <<= 1;
+                    slots = new T *[size];
+                    mask = size - 1;
+                    tail = 0;
+                    cachedHead = 0;
+                    fullWaits = 0;
+                    head = 0;
+                    cachedTail = 0;
+                    emptyWaits = 0;
+                    closed = false;
+                }
+
+                ~SpscRing() {
+                    delete[] slots;
+                }
+
+                SpscRing(const SpscRing &) = delete;
+
+                SpscRing &operator=(const SpscRing &) = delete;
+
+                /**
+                 * Appends the given item if there is room. Only the producer may call this.
+                 * @param[in] item the item to hand over (not `null`)
+                 * @return whether the item was appended; if not, the caller keeps its ownership
+                 */
+                bool tryPush(T *item) {
+                    size_t t = tail.load(std::memory_order_relaxed);
+                    if (t - cachedHead > mask) {
+                        cachedHead = head.load(std::memory_order_acquire);
+                        if (t - cachedHead > mask)
+                            return false;
+                    }
+                    slots[t & mask] = item;
+                    tail.store(t + 1, std::memory_order_release);
+                    return true;
+                }
+
+                /**
+                 * Removes the oldest item if there is one. Only the consumer may call this.
+                 * @return the oldest item, now owned by the caller, or `null` if the ring is empty
+                 */
+                T *tryPop() {
+                    size_t h = head.load(std::memory_order_relaxed);
+                    if (h == cachedTail) {
+                        cachedTail = tail.load(std::memory_order_acquire);
+                        if (h == cachedTail)
+                            return nullptr;
+                    }
+                    T *item = slots[h & mask];
+                    head.store(h + 1, std::memory_order_release);
+                    return item;
+                }
+
+                /**
+                 * Appends the given item, waiting while the ring is full. Only the producer may call this.
+                 * @param[in]     item   the item to hand over (not `null`)
+                 * @param[in,out] waited the time to add the time spent waiting to, or `null`
+                 * @return `true` if the item was appended, or `false` if the ring was closed, in which case the caller
+                 * keeps its ownership
+                 */
+                bool push(T *item, std::chrono::steady_clock::duration *waited = nullptr) {
+                    if (closed.load(std::memory_order_acquire))
+                        return false;
+                    if (tryPush(item))
+                        return true;
+                    fullWaits.fetch_add(1, std::memory_order_relaxed);
+                    auto start = std::chrono::steady_clock::now();
+                    Backoff backoff;
+                    bool result = false;
+                    while (!closed.load(std::memory_order_acquire)) {
+                        if (tryPush(item)) {
+                            result = true;
+                            break;
+                        }
+                        backoff.pause();
+                    }
+                    if (waited != nullptr)
+                        *waited += std::chrono::steady_clock::now() - start;
+                    return result;
+                }
+
+                /**
+                 * Removes the oldest item, waiting while the ring is empty and open. Only the consumer may call this.
+                 * @param[in,out] waited the time to add the time spent waiting to, or `null`
+                 * @return the oldest item, now owned by the caller, or `null` if the ring is closed and empty
+                 */
+                T *pop(std::chrono::steady_clock::duration *waited = nullptr) {
+                    T *item = tryPop();
+                    if (item != nullptr)
+                        return item;
+                    emptyWaits.fetch_add(1, std::memory_order_relaxed);
+                    auto start = std::chrono::steady_clock::now();
+                    Backoff backoff;
+                    while (true) {
+                        bool wasClosed = closed.load(std::memory_order_acquire);
+                        item = tryPop();
+                        if (item != nullptr || wasClosed)
+                            break;
+                        backoff.pause();
+                    }
+                    if (waited != nullptr)
+                        *waited += std::chrono::steady_clock::now() - start;
+                    return item;
+                }
+
+                /**
+                 * Makes waiting and future `push()` calls fail, and `pop()` return `null` once the ring is empty.
+                 * Either side may call this, e.g. the producer after its last item or the consumer to cancel.
+                 */
+                void close() {
+                    closed.store(true, std::memory_order_release);
+                }
+
+                /**
+                 * Returns whether `close()` was called.
+                 * @return whether the ring is closed
+                 */
+                bool isClosed() const {
+                    return closed.load(std::memory_order_acquire);
+                }
+
+                /**
+                 * Returns the number of items the ring can hold.
+                 * @return the capacity, a power of two
+                 */
+                size_t getCapacity() const {
+                    return mask + 1;
+                }
+
+                /**
+                 * Returns the number of items ever appended.
+                 * @return the number of pushed items
+                 */
+                uint_fast64_t getPushCount() const {
+                    return tail.load(std::memory_order_relaxed);
+                }
+
+                /**
+                 * Returns how many times the producer found the ring full and had to wait, i.e. was held back by the
+                 * consumer.
+                 * @return the number of waiting `push()` calls
+                 */
+                uint_fast64_t getFullWaits() const {
+                    return fullWaits.load(std::memory_order_relaxed);
+                }
+
+                /**
+                 * Returns how many times the consumer found the ring empty and had to wait, i.e. was starved by the
+                 * producer.
+                 * @return the number of waiting `pop()` calls
+                 */
+                uint_fast64_t getEmptyWaits() const {
+                    return emptyWaits.load(std::memory_order_relaxed);
+                }
+            };
+        }
+    }
+}
+
+#endif
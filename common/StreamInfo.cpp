@@ -23,13 +23,13 @@
  */
 #include "StreamInfo.h"
 
-#include <algorithm>
 #include <cstring>
 #include <stdexcept>
 
-#include "../decode/ByteArrayFlacInput.h"
 #include "../decode/DataFormatException.h"
-#include "../decode/FlacLowLevelInput.h"
+
+#include "Md5Hasher.h"
+#include "Probes.h"
 
 namespace Nayuki {
     namespace FLAC {
@@ -56,25 +56,32 @@ namespace Nayuki {
                     throw std::invalid_argument("Given metadata block is null");
                 if (length != 34)
                     throw std::invalid_argument("Invalid data length");
-                Decode::FlacLowLevelInput *in = new Decode::ByteArrayFlacInput(b, length);
-                minBlockSize = in->readUint(16);
-                maxBlockSize = in->readUint(16);
-                minFrameSize = in->readUint(24);
-                maxFrameSize = in->readUint(24);
+                // Parse the fields straight from the bytes, so that no stream needs to be allocated
+                auto readBytes = [b](int_fast32_t start, int_fast32_t count) {
+                    uint_fast64_t result = 0;
+                    for (int_fast32_t i = 0; i < count; i++)
+                        result = result << 8 | b[start + i];
+                    return result;
+                };
+                minBlockSize = (uint_fast16_t)readBytes(0, 2);
+                maxBlockSize = (uint_fast16_t)readBytes(2, 2);
+                minFrameSize = (uint_fast32_t)readBytes(4, 3);
+                maxFrameSize = (uint_fast32_t)readBytes(7, 3);
                 if (minBlockSize < 16)
                     throw Decode::DataFormatException("Minimum block size less than 16");
                 if (maxBlockSize < minBlockSize)
                     throw Decode::DataFormatException("Maximum block size less than minimum block size");
                 if (minFrameSize != 0 && maxFrameSize != 0 && maxFrameSize < minFrameSize)
                     throw Decode::DataFormatException("Maximum frame size less than minimum frame size");
-                sampleRate = in->readUint(20);
+                uint_fast64_t packed = readBytes(10, 8);  // Sample rate, channels, depth and sample count
+                sampleRate = (uint_fast32_t)(packed >> 44);
                 if (sampleRate == 0 || sampleRate > 655350)
                     throw Decode::DataFormatException("Invalid sample rate");
-                numChannels = in->readUint(3) + 1;
-                sampleDepth = in->readUint(5) + 1;
-                numSamples = (long) in->readUint(18) << 18 | in->readUint(18); // uint36
-                in->readFully(md5Hash, MD5_DIGEST_LENGTH);
-                // Skip closing the in-memory stream
+                numChannels = (uint_fast8_t)((packed >> 41 & 7) + 1);
+                sampleDepth = (uint_fast8_t)((packed >> 36 & 31) + 1);
+                numSamples = packed & (((uint_fast64_t)1 << 36) - 1);  // uint36
+                for (int_fast32_t i = 0; i < MD5_DIGEST_LENGTH; i++)
+                    md5Hash[i] = (unsigned char)b[18 + i];
             }
 
             void StreamInfo::checkValues() {
@@ -142,41 +149,22 @@ namespace Nayuki {
                     out->writeInt(8, b);
             }
 
-            unsigned char *StreamInfo::getMd5Hash(int_fast32_t *samples[], uint_fast8_t chans, uint_fast64_t numSamples,
-                                                  uint_fast8_t depth) {
+            void StreamInfo::getMd5Hash(int_fast32_t *samples[], uint_fast8_t chans, uint_fast64_t numSamples,
+                                        uint_fast8_t depth, unsigned char result[MD5_DIGEST_LENGTH]) {
                 // Check arguments
-                if (samples == nullptr)
-                    throw std::invalid_argument("Samples cannot be null");
+                if (samples == nullptr || result == nullptr)
+                    throw std::invalid_argument("Samples and result cannot be null");
                 for (uint_fast8_t i = 0; i < chans; i++)
                     if (samples[i] == nullptr)
                         throw std::invalid_argument("No channel can have null samples");
                 if (depth > 32 || depth % 8 != 0)
                     throw std::invalid_argument("Unsupported bit depth");
 
-                // Create hasher
-                MD5_CTX ctx;
-                MD5_Init(&ctx);
-
                 // Convert samples to a stream of bytes, compute hash
-                uint_fast8_t numBytes = depth / 8;
-                uint_fast64_t bufSize = chans * numBytes * std::min(numSamples, (uint_fast64_t) 2048);
-                uint_fast8_t *buf = new uint_fast8_t[bufSize];
-                for (uint_fast64_t i = 0, l = 0; i < numSamples; i++) {
-                    for (int j = 0; j < chans; j++) {
-                        int_fast32_t val = samples[j][i];
-                        for (int k = 0; k < numBytes; k++, l++)
-                            buf[l] = (uint_fast8_t)((uint_fast32_t)val >> (k << 3));
-                    }
-                    if (l == bufSize || i == numSamples - 1) {
-                        MD5_Update(&ctx, buf, l);
-                        l = 0;
-                    }
-                }
-
-                // Return final hasher result
-                unsigned char *result = new unsigned char[MD5_DIGEST_LENGTH];
-                MD5_Final(result, &ctx);
-                return result;
+                Md5Hasher hasher(chans, depth);
+                hasher.update(samples, 0, numSamples);
+                hasher.finish(result);
+                NAYUKI_PROBE3(md5_done, numSamples, chans, depth);
             }
         }
     }
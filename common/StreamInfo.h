@@ -140,18 +140,17 @@ namespace Nayuki {
                 void write(bool last, Encode::BitOutputStream *out);
 
                 /**
-                 * Computes and returns the MD5 hash of the specified raw audio sample data at the specified bit depth.
-                 * Currently, the bit depth must be a multiple of 8, between 8 and 32 inclusive. The returned array is
-                 * an array of length `MD5_DIGEST_LENGTH`.
-                 * @param[in] samples    the audio samples to hash, where each subarray is a channel (all not `null`)
-                 * @param[in] chans      the number of audio channels (number of sample channels)
-                 * @param[in] numSamples the number of samples per channel
-                 * @param[in] depth      the bit depth of the audio samples (each value is a signed `depth`-bit integer)
-                 * @return
-                 */
-                static unsigned char *
+                 * Computes the MD5 hash of the specified raw audio sample data at the specified bit depth into the given
+                 * array. Currently, the bit depth must be a multiple of 8, between 8 and 32 inclusive.
+                 * @param[in]  samples    the audio samples to hash, where each subarray is a channel (all not `null`)
+                 * @param[in]  chans      the number of audio channels (number of sample channels)
+                 * @param[in]  numSamples the number of samples per channel
+                 * @param[in]  depth      the bit depth of the audio samples (each value is a signed `depth`-bit integer)
+                 * @param[out] result     the array of length `MD5_DIGEST_LENGTH` to store the hash into (not `null`)
+                 */
+                static void
                 getMd5Hash(int_fast32_t *samples[], uint_fast8_t chans, uint_fast64_t numSamples,
-                           uint_fast8_t depth);
+                           uint_fast8_t depth, unsigned char result[MD5_DIGEST_LENGTH]);
             };
         }
     }
@@ -0,0 +1,244 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Common {
+            thread_local ThreadPool *ThreadPool::currentPool = nullptr;
+            thread_local int_fast32_t ThreadPool::currentIndex = -1;
+
+            ThreadPool::TaskGroup::TaskGroup(ThreadPool *pool) : pending(0) {
+                this->pool = pool;
+            }
+
+            ThreadPool::TaskGroup::~TaskGroup() {
+                try {
+                    wait();
+                } catch (...) {
+                    // A destructor cannot throw; the owner chose not to wait for the outcome
+                }
+            }
+
+            void ThreadPool::TaskGroup::run(std::function<void()> task) {
+                pending++;
+                if (pool == nullptr) {
+                    std::exception_ptr taskError;
+                    try {
+                        task();
+                    } catch (...) {
+                        taskError = std::current_exception();
+                    }
+                    finishTask(taskError);
+                } else
+                    pool->submit(Task{std::move(task), this});
+            }
+
+            void ThreadPool::TaskGroup::wait() {
+                while (pending > 0) {
+                    // Help instead of blocking, which also executes the nested tasks this group may be waiting on
+                    if (pool != nullptr && pool->runQueuedTask())
+                        continue;
+                    std::unique_lock<std::mutex> lock(mutex);
+                    finished.wait_for(lock, std::chrono::microseconds(200), [this] { return pending == 0; });
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                if (error != nullptr) {
+                    std::exception_ptr e = error;
+                    error = nullptr;
+                    std::rethrow_exception(e);
+                }
+            }
+
+            void ThreadPool::TaskGroup::finishTask(std::exception_ptr taskError) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (taskError != nullptr && error == nullptr)
+                    error = taskError;
+                if (--pending == 0)
+                    finished.notify_all();
+            }
+
+            ThreadPool::ThreadPool(int_fast32_t numThreads, const std::vector<int_fast32_t> &cpus) :
+                    queued(0), executed(0), stolen(0) {
+                if (numThreads < 0)
+                    throw std::invalid_argument("Negative number of threads");
+                if (numThreads == 0)
+                    numThreads = std::max((int_fast32_t)std::thread::hardware_concurrency(), (int_fast32_t)1);
+#ifdef __linux__
+                cpu_set_t allowed;
+                if (!cpus.empty() && sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+                    throw std::invalid_argument("Cannot query the usable processors");
+                for (int_fast32_t cpu : cpus) {
+                    if (cpu < 0 || cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed))
+                        throw std::invalid_argument("Processor " + std::to_string(cpu) + " is not usable");
+                }
+#else
+                (void)cpus;  // No thread affinity on this platform
+#endif
+                stopping = false;
+                for (int_fast32_t i = 0; i < numThreads; i++)
+                    workers.push_back(new Worker());
+                for (int_fast32_t i = 0; i < numThreads; i++) {
+                    workers[i]->thread = std::thread(&ThreadPool::workerLoop, this, i);
+#ifdef __linux__
+                    if (!cpus.empty()) {
+                        // Best effort: the processors were checked above, and a worker runs correctly unpinned
+                        cpu_set_t set;
+                        CPU_ZERO(&set);
+                        CPU_SET(cpus[i % cpus.size()], &set);
+                        pthread_setaffinity_np(workers[i]->thread.native_handle(), sizeof(set), &set);
+                    }
+#endif
+                }
+            }
+
+            ThreadPool::~ThreadPool() {
+                {
+                    std::lock_guard<std::mutex> lock(sleepMutex);
+                    stopping = true;
+                }
+                wakeup.notify_all();
+                // Workers may still steal from each other's queues until all of them have exited
+                for (Worker *worker : workers) {
+                    if (worker->thread.joinable())
+                        worker->thread.join();
+                }
+                for (Worker *worker : workers)
+                    delete worker;
+                workers.clear();
+            }
+
+            int_fast32_t ThreadPool::getSize() const {
+                return (int_fast32_t)workers.size();
+            }
+
+            uint_fast64_t ThreadPool::getExecutedCount() const {
+                return executed;
+            }
+
+            uint_fast64_t ThreadPool::getStolenCount() const {
+                return stolen;
+            }
+
+            ThreadPool &ThreadPool::getShared() {
+                static ThreadPool shared([] {
+                    const char *value = std::getenv("NAYUKI_THREADS");
+                    long n = value != nullptr ? std::strtol(value, nullptr, 10) : 0;
+                    return (int_fast32_t)(n > 0 && n <= 1024 ? n : 0);
+                }());
+                return shared;
+            }
+
+            void ThreadPool::submit(Task task) {
+                if (currentPool == this) {
+                    Worker *self = workers[currentIndex];
+                    std::lock_guard<std::mutex> lock(self->mutex);
+                    self->tasks.push_back(std::move(task));
+                } else {
+                    std::lock_guard<std::mutex> lock(injectedMutex);
+                    injected.push_back(std::move(task));
+                }
+                queued++;
+                {
+                    // Taking the lock orders the increment before the check of a worker about to sleep
+                    std::lock_guard<std::mutex> lock(sleepMutex);
+                }
+                wakeup.notify_one();
+            }
+
+            bool ThreadPool::runQueuedTask() {
+                if (queued <= 0)
+                    return false;
+                Task task{nullptr, nullptr};
+                bool found = false;
+                int_fast32_t self = currentPool == this ? currentIndex : -1;
+                if (self != -1) {
+                    Worker *worker = workers[self];
+                    std::lock_guard<std::mutex> lock(worker->mutex);
+                    if (!worker->tasks.empty()) {
+                        task = std::move(worker->tasks.back());
+                        worker->tasks.pop_back();
+                        found = true;
+                    }
+                }
+                if (!found) {
+                    std::lock_guard<std::mutex> lock(injectedMutex);
+                    if (!injected.empty()) {
+                        task = std::move(injected.front());
+                        injected.pop_front();
+                        found = true;
+                    }
+                }
+                auto numWorkers = (int_fast32_t)workers.size();
+                for (int_fast32_t i = 1; !found && i <= numWorkers; i++) {
+                    int_fast32_t victim = (self + i + numWorkers) % numWorkers;
+                    if (victim == self)
+                        continue;
+                    Worker *worker = workers[victim];
+                    std::lock_guard<std::mutex> lock(worker->mutex);
+                    if (!worker->tasks.empty()) {
+                        task = std::move(worker->tasks.front());
+                        worker->tasks.pop_front();
+                        found = true;
+                        stolen++;
+                    }
+                }
+                if (!found)
+                    return false;
+
+                queued--;
+                std::exception_ptr taskError;
+                try {
+                    task.function();
+                } catch (...) {
+                    taskError = std::current_exception();
+                }
+                executed++;
+                task.group->finishTask(taskError);
+                return true;
+            }
+
+            void ThreadPool::workerLoop(int_fast32_t index) {
+                currentPool = this;
+                currentIndex = index;
+                while (true) {
+                    if (runQueuedTask())
+                        continue;
+                    std::unique_lock<std::mutex> lock(sleepMutex);
+                    if (stopping && queued == 0)
+                        break;
+                    wakeup.wait(lock, [this] { return stopping || queued > 0; });
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,262 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_THREADPOOL_H
+#define NAYUKI_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Common {
+            /**
+             * A fixed set of worker threads executing tasks, meant to be shared by every parallel feature and by any
+             * number of concurrent decoders and encoders, so that a process never runs more busy threads than the pool
+             * has. Tasks are submitted through a `TaskGroup` and may themselves submit and wait for nested groups.
+             *
+             * Every worker has its own queue: a task submitted by a worker goes to the back of that worker's queue and
+             * is taken from the back again (so nested work runs depth-first and stays cache-warm), while idle workers
+             * steal from the front of the other queues. Tasks submitted by other threads go to a shared queue. A
+             * thread waiting for a group executes queued tasks meanwhile instead of blocking, so nesting cannot
+             * deadlock even when every worker is waiting.
+             *
+             * All methods are thread-safe.
+             */
+            class ThreadPool final {
+            public:
+                /**
+                 * A set of tasks which can be waited for together. Tasks run on the pool's workers or, while a thread
+                 * waits for any group, on that thread. The first exception thrown by a task of the group is rethrown
+                 * by `wait()`; the remaining tasks still run. Without a pool, tasks run immediately on the submitting
+                 * thread, so callers need no separate serial code path.
+                 */
+                class TaskGroup final {
+                private:
+                    /**
+                     * The pool executing the tasks, or `null` to run them immediately.
+                     */
+                    ThreadPool *pool;
+
+                    /**
+                     * The number of tasks submitted but not yet finished.
+                     */
+                    std::atomic<int_fast64_t> pending;
+
+                    /**
+                     * Guards `error` and the transitions of `pending` to zero.
+                     */
+                    std::mutex mutex;
+
+                    /**
+                     * Signaled when `pending` drops to zero.
+                     */
+                    std::condition_variable finished;
+
+                    /**
+                     * The first exception thrown by a task, or `null`.
+                     */
+                    std::exception_ptr error;
+
+                public:
+                    /**
+                     * Constructs an empty group executing on the given pool.
+                     * @param[in,out] pool the pool to execute on, or `null` to run every task immediately
+                     */
+                    explicit TaskGroup(ThreadPool *pool);
+
+                    TaskGroup(const TaskGroup &) = delete;
+
+                    TaskGroup &operator=(const TaskGroup &) = delete;
+
+                    /**
+                     * Waits for the remaining tasks, discarding any exception they throw.
+                     */
+                    ~TaskGroup();
+
+                    /**
+                     * Submits a task to this group.
+                     * @param[in] task the function to execute
+                     */
+                    void run(std::function<void()> task);
+
+                    /**
+                     * Waits until every task submitted so far has finished, executing queued tasks of any group in
+                     * the meantime.
+                     * @throws any exception thrown by a task of this group since the last `wait()`
+                     */
+                    void wait();
+
+                private:
+                    /**
+                     * Records the completion of one task, and the exception it threw, if any.
+                     * @param[in] taskError the exception thrown by the task, or `null`
+                     */
+                    void finishTask(std::exception_ptr taskError);
+
+                    friend class ThreadPool;
+                };
+
+                /**
+                 * Constructs a pool with the given number of workers, optionally pinning them to processors.
+                 * @param[in] numThreads the number of worker threads, or 0 for one per hardware thread
+                 * @param[in] cpus       the processors to pin the workers to, assigned round-robin, or empty to leave
+                 * the scheduling to the operating system; ignored on platforms other than Linux
+                 * @throws std::invalid_argument if the number of threads is negative or a processor is not usable
+                 */
+                explicit ThreadPool(int_fast32_t numThreads = 0, const std::vector<int_fast32_t> &cpus = {});
+
+                ThreadPool(const ThreadPool &) = delete;
+
+                ThreadPool &operator=(const ThreadPool &) = delete;
+
+                /**
+                 * Executes the queued tasks and stops the workers. No group may be waiting on this pool anymore.
+                 */
+                ~ThreadPool();
+
+                /**
+                 * Returns the number of worker threads.
+                 * @return the number of workers, at least 1
+                 */
+                int_fast32_t getSize() const;
+
+                /**
+                 * Returns the number of tasks executed so far.
+                 * @return the number of finished tasks
+                 */
+                uint_fast64_t getExecutedCount() const;
+
+                /**
+                 * Returns the number of tasks a worker took from another worker's queue so far.
+                 * @return the number of stolen tasks
+                 */
+                uint_fast64_t getStolenCount() const;
+
+                /**
+                 * Returns the process-wide pool, created on first use with the number of workers given by the
+                 * environment variable `NAYUKI_THREADS`, or one per hardware thread if it is unset or invalid.
+                 * @return the shared pool
+                 */
+                static ThreadPool &getShared();
+
+            private:
+                /**
+                 * A queued task and the group it belongs to.
+                 */
+                struct Task {
+                    std::function<void()> function;
+                    TaskGroup *group;
+                };
+
+                /**
+                 * A worker thread and its queue.
+                 */
+                struct Worker {
+                    std::mutex mutex;
+                    std::deque<Task> tasks;
+                    std::thread thread;
+                };
+
+                /**
+                 * The workers, owned by the pool.
+                 */
+                std::vector<Worker *> workers;
+
+                /**
+                 * Guards `injected`.
+                 */
+                std::mutex injectedMutex;
+
+                /**
+                 * The tasks submitted by threads outside the pool.
+                 */
+                std::deque<Task> injected;
+
+                /**
+                 * Guards `stopping` and the sleeping of idle workers.
+                 */
+                std::mutex sleepMutex;
+
+                /**
+                 * Signaled when a task is queued or the pool stops.
+                 */
+                std::condition_variable wakeup;
+
+                /**
+                 * The number of queued tasks, over all queues.
+                 */
+                std::atomic<int_fast64_t> queued;
+
+                /**
+                 * The number of finished tasks.
+                 */
+                std::atomic<uint_fast64_t> executed;
+
+                /**
+                 * The number of tasks taken from another worker's queue.
+                 */
+                std::atomic<uint_fast64_t> stolen;
+
+                /**
+                 * Whether the destructor asked the workers to exit.
+                 */
+                bool stopping;
+
+                /**
+                 * The pool whose worker is the calling thread, or `null`.
+                 */
+                static thread_local ThreadPool *currentPool;
+
+                /**
+                 * The index of the calling thread among the workers of `currentPool`.
+                 */
+                static thread_local int_fast32_t currentIndex;
+
+                /**
+                 * Queues the given task, on the calling worker's queue if it belongs to this pool.
+                 * @param[in] task the task to queue
+                 */
+                void submit(Task task);
+
+                /**
+                 * Takes one queued task, preferring the calling worker's own queue, and executes it.
+                 * @return whether a task was executed
+                 */
+                bool runQueuedTask();
+
+                /**
+                 * The main loop of the worker with the given index.
+                 * @param[in] index the index of the worker
+                 */
+                void workerLoop(int_fast32_t index);
+            };
+        }
+    }
+}
+
+#endif
@@ -32,7 +32,7 @@ namespace Nayuki {
              * @param[in] buf the byte array from which 8 bytes will be converted
              * @return the converted `uint64` value
              */
-            uint_fast64_t convertToUint64(uint_fast8_t buf[]) {
+            inline uint_fast64_t convertToUint64(uint_fast8_t buf[]) {
                 return (((uint_fast64_t) (buf[0] & 0xff) << 56) | ((uint_fast64_t) (buf[1] & 0xff) << 48) |
                         ((uint_fast64_t) (buf[2] & 0xff) << 40) | ((uint_fast64_t) (buf[3] & 0xff) << 32) |
                         ((uint_fast64_t) (buf[4] & 0xff) << 24) | ((uint_fast64_t) (buf[5] & 0xff) << 16) |
@@ -44,7 +44,7 @@ namespace Nayuki {
              * @param[in] buf the byte array from which 2 bytes will be converted
              * @return the converted `uint16` value
              */
-            uint_fast16_t convertToUint16(uint_fast8_t buf[]) {
+            inline uint_fast16_t convertToUint16(uint_fast8_t buf[]) {
                 return (((buf[0] & 0xff) << 8) | (buf[1] & 0xff));
             }
 
@@ -53,7 +53,7 @@ namespace Nayuki {
              * @param[in] i the value whose number of leading zeros is to be computed
              * @return the number of preceding zero bits
              */
-            int_fast32_t numberOfLeadingZeros(uint32_t i) {
+            inline int_fast32_t numberOfLeadingZeros(uint32_t i) {
                 if (i == 0)
                     return 32;
                 int n = 1;
@@ -70,12 +70,12 @@ namespace Nayuki {
              * @param[in] i the value whose number of leading zeros is to be computed
              * @return the number of preceding zero bits
              */
-            int_fast32_t numberOfLeadingZeros(uint64_t i) {
+            inline int_fast32_t numberOfLeadingZeros(uint64_t i) {
                 if (i == 0)
                     return 64;
                 int n = 1;
-                int x = (int)(i >> 32);
-                if (x == 0) { n += 32; x = (int)i; }
+                auto x = (uint32_t)(i >> 32);
+                if (x == 0) { n += 32; x = (uint32_t)i; }
                 if (x >> 16 == 0) { n += 16; x <<= 16; }
                 if (x >> 24 == 0) { n +=  8; x <<=  8; }
                 if (x >> 28 == 0) { n +=  4; x <<=  4; }
@@ -83,6 +83,22 @@ namespace Nayuki {
                 n -= x >> 31;
                 return n;
             }
+
+            /**
+             * Counts the number of trailing zero bits in the given 64-bit value.
+             * @param[in] i the value whose number of trailing zeros is to be computed
+             * @return the number of trailing zero bits, or 64 if the value is zero
+             */
+            inline int_fast32_t numberOfTrailingZeros(uint64_t i) {
+                if (i == 0)
+                    return 64;
+                int n = 0;
+                while ((i & 1) == 0) {
+                    i >>= 1;
+                    n++;
+                }
+                return n;
+            }
         }
     }
 }
@@ -30,74 +30,27 @@
 
 #include "DataFormatException.h"
 
+#include "../common/Kernels.h"
+#include "../common/Probes.h"
+
 namespace Nayuki {
     namespace FLAC {
         namespace Decode {
-            uint_fast8_t *AbstractFlacLowLevelInput::CRC8_TABLE = [] {
-                uint_fast8_t *crc8_table = new uint_fast8_t[CRC_TABLE_LEN];
-                for (int i = 0; i < CRC_TABLE_LEN; i++) {
-                    uint_fast32_t temp8 = i;
-                    for (int j = 0; j < 8; j++) {
-                        temp8 = (temp8 << 1) ^ ((temp8 >> 7) * 0x107);
-                    }
-                    crc8_table[i] = (uint_fast8_t) temp8;
-                }
-                return crc8_table;
-            }();
-
-            uint_fast16_t *AbstractFlacLowLevelInput::CRC16_TABLE = [] {
-                uint_fast16_t *crc16_table = new uint_fast16_t[CRC_TABLE_LEN];
-                for (int i = 0; i < CRC_TABLE_LEN; i++) {
-                    uint_fast32_t temp16 = i << 8;
-                    for (int j = 0; j < 8; j++) {
-                        temp16 = (temp16 << 1) ^ ((temp16 >> 15) * 0x18005);
-                    }
-                    crc16_table[i] = (uint_fast16_t) temp16;
-                }
-                return crc16_table;
-            }();
-
-            uint_fast8_t **AbstractFlacLowLevelInput::RICE_DECODING_CONSUMED_TABLES = [] {
-                uint_fast8_t **consumed_tables = new uint_fast8_t *[RICE_DECODING_TABLE_LEN];
-                for (int_fast32_t param = 0; param < RICE_DECODING_TABLE_LEN; param++) {
-                    consumed_tables[param] = new uint_fast8_t[1 << RICE_DECODING_TABLE_BITS];
-                    for (uint_fast32_t i = 0;; i++) {
-                        uint_fast32_t numBits = (i >> param) + 1 + param;
-                        if (numBits > RICE_DECODING_TABLE_BITS)
-                            break;
-                        uint_fast32_t bits = ((1 << param) | (i & ((1 << param) - 1)));
-                        uint_fast32_t shift = RICE_DECODING_TABLE_BITS - numBits;
-                        for (int_fast32_t j = 0; j < (1 << shift); j++) {
-                            consumed_tables[param][(bits << shift) | j] = (uint_fast8_t) numBits;
-                        }
-                    }
-                }
-                return consumed_tables;
-            }();
-
-            int_fast32_t **AbstractFlacLowLevelInput::RICE_DECODING_VALUE_TABLES = [] {
-                int_fast32_t **values_tables = new int_fast32_t *[RICE_DECODING_TABLE_LEN];
-                for (int_fast32_t param = 0; param < RICE_DECODING_TABLE_LEN; param++) {
-                    values_tables[param] = new int_fast32_t[1 << RICE_DECODING_TABLE_BITS];
-                    for (uint_fast32_t i = 0;; i++) {
-                        uint_fast32_t numBits = (i >> param) + 1 + param;
-                        if (numBits > RICE_DECODING_TABLE_BITS)
-                            break;
-                        uint_fast32_t bits = ((1 << param) | (i & ((1 << param) - 1)));
-                        uint_fast32_t shift = RICE_DECODING_TABLE_BITS - numBits;
-                        for (int_fast32_t j = 0; j < (1 << shift); j++) {
-                            values_tables[param][(bits << shift) | j] = (i >> 1) ^ -(i & 1);
-                        }
-                    }
-                }
-                return values_tables;
-            }();
-
-            AbstractFlacLowLevelInput::AbstractFlacLowLevelInput() {
-                byteBuffer = new uint_fast8_t[BUF_SIZE];
+            AbstractFlacLowLevelInput::AbstractFlacLowLevelInput(size_t bufferSize, size_t initialSize,
+                                                                 size_t adaptiveLimit) : buffer(&memory) {
+                if (bufferSize != 0 && (bufferSize < MIN_BUFFER_SIZE || bufferSize > MAX_BUFFER_SIZE))
+                    throw std::invalid_argument("Invalid buffer size");
+                if (initialSize < MIN_BUFFER_SIZE || adaptiveLimit < initialSize || adaptiveLimit > MAX_BUFFER_SIZE)
+                    throw std::invalid_argument("Invalid adaptive buffer sizes");
+                this->bufferSize = bufferSize != 0 ? bufferSize : initialSize;
+                this->adaptiveLimit = bufferSize != 0 ? 0 : adaptiveLimit;
+                buffer.reserve(1, this->bufferSize);
+                byteBuffer = buffer.getChannel(0);
                 positionChanged(0);
             }
 
+            AbstractFlacLowLevelInput::~AbstractFlacLowLevelInput() = default;
+
             uint_fast64_t AbstractFlacLowLevelInput::getPosition() {
                 return byteBufferStartPos + byteBufferIndex - (bitBufferLen + 7) / 8;
             }
@@ -107,8 +60,10 @@ namespace Nayuki {
             }
 
             void AbstractFlacLowLevelInput::positionChanged(uint_fast64_t pos) {
+                NAYUKI_PROBE1(input_seek, pos);
                 byteBufferStartPos = pos;
-                std::memset(byteBuffer, 0, BUF_SIZE * sizeof(uint_fast8_t));
+                // Bytes past byteBufferLen are never read, so the stale contents can stay (clearing a large adaptive
+                // buffer on every reset or seek would dominate decoding short clips)
                 byteBufferLen = 0;
                 byteBufferIndex = 0;
                 bitBuffer = 0;
@@ -116,6 +71,25 @@ namespace Nayuki {
                 resetCrcs();
             }
 
+            bool AbstractFlacLowLevelInput::seekWithinBuffer(uint_fast64_t pos) {
+                if (byteBufferLen <= 0 || pos < byteBufferStartPos || pos > byteBufferStartPos + byteBufferLen)
+                    return false;
+                NAYUKI_PROBE1(input_seek, pos);
+                byteBufferIndex = (int_fast32_t)(pos - byteBufferStartPos);
+                bitBuffer = 0;
+                bitBufferLen = 0;
+                resetCrcs();
+                return true;
+            }
+
+            void AbstractFlacLowLevelInput::reopen() {
+                if (byteBuffer == nullptr) {
+                    buffer.reserve(1, bufferSize);
+                    byteBuffer = buffer.getChannel(0);
+                }
+                positionChanged(0);
+            }
+
             void AbstractFlacLowLevelInput::checkByteAligned() {
                 if (bitBufferLen % 8 != 0)
                     throw std::runtime_error("Not at a byte boundary");
@@ -133,10 +107,8 @@ namespace Nayuki {
                     assert(bitBufferLen <= 64);
                 }
                 uint_fast32_t result = (uint_fast32_t) (bitBuffer >> (bitBufferLen - n));
-                if (n != 32) {
-                    result &= (1 << n) - 1;
-                    assert((result >> n) == 0);
-                }
+                result &= ((uint_fast64_t)1 << n) - 1;  // Also for n = 32, as uint_fast32_t may be wider
+                assert((result >> n) == 0);
                 bitBufferLen -= n;
                 assert(bitBufferLen <= 64);
                 return result;
@@ -145,8 +117,10 @@ namespace Nayuki {
             int_fast32_t AbstractFlacLowLevelInput::readSignedInt(uint_fast8_t n) {
                 if (n > 32)
                     throw std::invalid_argument("Cannot read more than 32 bits of a `uint32` value");
+                if (n == 0)
+                    return 0;
                 int_fast32_t shift = 32 - n;
-                return (readUint(n) << shift) >> shift;
+                return (int32_t)((uint32_t)readUint(n) << shift) >> shift;
             }
 
             void
@@ -156,30 +130,23 @@ namespace Nayuki {
                     throw std::invalid_argument("Rice Code Parameter has to be between 0 and 31 inclusive");
                 int_fast64_t unaryLimit = 1L << (53 - param);
 
-                uint_fast8_t *consumeTable = RICE_DECODING_CONSUMED_TABLES[param];
-                int_fast32_t *valueTable = RICE_DECODING_VALUE_TABLES[param];
+                const Common::Kernels &kernels = Common::Kernels::get();
                 while (true) {
-                    while (start <= end - RICE_DECODING_CHUNK) {
-                        if (bitBufferLen < RICE_DECODING_CHUNK * RICE_DECODING_TABLE_BITS) {
-                            if (byteBufferIndex <= byteBufferLen - 8) {
-                                fillBitBuffer();
-                            } else
-                                break;
-                        }
-                        for (int_fast32_t i = 0; i < RICE_DECODING_CHUNK; i++, start++) {
-                            // Fast decoder
-                            int_fast32_t extractedBits =
-                                    (int_fast32_t) (bitBuffer >> (bitBufferLen - RICE_DECODING_TABLE_BITS)) &
-                                    RICE_DECODING_TABLE_MASK;
-                            uint_fast8_t consumed = consumeTable[extractedBits];
-                            if (consumed == 0)
-                                goto middle;
-                            bitBufferLen -= consumed;
-                            result[start] = valueTable[extractedBits];
-                        }
-                    }
+                    // Decode as much as the bit and byte buffers hold in one go, then fall back to the slow path
+                    // below for a single value, which may refill the byte buffer from the underlying stream
+                    Common::Kernels::BitReader reader;
+                    reader.bitBuffer = bitBuffer;
+                    reader.bitBufferLen = bitBufferLen;
+                    reader.bytes = byteBuffer;
+                    reader.byteIndex = byteBufferIndex;
+                    reader.byteLen = byteBufferLen;
+                    int_fast32_t next = kernels.readRiceSignedInts(reader, param, result, start, end);
+                    bitBuffer = reader.bitBuffer;
+                    bitBufferLen = reader.bitBufferLen;
+                    byteBufferIndex = reader.byteIndex;
+                    NAYUKI_STAT(stats.riceFastPathValues[param] += next - start);
+                    start = next;
 
-                    middle:
                     if (start >= end)
                         break;
                     int_fast64_t val = 0;
@@ -199,28 +166,10 @@ namespace Nayuki {
                     assert((val >> 52) == 0 || (val >> 52) == -1);  // Must fit a signed int53 by design
                     result[start] = val;
                     start++;
+                    NAYUKI_STAT(stats.riceSlowPathValues[param]++);
                 }
             }
 
-            void AbstractFlacLowLevelInput::fillBitBuffer() {
-                int_fast32_t i = byteBufferIndex;
-                int_fast32_t n = std::min((int_fast32_t)((64U - bitBufferLen) >> 3), byteBufferLen - i);
-                uint_fast8_t *b = byteBuffer;
-                if (n > 0) {
-                    for (int j = 0; j < n; j++, i++)
-                        bitBuffer = (bitBuffer << 8) | (b[i] & 0xFF);
-                    bitBufferLen += n << 3;
-                } else if (bitBufferLen <= 56) {
-                    int temp = readUnderlying();
-                    if (temp == -1)
-                        throw std::runtime_error("End of data");
-                    bitBuffer = (bitBuffer << 8) | temp;
-                    bitBufferLen += 8;
-                }
-                assert(8 <= bitBufferLen && bitBufferLen <= 64);
-                byteBufferIndex += n;
-            }
-
             int_fast16_t AbstractFlacLowLevelInput::readByte() {
                 checkByteAligned();
                 if (bitBufferLen >= 8)
@@ -235,8 +184,126 @@ namespace Nayuki {
                 if (b == nullptr)
                     throw std::invalid_argument("Output buffer cannot be null");
                 checkByteAligned();
-                for (uint_fast64_t i = 0; i < length; i++)
+                uint_fast64_t i = 0;
+                for (; i < length && bitBufferLen >= 8; i++)
                     b[i] = (uint_fast8_t)readUint(8);
+
+                // The bit buffer is empty now, so copy straight out of the byte buffer
+                while (i < length) {
+                    if (byteBufferIndex >= byteBufferLen) {
+                        int_fast16_t temp = readUnderlying();  // Refills the byte buffer
+                        if (temp == -1)
+                            throw std::runtime_error("End of data");
+                        b[i] = (uint_fast8_t)temp;
+                        i++;
+                        continue;
+                    }
+                    auto n = (int_fast32_t)std::min(length - i, (uint_fast64_t)(byteBufferLen - byteBufferIndex));
+                    std::memcpy(b + i, byteBuffer + byteBufferIndex, (size_t)n);
+                    byteBufferIndex += n;
+                    i += n;
+                }
+            }
+
+            void AbstractFlacLowLevelInput::skipBytes(uint_fast64_t n) {
+                checkByteAligned();
+                for (; n > 0 && bitBufferLen >= 8; n--)
+                    readUint(8);
+                while (n > 0) {
+                    if (byteBufferIndex >= byteBufferLen) {
+                        if (readUnderlying() == -1)  // Refills the byte buffer
+                            throw std::runtime_error("End of data");
+                        n--;
+                        continue;
+                    }
+                    auto step = (int_fast32_t)std::min(n, (uint_fast64_t)(byteBufferLen - byteBufferIndex));
+                    byteBufferIndex += step;
+                    n -= step;
+                }
+            }
+
+            const uint_fast8_t *AbstractFlacLowLevelInput::peekBytes(size_t n, size_t *available) {
+                if (available == nullptr)
+                    throw std::invalid_argument("Available count cannot be null");
+                if (n > MAX_BUFFER_SIZE)
+                    throw std::invalid_argument("Cannot peek more bytes than the largest buffer holds");
+                checkByteAligned();
+
+                // Hand the whole bytes of the bit buffer back to the byte buffer, which still holds them; the CRC
+                // range never extends past them, so the CRCs are unaffected
+                int_fast32_t pending = bitBufferLen / 8;
+                assert(pending <= byteBufferIndex);
+                byteBufferIndex -= pending;
+                bitBufferLen = 0;
+
+                *available = fillByteBuffer(n);
+                return byteBuffer + byteBufferIndex;
+            }
+
+            uint_fast32_t AbstractFlacLowLevelInput::peekBits(uint_fast8_t n) {
+                if (n > 32)
+                    throw std::invalid_argument("Cannot peek more than 32 bits of a `uint32` value");
+                if (n == 0)
+                    return 0;
+                uint_fast64_t bits = bitBuffer;
+                uint_fast8_t bitsLen = bitBufferLen;
+                if (bitsLen < n) {
+                    // Combine the bit buffer with the next bytes without moving them into it
+                    size_t needed = (size_t)(n - bitsLen + 7) / 8;
+                    if (fillByteBuffer(needed) < needed)
+                        throw std::runtime_error("End of data");
+                    for (size_t i = 0; i < needed; i++)
+                        bits = (bits << 8) | byteBuffer[byteBufferIndex + i];
+                    bitsLen += needed * 8;
+                }
+                return (uint_fast32_t)((bits >> (bitsLen - n)) & (((uint_fast64_t)1 << n) - 1));
+            }
+
+            int_fast32_t AbstractFlacLowLevelInput::getKeptStart() {
+                return std::max(std::min(crcStartIndex, byteBufferIndex - bitBufferLen / 8), (int_fast32_t)0);
+            }
+
+            size_t AbstractFlacLowLevelInput::fillByteBuffer(size_t n) {
+                if (byteBufferLen == -1)
+                    return 0;
+                if (byteBufferLen - byteBufferIndex >= (int_fast32_t)n)
+                    return byteBufferLen - byteBufferIndex;
+
+                // Make room after the buffered data, keeping the bytes still needed by the bit buffer and the CRCs
+                int_fast32_t start = getKeptStart();
+                size_t needed = (size_t)(byteBufferIndex - start) + n;
+                if (needed > MAX_BUFFER_SIZE) {
+                    // Fold the bytes read so far into the CRCs now instead of keeping them, which leaves the CRC
+                    // values the same; only the bytes of the bit buffer must stay
+                    updateCrcs(bitBufferLen / 8);
+                    start = getKeptStart();
+                    needed = (size_t)(byteBufferIndex - start) + n;
+                    if (needed > MAX_BUFFER_SIZE)
+                        throw std::invalid_argument("Cannot buffer more bytes than the largest buffer holds");
+                }
+                if (needed > bufferSize) {
+                    size_t size = bufferSize;
+                    while (size < needed)
+                        size *= 2;
+                    resizeBuffer(std::min(size, (size_t)MAX_BUFFER_SIZE));
+                } else if (start > 0) {
+                    std::memmove(byteBuffer, byteBuffer + start, (size_t)(byteBufferLen - start));
+                    byteBufferStartPos += start;
+                    byteBufferLen -= start;
+                    byteBufferIndex -= start;
+                    crcStartIndex -= start;
+                }
+
+                // Append data until enough is available, stopping early at the end of the underlying stream
+                while (byteBufferLen - byteBufferIndex < (int_fast32_t)n && (size_t)byteBufferLen < bufferSize) {
+                    int_fast32_t read = readUnderlying(byteBuffer, byteBufferLen, bufferSize - byteBufferLen);
+                    NAYUKI_STAT(stats.countRead(read));
+                    NAYUKI_PROBE2(buffer_refill, byteBufferStartPos + byteBufferLen, read);
+                    if (read <= 0)
+                        break;
+                    byteBufferLen += read;
+                }
+                return std::max(byteBufferLen - byteBufferIndex, (int_fast32_t)0);
             }
 
             int_fast16_t AbstractFlacLowLevelInput::readUnderlying() {
@@ -245,7 +312,9 @@ namespace Nayuki {
                         return -1;
                     byteBufferStartPos += byteBufferLen;
                     updateCrcs(0);
-                    byteBufferLen = readUnderlying(byteBuffer, 0, BUF_SIZE);
+                    byteBufferLen = readUnderlying(byteBuffer, 0, bufferSize);
+                    NAYUKI_STAT(stats.countRead(byteBufferLen));
+                    NAYUKI_PROBE2(buffer_refill, byteBufferStartPos, byteBufferLen);
                     crcStartIndex = 0;
                     if (byteBufferLen <= 0)
                         return -1;
@@ -267,23 +336,25 @@ namespace Nayuki {
             uint_fast8_t AbstractFlacLowLevelInput::getCrc8() {
                 checkByteAligned();
                 updateCrcs(bitBufferLen / 8);
-                assert((crc8 >> 8) != 0);
+                assert((crc8 >> 8) == 0);
                 return crc8;
             }
 
             uint_fast16_t AbstractFlacLowLevelInput::getCrc16() {
                 checkByteAligned();
                 updateCrcs(bitBufferLen / 8);
-                assert((crc16 >> 16) != 0);
+                assert((crc16 >> 16) == 0);
                 return crc16;
             }
 
             void AbstractFlacLowLevelInput::updateCrcs(int_fast32_t unusedTrailingBytes) {
                 int_fast32_t end = byteBufferIndex - unusedTrailingBytes;
-                for (int_fast32_t i = crcStartIndex; i < end; i++) {
-                    uint_fast8_t b = byteBuffer[i] & 0xFF;
-                    crc8 = CRC8_TABLE[crc8 ^ b] & 0xFF;
-                    crc16 = CRC16_TABLE[(crc16 >> 8) ^ b] ^ ((crc16 & 0xFF) << 8);
+                NAYUKI_STAT(stats.crcBytes += std::max(end - crcStartIndex, (int_fast32_t)0));
+                if (end > crcStartIndex) {
+                    const Common::Kernels &kernels = Common::Kernels::get();
+                    size_t len = end - crcStartIndex;
+                    crc8 = kernels.crc8((uint_fast8_t)crc8, byteBuffer + crcStartIndex, len);
+                    crc16 = kernels.crc16((uint_fast16_t)crc16, byteBuffer + crcStartIndex, len);
                     assert((crc8 >> 8) == 0);
                     assert((crc16 >> 16) == 0);
                 }
@@ -291,6 +362,7 @@ namespace Nayuki {
             }
 
             void AbstractFlacLowLevelInput::close() {
+                buffer.clear();
                 byteBuffer = nullptr;
                 byteBufferLen = -1;
                 byteBufferIndex = -1;
@@ -300,6 +372,66 @@ namespace Nayuki {
                 crc16 = -1;
                 crcStartIndex = -1;
             }
+
+            Common::MemoryAccount *AbstractFlacLowLevelInput::getMemory() {
+                return &memory;
+            }
+
+            size_t AbstractFlacLowLevelInput::getBufferSize() {
+                return bufferSize;
+            }
+
+            void AbstractFlacLowLevelInput::setBufferSize(size_t size) {
+                if (size < MIN_BUFFER_SIZE || size > MAX_BUFFER_SIZE)
+                    throw std::invalid_argument("Invalid buffer size");
+                adaptiveLimit = 0;
+                resizeBuffer(size);
+            }
+
+            void AbstractFlacLowLevelInput::adaptBufferSize(uint_fast32_t maxFrameSize) {
+                if (adaptiveLimit == 0 || maxFrameSize == 0)
+                    return;
+                size_t size = bufferSize;
+                while (size < (size_t)maxFrameSize * 2 && size < adaptiveLimit)
+                    size *= 2;
+                size = std::min(size, adaptiveLimit);
+                if (size > bufferSize)
+                    resizeBuffer(size);
+            }
+
+            void AbstractFlacLowLevelInput::resizeBuffer(size_t size) {
+                if (byteBuffer == nullptr) {  // Closed, so only the size for reopening changes
+                    bufferSize = size;
+                    return;
+                }
+
+                // Keep the bytes from the CRC start (or the bit buffer, if earlier) to the end of the buffered data
+                int_fast32_t start = 0;
+                int_fast32_t kept = 0;
+                if (byteBufferLen > 0) {
+                    start = getKeptStart();
+                    kept = byteBufferLen - start;
+                    size = std::max(size, (size_t)kept);
+                }
+                Common::PlanarBuffer<uint_fast8_t> resized(&memory, 1, size);
+                uint_fast8_t *bytes = resized.getChannel(0);
+                std::memcpy(bytes, byteBuffer + start, (size_t)kept);
+                buffer.swap(resized);
+                byteBuffer = bytes;
+                bufferSize = size;
+                if (byteBufferLen > 0) {
+                    byteBufferStartPos += start;
+                    byteBufferLen = kept;
+                    byteBufferIndex -= start;
+                    crcStartIndex -= start;
+                }
+            }
+
+#ifdef NAYUKI_STATS
+            InputStats *AbstractFlacLowLevelInput::getStats() {
+                return &stats;
+            }
+#endif
         }
     }
 }
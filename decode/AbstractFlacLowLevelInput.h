@@ -26,72 +26,53 @@
 
 #include "FlacLowLevelInput.h"
 
+#include "../common/PlanarBuffer.h"
+
 namespace Nayuki {
     namespace FLAC {
         namespace Decode {
             class AbstractFlacLowLevelInput : public FlacLowLevelInput {
-            private:
-                /**
-                 * Constant representing the length of the byte buffer.
-                 */
-                static const int_fast16_t BUF_SIZE = 4096;
-
-                /**
-                 * Unknown variable, ported from original work.
-                 *
-                 * Configurable, must be positive.
-                 */
-                static const int_fast8_t RICE_DECODING_TABLE_BITS = 13;
-
+            public:
                 /**
-                 * Unknown variable, ported from original work.
+                 * The smallest allowed buffer size, in bytes.
                  */
-                static const int_fast32_t RICE_DECODING_TABLE_MASK = (1 << RICE_DECODING_TABLE_BITS) - 1;
+                static const size_t MIN_BUFFER_SIZE = 64;
 
                 /**
-                 * Length of rice decoding tables.
+                 * The largest allowed buffer size, in bytes.
                  */
-                static const int_fast8_t RICE_DECODING_TABLE_LEN = 31;
+                static const size_t MAX_BUFFER_SIZE = (size_t)1 << 24;
 
+            private:
                 /**
-                 * Unknown variable, ported from original work.
+                 * The length of the byte buffer, in the range [`MIN_BUFFER_SIZE`, `MAX_BUFFER_SIZE`].
                  */
-                static uint_fast8_t **RICE_DECODING_CONSUMED_TABLES;
+                size_t bufferSize;
 
                 /**
-                 * Unknown variable, ported from original work.
+                 * The largest size adaptive sizing may grow the buffer to, or 0 if the size was set explicitly and
+                 * adaptive sizing is off.
                  */
-                static int_fast32_t **RICE_DECODING_VALUE_TABLES;
+                size_t adaptiveLimit;
 
                 /**
                  * Unknown variable, ported from original work.
-                 *
-                 * Configurable, must be positive, and `RICE_DECODING_CHUNK * RICE_DECODING_TABLE_BITS <= 64`.
-                 */
-                static const int_fast32_t RICE_DECODING_CHUNK = 4;
-
-                /**
-                 * For CRC calculations.
-                 */
-                static const int_fast32_t CRC_TABLE_LEN = 256;
-
-                /**
-                 * For CRC calculations.
                  */
-                static uint_fast8_t *CRC8_TABLE;
+                uint_fast64_t byteBufferStartPos;
 
                 /**
-                 * For CRC calculations.
+                 * The account `byteBuffer` is charged to.
                  */
-                static uint_fast16_t *CRC16_TABLE;
+                Common::MemoryAccount memory;
 
                 /**
-                 * Unknown variable, ported from original work.
+                 * Owns the storage of `byteBuffer`. Empty after closing.
                  */
-                uint_fast64_t byteBufferStartPos;
+                Common::PlanarBuffer<uint_fast8_t> buffer;
 
                 /**
                  * Data from the underlying stream is first stored into this byte buffer before further processing.
+                 * Points into `buffer`, or is `null` after closing.
                  */
                 uint_fast8_t *byteBuffer;
 
@@ -134,15 +115,17 @@ namespace Nayuki {
                  */
                 int_fast32_t crcStartIndex;
 
+#ifdef NAYUKI_STATS
                 /**
-                 * Either returns silently or throws an exception.
+                 * The hot-path counters of this stream.
                  */
-                void checkByteAligned();
+                InputStats stats;
+#endif
 
                 /**
-                 * Appends at least 8 bits to the bit buffer, or throws an exception.
+                 * Either returns silently or throws an exception.
                  */
-                void fillBitBuffer();
+                void checkByteAligned();
 
                 /**
                  * Reads a byte from the byte buffer (if available) or from the underlying stream, returning either a
@@ -158,6 +141,31 @@ namespace Nayuki {
                  */
                 void updateCrcs(int_fast32_t unusedTrailingBytes);
 
+                /**
+                 * Replaces the byte buffer with one of the given size, moving the buffered bytes which are not yet
+                 * covered by the CRCs or not yet read to its start.
+                 * @param[in] size the new buffer size, in the range [`MIN_BUFFER_SIZE`, `MAX_BUFFER_SIZE`]
+                 */
+                void resizeBuffer(size_t size);
+
+                /**
+                 * Returns the index of the first buffered byte which must be kept when the buffer is compacted: the
+                 * start of the CRC range, or the first byte of the bit buffer, whichever is earlier.
+                 * @return the index of the first byte to keep, at least 0
+                 */
+                int_fast32_t getKeptStart();
+
+                /**
+                 * Makes at least the given number of bytes after `byteBufferIndex` available in the byte buffer, by
+                 * moving the kept bytes to the start of the buffer (growing it if they do not fit otherwise) and
+                 * appending data from the underlying stream. Leaves the position and the CRC values unchanged, but
+                 * may fold the bytes read so far into the CRCs early so that they need not be kept.
+                 * @param[in] n the number of bytes wanted, at most `MAX_BUFFER_SIZE`
+                 * @return the number of bytes available after `byteBufferIndex`, less than `n` only at end of stream
+                 * @throws std::invalid_argument if `n` and the whole bytes of the bit buffer exceed `MAX_BUFFER_SIZE`
+                 */
+                size_t fillByteBuffer(size_t n);
+
             protected:
                 /**
                  * When a subclass handles `seekTo()` and didn't throw an exception, it must call this method to flush
@@ -166,6 +174,21 @@ namespace Nayuki {
                  */
                 void positionChanged(uint_fast64_t pos);
 
+                /**
+                 * When a subclass handles `seekTo()`, it may call this method first to move within the buffered data
+                 * instead of flushing it. If this returns `true`, the seek is done and the underlying stream must stay
+                 * where it is, since the buffered data still ends there.
+                 * @param[in] pos the new position
+                 * @return whether the position was within the buffered data
+                 */
+                bool seekWithinBuffer(uint_fast64_t pos);
+
+                /**
+                 * When a subclass restarts the stream on new data, it must call this method to flush the buffers and
+                 * start again at position 0. Reuses the byte buffer, or allocates a new one if the stream was closed.
+                 */
+                void reopen();
+
                 /**
                  * Reads up to `len` bytes from the underlying byte-based input stream into the given array subrange.
                  * Returns a value in the range [0, `len`] for a successful read, or -1 if the end of stream was
@@ -179,11 +202,19 @@ namespace Nayuki {
 
             public:
                 /**
-                 * Creates a default and empty input stream.
+                 * Creates an empty input stream with the given buffer size, or with an adaptive one which starts at
+                 * the given initial size and grows with the frame size of the stream (see `adaptBufferSize()`). The
+                 * adaptive sizes suit the storage type of the subclass: e.g. a file read by system calls benefits
+                 * from larger reads than an array in memory.
+                 * @param[in] bufferSize    the buffer size in bytes, in the range [`MIN_BUFFER_SIZE`,
+                 * `MAX_BUFFER_SIZE`], or 0 for an adaptive size
+                 * @param[in] initialSize   the adaptive buffer size before the frame size is known, in bytes
+                 * @param[in] adaptiveLimit the largest adaptive buffer size, in bytes, at least `initialSize`
                  */
-                AbstractFlacLowLevelInput();
+                explicit AbstractFlacLowLevelInput(size_t bufferSize = 0, size_t initialSize = 4096,
+                                                   size_t adaptiveLimit = 65536);
 
-                virtual ~AbstractFlacLowLevelInput() = default;
+                virtual ~AbstractFlacLowLevelInput();
 
                 virtual uint_fast64_t getPosition();
 
@@ -200,6 +231,12 @@ namespace Nayuki {
 
                 virtual void readFully(uint_fast8_t b[], uint_fast64_t length);
 
+                virtual const uint_fast8_t *peekBytes(size_t n, size_t *available);
+
+                virtual uint_fast32_t peekBits(uint_fast8_t n);
+
+                virtual void skipBytes(uint_fast64_t n);
+
                 virtual void resetCrcs();
 
                 virtual uint_fast8_t getCrc8();
@@ -207,6 +244,23 @@ namespace Nayuki {
                 virtual uint_fast16_t getCrc16();
 
                 virtual void close();
+
+                virtual Common::MemoryAccount *getMemory();
+
+                virtual size_t getBufferSize();
+
+                virtual void setBufferSize(size_t size);
+
+                /**
+                 * Grows an adaptive buffer to the smallest power of 2 holding two maximum-size frames, so that most
+                 * frames are read contiguously and whole, within the adaptive limit of the constructor.
+                 * @param[in] maxFrameSize the maximum frame size in bytes, or 0 if unknown
+                 */
+                virtual void adaptBufferSize(uint_fast32_t maxFrameSize);
+
+#ifdef NAYUKI_STATS
+                virtual InputStats *getStats();
+#endif
             };
         }
     }
@@ -0,0 +1,307 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "BatchDecoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <stdexcept>
+
+#include "ByteArrayFlacInput.h"
+#include "DataFormatException.h"
+#include "FrameDecoder.h"
+
+#include "../common/FrameInfo.h"
+#include "../common/SampleFormat.h"
+#include "../common/StreamInfo.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Decode {
+            namespace {
+                /**
+                 * The placeholder data of an idle worker's input stream.
+                 */
+                const uint_fast8_t NO_DATA[1] = {0};
+
+                /**
+                 * The length of the payload of a stream info metadata block, in bytes.
+                 */
+                const uint_fast32_t STREAM_INFO_LENGTH = 34;
+            }
+
+            class BatchDecoder::Worker final {
+            public:
+                /**
+                 * The account the state of this worker is charged to. Not a child of the batch decoder's account,
+                 * because workers allocate concurrently; `decode()` transfers the total afterwards.
+                 */
+                Common::MemoryAccount memory;
+
+                /**
+                 * The input stream, restarted at the start of every clip.
+                 */
+                ByteArrayFlacInput input;
+
+                /**
+                 * The frame decoder, whose expected sample depth is updated for every clip.
+                 */
+                FrameDecoder frameDec;
+
+                /**
+                 * The samples of the most recently decoded frame, with 65536 samples per channel.
+                 */
+                Common::PlanarBuffer<int_fast32_t> samples;
+
+                /**
+                 * The header of the most recently decoded frame.
+                 */
+                Common::FrameInfo frameInfo;
+
+                /**
+                 * The contents of the most recently read clip file. Only grows.
+                 */
+                std::vector<uint_fast8_t> fileData;
+
+                /**
+                 * Constructs a worker whose input stream has no data yet.
+                 */
+                Worker() : input(NO_DATA, 0), frameDec(&input, 16, 4608), samples(&memory) {
+                    input.getMemory()->setParent(&memory);
+                    frameDec.getMemory()->setParent(&memory);
+                }
+
+                /**
+                 * Returns the number of bytes this worker occupies on the heap.
+                 * @return the size of the state in bytes
+                 */
+                uint_fast64_t getBytes() const {
+                    return sizeof(Worker) + memory.getCurrentBytes() + fileData.capacity();
+                }
+
+                /**
+                 * Reads the given file into `fileData`, reusing its capacity.
+                 * @param[in] path the path of the file
+                 */
+                void readFile(const std::string &path) {
+                    std::ifstream file(path, std::ios::in | std::ios::binary);
+                    if (!file.is_open())
+                        throw std::runtime_error("Cannot open file: " + path);
+                    file.seekg(0, std::ios::end);
+                    std::streamoff length = file.tellg();
+                    if (length < 0)
+                        throw std::runtime_error("Cannot determine file length");
+                    file.seekg(0, std::ios::beg);
+                    fileData.resize((size_t)length);
+                    file.read(reinterpret_cast<char *>(fileData.data()), length);
+                    if (file.gcount() != length)
+                        throw std::runtime_error("Read failed");
+                }
+            };
+
+            BatchDecoder::Clip::Clip(const uint_fast8_t *data, uint_fast64_t length) : data(data), length(length) {
+                if (data == nullptr)
+                    throw std::invalid_argument("FLAC data array cannot be null");
+            }
+
+            BatchDecoder::Clip::Clip(std::string path) : data(nullptr), length(0), path(std::move(path)) {
+                // Nothing extra to do
+            }
+
+            BatchDecoder::BatchDecoder(int_fast32_t numChannels, uint_fast32_t targetLength, Common::ThreadPool *pool)
+                    : tensor(&memory) {
+                if (numChannels < 1 || numChannels > 8)
+                    throw std::invalid_argument("Invalid number of channels");
+                if (targetLength < 1)
+                    throw std::invalid_argument("Invalid target length");
+                this->numChannels = numChannels;
+                this->targetLength = targetLength;
+                this->pool = pool;
+                batchSize = 0;
+                workersCharged = 0;
+            }
+
+            BatchDecoder::~BatchDecoder() {
+                for (Worker *worker : workers)
+                    delete worker;
+                memory.release(workersCharged);
+            }
+
+            void BatchDecoder::decode(const std::vector<Clip> &clips) {
+                if (clips.empty())
+                    throw std::invalid_argument("Empty batch");
+                size_t tensorLength = clips.size() * numChannels * targetLength;
+                if (tensor.getNumChannels() == 0 || tensor.getCapacity() < tensorLength)
+                    tensor.reserve(1, tensorLength);
+                batchSize = clips.size();
+                lengths.assign(batchSize, 0);
+
+                // Every task owns one worker and takes the next undecoded clip until none are left, so that slow
+                // clips do not hold up the others. A failed clip is zeroed, and the error of the first failed clip
+                // is thrown once all clips are done.
+                size_t numTasks = std::min(clips.size(), pool != nullptr ? (size_t)pool->getSize() : (size_t)1);
+                while (workers.size() < numTasks)
+                    workers.push_back(new Worker());
+                std::vector<size_t> errorIndices(numTasks, clips.size());
+                std::vector<std::exception_ptr> errors(numTasks);
+                std::atomic<size_t> next(0);
+                {
+                    Common::ThreadPool::TaskGroup group(pool);
+                    for (size_t i = 0; i < numTasks; i++) {
+                        group.run([this, i, &clips, &next, &errorIndices, &errors]() {
+                            for (size_t index; (index = next.fetch_add(1, std::memory_order_relaxed)) < clips.size();) {
+                                try {
+                                    decodeClip(workers[i], clips[index], index);
+                                } catch (...) {
+                                    std::memset(tensor.getChannel(0) + index * numChannels * targetLength, 0,
+                                                (size_t)numChannels * targetLength * sizeof(float));
+                                    lengths[index] = 0;
+                                    if (errors[i] == nullptr) {
+                                        errorIndices[i] = index;
+                                        errors[i] = std::current_exception();
+                                    }
+                                }
+                            }
+                        });
+                    }
+                    group.wait();
+                }
+                rechargeWorkers();
+                size_t first = (size_t)(std::min_element(errorIndices.begin(), errorIndices.end()) -
+                                        errorIndices.begin());
+                if (errors[first] != nullptr)
+                    std::rethrow_exception(errors[first]);
+            }
+
+            void BatchDecoder::decodeClip(Worker *worker, const Clip &clip, size_t index) {
+                const uint_fast8_t *data = clip.data;
+                uint_fast64_t length = clip.length;
+                if (data == nullptr) {
+                    worker->readFile(clip.path);
+                    data = worker->fileData.data() != nullptr ? worker->fileData.data() : NO_DATA;
+                    length = worker->fileData.size();
+                }
+                ByteArrayFlacInput &in = worker->input;
+                in.reset(data, length);
+
+                // Read the stream info and skip all other metadata blocks
+                if (in.readUint(32) != 0x664C6143)  // Magic string "fLaC"
+                    throw DataFormatException("Invalid magic string");
+                Common::StreamInfo info;
+                bool haveInfo = false;
+                for (bool last = false; !last;) {
+                    last = in.readUint(1) != 0;
+                    int_fast32_t blockType = in.readUint(7);
+                    uint_fast32_t blockLength = in.readUint(24);
+                    if (blockType == 0) {
+                        if (haveInfo)
+                            throw DataFormatException("Duplicate stream info metadata block");
+                        if (blockLength != STREAM_INFO_LENGTH)
+                            throw DataFormatException("Invalid stream info metadata block length");
+                        uint_fast8_t block[STREAM_INFO_LENGTH];
+                        in.readFully(block, STREAM_INFO_LENGTH);
+                        info = Common::StreamInfo(block, STREAM_INFO_LENGTH);
+                        haveInfo = true;
+                    } else {
+                        if (!haveInfo)
+                            throw DataFormatException("Expected stream info metadata block");
+                        uint_fast64_t end = in.getPosition() + blockLength;
+                        if (end > length)
+                            throw DataFormatException("Metadata block extends past the end of the clip");
+                        in.seekTo(end);
+                    }
+                }
+                int_fast32_t clipChannels = info.numChannels;
+                if (clipChannels != numChannels && clipChannels != 1)
+                    throw DataFormatException("Unsupported number of channels in clip");
+                if (worker->samples.getNumChannels() < clipChannels)
+                    worker->samples.reserve(clipChannels, 65536);
+                in.adaptBufferSize(info.maxFrameSize);
+                worker->frameDec.expectedSampleDepth = info.sampleDepth;
+                worker->frameDec.maxFrameSize = info.maxFrameSize;
+
+                // Decode frames straight into the tensor until the clip ends or fills the target length. The channel
+                // assignment of every frame header is peeked at before decoding, so that a frame cannot overflow the
+                // sample buffers.
+                float *dest = tensor.getChannel(0) + index * numChannels * targetLength;
+                int_fast32_t **samples = worker->samples.getChannels();
+                uint_fast32_t pos = 0;
+                while (pos < targetLength) {
+                    size_t available;
+                    const uint_fast8_t *header = in.peekBytes(4, &available);
+                    if (available == 0)
+                        break;
+                    if (available >= 4) {  // Otherwise the frame is truncated, which the frame decoder reports
+                        uint_fast32_t chanAsgn = header[3] >> 4;
+                        if ((chanAsgn < 8 ? chanAsgn + 1 : 2) != (uint_fast32_t)clipChannels)
+                            throw DataFormatException("Channel count mismatch");
+                    }
+                    if (!worker->frameDec.readFrame(samples, 0, &worker->frameInfo))
+                        break;
+                    auto n = std::min((uint_fast32_t)worker->frameInfo.blockSize, targetLength - pos);
+                    for (int_fast32_t ch = 0; ch < numChannels; ch++) {
+                        const int_fast32_t *const src[] = {samples[clipChannels == 1 ? 0 : ch]};
+                        Common::SampleConverter::interleave(src, 1, 0, n, info.sampleDepth,
+                                                            Common::SampleFormat::FLOAT32,
+                                                            dest + ch * targetLength + pos);
+                    }
+                    pos += n;
+                }
+                for (int_fast32_t ch = 0; ch < numChannels; ch++)
+                    std::memset(dest + ch * targetLength + pos, 0, (targetLength - pos) * sizeof(float));
+                lengths[index] = pos;
+            }
+
+            void BatchDecoder::rechargeWorkers() {
+                uint_fast64_t total = 0;
+                for (const Worker *worker : workers)
+                    total += worker->getBytes();
+                if (total > workersCharged)
+                    memory.charge(total - workersCharged);
+                else
+                    memory.release(workersCharged - total);
+                workersCharged = total;
+            }
+
+            const float *BatchDecoder::getSamples() {
+                if (batchSize == 0)
+                    throw std::logic_error("No batch decoded yet");
+                return tensor.getChannel(0);
+            }
+
+            size_t BatchDecoder::getBatchSize() const {
+                return batchSize;
+            }
+
+            uint_fast32_t BatchDecoder::getLength(size_t clip) const {
+                if (clip >= batchSize)
+                    throw std::out_of_range("Clip index out of range");
+                return lengths[clip];
+            }
+
+            const Common::MemoryAccount &BatchDecoder::getMemory() const {
+                return memory;
+            }
+        }
+    }
+}
@@ -0,0 +1,212 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_BATCHDECODER_H
+#define NAYUKI_BATCHDECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../common/MemoryAccount.h"
+#include "../common/PlanarBuffer.h"
+#include "../common/ThreadPool.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Decode {
+            /**
+             * Decodes many short FLAC clips at once into one contiguous tensor of floats, laid out as
+             * `[clip][channel][sample]` with every channel exactly `targetLength` samples long: longer clips are
+             * truncated and shorter ones padded with zeros. The samples are scaled like
+             * `Common::SampleFormat::FLOAT32`. Sample usage:
+             *
+             *     BatchDecoder batch(2, 16000, &Common::ThreadPool::getShared());
+             *     std::vector<BatchDecoder::Clip> clips;
+             *     clips.emplace_back(blob, blobLength);  // In memory, must stay alive during decode()
+             *     clips.emplace_back("clip.flac");       // Read from a file
+             *     batch.decode(clips);
+             *     const float *tensor = batch.getSamples();
+             *
+             * The clips are decoded in parallel on the given pool, each task reusing its own input stream, frame
+             * decoder and sample buffers for clip after clip, and the tensor is reused by the next batch, so a
+             * steady stream of batches allocates nothing per clip. Mono clips are copied into every channel; other
+             * clips must have exactly the batch's number of channels. The MD5 hash of the clips is not checked, and
+             * their sample rates are not converted. Not thread-safe.
+             */
+            class BatchDecoder final {
+            public:
+                /**
+                 * One clip of a batch: either FLAC data in memory, owned by the caller, or the path of a FLAC file.
+                 */
+                class Clip final {
+                public:
+                    /**
+                     * The FLAC data, or `null` if the clip is read from `path`.
+                     */
+                    const uint_fast8_t *data;
+
+                    /**
+                     * The length of `data` in bytes.
+                     */
+                    uint_fast64_t length;
+
+                    /**
+                     * The path of the FLAC file, used only if `data` is `null`.
+                     */
+                    std::string path;
+
+                    /**
+                     * Constructs a clip of FLAC data in memory.
+                     * @param[in] data   the FLAC data (not `null`), which must stay alive until the batch is decoded
+                     * @param[in] length the length of the data in bytes
+                     */
+                    Clip(const uint_fast8_t *data, uint_fast64_t length);
+
+                    /**
+                     * Constructs a clip read from the given FLAC file.
+                     * @param[in] path the path of the FLAC file
+                     */
+                    explicit Clip(std::string path);
+                };
+
+            private:
+                /**
+                 * The decoding state reused by one task for all the clips it decodes (defined in the implementation
+                 * file).
+                 */
+                class Worker;
+
+                /**
+                 * The number of channels of every clip in the tensor, in the range [1, 8].
+                 */
+                int_fast32_t numChannels;
+
+                /**
+                 * The number of samples of every channel in the tensor, at least 1.
+                 */
+                uint_fast32_t targetLength;
+
+                /**
+                 * The pool decoding the clips, or `null` to decode them on the calling thread.
+                 */
+                Common::ThreadPool *pool;
+
+                /**
+                 * The account the tensor and the state of all workers are charged to.
+                 */
+                Common::MemoryAccount memory;
+
+                /**
+                 * The tensor of the most recent batch, as a single channel. Only grows.
+                 */
+                Common::PlanarBuffer<float> tensor;
+
+                /**
+                 * The number of clips in the most recent batch.
+                 */
+                size_t batchSize;
+
+                /**
+                 * The number of decoded samples per channel of every clip of the most recent batch, before padding.
+                 */
+                std::vector<uint_fast32_t> lengths;
+
+                /**
+                 * The decoding state of every task, one per pool worker, owned by this object.
+                 */
+                std::vector<Worker *> workers;
+
+                /**
+                 * The number of bytes of the workers charged to `memory` so far.
+                 */
+                uint_fast64_t workersCharged;
+
+                /**
+                 * Decodes the given clip into its place in the tensor and records its length.
+                 * @param[in,out] worker the state of the task decoding the clip (not `null`)
+                 * @param[in]     clip   the clip to decode
+                 * @param[in]     index  the index of the clip in the batch
+                 */
+                void decodeClip(Worker *worker, const Clip &clip, size_t index);
+
+                /**
+                 * Charges or releases the difference between the current size of all workers and `workersCharged`.
+                 */
+                void rechargeWorkers();
+
+            public:
+                /**
+                 * Constructs a batch decoder producing tensors of the given shape.
+                 * @param[in]     numChannels  the number of channels per clip, in the range [1, 8]
+                 * @param[in]     targetLength the number of samples per channel, at least 1
+                 * @param[in,out] pool         the pool to decode on, which must outlive this object, or `null` to
+                 * decode on the calling thread
+                 */
+                BatchDecoder(int_fast32_t numChannels, uint_fast32_t targetLength, Common::ThreadPool *pool);
+
+                ~BatchDecoder();
+
+                BatchDecoder(const BatchDecoder &) = delete;
+
+                BatchDecoder &operator=(const BatchDecoder &) = delete;
+
+                /**
+                 * Decodes the given clips into the tensor, replacing the previous batch.
+                 * @param[in] clips the clips to decode, at least one
+                 * @throws std::runtime_error if a clip cannot be read, is not valid FLAC (`DataFormatException`) or
+                 * has an unsupported number of channels; the error of the first such clip is thrown after all other
+                 * clips were decoded, and failed clips are left zeroed with a length of 0
+                 */
+                void decode(const std::vector<Clip> &clips);
+
+                /**
+                 * Returns the tensor of the most recent batch, `getBatchSize() * numChannels * targetLength` floats
+                 * starting on a 64-byte boundary. Valid until the next call to `decode()`.
+                 * @return the samples of all clips
+                 */
+                const float *getSamples();
+
+                /**
+                 * Returns the number of clips in the most recent batch.
+                 * @return the batch size
+                 */
+                size_t getBatchSize() const;
+
+                /**
+                 * Returns the number of samples per channel decoded for the given clip of the most recent batch, not
+                 * counting the padding; equal to `targetLength` if the clip was truncated.
+                 * @param[in] clip the index of the clip, in the range [0, `getBatchSize()`)
+                 * @return the unpadded length of the clip
+                 */
+                uint_fast32_t getLength(size_t clip) const;
+
+                /**
+                 * Returns the heap usage of the tensor and of the decoding state of all workers.
+                 * @return the memory account of this batch decoder
+                 */
+                const Common::MemoryAccount &getMemory() const;
+            };
+        }
+    }
+}
+
+#endif
@@ -30,12 +30,34 @@
 namespace Nayuki {
     namespace FLAC {
         namespace Decode {
-            ByteArrayFlacInput::ByteArrayFlacInput(uint_fast8_t *b, uint_fast64_t len) : AbstractFlacLowLevelInput() {
+            namespace {
+                /**
+                 * The adaptive buffer size before the frame size is known, in bytes.
+                 */
+                const size_t INITIAL_BUFFER_SIZE = 4096;
+
+                /**
+                 * The largest adaptive buffer size, in bytes.
+                 */
+                const size_t ADAPTIVE_BUFFER_LIMIT = 65536;
+            }
+
+            ByteArrayFlacInput::ByteArrayFlacInput(const uint_fast8_t *b, uint_fast64_t len, size_t bufferSize)
+                    : AbstractFlacLowLevelInput(bufferSize, INITIAL_BUFFER_SIZE, ADAPTIVE_BUFFER_LIMIT) {
+                if (b == nullptr)
+                    throw std::invalid_argument("FLAC data array cannot be null");
+                data = b;
+                length = len;
+                offset = 0;
+            }
+
+            void ByteArrayFlacInput::reset(const uint_fast8_t *b, uint_fast64_t len) {
                 if (b == nullptr)
                     throw std::invalid_argument("FLAC data array cannot be null");
                 data = b;
                 length = len;
                 offset = 0;
+                reopen();
             }
 
             uint_fast64_t ByteArrayFlacInput::getLength() {
@@ -43,6 +65,8 @@ namespace Nayuki {
             }
 
             void ByteArrayFlacInput::seekTo(uint_fast64_t pos) {
+                if (seekWithinBuffer(pos))
+                    return;
                 offset = pos;
                 positionChanged(pos);
             }
@@ -34,7 +34,7 @@ namespace Nayuki {
                 /**
                  * The underlying byte array to read from.
                  */
-                uint_fast8_t *data;
+                const uint_fast8_t *data;
 
                 /**
                  * The length of the underlying byte array.
@@ -51,11 +51,21 @@ namespace Nayuki {
 
             public:
                 /**
-                 * Creates a new FLAC input stream with a given array of bytes.
-                 * @param[in] b   the FLAC data for the input stream as byte array
+                 * Creates a new FLAC input stream with a given array of bytes. The adaptive buffer size stays small,
+                 * since copying from memory gains little from larger chunks.
+                 * @param[in] b          the FLAC data for the input stream as byte array
+                 * @param[in] len        the length of the given FLAC data in bytes
+                 * @param[in] bufferSize the buffer size in bytes, or 0 for an adaptive size
+                 */
+                ByteArrayFlacInput(const uint_fast8_t *b, uint_fast64_t len, size_t bufferSize = 0);
+
+                /**
+                 * Restarts this stream at the beginning of another array of bytes, keeping the internal buffer. Also
+                 * reopens a closed stream.
+                 * @param[in] b   the FLAC data for the input stream as byte array (not `null`)
                  * @param[in] len the length of the given FLAC data in bytes
                  */
-                ByteArrayFlacInput(uint_fast8_t *b, uint_fast64_t len);
+                void reset(const uint_fast8_t *b, uint_fast64_t len);
 
                 virtual uint_fast64_t getLength();
 
@@ -29,7 +29,7 @@
 namespace Nayuki {
     namespace FLAC {
         namespace Decode {
-            class DataFormatException : std::runtime_error {
+            class DataFormatException : public std::runtime_error {
             public:
                 explicit DataFormatException(const std::string& what_arg) : std::runtime_error(what_arg) { }
                 explicit DataFormatException(const char *what_arg) : std::runtime_error(what_arg) { }
@@ -0,0 +1,122 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "DecoderPool.h"
+
+#include <stdexcept>
+
+#include "ByteArrayFlacInput.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Decode {
+            DecoderPool::Lease::Lease(DecoderPool *pool, FlacDecoder *decoder) : pool(pool), decoder(decoder) {
+                // Nothing extra to do
+            }
+
+            DecoderPool::Lease::Lease(Lease &&other) noexcept : pool(other.pool), decoder(other.decoder) {
+                other.pool = nullptr;
+                other.decoder = nullptr;
+            }
+
+            DecoderPool::Lease &DecoderPool::Lease::operator=(Lease &&other) noexcept {
+                if (this != &other) {
+                    if (decoder != nullptr)
+                        pool->release(decoder);
+                    pool = other.pool;
+                    decoder = other.decoder;
+                    other.pool = nullptr;
+                    other.decoder = nullptr;
+                }
+                return *this;
+            }
+
+            DecoderPool::Lease::~Lease() {
+                if (decoder != nullptr)
+                    pool->release(decoder);
+            }
+
+            FlacDecoder *DecoderPool::Lease::get() const {
+                return decoder;
+            }
+
+            FlacDecoder *DecoderPool::Lease::operator->() const {
+                return decoder;
+            }
+
+            FlacDecoder &DecoderPool::Lease::operator*() const {
+                return *decoder;
+            }
+
+            DecoderPool::DecoderPool(size_t maxIdle) : maxIdle(maxIdle), created(0) {
+                // Nothing extra to do
+            }
+
+            DecoderPool::~DecoderPool() {
+                for (FlacDecoder *decoder : idle)
+                    delete decoder;
+            }
+
+            DecoderPool::Lease DecoderPool::acquire(const uint_fast8_t *data, uint_fast64_t length) {
+                if (data == nullptr)
+                    throw std::invalid_argument("FLAC data array cannot be null");
+                FlacDecoder *decoder = nullptr;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!idle.empty()) {
+                        decoder = idle.back();
+                        idle.pop_back();
+                    }
+                }
+                if (decoder == nullptr) {
+                    decoder = new FlacDecoder(new ByteArrayFlacInput(data, length));
+                    std::lock_guard<std::mutex> lock(mutex);
+                    created++;
+                    return Lease(this, decoder);
+                }
+                Lease result(this, decoder);
+                decoder->reset(data, length);  // On failure, the lease still returns the decoder to the pool
+                return result;
+            }
+
+            void DecoderPool::release(FlacDecoder *decoder) {
+                decoder->stopPipeline();  // Its threads must not read the caller's data any longer
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (maxIdle == 0 || idle.size() < maxIdle) {
+                        idle.push_back(decoder);
+                        return;
+                    }
+                }
+                delete decoder;
+            }
+
+            size_t DecoderPool::getIdleCount() {
+                std::lock_guard<std::mutex> lock(mutex);
+                return idle.size();
+            }
+
+            uint_fast64_t DecoderPool::getCreatedCount() {
+                std::lock_guard<std::mutex> lock(mutex);
+                return created;
+            }
+        }
+    }
+}
@@ -0,0 +1,188 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_DECODERPOOL_H
+#define NAYUKI_DECODERPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "FlacDecoder.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Decode {
+            /**
+             * Keeps idle decoders around for reuse, so that decoding many small in-memory FLAC files allocates nothing
+             * once every thread has used a decoder. Sample usage:
+             *
+             *     DecoderPool pool;
+             *     for (each blob) {
+             *         DecoderPool::Lease dec = pool.acquire(blob, blobLength);
+             *         while (dec->readAndHandleMetadataBlock(nullptr, nullptr));
+             *         while (dec->readAudioBlock(samples, 0) > 0) { ... }
+             *     }  // The decoder returns to the pool here
+             *
+             * All methods are thread-safe; every lease must end before the pool is destroyed.
+             */
+            class DecoderPool final {
+            public:
+                /**
+                 * Exclusive use of one pooled decoder, which goes back to the pool when the lease ends. Movable but not
+                 * copyable.
+                 */
+                class Lease final {
+                private:
+                    /**
+                     * The pool to return the decoder to, or `null` if this lease is empty.
+                     */
+                    DecoderPool *pool;
+
+                    /**
+                     * The leased decoder, or `null` if this lease is empty.
+                     */
+                    FlacDecoder *decoder;
+
+                    /**
+                     * Constructs a lease of the given decoder.
+                     * @param[in,out] pool    the pool owning the decoder (not `null`)
+                     * @param[in,out] decoder the decoder (not `null`)
+                     */
+                    Lease(DecoderPool *pool, FlacDecoder *decoder);
+
+                    friend class DecoderPool;
+
+                public:
+                    /**
+                     * Takes over the decoder of the given lease, leaving it empty.
+                     * @param[in,out] other the lease to move from
+                     */
+                    Lease(Lease &&other) noexcept;
+
+                    /**
+                     * Returns the current decoder to the pool and takes over the decoder of the given lease, leaving it
+                     * empty.
+                     * @param[in,out] other the lease to move from
+                     * @return this lease
+                     */
+                    Lease &operator=(Lease &&other) noexcept;
+
+                    Lease(const Lease &) = delete;
+
+                    Lease &operator=(const Lease &) = delete;
+
+                    /**
+                     * Returns the decoder to the pool.
+                     */
+                    ~Lease();
+
+                    /**
+                     * Returns the leased decoder.
+                     * @return the decoder, or `null` if this lease is empty
+                     */
+                    FlacDecoder *get() const;
+
+                    /**
+                     * Returns the leased decoder, which must exist.
+                     * @return the decoder
+                     */
+                    FlacDecoder *operator->() const;
+
+                    /**
+                     * Returns the leased decoder, which must exist.
+                     * @return the decoder
+                     */
+                    FlacDecoder &operator*() const;
+                };
+
+            private:
+                /**
+                 * Guards `idle` and `created`.
+                 */
+                std::mutex mutex;
+
+                /**
+                 * The decoders not leased out, owned by this pool. Most recently returned last, so that the warmest
+                 * one is reused first.
+                 */
+                std::vector<FlacDecoder *> idle;
+
+                /**
+                 * The maximum number of idle decoders to keep, or 0 for no limit.
+                 */
+                size_t maxIdle;
+
+                /**
+                 * The number of decoders constructed so far.
+                 */
+                uint_fast64_t created;
+
+                /**
+                 * Takes back the given decoder, deleting it if there are already `maxIdle` idle decoders.
+                 * @param[in] decoder the decoder to take back (not `null`)
+                 */
+                void release(FlacDecoder *decoder);
+
+            public:
+                /**
+                 * Constructs an empty pool.
+                 * @param[in] maxIdle the maximum number of idle decoders to keep, or 0 for no limit
+                 */
+                explicit DecoderPool(size_t maxIdle = 0);
+
+                /**
+                 * Deletes the idle decoders. No lease may be active anymore.
+                 */
+                ~DecoderPool();
+
+                DecoderPool(const DecoderPool &) = delete;
+
+                DecoderPool &operator=(const DecoderPool &) = delete;
+
+                /**
+                 * Leases a decoder which was reset to the given FLAC data (see `FlacDecoder::reset()`), reusing an idle
+                 * one if possible.
+                 * @param[in] data   the FLAC data (not `null`), which must stay alive while it is decoded
+                 * @param[in] length the length of the data in bytes
+                 * @return the lease of the decoder, positioned right after the magic string
+                 * @throws DataFormatException if the data does not start with the FLAC magic string
+                 */
+                Lease acquire(const uint_fast8_t *data, uint_fast64_t length);
+
+                /**
+                 * Returns the number of idle decoders.
+                 * @return the number of decoders not leased out
+                 */
+                size_t getIdleCount();
+
+                /**
+                 * Returns the number of decoders this pool constructed so far, which stops growing once there are
+                 * enough for all concurrent users.
+                 * @return the number of decoders created
+                 */
+                uint_fast64_t getCreatedCount();
+            };
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,408 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#include "FlacDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "AbstractFlacLowLevelInput.h"
+#include "ByteArrayFlacInput.h"
+#include "DataFormatException.h"
+#include "FrameBoundaryFinder.h"
+#include "SeekableFileFlacInput.h"
+
+#include "../common/Probes.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Decode {
+            FlacDecoder::FlacDecoder(const std::string &path) : FlacDecoder(new SeekableFileFlacInput(path)) {
+                // Nothing extra to do
+            }
+
+            FlacDecoder::FlacDecoder(FlacLowLevelInput *in) : seekBuffer(&memory), interleaveBuffer(&memory) {
+                if (in == nullptr)
+                    throw std::invalid_argument("Input stream cannot be null");
+                input = in;
+                if (input->getMemory() != nullptr)
+                    input->getMemory()->setParent(&memory);
+                metadataEndPos = -1;
+                frameDec = nullptr;
+                pipeline = nullptr;
+                streamInfo = nullptr;
+                seekTable = nullptr;
+                try {
+                    readMagic();
+                } catch (...) {
+                    close();
+                    throw;
+                }
+            }
+
+            FlacDecoder::~FlacDecoder() {
+                close();
+            }
+
+            void FlacDecoder::reset(FlacLowLevelInput *in) {
+                if (in == nullptr)
+                    throw std::invalid_argument("Input stream cannot be null");
+                if (in != input) {
+                    if (input != nullptr) {
+                        input->close();
+                        delete input;
+                    }
+                    input = in;
+                    if (input->getMemory() != nullptr)
+                        input->getMemory()->setParent(&memory);
+                }
+                restart();
+            }
+
+            void FlacDecoder::reset(const uint_fast8_t *data, uint_fast64_t length) {
+                auto *byteInput = dynamic_cast<ByteArrayFlacInput *>(input);
+                if (byteInput != nullptr) {
+                    byteInput->reset(data, length);
+                    restart();
+                } else
+                    reset(new ByteArrayFlacInput(data, length));
+            }
+
+            void FlacDecoder::restart() {
+                delete pipeline;
+                pipeline = nullptr;
+                metadataEndPos = -1;
+                streamInfo = nullptr;
+                if (seekTable != nullptr)
+                    memory.release(getSeekTableBytes());
+                delete seekTable;
+                seekTable = nullptr;
+                readMagic();
+            }
+
+            void FlacDecoder::readMagic() {
+                if (input->readUint(32) != 0x664C6143)  // Magic string "fLaC"
+                    throw DataFormatException("Invalid magic string");
+            }
+
+            bool FlacDecoder::readAndHandleMetadataBlock(int_fast32_t *type, std::vector<uint_fast8_t> *data) {
+                if (input == nullptr)
+                    throw std::logic_error("Decoder is closed");
+                if (metadataEndPos != -1)
+                    return false;  // All metadata already consumed
+
+                // Read entire block
+                bool last = input->readUint(1) != 0;
+                int_fast32_t blockType = input->readUint(7);
+                uint_fast32_t length = input->readUint(24);
+                metadataBuffer.resize(length);
+                input->readFully(metadataBuffer.data(), length);
+                NAYUKI_PROBE3(metadata_block, blockType, length, last);
+
+                // Handle recognized block
+                if (blockType == 0) {
+                    if (streamInfo != nullptr)
+                        throw DataFormatException("Duplicate stream info metadata block");
+                    streamInfoData = Common::StreamInfo(metadataBuffer.data(), length);
+                    streamInfo = &streamInfoData;
+                } else {
+                    if (streamInfo == nullptr)
+                        throw DataFormatException("Expected stream info metadata block");
+                    if (blockType == 3) {
+                        if (seekTable != nullptr)
+                            throw DataFormatException("Duplicate seek table metadata block");
+                        seekTable = new Common::SeekTable(metadataBuffer);
+                        memory.charge(getSeekTableBytes());
+                    }
+                }
+
+                if (last) {
+                    metadataEndPos = (int_fast64_t)input->getPosition();
+                    input->adaptBufferSize(streamInfo->maxFrameSize);
+                    if (frameDec == nullptr) {
+                        frameDec = new FrameDecoder(input, streamInfo->sampleDepth, streamInfo->maxBlockSize);
+                        frameDec->getMemory()->setParent(&memory);
+                    } else {  // Reused after a reset
+                        frameDec->in = input;
+                        frameDec->expectedSampleDepth = streamInfo->sampleDepth;
+                    }
+                    frameDec->maxFrameSize = streamInfo->maxFrameSize;
+                }
+                if (type != nullptr)
+                    *type = blockType;
+                if (data != nullptr)
+                    data->assign(metadataBuffer.begin(), metadataBuffer.end());
+                return true;
+            }
+
+            int_fast32_t FlacDecoder::readAudioBlock(int_fast32_t *samples[], uint_fast32_t off) {
+                if (metadataEndPos == -1)
+                    throw std::logic_error("Metadata blocks not fully consumed yet");
+                if (pipeline != nullptr && pipeline->isRunning())
+                    return pipeline->readAudioBlock(samples, off, &frameInfo);
+                if (!frameDec->readFrame(samples, off, &frameInfo))
+                    return 0;
+                return frameInfo.blockSize;  // In the range [1, 65536]
+            }
+
+            int_fast32_t FlacDecoder::readInterleavedBlock(Common::SampleFormat format, void *out) {
+                if (out == nullptr)
+                    throw std::invalid_argument("Output buffer cannot be null");
+                if (metadataEndPos == -1)
+                    throw std::logic_error("Metadata blocks not fully consumed yet");
+                if (interleaveBuffer.getNumChannels() < streamInfo->numChannels)
+                    interleaveBuffer.reserve(streamInfo->numChannels, 65536);
+                int_fast32_t n = readAudioBlock(interleaveBuffer.getChannels(), 0);
+                Common::SampleConverter::interleave(interleaveBuffer.getChannels(), streamInfo->numChannels, 0,
+                                                    (uint_fast32_t)n, streamInfo->sampleDepth, format, out);
+                return n;
+            }
+
+            int_fast32_t FlacDecoder::seekAndReadAudioBlock(uint_fast64_t pos, int_fast32_t *samples[],
+                                                            uint_fast32_t off) {
+                if (metadataEndPos == -1)
+                    throw std::logic_error("Metadata blocks not fully consumed yet");
+                if (pipeline != nullptr)
+                    pipeline->stop();
+                NAYUKI_PROBE1(seek_start, pos);
+
+                uint_fast64_t samplePos;
+                uint_fast64_t filePos;
+                getBestSeekPoint(pos, &samplePos, &filePos);
+                if (pos - samplePos > 300000) {
+                    if (!seekBySyncAndDecode(pos, &samplePos, &filePos))
+                        return 0;
+                    filePos -= metadataEndPos;
+                }
+                input->seekTo(filePos + metadataEndPos);
+                NAYUKI_PROBE3(seek_done, pos, samplePos, filePos + metadataEndPos);
+
+                uint_fast64_t curPos = samplePos;
+                int_fast32_t numChannels = streamInfo->numChannels;
+                if (seekBuffer.getNumChannels() < numChannels)
+                    seekBuffer.reserve(numChannels, 65536);
+                int_fast32_t **smpl = seekBuffer.getChannels();
+                while (true) {
+                    if (!frameDec->readFrame(smpl, 0, &frameInfo))
+                        return 0;
+                    uint_fast64_t nextPos = curPos + frameInfo.blockSize;
+                    if (nextPos > pos) {
+                        for (int_fast32_t ch = 0; ch < numChannels; ch++)
+                            std::memcpy(samples[ch] + off, smpl[ch] + (pos - curPos),
+                                        (size_t)(nextPos - pos) * sizeof(int_fast32_t));
+                        return (int_fast32_t)(nextPos - pos);
+                    }
+                    curPos = nextPos;
+                }
+            }
+
+            bool FlacDecoder::scanFrame(FrameHandle *handle) {
+                if (handle == nullptr)
+                    throw std::invalid_argument("Frame handle cannot be null");
+                if (metadataEndPos == -1)
+                    throw std::logic_error("Metadata blocks not fully consumed yet");
+                if (pipeline != nullptr && pipeline->isRunning())
+                    throw std::logic_error("Cannot scan frames while the pipeline is running");
+
+                // Look at the frame and the header after it, widening the view until the end of the frame shows
+                size_t want = streamInfo->maxFrameSize != 0 ?
+                        streamInfo->maxFrameSize + FrameBoundaryFinder::MAX_HEADER_SIZE : 4096;
+                size_t available;
+                const uint_fast8_t *bytes = input->peekBytes(want, &available);
+                if (available == 0)
+                    return false;
+                FrameBoundaryFinder::parseHeader(bytes, available, &handle->info);
+                FrameBoundaryFinder finder(handle->info);
+                size_t end;
+                while ((end = finder.find(bytes, available, available < want, nullptr)) == 0) {
+                    if (want >= AbstractFlacLowLevelInput::MAX_BUFFER_SIZE)
+                        throw DataFormatException("Frame too large");
+                    want = std::min(want * 2, (size_t)AbstractFlacLowLevelInput::MAX_BUFFER_SIZE);
+                    bytes = input->peekBytes(want, &available);
+                }
+
+                handle->filePos = input->getPosition();
+                handle->samplePos = getSampleOffset(&handle->info);
+                handle->info.frameSize = (int_fast32_t)end;
+                input->skipBytes(end);
+                return true;
+            }
+
+            int_fast32_t FlacDecoder::decodeFrame(const FrameHandle &handle, int_fast32_t *samples[],
+                                                  uint_fast32_t off) {
+                if (metadataEndPos == -1)
+                    throw std::logic_error("Metadata blocks not fully consumed yet");
+                if (handle.filePos < (uint_fast64_t)metadataEndPos || handle.info.frameSize <= 0)
+                    throw std::invalid_argument("Invalid frame handle");
+                if (pipeline != nullptr)
+                    pipeline->stop();
+
+                // Within the buffered data, which still holds the frame right after scanning it, this seek is cheap
+                input->seekTo(handle.filePos);
+                if (!frameDec->readFrame(samples, off, &frameInfo) ||
+                    input->getPosition() != handle.filePos + handle.info.frameSize)
+                    throw DataFormatException("Frame does not match its handle");
+                return frameInfo.blockSize;
+            }
+
+            void FlacDecoder::startPipeline(Common::ThreadPool *pool) {
+                if (metadataEndPos == -1)
+                    throw std::logic_error("Metadata blocks not fully consumed yet");
+                if (pipeline != nullptr && pipeline->isRunning())
+                    throw std::logic_error("Pipeline already running");
+                delete pipeline;
+                pipeline = nullptr;
+                bool atStart = input->getPosition() == (uint_fast64_t)metadataEndPos;
+                pipeline = new FramePipeline(input, *streamInfo, pool, atStart);
+                pipeline->getMemory()->setParent(&memory);
+            }
+
+            void FlacDecoder::stopPipeline() {
+                if (pipeline != nullptr)
+                    pipeline->stop();
+            }
+
+            const Common::PipelineStats *FlacDecoder::getPipelineStats() const {
+                return pipeline != nullptr ? &pipeline->getStats() : nullptr;
+            }
+
+            void FlacDecoder::getBestSeekPoint(uint_fast64_t pos, uint_fast64_t *samplePos, uint_fast64_t *filePos) {
+                *samplePos = 0;
+                *filePos = 0;
+                if (seekTable != nullptr) {
+                    for (const Common::SeekTable::SeekPoint &p : seekTable->points) {
+                        if (p.sampleOffset <= pos) {
+                            *samplePos = p.sampleOffset;
+                            *filePos = p.fileOffset;
+                        } else
+                            break;
+                    }
+                }
+            }
+
+            bool FlacDecoder::seekBySyncAndDecode(uint_fast64_t pos, uint_fast64_t *samplePos,
+                                                  uint_fast64_t *filePos) {
+                uint_fast64_t start = metadataEndPos;
+                uint_fast64_t end = input->getLength();
+                while (end - start > 100000) {  // Binary search
+                    uint_fast64_t mid = (start + end) >> 1;
+                    uint_fast64_t frameSamplePos;
+                    uint_fast64_t frameFilePos;
+                    if (!getNextFrameOffsets(mid, &frameSamplePos, &frameFilePos) || frameSamplePos > pos)
+                        end = mid;
+                    else
+                        start = frameFilePos;
+                }
+                return getNextFrameOffsets(start, samplePos, filePos);
+            }
+
+            bool FlacDecoder::getNextFrameOffsets(uint_fast64_t filePos, uint_fast64_t *frameSamplePos,
+                                                  uint_fast64_t *frameFilePos) {
+                if (filePos < (uint_fast64_t)metadataEndPos || filePos > input->getLength())
+                    throw std::invalid_argument("File position out of bounds");
+
+                // Repeatedly search for a sync
+                while (true) {
+                    // Scan a buffer's worth of lookahead at a time for the 2-byte sync sequence
+                    input->seekTo(filePos);
+                    size_t available;
+                    const uint_fast8_t *bytes =
+                            input->peekBytes(std::max(input->getBufferSize(), (size_t)2), &available);
+                    if (available < 2)
+                        return false;
+                    const uint_fast8_t *end = bytes + available - 1;
+                    const uint_fast8_t *p = bytes;
+                    while (true) {
+                        p = (const uint_fast8_t *)std::memchr(p, 0xFF, (size_t)(end - p));
+                        if (p == nullptr || (p[1] & 0xFE) == 0xF8)
+                            break;
+                        p++;
+                    }
+                    if (p == nullptr) {
+                        filePos += available - 1;  // The last byte may start a sync
+                        continue;
+                    }
+
+                    // Sync found, try to decode frame header
+                    filePos += p - bytes;
+                    input->seekTo(filePos);
+                    try {
+                        Common::FrameInfo frame;
+                        if (!Common::FrameInfo::readFrame(input, &frame))
+                            return false;
+                        *frameSamplePos = getSampleOffset(&frame);
+                        *frameFilePos = filePos;
+                        return true;
+                    } catch (const DataFormatException &) {
+                        // Advance past the sync and search again
+                        filePos += 2;
+                    }
+                }
+            }
+
+            uint_fast64_t FlacDecoder::getSampleOffset(const Common::FrameInfo *frame) {
+                if (frame->sampleOffset != -1)
+                    return (uint_fast64_t)frame->sampleOffset;
+                else if (frame->frameIndex != -1)
+                    return (uint_fast64_t)frame->frameIndex * streamInfo->maxBlockSize;
+                else
+                    throw std::logic_error("Frame has neither a sample offset nor a frame index");
+            }
+
+            InputStats *FlacDecoder::getStats() {
+                return input != nullptr ? input->getStats() : nullptr;
+            }
+
+            const Common::MemoryAccount &FlacDecoder::getMemory() const {
+                return memory;
+            }
+
+            uint_fast64_t FlacDecoder::getSeekTableBytes() const {
+                return sizeof(Common::SeekTable) + seekTable->points.capacity() * sizeof(Common::SeekTable::SeekPoint);
+            }
+
+            void FlacDecoder::close() {
+                if (input != nullptr) {
+                    delete pipeline;
+                    pipeline = nullptr;
+                    metadataEndPos = -1;
+                    streamInfo = nullptr;
+                    if (seekTable != nullptr)
+                        memory.release(getSeekTableBytes());
+                    delete seekTable;
+                    seekTable = nullptr;
+                    seekBuffer.clear();
+                    interleaveBuffer.clear();
+                    metadataBuffer.clear();
+                    metadataBuffer.shrink_to_fit();
+                    delete frameDec;
+                    frameDec = nullptr;
+                    input->close();
+                    delete input;
+                    input = nullptr;
+                }
+            }
+        }
+    }
+}
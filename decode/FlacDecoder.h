@@ -0,0 +1,352 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#ifndef NAYUKI_FLACDECODER_H
+#define NAYUKI_FLACDECODER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "FlacLowLevelInput.h"
+#include "FrameDecoder.h"
+#include "FrameHandle.h"
+#include "FramePipeline.h"
+
+#include "../common/PipelineStats.h"
+#include "../common/PlanarBuffer.h"
+#include "../common/SampleFormat.h"
+#include "../common/SeekTable.h"
+#include "../common/StreamInfo.h"
+#include "../common/ThreadPool.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Decode {
+            /**
+             * Handles high-level decoding and seeking in FLAC files. Also returns metadata blocks. Every object is
+             * stateful, not thread-safe, and needs to be closed. Sample usage:
+             *
+             *     // Create a decoder
+             *     FlacDecoder dec("song.flac");
+             *
+             *     // Make the decoder process all metadata blocks internally.
+             *     // We could capture the returned data for extra processing.
+             *     // We could also look at the decoder's stream info and seek table
+             *     // instead of capturing the returned metadata blocks.
+             *     while (dec.readAndHandleMetadataBlock(nullptr, nullptr));
+             *
+             *     // Decode all audio samples into the buffers,
+             *     // one channel after another, block after block.
+             *     while (dec.readAudioBlock(samples, 0) > 0) { ... }
+             *
+             *     // Or decode them interleaved, e.g. as floats for playback.
+             *     while (dec.readInterleavedBlock(Common::SampleFormat::FLOAT32, frames) > 0) { ... }
+             *
+             *     dec.close();
+             *
+             * Calling `startPipeline()` after the metadata makes `readAudioBlock()` return frames which were read,
+             * decoded and checked against the MD5 hash ahead of time by other threads (see `FramePipeline`).
+             *
+             * Timelines and scrubbing can call `scanFrame()` instead, which lists the frames with their header fields
+             * and byte ranges without decoding any samples, and then `decodeFrame()` on the frames actually needed.
+             *
+             * A decoder can be `reset()` to another stream, keeping its input buffer, frame decoder and sample buffers,
+             * so decoding many small files one after another allocates nothing in steady state (see `DecoderPool`).
+             */
+            class FlacDecoder final {
+            private:
+                /**
+                 * The input stream of the FLAC file, owned by this object. `null` after closing.
+                 */
+                FlacLowLevelInput *input;
+
+                /**
+                 * The byte position right after the last metadata block, or -1 if not all metadata has been read yet.
+                 */
+                int_fast64_t metadataEndPos;
+
+                /**
+                 * The frame decoder, created once all metadata has been read.
+                 */
+                FrameDecoder *frameDec;
+
+                /**
+                 * The account this decoder's buffers and metadata are charged to. Also the parent of the accounts of
+                 * the input stream and the frame decoder.
+                 */
+                Common::MemoryAccount memory;
+
+                /**
+                 * The header of the most recently decoded frame, reused for every frame.
+                 */
+                Common::FrameInfo frameInfo;
+
+                /**
+                 * Scratch space for decoding the frame containing a seek target, with 65536 samples per channel, or
+                 * empty if no seek happened yet.
+                 */
+                Common::PlanarBuffer<int_fast32_t> seekBuffer;
+
+                /**
+                 * Scratch space for the planar samples of `readInterleavedBlock()`, with 65536 samples per channel, or
+                 * empty if it was not called yet.
+                 */
+                Common::PlanarBuffer<int_fast32_t> interleaveBuffer;
+
+                /**
+                 * The storage of `streamInfo`, reused by every stream.
+                 */
+                Common::StreamInfo streamInfoData;
+
+                /**
+                 * The payload of the most recently read metadata block. Only grows until the decoder is closed.
+                 */
+                std::vector<uint_fast8_t> metadataBuffer;
+
+                /**
+                 * The pipeline decoding ahead, or `null` if none was started. Kept after being stopped by a seek, for
+                 * its statistics.
+                 */
+                FramePipeline *pipeline;
+
+                /**
+                 * Checks the magic string at the start of the input stream.
+                 */
+                void readMagic();
+
+                /**
+                 * Forgets the metadata and the pipeline of the previous stream, and reads the magic string of the
+                 * input stream, which must be at the beginning of a FLAC file.
+                 */
+                void restart();
+
+                /**
+                 * Returns the sample offset and the file offset (relative to the end of metadata) of the latest seek
+                 * point at or before the given sample position, or of the stream start.
+                 * @param[in]  pos        the sample position to seek to
+                 * @param[out] samplePos  the sample offset of the seek point
+                 * @param[out] filePos    the file offset of the seek point
+                 */
+                void getBestSeekPoint(uint_fast64_t pos, uint_fast64_t *samplePos, uint_fast64_t *filePos);
+
+                /**
+                 * Binary searches the file for a frame near the given sample position by looking for sync codes.
+                 * @param[in]  pos       the sample position to seek to
+                 * @param[out] samplePos the sample offset of the found frame
+                 * @param[out] filePos   the absolute file offset of the found frame
+                 * @return whether a frame was found
+                 */
+                bool seekBySyncAndDecode(uint_fast64_t pos, uint_fast64_t *samplePos, uint_fast64_t *filePos);
+
+                /**
+                 * Finds the first frame header starting at or after the given file position.
+                 * @param[in]  filePos       the absolute file offset to start searching at
+                 * @param[out] frameSamplePos the sample offset of the found frame
+                 * @param[out] frameFilePos   the absolute file offset of the found frame
+                 * @return whether a frame was found before the end of the file
+                 */
+                bool getNextFrameOffsets(uint_fast64_t filePos, uint_fast64_t *frameSamplePos,
+                                         uint_fast64_t *frameFilePos);
+
+                /**
+                 * Returns the offset of the first sample of the given frame in the stream.
+                 * @param[in] frame the frame header (not `null`)
+                 * @return the sample offset
+                 */
+                uint_fast64_t getSampleOffset(const Common::FrameInfo *frame);
+
+                /**
+                 * Returns the number of bytes the current seek table (not `null`) occupies on the heap.
+                 * @return the size of the seek table in bytes
+                 */
+                uint_fast64_t getSeekTableBytes() const;
+
+            public:
+                /**
+                 * The stream info metadata block of the file, owned by this decoder, or `null` if it has not been read
+                 * yet.
+                 */
+                Common::StreamInfo *streamInfo;
+
+                /**
+                 * The seek table metadata block of the file, or `null` if there is none (or it has not been read yet).
+                 */
+                Common::SeekTable *seekTable;
+
+                /**
+                 * Opens the given FLAC file and reads its magic string, throwing an exception on failure.
+                 * @param[in] path the path of the FLAC file
+                 */
+                explicit FlacDecoder(const std::string &path);
+
+                /**
+                 * Starts decoding from the given input stream, which must be at the beginning of a FLAC file, and
+                 * reads its magic string. The decoder takes ownership of the input stream.
+                 * @param[in] in the input stream to decode (not `null`)
+                 */
+                explicit FlacDecoder(FlacLowLevelInput *in);
+
+                ~FlacDecoder();
+
+                FlacDecoder(const FlacDecoder &) = delete;
+
+                FlacDecoder &operator=(const FlacDecoder &) = delete;
+
+                /**
+                 * Starts decoding another FLAC file from the given input stream, like the constructor but reusing the
+                 * buffers of this decoder. The decoder takes ownership of the input stream, and closes and deletes the
+                 * previous one unless it is the same object (which must then be at the beginning of a FLAC file
+                 * again). Also reopens a closed decoder. If the magic string is invalid, the decoder has to be reset
+                 * again before further use.
+                 * @param[in] in the input stream to decode (not `null`)
+                 */
+                void reset(FlacLowLevelInput *in);
+
+                /**
+                 * Starts decoding another FLAC file from the given bytes, reusing the current input stream if it is a
+                 * `ByteArrayFlacInput` and otherwise replacing it with one (see `reset(FlacLowLevelInput*)`).
+                 * @param[in] data   the FLAC data (not `null`), which must stay alive while it is decoded
+                 * @param[in] length the length of the data in bytes
+                 */
+                void reset(const uint_fast8_t *data, uint_fast64_t length);
+
+                /**
+                 * Reads, handles, and returns the next metadata block. Returns `true` and stores the block's type and
+                 * payload into the given (optional) arguments if the next metadata block exists, otherwise returns
+                 * `false` if the final metadata block was previously read. In addition to reading and returning data,
+                 * this method also updates the internal state of this object to reflect the new data seen, and throws
+                 * exceptions for situations such as not starting with a stream info metadata block or encountering
+                 * duplicates of certain blocks.
+                 * @param[out] type the type of the block (can be `null`)
+                 * @param[out] data the payload of the block (can be `null`)
+                 * @return whether a metadata block was read
+                 */
+                bool readAndHandleMetadataBlock(int_fast32_t *type, std::vector<uint_fast8_t> *data);
+
+                /**
+                 * Reads and decodes the next block of audio samples into the given buffer, returning the number of
+                 * samples in the block. The return value is 0 if the read started at the end of stream, or a number in
+                 * the range [1, 65536] for a normal block. After returning, `samples[i][off]` to
+                 * `samples[i][off + returnValue - 1]` are valid for `i = 0 .. numChannels - 1`.
+                 * @param[out] samples the arrays to store the samples into, one per channel (all not `null`)
+                 * @param[in]  off     the offset in the arrays to store the first sample at
+                 * @return the number of samples per channel that were decoded
+                 */
+                int_fast32_t readAudioBlock(int_fast32_t *samples[], uint_fast32_t off);
+
+                /**
+                 * Reads and decodes the next block of audio samples like `readAudioBlock()`, and converts them to
+                 * interleaved samples of the given format right away, while they are still in the cache (see
+                 * `Common::SampleConverter` for how the samples are scaled).
+                 * @param[in]  format the layout to store the samples in
+                 * @param[out] out    the buffer for up to `65536 * numChannels` samples of the format (not `null`)
+                 * @return the number of samples per channel that were decoded, 0 at the end of the stream
+                 */
+                int_fast32_t readInterleavedBlock(Common::SampleFormat format, void *out);
+
+                /**
+                 * Starts reading and decoding the following frames on other threads, so that `readAudioBlock()` only
+                 * has to copy out the samples. If the pipeline starts at the first frame, the samples are also checked
+                 * against the MD5 hash of the stream info, and `readAudioBlock()` throws a `DataFormatException` at the
+                 * end of the stream if they do not match. Seeking stops the pipeline and continues on the calling
+                 * thread; it can be started again afterwards.
+                 * @param[in,out] pool the pool to decode the frames on, which must outlive the pipeline, or `null` to
+                 * decode them on a single reader thread
+                 */
+                void startPipeline(Common::ThreadPool *pool);
+
+                /**
+                 * Stops the pipeline, if one is running, so that no other thread reads the input stream anymore.
+                 * Since the pipeline has read ahead, decoding can only continue after a seek or a reset.
+                 */
+                void stopPipeline();
+
+                /**
+                 * Returns the per-stage counters of the most recently started pipeline, or `null` if none was started.
+                 * @return the pipeline counters, or `null`
+                 */
+                const Common::PipelineStats *getPipelineStats() const;
+
+                /**
+                 * Seeks to the given sample position and reads audio samples into the given buffer, returning the
+                 * number of samples filled. If audio data is available then the return value is at least 1; otherwise
+                 * 0 is returned to indicate the end of stream. Note that the sample position can land in the middle of
+                 * a FLAC block and will still behave correctly. In theory this method subsumes the functionality of
+                 * `readAudioBlock()`, but seeking can be an expensive operation so `readAudioBlock()` should be used
+                 * for ordinary contiguous streaming.
+                 * @param[in]  pos     the sample position to seek to
+                 * @param[out] samples the arrays to store the samples into, one per channel (all not `null`)
+                 * @param[in]  off     the offset in the arrays to store the first sample at
+                 * @return the number of samples per channel that were decoded
+                 */
+                int_fast32_t seekAndReadAudioBlock(uint_fast64_t pos, int_fast32_t *samples[], uint_fast32_t off);
+
+                /**
+                 * Locates the next frame without decoding its subframes: parses its header, finds its end by
+                 * searching for the next frame header (see `FrameBoundaryFinder`), and moves past it. Repeated calls
+                 * thus list the frames of the stream at a fraction of the cost of decoding them. The frame's samples
+                 * can be decoded later from the handle by `decodeFrame()`. Cannot be called while a pipeline is
+                 * running.
+                 * @param[out] handle the handle to store the frame's header fields and position into (not `null`)
+                 * @return `true` if a frame was found, or `false` at the end of the stream
+                 */
+                bool scanFrame(FrameHandle *handle);
+
+                /**
+                 * Decodes the frame of the given handle, which was returned by `scanFrame()` of this or another
+                 * decoder of the same stream, and checks that it ends where the handle says. Subsequent reads
+                 * continue after that frame. The samples are not added to any MD5 check. Stops the pipeline, if one is
+                 * running.
+                 * @param[in]  handle  the frame to decode
+                 * @param[out] samples the arrays to store the samples into, one per channel (all not `null`)
+                 * @param[in]  off     the offset in the arrays to store the first sample at
+                 * @return the number of samples per channel that were decoded, i.e. the block size of the frame
+                 */
+                int_fast32_t decodeFrame(const FrameHandle &handle, int_fast32_t *samples[], uint_fast32_t off);
+
+                /**
+                 * Returns the hot-path counters of the underlying input stream, which also cover the frames decoded
+                 * from it, or `null` if the stream keeps no counters (always the case unless `NAYUKI_STATS` is
+                 * defined).
+                 * @return the counters of the input stream, or `null`
+                 */
+                InputStats *getStats();
+
+                /**
+                 * Returns the heap usage of this decoder, including its input stream and frame decoder but excluding
+                 * the shared tables (see `Common::MemoryAccount::getShared()`).
+                 * @return the memory account of this decoder
+                 */
+                const Common::MemoryAccount &getMemory() const;
+
+                /**
+                 * Closes the underlying input stream and releases all resources. Idempotent.
+                 */
+                void close();
+            };
+        }
+    }
+}
+
+#endif
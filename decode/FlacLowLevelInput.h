@@ -24,14 +24,19 @@
 #ifndef NAYUKI_FLACLOWLEVELINPUT_H
 #define NAYUKI_FLACLOWLEVELINPUT_H
 
+#include <cstddef>
 #include <cstdint>
 
+#include "InputStats.h"
+
+#include "../common/MemoryAccount.h"
+
 namespace Nayuki {
     namespace FLAC {
         namespace Decode {
             /**
              * A low-level input stream tailored to the needs of FLAC decoding. An overview of methods includes bit
-             * reading, CRC calculation, Rice decoding, and positioning and seeking (partly optional).
+             * reading, lookahead, CRC calculation, Rice decoding, and positioning and seeking (partly optional).
              */
             class FlacLowLevelInput {
             public:
@@ -120,6 +125,33 @@ namespace Nayuki {
                  */
                 virtual void readFully(uint_fast8_t b[], uint_fast64_t length) = 0;
 
+                /**
+                 * Returns a view of the next bytes of the stream without consuming them: the position, the bit
+                 * position and the CRCs stay unchanged. Data is read from the underlying stream as needed to make `n`
+                 * bytes available contiguously. The view stays valid until any other method is called. Must be called
+                 * at a byte boundary (i.e. `getBitPosition() == 0`), otherwise an exception is thrown.
+                 * @param[in]  n         the number of bytes wanted
+                 * @param[out] available the number of bytes in the view, at least `n` unless the stream ends earlier
+                 * @return the view of the next bytes, valid for `*available` bytes
+                 */
+                virtual const uint_fast8_t *peekBytes(size_t n, size_t *available) = 0;
+
+                /**
+                 * Discards the next given number of bytes like `readFully()`, so they are still covered by the CRCs.
+                 * Must be called at a byte boundary (i.e. `getBitPosition() == 0`), otherwise an exception is thrown.
+                 * @param[in] n the number of bytes to skip
+                 */
+                virtual void skipBytes(uint_fast64_t n) = 0;
+
+                /**
+                 * Returns the next given number of bits (`0 <= n <= 32`) as an unsigned integer without consuming them,
+                 * i.e. the value the next `readUint(n)` will return. Unlike `peekBytes()`, this may be called at any
+                 * bit position.
+                 * @param[in] n the number of bits to peek
+                 * @return the next bits as an unsigned integer
+                 */
+                virtual uint_fast32_t peekBits(uint_fast8_t n) = 0;
+
                 /**
                  * Marks the current byte position as the start of both CRC calculations. The effect of `resetCrcs()` is
                  * implied at the beginning of stream and when `seekTo()` is called. Must be called at a byte boundary
@@ -162,6 +194,53 @@ namespace Nayuki {
                  * works correctly on all types.
                  */
                 virtual void close() = 0;
+
+                /**
+                 * Returns the event counters of this stream and of the frames decoded from it, or `null` if they are
+                 * not kept. Counters are only kept in builds with hot-path counters enabled (`NAYUKI_STATS`), and the
+                 * returned object remains owned by this stream.
+                 * @return the counters of this stream, or `null`
+                 */
+                virtual InputStats *getStats() {
+                    return nullptr;
+                }
+
+                /**
+                 * Returns the size of the buffer this stream reads the underlying data into, or 0 if it has none.
+                 * @return the buffer size in bytes, or 0
+                 */
+                virtual size_t getBufferSize() {
+                    return 0;
+                }
+
+                /**
+                 * Changes the size of the buffer this stream reads the underlying data into, keeping the data buffered
+                 * so far, and turns off adaptive sizing (see `adaptBufferSize()`). Streams without a buffer ignore
+                 * this.
+                 * @param[in] size the new buffer size in bytes, within the limits of the implementation
+                 */
+                virtual void setBufferSize(size_t size) {
+                    (void)size;
+                }
+
+                /**
+                 * Tells this stream the largest frame size of the FLAC stream, so that a buffer whose size was not set
+                 * explicitly can grow to hold whole frames. Called by the decoder once it has read the stream info.
+                 * @param[in] maxFrameSize the maximum frame size in bytes (see `Common::StreamInfo::maxFrameSize`), or
+                 * 0 if unknown
+                 */
+                virtual void adaptBufferSize(uint_fast32_t maxFrameSize) {
+                    (void)maxFrameSize;
+                }
+
+                /**
+                 * Returns the account this stream charges its buffers to, or `null` if it does not keep one. The
+                 * returned object remains owned by this stream.
+                 * @return the memory account of this stream, or `null`
+                 */
+                virtual Common::MemoryAccount *getMemory() {
+                    return nullptr;
+                }
             };
         }
     }
@@ -0,0 +1,82 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "FrameBoundaryFinder.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "AbstractFlacLowLevelInput.h"
+#include "ByteArrayFlacInput.h"
+
+#include "../common/Kernels.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Decode {
+            FrameBoundaryFinder::FrameBoundaryFinder(const Common::FrameInfo &header) :
+                    header(header), crc(0), crcPos(0), pos(2) {
+                // Nothing extra to do
+            }
+
+            size_t FrameBoundaryFinder::find(const uint_fast8_t *bytes, size_t length, bool atEnd,
+                                             Common::FrameInfo *next) {
+                const Common::Kernels &kernels = Common::Kernels::get();
+                Common::FrameInfo candidate;
+                while (pos + 1 < length) {
+                    const void *found = std::memchr(bytes + pos, 0xFF, length - 1 - pos);
+                    if (found == nullptr) {
+                        pos = length - 1;  // The last byte may start a sync code
+                        break;
+                    }
+                    pos = static_cast<const uint_fast8_t *>(found) - bytes;
+                    if ((bytes[pos + 1] & 0xFE) == 0xF8) {
+                        crc = kernels.crc16(crc, bytes + crcPos, pos - crcPos);
+                        crcPos = pos;
+                        if (crc == 0) {
+                            if (length - pos < MAX_HEADER_SIZE && !atEnd)
+                                return 0;  // The header may continue past the bytes
+                            try {
+                                if (parseHeader(bytes + pos, length - pos, &candidate) && (header.sampleOffset != -1 ?
+                                        candidate.sampleOffset == header.sampleOffset + header.blockSize :
+                                        candidate.frameIndex == header.frameIndex + 1)) {
+                                    if (next != nullptr)
+                                        *next = candidate;
+                                    return pos;
+                                }
+                            } catch (const std::runtime_error &) {
+                                // Not a frame header after all
+                            }
+                        }
+                    }
+                    pos++;
+                }
+                return atEnd ? length : 0;  // The last frame extends to the end of the stream
+            }
+
+            bool FrameBoundaryFinder::parseHeader(const uint_fast8_t *bytes, size_t length,
+                                                  Common::FrameInfo *result) {
+                // A header is at most `MAX_HEADER_SIZE` bytes, so the smallest buffer suffices
+                ByteArrayFlacInput in(bytes, length, AbstractFlacLowLevelInput::MIN_BUFFER_SIZE);
+                return Common::FrameInfo::readFrame(&in, result);
+            }
+        }
+    }
+}
@@ -0,0 +1,102 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_FRAMEBOUNDARYFINDER_H
+#define NAYUKI_FRAMEBOUNDARYFINDER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../common/FrameInfo.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Decode {
+            /**
+             * Finds where a frame ends in its raw bytes without decoding it. The frame ends at the first following
+             * frame header which continues the sample numbering, such that the CRC-16 of everything before it, which
+             * includes the frame's own CRC-16, is zero. The last frame extends to the end of the stream.
+             *
+             * The search can be resumed: when the bytes seen so far do not settle the end, the caller supplies more
+             * bytes of the same frame and calls `find()` again, which continues where it stopped. Positions are kept
+             * relative to the start of the frame, so the bytes may move between calls.
+             */
+            class FrameBoundaryFinder final {
+            public:
+                /**
+                 * The maximum length of a frame header in bytes, which must be visible to parse one.
+                 */
+                static const size_t MAX_HEADER_SIZE = 16;
+
+            private:
+                /**
+                 * The header of the frame whose end is searched.
+                 */
+                Common::FrameInfo header;
+
+                /**
+                 * The CRC-16 of the frame's bytes before `crcPos`.
+                 */
+                uint_fast16_t crc;
+
+                /**
+                 * The number of bytes at the start of the frame covered by `crc`.
+                 */
+                size_t crcPos;
+
+                /**
+                 * The index of the next byte to check for the start of a sync code.
+                 */
+                size_t pos;
+
+            public:
+                /**
+                 * Starts searching for the end of the frame with the given header.
+                 * @param[in] header the parsed header of the frame
+                 */
+                explicit FrameBoundaryFinder(const Common::FrameInfo &header);
+
+                /**
+                 * Continues searching for the end of the frame in the given bytes.
+                 * @param[in]  bytes  the bytes of the frame seen so far, starting at its sync code, followed by any
+                 *                    bytes after it (not `null`); same as in the previous calls, but possibly longer
+                 * @param[in]  length the number of bytes, at least as many as in the previous call
+                 * @param[in]  atEnd  whether the stream ends after these bytes
+                 * @param[out] next   the header of the following frame if one ends this frame, or `null` if not needed
+                 * @return the size of the frame in bytes, which is `length` if the frame extends to the end of the
+                 * stream, or 0 if more bytes are needed to decide
+                 */
+                size_t find(const uint_fast8_t *bytes, size_t length, bool atEnd, Common::FrameInfo *next);
+
+                /**
+                 * Parses the frame header at the start of the given bytes, which must include `MAX_HEADER_SIZE` bytes
+                 * unless the stream ends earlier.
+                 * @param[in]  bytes  the bytes starting at the header (not `null`)
+                 * @param[in]  length the number of bytes
+                 * @param[out] result the parsed header (not `null`)
+                 * @return `true` if a header was parsed, or `false` if `length` is 0
+                 */
+                static bool parseHeader(const uint_fast8_t *bytes, size_t length, Common::FrameInfo *result);
+            };
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,477 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#include "FrameDecoder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+#include "DataFormatException.h"
+
+#include "../common/Kernels.h"
+#include "../common/Probes.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Decode {
+            const int_fast32_t FrameDecoder::FIXED_PREDICTION_COEFFICIENTS[5][4] = {
+                {},
+                {1},
+                {2, -1},
+                {3, -3, 1},
+                {4, -6, 4, -1}
+            };
+
+            /**
+             * Checks and stores the decoded channels of a frame for streams of one sample depth, which is a
+             * compile-time constant. The depths of the common stream configurations are narrow enough that stereo
+             * decorrelation runs exactly on 32-bit values, and the range checks are folded into a flag instead of a
+             * branch per sample, so the compiler can vectorize every loop.
+             */
+            class FrameDecoder::Specialization final {
+            public:
+                /**
+                 * The bit depth of the streams this stage is compiled for.
+                 */
+                int_fast32_t sampleDepth;
+
+                /**
+                 * Checks and stores the samples of an independently coded channel.
+                 * @param[in]  in        the decoded samples (not `null`)
+                 * @param[out] out       the array to store the samples into (not `null`)
+                 * @param[in]  blockSize the number of samples
+                 * @return `false` if a sample does not fit the bit depth, `true` otherwise
+                 */
+                bool (*storeChannel)(const int_fast64_t in[], int_fast32_t out[], int_fast32_t blockSize);
+
+                /**
+                 * Undoes the stereo decorrelation of a frame, then checks and stores both channels.
+                 * @param[in]  chanAsgn  the channel assignment, in the range [8, 10]
+                 * @param[in]  in0       the decoded samples of the first subframe (not `null`)
+                 * @param[in]  in1       the decoded samples of the second subframe (not `null`)
+                 * @param[out] outLeft   the array to store the left channel into (not `null`)
+                 * @param[out] outRight  the array to store the right channel into (not `null`)
+                 * @param[in]  blockSize the number of samples
+                 * @return `false` if a sample does not fit the bit depth, `true` otherwise
+                 */
+                bool (*storeStereo)(int_fast32_t chanAsgn, const int_fast64_t in0[], const int_fast64_t in1[],
+                                    int_fast32_t outLeft[], int_fast32_t outRight[], int_fast32_t blockSize);
+
+                /**
+                 * Returns the output stage for the given stream bit depth.
+                 * @param[in] sampleDepth the bit depth of the stream
+                 * @return the output stage, or `null` if the depth only has the generic path
+                 */
+                static const Specialization *select(int_fast32_t sampleDepth);
+            };
+
+            namespace {
+                /**
+                 * Returns a nonzero value if the given value does not fit into a signed `Depth`-bit integer, and zero
+                 * otherwise. The value must be less than 2^31 - 2^(`Depth` - 1) in magnitude.
+                 * @tparam Depth the bit depth, in the range [1, 31]
+                 */
+                template<int_fast32_t Depth>
+                uint32_t exceedsDepth(int32_t val) {
+                    return ((uint32_t)val + ((uint32_t)1 << (Depth - 1))) >> Depth;
+                }
+
+                /**
+                 * Implements `FrameDecoder::Specialization::storeChannel` for streams of `Depth` bits.
+                 * @tparam Depth the bit depth of the stream, in the range [1, 32]
+                 */
+                template<int_fast32_t Depth>
+                bool storeIndependent(const int_fast64_t in[], int_fast32_t out[], int_fast32_t blockSize) {
+                    uint_fast64_t excess = 0;
+                    for (int_fast32_t i = 0; i < blockSize; i++) {
+                        excess |= ((uint_fast64_t)in[i] + ((uint_fast64_t)1 << (Depth - 1))) >> Depth;
+                        out[i] = (int_fast32_t)in[i];
+                    }
+                    return excess == 0;
+                }
+
+                /**
+                 * Implements `FrameDecoder::Specialization::storeStereo` for streams of `Depth` bits. Every subframe
+                 * sample already fits its own depth (checked while decoding it), so side samples fit `Depth + 1` bits
+                 * and no intermediate value exceeds `Depth + 2` bits. A channel that is stored exactly as decoded is
+                 * not checked again.
+                 * @tparam Depth the bit depth of the stream, in the range [1, 28]
+                 */
+                template<int_fast32_t Depth>
+                bool storeDecorrelated(int_fast32_t chanAsgn, const int_fast64_t in0[], const int_fast64_t in1[],
+                                       int_fast32_t outLeft[], int_fast32_t outRight[], int_fast32_t blockSize) {
+                    static_assert(Depth <= 28, "Decorrelated samples must fit 32 bits");
+                    uint32_t excess = 0;
+                    if (chanAsgn == 8) {  // Left-side stereo
+                        for (int_fast32_t i = 0; i < blockSize; i++) {
+                            auto left = (int32_t)in0[i];
+                            int32_t right = left - (int32_t)in1[i];
+                            excess |= exceedsDepth<Depth>(right);
+                            outLeft [i] = left;
+                            outRight[i] = right;
+                        }
+                    } else if (chanAsgn == 9) {  // Side-right stereo
+                        for (int_fast32_t i = 0; i < blockSize; i++) {
+                            auto right = (int32_t)in1[i];
+                            int32_t left = (int32_t)in0[i] + right;
+                            excess |= exceedsDepth<Depth>(left);
+                            outLeft [i] = left;
+                            outRight[i] = right;
+                        }
+                    } else {  // Mid-side stereo
+                        for (int_fast32_t i = 0; i < blockSize; i++) {
+                            auto side = (int32_t)in1[i];
+                            auto mid = (int32_t)((uint32_t)(int32_t)in0[i] << 1) | (side & 1);
+                            int32_t left  = (mid + side) >> 1;
+                            int32_t right = (mid - side) >> 1;
+                            excess |= exceedsDepth<Depth>(left) | exceedsDepth<Depth>(right);
+                            outLeft [i] = left;
+                            outRight[i] = right;
+                        }
+                    }
+                    return excess == 0;
+                }
+            }
+
+            const FrameDecoder::Specialization *FrameDecoder::Specialization::select(int_fast32_t sampleDepth) {
+                static const Specialization SPECIALIZATIONS[] = {
+                    {16, storeIndependent<16>, storeDecorrelated<16>},
+                    {24, storeIndependent<24>, storeDecorrelated<24>}
+                };
+                for (const Specialization &spec : SPECIALIZATIONS) {
+                    if (spec.sampleDepth == sampleDepth)
+                        return &spec;
+                }
+                return nullptr;
+            }
+
+            FrameDecoder::FrameDecoder(FlacLowLevelInput *in, int_fast32_t expectDepth, int_fast32_t maxBlockSize)
+                    : temps(&memory) {
+                if (in == nullptr)
+                    throw std::invalid_argument("Input stream cannot be null");
+                if (expectDepth != -1 && (expectDepth < 1 || expectDepth > 32))
+                    throw std::invalid_argument("Invalid sample depth");
+                if (maxBlockSize < 1 || maxBlockSize > 65536)
+                    throw std::invalid_argument("Invalid maximum block size");
+                this->in = in;
+                expectedSampleDepth = expectDepth;
+                maxFrameSize = 0;
+                specialization = Specialization::select(expectDepth);
+                growTemps(maxBlockSize);
+                currentBlockSize = -1;
+            }
+
+            FrameDecoder::~FrameDecoder() {
+                // Nothing to do, the temporary arrays free themselves
+            }
+
+            Common::MemoryAccount *FrameDecoder::getMemory() {
+                return &memory;
+            }
+
+            Common::FrameInfo *FrameDecoder::readFrame(int_fast32_t *outSamples[], uint_fast32_t outOffset) {
+                auto *meta = new Common::FrameInfo();
+                try {
+                    if (readFrame(outSamples, outOffset, meta))
+                        return meta;
+                } catch (...) {
+                    delete meta;
+                    throw;
+                }
+                delete meta;
+                return nullptr;
+            }
+
+            bool FrameDecoder::readFrame(int_fast32_t *outSamples[], uint_fast32_t outOffset, Common::FrameInfo *meta) {
+                // Check field states
+                if (outSamples == nullptr)
+                    throw std::invalid_argument("Output samples cannot be null");
+                if (currentBlockSize != -1)
+                    throw std::logic_error("Concurrent call");
+
+                // Make the whole frame contiguous in the input buffer, moving a tail that straddles the end of the
+                // buffer to its front, so that the frame is parsed and its CRCs are computed in one piece
+                size_t bufferSize = in->getBufferSize();
+                if (maxFrameSize != 0 && bufferSize != 0) {
+                    in->resetCrcs();  // Releases the bytes before the frame from the buffer
+                    size_t available;
+                    in->peekBytes(std::min((size_t)maxFrameSize, bufferSize), &available);
+                }
+
+                // Parse the frame header to see if one is available
+                uint_fast64_t startByte = in->getPosition();
+                NAYUKI_PROBE1(decode_frame_start, startByte);
+                if (!Common::FrameInfo::readFrame(in, meta))  // EOF occurred cleanly
+                    return false;
+                try {
+                    if (meta->sampleDepth != -1 && meta->sampleDepth != expectedSampleDepth)
+                        throw DataFormatException("Sample depth mismatch");
+
+                    // Do the hard work
+                    currentBlockSize = meta->blockSize;
+                    if ((size_t)currentBlockSize > temps.getCapacity())
+                        growTemps(currentBlockSize);
+                    decodeSubframes(expectedSampleDepth, meta->channelAssignment, outSamples, outOffset);
+
+                    // Read padding and footer
+                    if (in->readUint((uint_fast8_t)((8 - in->getBitPosition()) % 8)) != 0)
+                        throw DataFormatException("Invalid padding bits");
+                    uint_fast16_t computedCrc16 = in->getCrc16();
+                    if (in->readUint(16) != computedCrc16)
+                        throw DataFormatException("CRC-16 mismatch");
+                } catch (...) {
+                    currentBlockSize = -1;
+                    throw;
+                }
+
+                // Handle frame size and miscellaneous
+                uint_fast64_t frameSize = in->getPosition() - startByte;
+                assert(frameSize >= 10);
+                if ((frameSize >> 31) != 0) {
+                    currentBlockSize = -1;
+                    throw DataFormatException("Frame size too large");
+                }
+                meta->frameSize = (int_fast32_t)frameSize;
+                currentBlockSize = -1;
+                NAYUKI_PROBE5(decode_frame_done, meta->frameIndex, meta->sampleOffset, meta->blockSize, startByte,
+                              frameSize);
+                return true;
+            }
+
+            void FrameDecoder::growTemps(int_fast32_t capacity) {
+                temps.reserve(2, (size_t)capacity);
+                temp0 = temps.getChannel(0);
+                temp1 = temps.getChannel(1);
+            }
+
+            void FrameDecoder::decodeSubframes(int_fast32_t sampleDepth, int_fast32_t chanAsgn,
+                                               int_fast32_t *outSamples[], uint_fast32_t outOffset) {
+                if (sampleDepth < 1 || sampleDepth > 32)
+                    throw std::invalid_argument("Invalid sample depth");
+                if (((uint_fast32_t)chanAsgn >> 4) != 0)
+                    throw std::invalid_argument("Invalid channel assignment");
+
+                // The depth is public and may have changed since the specialization was selected
+                const Specialization *spec = specialization;
+                if (spec != nullptr && spec->sampleDepth != sampleDepth)
+                    spec = nullptr;
+
+                if (0 <= chanAsgn && chanAsgn <= 7) {
+                    int_fast32_t numChannels = chanAsgn + 1;
+                    for (int_fast32_t ch = 0; ch < numChannels; ch++) {
+                        decodeSubframe(sampleDepth, temp0);
+                        int_fast32_t *outChan = outSamples[ch];
+                        if (spec != nullptr) {
+                            if (!spec->storeChannel(temp0, outChan + outOffset, currentBlockSize))
+                                throw DataFormatException("Sample value exceeds bit depth");
+                        } else {
+                            for (int_fast32_t i = 0; i < currentBlockSize; i++)
+                                outChan[outOffset + i] = checkBitDepth(temp0[i], sampleDepth);
+                        }
+                    }
+                } else if (8 <= chanAsgn && chanAsgn <= 10) {
+                    decodeSubframe(sampleDepth + (chanAsgn == 9 ? 1 : 0), temp0);
+                    decodeSubframe(sampleDepth + (chanAsgn == 9 ? 0 : 1), temp1);
+
+                    if (spec != nullptr) {
+                        if (!spec->storeStereo(chanAsgn, temp0, temp1, outSamples[0] + outOffset,
+                                               outSamples[1] + outOffset, currentBlockSize))
+                            throw DataFormatException("Sample value exceeds bit depth");
+                    } else {
+                        if (chanAsgn == 8) {  // Left-side stereo
+                            for (int_fast32_t i = 0; i < currentBlockSize; i++)
+                                temp1[i] = temp0[i] - temp1[i];
+                        } else if (chanAsgn == 9) {  // Side-right stereo
+                            for (int_fast32_t i = 0; i < currentBlockSize; i++)
+                                temp0[i] += temp1[i];
+                        } else {  // Mid-side stereo
+                            for (int_fast32_t i = 0; i < currentBlockSize; i++) {
+                                int_fast64_t s = temp1[i];
+                                int_fast64_t m = (int_fast64_t)((uint_fast64_t)temp0[i] << 1) | (s & 1);
+                                temp0[i] = (m + s) >> 1;
+                                temp1[i] = (m - s) >> 1;
+                            }
+                        }
+
+                        int_fast32_t *outLeft  = outSamples[0];
+                        int_fast32_t *outRight = outSamples[1];
+                        for (int_fast32_t i = 0; i < currentBlockSize; i++) {
+                            outLeft [outOffset + i] = checkBitDepth(temp0[i], sampleDepth);
+                            outRight[outOffset + i] = checkBitDepth(temp1[i], sampleDepth);
+                        }
+                    }
+                } else  // 11 <= channelAssignment <= 15
+                    throw DataFormatException("Reserved channel assignment");
+            }
+
+            int_fast32_t FrameDecoder::checkBitDepth(int_fast64_t val, int_fast32_t depth) {
+                assert(1 <= depth && depth <= 32);
+                // Equivalent check: (val >> (depth - 1)) == 0 || (val >> (depth - 1)) == -1
+                if (val >> (depth - 1) == val >> depth)
+                    return (int_fast32_t)val;
+                else
+                    throw DataFormatException("Sample value exceeds bit depth");
+            }
+
+            void FrameDecoder::decodeSubframe(int_fast32_t sampleDepth, int_fast64_t result[]) {
+                if (sampleDepth < 1 || sampleDepth > 33)
+                    throw std::invalid_argument("Invalid sample depth");
+
+                if (in->readUint(1) != 0)
+                    throw DataFormatException("Invalid padding bit");
+                int_fast32_t type = in->readUint(6);
+                int_fast32_t shift = in->readUint(1);  // Also known as "wasted bits-per-sample"
+                if (shift == 1) {
+                    while (in->readUint(1) == 0) {  // Unary coding
+                        if (shift >= sampleDepth)
+                            throw DataFormatException("Waste-bits-per-sample exceeds bit depth");
+                        shift++;
+                    }
+                }
+                assert(0 <= shift && shift <= sampleDepth);
+                sampleDepth -= shift;
+
+                if (type == 0)  // Constant coding
+                    std::fill(result, result + currentBlockSize, readRawSample(sampleDepth));
+                else if (type == 1) {  // Verbatim coding
+                    for (int_fast32_t i = 0; i < currentBlockSize; i++)
+                        result[i] = readRawSample(sampleDepth);
+                } else if (8 <= type && type <= 12)
+                    decodeFixedPredictionSubframe(type - 8, sampleDepth, result);
+                else if (32 <= type && type <= 63)
+                    decodeLinearPredictiveCodingSubframe(type - 31, sampleDepth, result);
+                else
+                    throw DataFormatException("Reserved subframe type");
+                NAYUKI_STAT(
+                    InputStats *stats = in->getStats();
+                    if (stats != nullptr)
+                        stats->subframeTypes[type == 0 ? 0 : type == 1 ? 1 : type < 32 ? 2 : 3]++;
+                );
+
+                // Add trailing zeros to each sample
+                if (shift > 0) {
+                    for (int_fast32_t i = 0; i < currentBlockSize; i++)
+                        result[i] = (int_fast64_t)((uint_fast64_t)result[i] << shift);
+                }
+            }
+
+            int_fast64_t FrameDecoder::readRawSample(int_fast32_t depth) {
+                if (depth <= 32)
+                    return in->readSignedInt((uint_fast8_t)depth);
+                else {  // depth == 33
+                    int_fast64_t high = in->readSignedInt(1);
+                    return (int_fast64_t)((uint_fast64_t)high << 32) | in->readUint(32);
+                }
+            }
+
+            void FrameDecoder::decodeFixedPredictionSubframe(int_fast32_t predOrder, int_fast32_t sampleDepth,
+                                                             int_fast64_t result[]) {
+                if (predOrder < 0 || predOrder > 4)
+                    throw std::invalid_argument("Invalid prediction order");
+                if (sampleDepth < 1 || sampleDepth > 33)
+                    throw std::invalid_argument("Invalid sample depth");
+                if (predOrder > currentBlockSize)
+                    throw DataFormatException("Fixed prediction order exceeds block size");
+
+                for (int_fast32_t i = 0; i < predOrder; i++)  // Non-Rice-coded warm-up samples
+                    result[i] = readRawSample(sampleDepth);
+                readResiduals(predOrder, result);
+                restoreLpc(result, FIXED_PREDICTION_COEFFICIENTS[predOrder], predOrder, sampleDepth, 0);
+            }
+
+            void FrameDecoder::decodeLinearPredictiveCodingSubframe(int_fast32_t lpcOrder, int_fast32_t sampleDepth,
+                                                                    int_fast64_t result[]) {
+                if (lpcOrder < 1 || lpcOrder > 32)
+                    throw std::invalid_argument("Invalid LPC order");
+                if (sampleDepth < 1 || sampleDepth > 33)
+                    throw std::invalid_argument("Invalid sample depth");
+                if (lpcOrder > currentBlockSize)
+                    throw DataFormatException("LPC order exceeds block size");
+
+                for (int_fast32_t i = 0; i < lpcOrder; i++)  // Non-Rice-coded warm-up samples
+                    result[i] = readRawSample(sampleDepth);
+
+                int_fast32_t precision = in->readUint(4) + 1;
+                if (precision == 16)
+                    throw DataFormatException("Invalid LPC precision");
+                int_fast32_t shift = in->readSignedInt(5);
+                if (shift < 0)
+                    throw DataFormatException("Invalid LPC shift");
+
+                int_fast32_t coefs[32];
+                for (int_fast32_t i = 0; i < lpcOrder; i++)
+                    coefs[i] = in->readSignedInt((uint_fast8_t)precision);
+
+                readResiduals(lpcOrder, result);
+                restoreLpc(result, coefs, lpcOrder, sampleDepth, shift);
+            }
+
+            void FrameDecoder::restoreLpc(int_fast64_t result[], const int_fast32_t coefs[], int_fast32_t order,
+                                          int_fast32_t sampleDepth, int_fast32_t shift) {
+                if (sampleDepth < 1 || sampleDepth > 33)
+                    throw std::invalid_argument("Invalid sample depth");
+                if (shift < 0 || shift > 63)
+                    throw std::invalid_argument("Invalid shift");
+                if (!Common::Kernels::get().restoreLpc(result, currentBlockSize, coefs, order, shift, sampleDepth))
+                    throw DataFormatException("Post-LPC result exceeds bit depth");
+            }
+
+            void FrameDecoder::readResiduals(int_fast32_t warmup, int_fast64_t result[]) {
+                if (warmup < 0 || warmup > currentBlockSize)
+                    throw std::invalid_argument("Invalid number of warm-up samples");
+
+                int_fast32_t method = in->readUint(2);
+                if (method >= 2)
+                    throw DataFormatException("Reserved residual coding method");
+                assert(method == 0 || method == 1);
+                uint_fast8_t paramBits = method == 0 ? 4 : 5;
+                int_fast32_t escapeParam = method == 0 ? 0xF : 0x1F;
+
+                int_fast32_t partitionOrder = in->readUint(4);
+                int_fast32_t numPartitions = 1 << partitionOrder;
+                if (currentBlockSize % numPartitions != 0)
+                    throw DataFormatException("Block size not divisible by number of Rice partitions");
+                int_fast32_t inc = currentBlockSize >> partitionOrder;
+                if (inc < warmup)
+                    throw DataFormatException("First Rice partition is shorter than the warm-up samples");
+                for (int_fast32_t partEnd = inc, resultIndex = warmup; partEnd <= currentBlockSize; partEnd += inc) {
+                    int_fast32_t param = in->readUint(paramBits);
+                    if (param == escapeParam) {
+                        auto numBits = (uint_fast8_t)in->readUint(5);
+                        NAYUKI_STAT(
+                            InputStats *stats = in->getStats();
+                            if (stats != nullptr)
+                                stats->escapedPartitions++;
+                        );
+                        for (; resultIndex < partEnd; resultIndex++)
+                            result[resultIndex] = in->readSignedInt(numBits);
+                    } else {
+                        in->readRiceSignedInts(param, result, resultIndex, partEnd);
+                        resultIndex = partEnd;
+                    }
+                }
+            }
+        }
+    }
+}
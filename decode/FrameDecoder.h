@@ -0,0 +1,236 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#ifndef NAYUKI_FRAMEDECODER_H
+#define NAYUKI_FRAMEDECODER_H
+
+#include <cstdint>
+
+#include "FlacLowLevelInput.h"
+
+#include "../common/FrameInfo.h"
+#include "../common/PlanarBuffer.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Decode {
+            /**
+             * Decodes a FLAC frame from an input stream into raw audio samples. Note that these objects are stateful
+             * and not thread-safe, due to the bit input stream field, private temporary arrays, etc. This class only
+             * uses memory and has no native resources; however, the code that manipulates the bit input stream is
+             * responsible for cleaning up that object.
+             */
+            class FrameDecoder final {
+            private:
+                /**
+                 * The coefficients of the fixed predictors, indexed by order.
+                 */
+                static const int_fast32_t FIXED_PREDICTION_COEFFICIENTS[5][4];
+
+                /**
+                 * The output stage compiled for one common stream configuration (defined in the implementation file).
+                 */
+                class Specialization;
+
+                /**
+                 * The output stage for the sample depth the decoder was constructed with, or `null` if that depth has
+                 * none and every frame takes the generic path.
+                 */
+                const Specialization *specialization;
+
+                /**
+                 * The account the temporary arrays are charged to.
+                 */
+                Common::MemoryAccount memory;
+
+                /**
+                 * Temporary storage with two channels, each at least as long as the current block. Sized initially
+                 * for the maximum block size the decoder was constructed with, and only grows if a frame exceeds it.
+                 */
+                Common::PlanarBuffer<int_fast64_t> temps;
+
+                /**
+                 * Channel 0 of `temps`: the samples of the first channel of a stereo pair, and of all channels that are
+                 * decoded independently.
+                 */
+                int_fast64_t *temp0;
+
+                /**
+                 * Channel 1 of `temps`: the samples of the second channel of a stereo pair.
+                 */
+                int_fast64_t *temp1;
+
+                /**
+                 * The block size of the frame currently being decoded, or -1 if no call to `readFrame()` is active.
+                 */
+                int_fast32_t currentBlockSize;
+
+                /**
+                 * Reads all the subframes of a frame with the given channel assignment, undoes stereo decorrelation,
+                 * and stores the samples into the given output arrays.
+                 * @param[in]  sampleDepth the bit depth of the stream, in the range [1, 32]
+                 * @param[in]  chanAsgn    the channel assignment of the frame, a `uint4` value
+                 * @param[out] outSamples  the arrays to store the samples into, one per channel
+                 * @param[in]  outOffset   the offset in the output arrays to store the first sample at
+                 */
+                void decodeSubframes(int_fast32_t sampleDepth, int_fast32_t chanAsgn, int_fast32_t *outSamples[],
+                                     uint_fast32_t outOffset);
+
+                /**
+                 * Checks that the given value fits into a signed integer of the given bit depth, throwing an exception
+                 * otherwise.
+                 * @param[in] val   the value to check
+                 * @param[in] depth the bit depth, in the range [1, 32]
+                 * @return the value, narrowed to a 32-bit type
+                 */
+                static int_fast32_t checkBitDepth(int_fast64_t val, int_fast32_t depth);
+
+                /**
+                 * Reads one subframe (including wasted bits) into the given array.
+                 * @param[in]  sampleDepth the bit depth of the subframe, in the range [1, 33]
+                 * @param[out] result      the array to store `currentBlockSize` samples into
+                 */
+                void decodeSubframe(int_fast32_t sampleDepth, int_fast64_t result[]);
+
+                /**
+                 * Reads a warm-up sample or an unencoded sample as a signed integer of the given bit depth.
+                 * @param[in] depth the bit depth, in the range [0, 33]
+                 * @return the read sample value
+                 */
+                int_fast64_t readRawSample(int_fast32_t depth);
+
+                /**
+                 * Reads the body of a fixed prediction subframe into the given array.
+                 * @param[in]  predOrder   the prediction order, in the range [0, 4]
+                 * @param[in]  sampleDepth the bit depth of the subframe, in the range [1, 33]
+                 * @param[out] result      the array to store `currentBlockSize` samples into
+                 */
+                void decodeFixedPredictionSubframe(int_fast32_t predOrder, int_fast32_t sampleDepth,
+                                                   int_fast64_t result[]);
+
+                /**
+                 * Reads the body of a linear predictive coding subframe into the given array.
+                 * @param[in]  lpcOrder    the prediction order, in the range [1, 32]
+                 * @param[in]  sampleDepth the bit depth of the subframe, in the range [1, 33]
+                 * @param[out] result      the array to store `currentBlockSize` samples into
+                 */
+                void decodeLinearPredictiveCodingSubframe(int_fast32_t lpcOrder, int_fast32_t sampleDepth,
+                                                          int_fast64_t result[]);
+
+                /**
+                 * Updates the values of the given array (which holds the warm-up samples followed by the residuals) by
+                 * applying linear prediction with the given coefficients, checking that each result fits into the
+                 * given bit depth. The products fit into a signed `int54` because the residuals are at most `int53`
+                 * (see `FlacLowLevelInput::readRiceSignedInts()`) and the samples are at most `int33`.
+                 * @param[in,out] result      the warm-up samples and residuals, replaced by the samples
+                 * @param[in]     coefs       the predictor coefficients (not `null`)
+                 * @param[in]     order       the number of coefficients
+                 * @param[in]     sampleDepth the bit depth of the subframe, in the range [1, 33]
+                 * @param[in]     shift       the right shift applied to the prediction sum, in the range [0, 63]
+                 */
+                void restoreLpc(int_fast64_t result[], const int_fast32_t coefs[], int_fast32_t order,
+                                int_fast32_t sampleDepth, int_fast32_t shift);
+
+                /**
+                 * Replaces the temporary arrays with new ones of the given length.
+                 * @param[in] capacity the new length, in the range [1, 65536]
+                 */
+                void growTemps(int_fast32_t capacity);
+
+                /**
+                 * Reads the Rice-coded (or escaped) residuals of a subframe into the given array, after the warm-up
+                 * samples.
+                 * @param[in]  warmup the number of warm-up samples, in the range [0, `currentBlockSize`]
+                 * @param[out] result the array to store the residuals into
+                 */
+                void readResiduals(int_fast32_t warmup, int_fast64_t result[]);
+
+            public:
+                /**
+                 * The input stream to read frames from. Can be changed between calls to `readFrame()`.
+                 */
+                FlacLowLevelInput *in;
+
+                /**
+                 * The bit depth of the stream, in the range [1, 32]. Frames which declare a different depth in their
+                 * header are rejected.
+                 */
+                int_fast32_t expectedSampleDepth;
+
+                /**
+                 * The largest frame size of the stream in bytes (see `Common::StreamInfo::maxFrameSize`), or 0 if
+                 * unknown. When known, `readFrame()` first makes that many bytes contiguous in the input buffer, as far
+                 * as the buffer holds them, so that a frame is parsed without refilling the buffer in between.
+                 */
+                uint_fast32_t maxFrameSize;
+
+                /**
+                 * Constructs a frame decoder that initially uses the given input stream and expects the given sample
+                 * depth. The temporary arrays are sized for the given maximum block size, and grow if a frame exceeds
+                 * it.
+                 * @param[in] in           the input stream to read frames from (not `null`)
+                 * @param[in] expectDepth  the bit depth of the stream, in the range [1, 32]
+                 * @param[in] maxBlockSize the largest expected block size, in the range [1, 65536]
+                 */
+                FrameDecoder(FlacLowLevelInput *in, int_fast32_t expectDepth, int_fast32_t maxBlockSize = 65536);
+
+                ~FrameDecoder();
+
+                FrameDecoder(const FrameDecoder &) = delete;
+
+                FrameDecoder &operator=(const FrameDecoder &) = delete;
+
+                /**
+                 * Reads the next frame of FLAC data from the current bit input stream, decodes it, and stores output
+                 * samples into the given array, and returns a new metadata object. The bit input stream must be
+                 * initially aligned at a byte boundary. If EOF is encountered before any actual bytes were read, then
+                 * this returns `null`. Otherwise this function either successfully decodes a frame and returns a new
+                 * metadata object (to be deleted by the caller), or throws an appropriate exception. A frame may have
+                 * up to 8 channels and 65536 samples, so the output arrays need to be sized appropriately.
+                 * @param[out] outSamples the arrays to store the samples into, one per channel (all not `null`)
+                 * @param[in]  outOffset  the offset in the output arrays to store the first sample at
+                 * @return a new frame info object, or `null` at the end of stream
+                 */
+                Common::FrameInfo *readFrame(int_fast32_t *outSamples[], uint_fast32_t outOffset);
+
+                /**
+                 * Reads and decodes the next frame like `readFrame(int_fast32_t*[], uint_fast32_t)`, but stores the
+                 * frame header fields into the given existing object, so no memory is allocated per frame.
+                 * @param[out] outSamples the arrays to store the samples into, one per channel (all not `null`)
+                 * @param[in]  outOffset  the offset in the output arrays to store the first sample at
+                 * @param[out] meta       the frame info object to overwrite (not `null`)
+                 * @return `true` if a frame was decoded, or `false` at the end of stream
+                 */
+                bool readFrame(int_fast32_t *outSamples[], uint_fast32_t outOffset, Common::FrameInfo *meta);
+
+                /**
+                 * Returns the account this decoder charges its temporary arrays to.
+                 * @return the memory account of this decoder
+                 */
+                Common::MemoryAccount *getMemory();
+            };
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,63 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_FRAMEHANDLE_H
+#define NAYUKI_FRAMEHANDLE_H
+
+#include <cstdint>
+
+#include "../common/FrameInfo.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Decode {
+            /**
+             * A frame located by `FlacDecoder::scanFrame()` without decoding its samples: the fields of its header and
+             * where it lies in the stream. Handles are plain values, so they can be kept, skipped or reordered, and
+             * their samples are only decoded when passed to `FlacDecoder::decodeFrame()`, which may be called on any
+             * decoder of the same stream, e.g. one per thread.
+             */
+            class FrameHandle final {
+            public:
+                /**
+                 * The fields of the frame header, with `frameSize` set to the length of the whole frame in bytes.
+                 */
+                Common::FrameInfo info;
+
+                /**
+                 * The byte offset of the frame in the stream.
+                 */
+                uint_fast64_t filePos;
+
+                /**
+                 * The offset of the first sample of the frame in the stream, in samples per channel.
+                 */
+                uint_fast64_t samplePos;
+
+                /**
+                 * Constructs a handle which does not refer to any frame yet.
+                 */
+                FrameHandle() : filePos(0), samplePos(0) {}
+            };
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,386 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "FramePipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#include "ByteArrayFlacInput.h"
+#include "DataFormatException.h"
+#include "FrameBoundaryFinder.h"
+#include "FrameDecoder.h"
+
+#include "../common/Md5Hasher.h"
+#include "../common/PlanarBuffer.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Decode {
+            class FramePipeline::Frame final {
+            public:
+                /**
+                 * The account of the sample buffer and the frame decoder, used by whichever thread owns the frame.
+                 */
+                Common::MemoryAccount memory;
+
+                /**
+                 * The compressed frame, from its header up to and including its CRC-16.
+                 */
+                std::vector<uint_fast8_t> bytes;
+
+                /**
+                 * The header the reader parsed when splitting the frame off.
+                 */
+                Common::FrameInfo header;
+
+                /**
+                 * The decoded samples, one array per channel.
+                 */
+                Common::PlanarBuffer<int_fast32_t> samples;
+
+                /**
+                 * The header as parsed by the decoder.
+                 */
+                Common::FrameInfo info;
+
+                /**
+                 * The decoder, created by the first task decoding this frame and reused afterwards, or `null`.
+                 */
+                FrameDecoder *decoder;
+
+                /**
+                 * Whether the samples are ready (or `error` is set), released by the decoding task.
+                 */
+                std::atomic<bool> decoded;
+
+                /**
+                 * The error the reader, the decoder or the MD5 check found in this frame, or `null`.
+                 */
+                std::exception_ptr error;
+
+                /**
+                 * Whether this is not a frame but the marker of the end of the stream.
+                 */
+                bool end;
+
+                /**
+                 * The number of bytes charged to the pipeline's account for this frame.
+                 */
+                uint_fast64_t charged;
+
+                /**
+                 * Constructs an empty frame with room for the given number of samples per channel.
+                 */
+                Frame(int_fast32_t numChannels, int_fast32_t capacity)
+                        : samples(&memory, numChannels, (size_t)capacity) {
+                    decoder = nullptr;
+                    decoded = false;
+                    end = false;
+                    charged = 0;
+                }
+
+                ~Frame() {
+                    delete decoder;
+                }
+            };
+
+            namespace {
+                /**
+                 * Charges or releases the difference between the given size and the amount charged so far.
+                 */
+                void recharge(Common::MemoryAccount &account, uint_fast64_t *charged, uint_fast64_t size) {
+                    if (size > *charged)
+                        account.charge(size - *charged);
+                    else
+                        account.release(*charged - size);
+                    *charged = size;
+                }
+
+                /**
+                 * Returns the number of frames in flight for the given pool and requested count.
+                 */
+                size_t getFrameCount(Common::ThreadPool *pool, size_t numFrames) {
+                    if (numFrames != 0)
+                        return numFrames;
+                    return pool != nullptr ? (size_t)pool->getSize() * 2 + 2 : 3;
+                }
+            }
+
+            FramePipeline::FramePipeline(FlacLowLevelInput *in, const Common::StreamInfo &info,
+                                         Common::ThreadPool *pool, bool checkMd5, size_t numFrames)
+                    : emptyFrames(getFrameCount(pool, numFrames)), decodingFrames(getFrameCount(pool, numFrames)),
+                      decodedFrames(getFrameCount(pool, numFrames)) {
+                if (in == nullptr)
+                    throw std::invalid_argument("Input stream cannot be null");
+                input = in;
+                numChannels = info.numChannels;
+                sampleDepth = info.sampleDepth;
+                maxBlockSize = info.maxBlockSize;
+                std::memcpy(expectedMd5, info.md5Hash, sizeof(expectedMd5));
+                verifyMd5 = checkMd5 && std::any_of(expectedMd5, expectedMd5 + sizeof(expectedMd5),
+                                                    [](unsigned char b) { return b != 0; });
+                this->pool = pool;
+                window.resize(READ_SIZE * 2);
+                windowStart = 0;
+                windowEnd = 0;
+                windowCapacity = window.capacity();
+                windowCharged = 0;
+                inputRemaining = in->getLength() - in->getPosition();
+                haveHeader = false;
+                finished = false;
+                running = true;
+
+                for (size_t i = 0, n = getFrameCount(pool, numFrames); i < n; i++) {
+                    auto *frame = new Frame(numChannels, maxBlockSize);
+                    frames.push_back(frame);
+                    accountFrame(frame);
+                    emptyFrames.push(frame);
+                }
+                try {
+                    readerThread = std::thread(&FramePipeline::readerLoop, this);
+                    outputThread = std::thread(&FramePipeline::outputLoop, this);
+                } catch (...) {
+                    stop();
+                    for (Frame *frame : frames)
+                        delete frame;
+                    throw;
+                }
+            }
+
+            FramePipeline::~FramePipeline() {
+                stop();
+                for (Frame *frame : frames)
+                    delete frame;
+            }
+
+            int_fast32_t FramePipeline::readAudioBlock(int_fast32_t *samples[], uint_fast32_t off,
+                                                       Common::FrameInfo *meta) {
+                if (samples == nullptr || meta == nullptr)
+                    throw std::invalid_argument("Arguments cannot be null");
+                if (error != nullptr)
+                    std::rethrow_exception(error);
+                if (finished)
+                    return 0;
+                if (!running)
+                    throw std::logic_error("Pipeline is stopped");
+
+                Frame *frame = decodedFrames.pop();
+                accountFrame(frame);
+                int_fast32_t result = 0;
+                if (frame->error != nullptr) {
+                    error = frame->error;
+                    finished = true;
+                } else if (frame->end)
+                    finished = true;
+                else {
+                    result = frame->info.blockSize;
+                    for (int_fast32_t ch = 0; ch < numChannels; ch++)
+                        std::memcpy(samples[ch] + off, frame->samples.getChannels()[ch],
+                                    (size_t)result * sizeof(int_fast32_t));
+                    *meta = frame->info;
+                }
+                frame->error = nullptr;
+                frame->end = false;
+                emptyFrames.push(frame);
+                if (error != nullptr)
+                    std::rethrow_exception(error);
+                return result;
+            }
+
+            void FramePipeline::stop() {
+                if (!running)
+                    return;
+                running = false;
+                emptyFrames.close();
+                decodingFrames.close();
+                decodedFrames.close();
+                if (readerThread.joinable())
+                    readerThread.join();
+                if (outputThread.joinable())
+                    outputThread.join();
+            }
+
+            bool FramePipeline::isRunning() const {
+                return running;
+            }
+
+            const Common::PipelineStats &FramePipeline::getStats() const {
+                return stats;
+            }
+
+            Common::MemoryAccount *FramePipeline::getMemory() {
+                return &memory;
+            }
+
+            void FramePipeline::readerLoop() {
+                // Waits for the frames in flight when leaving, so that no task outlives the pipeline
+                Common::ThreadPool::TaskGroup group(pool);
+                while (true) {
+                    std::chrono::steady_clock::duration waited(0);
+                    Frame *frame = emptyFrames.pop(&waited);
+                    stats.addStall(Common::PipelineStats::Stage::INPUT, waited);
+                    if (frame == nullptr)
+                        break;  // Cancelled
+                    auto start = std::chrono::steady_clock::now();
+                    bool split;
+                    try {
+                        split = splitFrame(frame);
+                    } catch (...) {
+                        frame->error = std::current_exception();
+                        split = false;
+                    }
+                    if (!split) {
+                        frame->end = true;
+                        frame->decoded.store(true, std::memory_order_release);
+                        decodingFrames.push(frame);
+                        break;
+                    }
+                    stats.addWork(Common::PipelineStats::Stage::INPUT, frame->bytes.size(),
+                                  std::chrono::steady_clock::now() - start);
+
+                    frame->decoded.store(false, std::memory_order_relaxed);
+                    group.run([this, frame] { decodeFrame(frame); });
+                    if (!decodingFrames.push(frame))
+                        break;  // Cancelled
+                }
+                group.wait();
+            }
+
+            bool FramePipeline::splitFrame(Frame *frame) {
+                if (!haveHeader) {
+                    while (windowEnd - windowStart < FrameBoundaryFinder::MAX_HEADER_SIZE && fillWindow());
+                    if (windowStart == windowEnd ||
+                            !FrameBoundaryFinder::parseHeader(window.data() + windowStart, windowEnd - windowStart,
+                                                              &header))
+                        return false;
+                    haveHeader = true;
+                }
+
+                // Widen the window until the end of the frame shows
+                FrameBoundaryFinder finder(header);
+                Common::FrameInfo next;
+                size_t end;
+                while ((end = finder.find(window.data() + windowStart, windowEnd - windowStart, inputRemaining == 0,
+                                          &next)) == 0)
+                    fillWindow();
+                bool haveNext = windowStart + end < windowEnd;
+
+                frame->bytes.assign(window.begin() + windowStart, window.begin() + windowStart + end);
+                frame->header = header;
+                windowStart += end;
+                haveHeader = haveNext;
+                if (haveNext)
+                    header = next;
+                return true;
+            }
+
+            bool FramePipeline::fillWindow() {
+                if (inputRemaining == 0)
+                    return false;
+                size_t unsplit = windowEnd - windowStart;
+                std::memmove(window.data(), window.data() + windowStart, unsplit);
+                windowStart = 0;
+                windowEnd = unsplit;
+                auto n = (size_t)std::min(inputRemaining, (uint_fast64_t)READ_SIZE);
+                if (window.size() < windowEnd + n) {
+                    window.resize(windowEnd + n);
+                    windowCapacity.store(window.capacity(), std::memory_order_relaxed);
+                }
+                input->readFully(window.data() + windowEnd, n);
+                windowEnd += n;
+                inputRemaining -= n;
+                return true;
+            }
+
+            void FramePipeline::decodeFrame(Frame *frame) {
+                auto start = std::chrono::steady_clock::now();
+                try {
+                    if (frame->header.numChannels != numChannels)
+                        throw DataFormatException("Channel count mismatch");
+                    if ((size_t)frame->header.blockSize > frame->samples.getCapacity())
+                        frame->samples.reserve(numChannels, (size_t)frame->header.blockSize);
+
+                    // Buffer the whole frame, so that it is read in one piece
+                    size_t bufferSize = frame->bytes.size();
+                    bufferSize = std::max(bufferSize, (size_t)AbstractFlacLowLevelInput::MIN_BUFFER_SIZE);
+                    bufferSize = std::min(bufferSize, (size_t)AbstractFlacLowLevelInput::MAX_BUFFER_SIZE);
+                    ByteArrayFlacInput in(frame->bytes.data(), frame->bytes.size(), bufferSize);
+                    if (frame->decoder == nullptr) {
+                        frame->decoder = new FrameDecoder(&in, sampleDepth, maxBlockSize);
+                        frame->decoder->getMemory()->setParent(&frame->memory);
+                    } else
+                        frame->decoder->in = &in;
+                    if (!frame->decoder->readFrame(frame->samples.getChannels(), 0, &frame->info) ||
+                        in.getPosition() != frame->bytes.size())
+                        throw DataFormatException("Frame does not end at the next frame header");
+                } catch (...) {
+                    frame->error = std::current_exception();
+                }
+                stats.addWork(Common::PipelineStats::Stage::CODEC, frame->bytes.size(),
+                              std::chrono::steady_clock::now() - start);
+                frame->decoded.store(true, std::memory_order_release);
+            }
+
+            void FramePipeline::outputLoop() {
+                Common::Md5Hasher hasher((uint_fast8_t)numChannels, (uint_fast8_t)sampleDepth);
+                auto pcmBytesPerSample = (uint_fast64_t)numChannels * ((sampleDepth + 7) / 8);
+                while (true) {
+                    std::chrono::steady_clock::duration waited(0);
+                    Frame *frame = decodingFrames.pop(&waited);
+                    if (frame == nullptr)
+                        return;  // Cancelled
+                    if (!frame->decoded.load(std::memory_order_acquire)) {
+                        auto start = std::chrono::steady_clock::now();
+                        Common::Backoff backoff;
+                        while (!frame->decoded.load(std::memory_order_acquire))
+                            backoff.pause();
+                        waited += std::chrono::steady_clock::now() - start;
+                    }
+                    stats.addStall(Common::PipelineStats::Stage::OUTPUT, waited);
+
+                    bool last = frame->end || frame->error != nullptr;
+                    if (!last) {
+                        auto start = std::chrono::steady_clock::now();
+                        if (verifyMd5)
+                            hasher.update(frame->samples.getChannels(), 0, (uint_fast64_t)frame->info.blockSize);
+                        stats.addWork(Common::PipelineStats::Stage::OUTPUT, frame->info.blockSize * pcmBytesPerSample,
+                                      std::chrono::steady_clock::now() - start);
+                    } else if (frame->error == nullptr && verifyMd5) {
+                        unsigned char actual[MD5_DIGEST_LENGTH];
+                        hasher.finish(actual);
+                        if (std::memcmp(actual, expectedMd5, sizeof(expectedMd5)) != 0)
+                            frame->error = std::make_exception_ptr(DataFormatException("MD5 hash mismatch"));
+                    }
+                    if (!decodedFrames.push(frame) || last)
+                        return;
+                }
+            }
+
+            void FramePipeline::accountFrame(Frame *frame) {
+                recharge(memory, &frame->charged,
+                         sizeof(Frame) + frame->memory.getCurrentBytes() + frame->bytes.capacity());
+                recharge(memory, &windowCharged, windowCapacity.load(std::memory_order_relaxed));
+            }
+        }
+    }
+}
@@ -0,0 +1,306 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_FRAMEPIPELINE_H
+#define NAYUKI_FRAMEPIPELINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include "FlacLowLevelInput.h"
+
+#include "../common/FrameInfo.h"
+#include "../common/MemoryAccount.h"
+#include "../common/PipelineStats.h"
+#include "../common/SpscRing.h"
+#include "../common/StreamInfo.h"
+#include "../common/ThreadPool.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Decode {
+            /**
+             * Decodes the audio frames of a FLAC stream ahead of the caller, as a pipeline of three stages connected
+             * by single-producer/single-consumer rings which pass frames by ownership:
+             *
+             * - a reader thread reads the input and splits it into frames, by looking for a frame header after which
+             *   the CRC-16 of the bytes so far is zero and which continues the sample numbering of the previous frame,
+             * - every frame is decoded as a task of a thread pool, so several frames decode at once,
+             * - an output thread takes the frames back in stream order, waits for each to finish decoding and adds its
+             *   samples to the MD5 hash, which is checked against the stream info at the end of the stream.
+             *
+             * The caller takes the decoded frames from the output thread and hands them back to the reader for reuse,
+             * so the number of frames in flight, and thereby the memory, is fixed. Errors of any stage are reported
+             * by `readAudioBlock()` in stream order, i.e. only after all the frames before the faulty one.
+             *
+             * The reader uses the input stream exclusively while the pipeline runs. Apart from `getStats()`, the
+             * methods must be called by one thread. Normally used through `FlacDecoder::startPipeline()`.
+             */
+            class FramePipeline final {
+            private:
+                /**
+                 * The number of bytes the reader requests from the input at once.
+                 */
+                static const size_t READ_SIZE = 65536;
+
+                /**
+                 * The bytes of one frame, its decoded samples and the state of its trip through the stages. Defined in
+                 * the implementation.
+                 */
+                class Frame;
+
+                /**
+                 * The input stream, owned by the caller and used by the reader thread only.
+                 */
+                FlacLowLevelInput *input;
+
+                /**
+                 * The number of channels of the stream, in the range [1, 8].
+                 */
+                int_fast32_t numChannels;
+
+                /**
+                 * The bit depth of the stream, in the range [1, 32].
+                 */
+                int_fast32_t sampleDepth;
+
+                /**
+                 * The maximum block size declared by the stream, which the sample buffers start out with.
+                 */
+                int_fast32_t maxBlockSize;
+
+                /**
+                 * The MD5 hash declared by the stream info, checked at the end of the stream.
+                 */
+                unsigned char expectedMd5[16];
+
+                /**
+                 * Whether to hash the samples and check the MD5 hash, i.e. whether the pipeline started at the first
+                 * frame and the stream declares a hash.
+                 */
+                bool verifyMd5;
+
+                /**
+                 * The pool decoding the frames, or `null` to decode them on the reader thread.
+                 */
+                Common::ThreadPool *pool;
+
+                /**
+                 * The account charged with the frames, on the caller's thread only.
+                 */
+                Common::MemoryAccount memory;
+
+                /**
+                 * The counters of the stages.
+                 */
+                Common::PipelineStats stats;
+
+                /**
+                 * All frames, owned by this object wherever they are in the pipeline.
+                 */
+                std::vector<Frame *> frames;
+
+                /**
+                 * The frames to fill, from the caller to the reader.
+                 */
+                Common::SpscRing<Frame> emptyFrames;
+
+                /**
+                 * The frames in stream order, some of them still being decoded, from the reader to the output thread.
+                 */
+                Common::SpscRing<Frame> decodingFrames;
+
+                /**
+                 * The decoded and hashed frames, from the output thread to the caller.
+                 */
+                Common::SpscRing<Frame> decodedFrames;
+
+                /**
+                 * The thread of the reader stage.
+                 */
+                std::thread readerThread;
+
+                /**
+                 * The thread of the output stage.
+                 */
+                std::thread outputThread;
+
+                /**
+                 * The input bytes read but not yet split off into frames, owned by the reader.
+                 */
+                std::vector<uint_fast8_t> window;
+
+                /**
+                 * The index of the first unsplit byte in `window`, at the start of a frame.
+                 */
+                size_t windowStart;
+
+                /**
+                 * The number of valid bytes in `window`.
+                 */
+                size_t windowEnd;
+
+                /**
+                 * The capacity of `window`, published by the reader for the caller to account.
+                 */
+                std::atomic<size_t> windowCapacity;
+
+                /**
+                 * The capacity of `window` last charged to `memory`.
+                 */
+                uint_fast64_t windowCharged;
+
+                /**
+                 * The number of input bytes left to read.
+                 */
+                uint_fast64_t inputRemaining;
+
+                /**
+                 * The header of the frame starting at `windowStart`, valid if `haveHeader` is set.
+                 */
+                Common::FrameInfo header;
+
+                /**
+                 * Whether `header` was parsed already.
+                 */
+                bool haveHeader;
+
+                /**
+                 * The error which ended the stream, rethrown by every later `readAudioBlock()`, or `null`.
+                 */
+                std::exception_ptr error;
+
+                /**
+                 * Whether the end of the stream or an error was returned to the caller.
+                 */
+                bool finished;
+
+                /**
+                 * Whether the threads are running, i.e. `stop()` was not called yet.
+                 */
+                bool running;
+
+                /**
+                 * Runs the reader stage until the end of the input, an error or cancellation.
+                 */
+                void readerLoop();
+
+                /**
+                 * Runs the output stage until the end of the stream, an error or cancellation.
+                 */
+                void outputLoop();
+
+                /**
+                 * Moves the next frame of the input into the given frame's bytes, or returns `false` at the end of
+                 * the input.
+                 * @param[in,out] frame the frame to fill (not `null`)
+                 * @return whether a frame was split off
+                 */
+                bool splitFrame(Frame *frame);
+
+                /**
+                 * Reads more input into the window, first moving the unsplit bytes to its start.
+                 * @return whether any bytes were read, or `false` at the end of the input
+                 */
+                bool fillWindow();
+
+                /**
+                 * Decodes the given frame and marks it as decoded, recording any error in it. Runs on the pool.
+                 * @param[in,out] frame the frame to decode (not `null`)
+                 */
+                void decodeFrame(Frame *frame);
+
+                /**
+                 * Updates the charges of the given frame, which the caller owns, and of the reader's window to their
+                 * current sizes.
+                 * @param[in,out] frame the frame to account (not `null`)
+                 */
+                void accountFrame(Frame *frame);
+
+            public:
+                /**
+                 * Starts decoding the given input stream, which must be positioned at the start of a frame.
+                 * @param[in,out] in        the input stream, which must not be used by anyone else until `stop()` (not
+                 * `null`)
+                 * @param[in]     info      the stream info of the stream
+                 * @param[in,out] pool      the pool to decode the frames on, or `null` to decode them on the reader
+                 * thread (which still overlaps the decoding with the caller and the MD5 hashing)
+                 * @param[in]     checkMd5  whether the input starts at the first frame, so that the MD5 hash can be
+                 * checked
+                 * @param[in]     numFrames the number of frames in flight, at least 2, or 0 for a default which keeps
+                 * every worker of the pool busy
+                 */
+                FramePipeline(FlacLowLevelInput *in, const Common::StreamInfo &info, Common::ThreadPool *pool,
+                              bool checkMd5, size_t numFrames = 0);
+
+                /**
+                 * Stops the pipeline and frees all frames.
+                 */
+                ~FramePipeline();
+
+                FramePipeline(const FramePipeline &) = delete;
+
+                FramePipeline &operator=(const FramePipeline &) = delete;
+
+                /**
+                 * Returns the samples of the next frame like `FlacDecoder::readAudioBlock()`, waiting until the frame
+                 * is decoded.
+                 * @param[out] samples the arrays to store the samples into, one per channel (all not `null`)
+                 * @param[in]  off     the offset in the arrays to store the first sample at
+                 * @param[out] meta    the header of the returned frame (not `null`)
+                 * @return the number of samples per channel, or 0 at the end of the stream
+                 * @throws DataFormatException if the frame or the stream is invalid, including an MD5 mismatch at the
+                 * end of the stream
+                 */
+                int_fast32_t readAudioBlock(int_fast32_t *samples[], uint_fast32_t off, Common::FrameInfo *meta);
+
+                /**
+                 * Cancels the pipeline and waits for its threads and tasks to end. The position of the input stream
+                 * is undefined afterwards. Idempotent.
+                 */
+                void stop();
+
+                /**
+                 * Returns whether `stop()` was not called yet.
+                 * @return whether the pipeline runs
+                 */
+                bool isRunning() const;
+
+                /**
+                 * Returns the counters of the stages, which may be read from any thread at any time.
+                 * @return the counters
+                 */
+                const Common::PipelineStats &getStats() const;
+
+                /**
+                 * Returns the heap usage of the frames in flight and the reader's window.
+                 * @return the memory account of this pipeline
+                 */
+                Common::MemoryAccount *getMemory();
+            };
+        }
+    }
+}
+
+#endif
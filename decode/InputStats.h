@@ -0,0 +1,139 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_INPUTSTATS_H
+#define NAYUKI_INPUTSTATS_H
+
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Executes the given statement only in builds with hot-path counters enabled (CMake option `NAYUKI_ENABLE_STATS`).
+ * Otherwise the statement is not compiled at all, so the counters cost nothing.
+ */
+#ifdef NAYUKI_STATS
+#define NAYUKI_STAT(...) do { __VA_ARGS__; } while (false)
+#else
+#define NAYUKI_STAT(...) do { } while (false)
+#endif
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Decode {
+            /**
+             * Event counters of one input stream and the frames decoded from it. The counters are only updated in
+             * builds with `NAYUKI_STATS` defined; see `FlacLowLevelInput::getStats()`.
+             */
+            class InputStats final {
+            public:
+                /**
+                 * The number of buckets of `readSizes`.
+                 */
+                static const int_fast32_t READ_SIZE_BUCKETS = 17;
+
+                /**
+                 * The number of times the byte buffer was refilled, i.e. calls to the underlying `readUnderlying()`.
+                 */
+                uint_fast64_t bufferRefills;
+
+                /**
+                 * The total number of bytes returned by the underlying `readUnderlying()`.
+                 */
+                uint_fast64_t underlyingBytes;
+
+                /**
+                 * A histogram of the number of bytes returned per `readUnderlying()` call. Bucket 0 counts calls which
+                 * hit the end of the stream, and bucket `i > 0` counts calls returning [2^(i-1), 2^i) bytes (the last
+                 * bucket also counts all larger reads).
+                 */
+                uint_fast64_t readSizes[READ_SIZE_BUCKETS];
+
+                /**
+                 * Per Rice parameter, the number of values decoded by the table-driven fast path.
+                 */
+                uint_fast64_t riceFastPathValues[32];
+
+                /**
+                 * Per Rice parameter, the number of values decoded bit by bit, because the code was too long for the
+                 * lookup table or the byte buffer was almost exhausted.
+                 */
+                uint_fast64_t riceSlowPathValues[32];
+
+                /**
+                 * The number of bytes fed through the CRC-8 and CRC-16 computations.
+                 */
+                uint_fast64_t crcBytes;
+
+                /**
+                 * The number of frame headers parsed.
+                 */
+                uint_fast64_t frameHeaders;
+
+                /**
+                 * The number of frame headers whose block size and sample rate were fully described by their codes,
+                 * so that no extra bytes had to be read after the coded number.
+                 */
+                uint_fast64_t headerFastPath;
+
+                /**
+                 * The number of subframes decoded per type: constant, verbatim, fixed prediction and LPC.
+                 */
+                uint_fast64_t subframeTypes[4];
+
+                /**
+                 * The number of residual partitions stored with the escape code instead of Rice coding.
+                 */
+                uint_fast64_t escapedPartitions;
+
+                /**
+                 * Constructs a set of counters which are all zero.
+                 */
+                InputStats() {
+                    reset();
+                }
+
+                /**
+                 * Sets all counters to zero.
+                 */
+                void reset() {
+                    std::memset(this, 0, sizeof(InputStats));
+                }
+
+                /**
+                 * Records one `readUnderlying()` call which returned the given number of bytes (-1 or 0 for the end of
+                 * the stream).
+                 * @param[in] n the number of bytes read
+                 */
+                void countRead(int_fast64_t n) {
+                    bufferRefills++;
+                    int_fast32_t bucket = 0;
+                    if (n > 0) {
+                        underlyingBytes += n;
+                        while (bucket < READ_SIZE_BUCKETS - 1 && (n >> bucket) != 0)
+                            bucket++;
+                    }
+                    readSizes[bucket]++;
+                }
+            };
+        }
+    }
+}
+
+#endif
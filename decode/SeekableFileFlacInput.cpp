@@ -0,0 +1,100 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#include "SeekableFileFlacInput.h"
+
+#include <stdexcept>
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Decode {
+            namespace {
+                /**
+                 * The adaptive buffer size before the frame size is known, in bytes.
+                 */
+                const size_t INITIAL_BUFFER_SIZE = 65536;
+
+                /**
+                 * The largest adaptive buffer size, in bytes.
+                 */
+                const size_t ADAPTIVE_BUFFER_LIMIT = (size_t)1 << 20;
+            }
+
+            SeekableFileFlacInput::SeekableFileFlacInput(const std::string &path, size_t bufferSize)
+                    : AbstractFlacLowLevelInput(bufferSize, INITIAL_BUFFER_SIZE, ADAPTIVE_BUFFER_LIMIT) {
+                raf.open(path, std::ios::in | std::ios::binary);
+                if (!raf.is_open())
+                    throw std::runtime_error("Cannot open file: " + path);
+            }
+
+            void SeekableFileFlacInput::reset(const std::string &path) {
+                raf.close();
+                raf.clear();
+                raf.open(path, std::ios::in | std::ios::binary);
+                if (!raf.is_open())
+                    throw std::runtime_error("Cannot open file: " + path);
+                reopen();
+            }
+
+            uint_fast64_t SeekableFileFlacInput::getLength() {
+                raf.clear();  // After reaching the end, the stream refuses to report positions
+                std::streampos pos = raf.tellg();
+                raf.seekg(0, std::ios::end);
+                std::streampos end = raf.tellg();
+                raf.seekg(pos);
+                if (end < 0)
+                    throw std::runtime_error("Cannot determine file length");
+                return (uint_fast64_t)end;
+            }
+
+            void SeekableFileFlacInput::seekTo(uint_fast64_t pos) {
+                if (seekWithinBuffer(pos))
+                    return;
+                raf.clear();
+                raf.seekg((std::streamoff)pos);
+                if (!raf)
+                    throw std::runtime_error("Seek failed");
+                positionChanged(pos);
+            }
+
+            int_fast32_t SeekableFileFlacInput::readUnderlying(uint_fast8_t buf[], uint_fast64_t off,
+                                                               uint_fast64_t len) {
+                raf.read((char *)(buf + off), (std::streamsize)len);
+                auto n = (int_fast32_t)raf.gcount();
+                if (n == 0) {
+                    if (raf.bad())
+                        throw std::runtime_error("Read failed");
+                    return -1;
+                }
+                return n;
+            }
+
+            void SeekableFileFlacInput::close() {
+                if (raf.is_open()) {
+                    raf.close();
+                    AbstractFlacLowLevelInput::close();
+                }
+            }
+        }
+    }
+}
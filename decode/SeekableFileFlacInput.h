@@ -0,0 +1,75 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#ifndef NAYUKI_SEEKABLEFILEFLACINPUT_H
+#define NAYUKI_SEEKABLEFILEFLACINPUT_H
+
+#include <fstream>
+#include <string>
+
+#include "AbstractFlacLowLevelInput.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Decode {
+            /**
+             * A FLAC input stream based on a file, which supports seeking.
+             */
+            class SeekableFileFlacInput final : public AbstractFlacLowLevelInput {
+            private:
+                /**
+                 * The underlying file stream to read from.
+                 */
+                std::ifstream raf;
+
+            protected:
+                virtual int_fast32_t readUnderlying(uint_fast8_t buf[], uint_fast64_t off, uint_fast64_t len);
+
+            public:
+                /**
+                 * Opens the file at the given path for reading, throwing an exception if that fails. The adaptive
+                 * buffer size starts larger than for memory, since every refill is a system call (and a round trip
+                 * on network file systems).
+                 * @param[in] path       the path of the FLAC file
+                 * @param[in] bufferSize the buffer size in bytes, or 0 for an adaptive size
+                 */
+                explicit SeekableFileFlacInput(const std::string &path, size_t bufferSize = 0);
+
+                /**
+                 * Closes the current file and restarts this stream at the beginning of the file at the given path,
+                 * keeping the internal buffer. Also reopens a closed stream.
+                 * @param[in] path the path of the FLAC file
+                 */
+                void reset(const std::string &path);
+
+                virtual uint_fast64_t getLength();
+
+                virtual void seekTo(uint_fast64_t pos);
+
+                virtual void close();
+            };
+        }
+    }
+}
+
+#endif
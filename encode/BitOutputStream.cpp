@@ -27,6 +27,8 @@
 #include <fstream>
 #include <stdexcept>
 
+#include "../common/Kernels.h"
+
 namespace Nayuki {
     namespace FLAC {
         namespace Encode {
@@ -62,11 +64,23 @@ namespace Nayuki {
                 assert(bitBufferLen <= 64);
             }
 
+            void BitOutputStream::writeBytes(const uint_fast8_t data[], size_t len) {
+                checkByteAligned();
+                flush();
+                if (out != nullptr)
+                    out->write(reinterpret_cast<const char *>(data), (std::streamsize)len);
+                byteCount += len;
+                const Common::Kernels &kernels = Common::Kernels::get();
+                crc8 = kernels.crc8((uint_fast8_t)crc8, data, len);
+                crc16 = kernels.crc16((uint_fast16_t)crc16, data, len);
+            }
+
             void BitOutputStream::flush() {
                 while (bitBufferLen >= 8) {
                     bitBufferLen -= 8;
                     auto b = (uint_fast8_t)((bitBuffer >> bitBufferLen) & 0xFF);
-                    out->put(b);
+                    if (out != nullptr)
+                        out->put(b);
                     byteCount++;
                     crc8 ^= b;
                     crc16 ^= b << 8;
@@ -80,7 +94,6 @@ namespace Nayuki {
                     }
                 }
                 assert(bitBufferLen <= 64);
-                out->flush();
             }
 
             void BitOutputStream::resetCrcs() {
@@ -92,14 +105,14 @@ namespace Nayuki {
             uint_fast8_t BitOutputStream::getCrc8() {
                 checkByteAligned();
                 flush();
-                assert((crc8 >> 8) != 0);
+                assert((crc8 >> 8) == 0);
                 return (uint_fast8_t)crc8;
             }
 
             uint_fast16_t BitOutputStream::getCrc16() {
                 checkByteAligned();
                 flush();
-                assert((crc16 >> 16) != 0);
+                assert((crc16 >> 16) == 0);
                 return (uint_fast16_t)crc16;
             }
 
@@ -111,6 +124,7 @@ namespace Nayuki {
                 if (out != nullptr) {
                     checkByteAligned();
                     flush();
+                    out->flush();
                     auto fout = dynamic_cast<std::ofstream*>(out);
                     if (fout != nullptr)
                         fout->close();
@@ -24,6 +24,7 @@
 #ifndef NAYUKI_BITOUTPUTSTREAM_H
 #define NAYUKI_BITOUTPUTSTREAM_H
 
+#include <cstddef>
 #include <cstdint>
 #include <ostream>
 
@@ -72,8 +73,9 @@ namespace Nayuki {
 
             public:
                 /**
-                 * Constructs a FLAC-oriented bit output stream from the given byte-based output stream.
-                 * @param[in,out] out the byte-based output stream which will be used
+                 * Constructs a FLAC-oriented bit output stream from the given byte-based output stream. Without an
+                 * output stream, the bytes are only counted and included in the CRCs, e.g. to measure a header's size.
+                 * @param[in,out] out the byte-based output stream which will be used, or `null` to discard the bytes
                  */
                 explicit BitOutputStream(std::ostream *out);
 
@@ -90,6 +92,14 @@ namespace Nayuki {
                  */
                 void writeInt(int_fast8_t n, int_fast32_t val);
 
+                /**
+                 * Writes the given bytes at the current position, which must be byte-aligned, and includes them in the
+                 * CRCs. Used to append frames which were encoded into separate streams.
+                 * @param[in] data the bytes to write (not `null` unless `len` is 0)
+                 * @param[in] len  the number of bytes
+                 */
+                void writeBytes(const uint_fast8_t data[], size_t len);
+
                 /**
                  * Writes out whole bytes from the bit buffer to the underlying stream. After this is done, only 0 to 7
                  * bits remain in the bit buffer. Also updates the CRCs on each byte written.
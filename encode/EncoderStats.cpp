@@ -0,0 +1,215 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "EncoderStats.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "FrameEncoder.h"
+
+#include "../common/Utilities.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Encode {
+            EncoderStats::StageTimer::StageTimer(EncoderStats *stats, Stage stage) : stats(stats), stage(stage) {
+                if (stats != nullptr)
+                    start = std::chrono::steady_clock::now();
+            }
+
+            EncoderStats::StageTimer::~StageTimer() {
+                stop();
+            }
+
+            void EncoderStats::StageTimer::stop() {
+                if (stats != nullptr) {
+                    stats->addTime(stage, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+                    stats = nullptr;
+                }
+            }
+
+            EncoderStats::EncoderStats() {
+                reset();
+            }
+
+            void EncoderStats::reset() {
+                numFrames = 0;
+                totalBytes = 0;
+                std::fill(totalSeconds, totalSeconds + NUM_STAGES, 0.0);
+                std::fill(frameSeconds, frameSeconds + NUM_STAGES, 0.0);
+                for (auto &histogram : stageMicrosHistogram)
+                    std::fill(histogram, histogram + NUM_BUCKETS, 0);
+                std::fill(frameBytesHistogram, frameBytesHistogram + NUM_BUCKETS, 0);
+                blockSizes.clear();
+                std::fill(channelAssignments, channelAssignments + 11, 0);
+                std::fill(subframeTypes, subframeTypes + 64, 0);
+                std::fill(riceOrders, riceOrders + 16, 0);
+            }
+
+            void EncoderStats::addTime(Stage stage, double seconds) {
+                frameSeconds[(int)stage] += seconds;
+            }
+
+            void EncoderStats::endFrame(const FrameEncoder *enc, uint_fast64_t frameBytes) {
+                if (enc == nullptr)
+                    throw std::invalid_argument("Frame encoder cannot be null");
+                const Common::FrameInfo &meta = enc->getMetadata();
+                numFrames++;
+                for (int_fast32_t i = 0; i < NUM_STAGES; i++) {
+                    totalSeconds[i] += frameSeconds[i];
+                    stageMicrosHistogram[i][getBucket((uint_fast64_t)(frameSeconds[i] * 1e6))]++;
+                    frameSeconds[i] = 0;
+                }
+                frameBytesHistogram[getBucket(frameBytes)]++;
+                totalBytes += frameBytes;
+                blockSizes[meta.blockSize]++;
+                channelAssignments[meta.channelAssignment]++;
+                for (int_fast32_t ch = 0; ch < meta.numChannels; ch++) {
+                    const SubframeEncoder *sub = enc->getSubframeEncoder(ch);
+                    subframeTypes[sub->getType()]++;
+                    if (sub->getRiceOrder() != -1)
+                        riceOrders[sub->getRiceOrder()]++;
+                }
+            }
+
+            void EncoderStats::add(const EncoderStats &other) {
+                numFrames += other.numFrames;
+                totalBytes += other.totalBytes;
+                for (int_fast32_t i = 0; i < NUM_STAGES; i++) {
+                    totalSeconds[i] += other.totalSeconds[i];
+                    for (int_fast32_t j = 0; j < NUM_BUCKETS; j++)
+                        stageMicrosHistogram[i][j] += other.stageMicrosHistogram[i][j];
+                }
+                for (int_fast32_t i = 0; i < NUM_BUCKETS; i++)
+                    frameBytesHistogram[i] += other.frameBytesHistogram[i];
+                for (const auto &entry : other.blockSizes)
+                    blockSizes[entry.first] += entry.second;
+                for (int_fast32_t i = 0; i < 11; i++)
+                    channelAssignments[i] += other.channelAssignments[i];
+                for (int_fast32_t i = 0; i < 64; i++)
+                    subframeTypes[i] += other.subframeTypes[i];
+                for (int_fast32_t i = 0; i < 16; i++)
+                    riceOrders[i] += other.riceOrders[i];
+            }
+
+            namespace {
+                /**
+                 * Writes the given logarithmic histogram as a JSON object mapping each non-empty bucket's lower bound
+                 * to its count.
+                 */
+                void writeHistogram(std::ostream &out, const uint_fast64_t histogram[], int_fast32_t len) {
+                    out << "{";
+                    bool first = true;
+                    for (int_fast32_t i = 0; i < len; i++) {
+                        if (histogram[i] == 0)
+                            continue;
+                        out << (first ? "" : ", ") << "\"" << (i == 0 ? 0 : (uint_fast64_t)1 << i) << "\": "
+                            << histogram[i];
+                        first = false;
+                    }
+                    out << "}";
+                }
+
+                /**
+                 * Writes the non-zero entries of the given array as a JSON object mapping each index (after applying
+                 * the given naming function) to its count.
+                 */
+                template<typename F>
+                void writeCounts(std::ostream &out, const uint_fast64_t counts[], int_fast32_t len, F name) {
+                    out << "{";
+                    bool first = true;
+                    for (int_fast32_t i = 0; i < len; i++) {
+                        if (counts[i] == 0)
+                            continue;
+                        out << (first ? "" : ", ") << "\"" << name(i) << "\": " << counts[i];
+                        first = false;
+                    }
+                    out << "}";
+                }
+
+                std::string getChannelAssignmentName(int_fast32_t chanAsgn) {
+                    switch (chanAsgn) {
+                        case 8:  return "left-side";
+                        case 9:  return "side-right";
+                        case 10: return "mid-side";
+                        default: return "independent-" + std::to_string(chanAsgn + 1);
+                    }
+                }
+
+                std::string getSubframeTypeName(int_fast32_t type) {
+                    if (type == 0)
+                        return "constant";
+                    else if (type == 1)
+                        return "verbatim";
+                    else if (type < 32)
+                        return "fixed-" + std::to_string(type - 8);
+                    else
+                        return "lpc-" + std::to_string(type - 31);
+                }
+            }
+
+            void EncoderStats::writeJson(std::ostream &out) const {
+                out << "{\"frames\": " << numFrames << ", \"total_bytes\": " << totalBytes << ", \"stage_seconds\": {";
+                for (int_fast32_t i = 0; i < NUM_STAGES; i++)
+                    out << (i > 0 ? ", " : "") << "\"" << getStageName((Stage)i) << "\": " << totalSeconds[i];
+                out << "}, \"stage_micros_histogram\": {";
+                for (int_fast32_t i = 0; i < NUM_STAGES; i++) {
+                    out << (i > 0 ? ", " : "") << "\"" << getStageName((Stage)i) << "\": ";
+                    writeHistogram(out, stageMicrosHistogram[i], NUM_BUCKETS);
+                }
+                out << "}, \"frame_bytes_histogram\": ";
+                writeHistogram(out, frameBytesHistogram, NUM_BUCKETS);
+                out << ", \"block_sizes\": {";
+                bool first = true;
+                for (const auto &entry : blockSizes) {
+                    out << (first ? "" : ", ") << "\"" << entry.first << "\": " << entry.second;
+                    first = false;
+                }
+                out << "}, \"stereo_modes\": ";
+                writeCounts(out, channelAssignments, 11, getChannelAssignmentName);
+                out << ", \"subframe_types\": ";
+                writeCounts(out, subframeTypes, 64, getSubframeTypeName);
+                out << ", \"rice_partition_orders\": ";
+                writeCounts(out, riceOrders, 16, [](int_fast32_t i) { return std::to_string(i); });
+                out << "}";
+            }
+
+            const char *EncoderStats::getStageName(Stage stage) {
+                switch (stage) {
+                    case Stage::ANALYSIS:      return "analysis";
+                    case Stage::SEARCH:        return "search";
+                    case Stage::RESIDUAL:      return "residual";
+                    case Stage::RICE:          return "rice";
+                    case Stage::SERIALIZATION: return "serialization";
+                    default:
+                        throw std::invalid_argument("Unknown stage");
+                }
+            }
+
+            int_fast32_t EncoderStats::getBucket(uint_fast64_t val) {
+                if (val == 0)
+                    return 0;
+                return std::min(63 - (int_fast32_t)Common::numberOfLeadingZeros((uint64_t)val), NUM_BUCKETS - 1);
+            }
+        }
+    }
+}
@@ -0,0 +1,216 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_ENCODERSTATS_H
+#define NAYUKI_ENCODERSTATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <ostream>
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Encode {
+            class FrameEncoder;
+
+            /**
+             * An optional sink for encoder statistics: the wall time of each frame split by stage, and the decisions
+             * the search made (block size, stereo mode, subframe type and order, Rice partition order, frame size),
+             * aggregated into histograms. Pass one to `FlacEncoder` to fill it; the encoder is slightly slower while
+             * collecting. Not thread-safe.
+             */
+            class EncoderStats final {
+            public:
+                /**
+                 * The stages that the time spent on a frame is split into.
+                 */
+                enum class Stage {
+                    /**
+                     * Copying samples, stereo decorrelation, constant and wasted bits detection, autocorrelation.
+                     */
+                    ANALYSIS,
+
+                    /**
+                     * Solving for LPC coefficients and trying coefficient roundings.
+                     */
+                    SEARCH,
+
+                    /**
+                     * Computing prediction residuals of candidate predictors.
+                     */
+                    RESIDUAL,
+
+                    /**
+                     * Choosing Rice partition orders and parameters of candidate residuals.
+                     */
+                    RICE,
+
+                    /**
+                     * Writing the chosen encoding to the bit stream.
+                     */
+                    SERIALIZATION
+                };
+
+                /**
+                 * The number of stages.
+                 */
+                static const int_fast32_t NUM_STAGES = 5;
+
+                /**
+                 * The number of buckets of the logarithmic histograms. Bucket `i` counts values in [2^i, 2^(i+1)), and
+                 * bucket 0 also counts the value 0.
+                 */
+                static const int_fast32_t NUM_BUCKETS = 32;
+
+                /**
+                 * Measures the time from construction to destruction (or to `stop()`) and adds it to a stage of the
+                 * current frame. Does nothing if the statistics sink is `null`.
+                 */
+                class StageTimer final {
+                private:
+                    EncoderStats *stats;
+
+                    Stage stage;
+
+                    std::chrono::steady_clock::time_point start;
+
+                public:
+                    StageTimer(EncoderStats *stats, Stage stage);
+
+                    ~StageTimer();
+
+                    /**
+                     * Adds the time measured so far and stops measuring. Idempotent.
+                     */
+                    void stop();
+
+                    StageTimer(const StageTimer &) = delete;
+
+                    StageTimer &operator=(const StageTimer &) = delete;
+                };
+
+                /**
+                 * The number of frames recorded.
+                 */
+                uint_fast64_t numFrames;
+
+                /**
+                 * The total time spent per stage over all frames, in seconds.
+                 */
+                double totalSeconds[NUM_STAGES];
+
+                /**
+                 * Per stage, a histogram of the time spent on each frame in microseconds (logarithmic buckets).
+                 */
+                uint_fast64_t stageMicrosHistogram[NUM_STAGES][NUM_BUCKETS];
+
+                /**
+                 * A histogram of the encoded frame sizes in bytes (logarithmic buckets).
+                 */
+                uint_fast64_t frameBytesHistogram[NUM_BUCKETS];
+
+                /**
+                 * The total size of all recorded frames in bytes.
+                 */
+                uint_fast64_t totalBytes;
+
+                /**
+                 * The number of frames per block size.
+                 */
+                std::map<int_fast32_t, uint_fast64_t> blockSizes;
+
+                /**
+                 * The number of frames per channel assignment (0 to 7 for independent channels, 8 for left/side, 9 for
+                 * side/right, 10 for mid/side).
+                 */
+                uint_fast64_t channelAssignments[11];
+
+                /**
+                 * The number of subframes per subframe type code, which encodes both the predictor and its order
+                 * (0 constant, 1 verbatim, 8 to 12 fixed order 0 to 4, 32 to 63 LPC order 1 to 32).
+                 */
+                uint_fast64_t subframeTypes[64];
+
+                /**
+                 * The number of Rice-coded subframes per partition order.
+                 */
+                uint_fast64_t riceOrders[16];
+
+                /**
+                 * Constructs an empty set of statistics.
+                 */
+                EncoderStats();
+
+                /**
+                 * Clears all statistics.
+                 */
+                void reset();
+
+                /**
+                 * Adds the given time to a stage of the frame currently being encoded.
+                 * @param[in] stage   the stage
+                 * @param[in] seconds the time to add
+                 */
+                void addTime(Stage stage, double seconds);
+
+                /**
+                 * Records the decisions of the given frame encoder and the times added since the previous frame, and
+                 * starts a new frame.
+                 * @param[in] enc        the encoder of the frame which was just written (not `null`)
+                 * @param[in] frameBytes the size of the written frame in bytes
+                 */
+                void endFrame(const FrameEncoder *enc, uint_fast64_t frameBytes);
+
+                /**
+                 * Adds all the statistics of the given object to this one.
+                 * @param[in] other the statistics to add
+                 */
+                void add(const EncoderStats &other);
+
+                /**
+                 * Writes all statistics as a JSON object.
+                 * @param[in,out] out the stream to write to
+                 */
+                void writeJson(std::ostream &out) const;
+
+                /**
+                 * Returns the name of the given stage in lowercase, such as `rice`.
+                 * @param[in] stage the stage
+                 * @return the name of the stage
+                 */
+                static const char *getStageName(Stage stage);
+
+            private:
+                /**
+                 * The times added to each stage of the current frame, in seconds.
+                 */
+                double frameSeconds[NUM_STAGES];
+
+                /**
+                 * Returns the logarithmic histogram bucket of the given value.
+                 */
+                static int_fast32_t getBucket(uint_fast64_t val);
+            };
+        }
+    }
+}
+
+#endif
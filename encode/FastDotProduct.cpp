@@ -0,0 +1,68 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#include "FastDotProduct.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "../common/Kernels.h"
+#include "../common/MemoryAccount.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Encode {
+            FastDotProduct::FastDotProduct(const int_fast64_t data[], uint_fast32_t length, int_fast32_t maxDelta) {
+                if (data == nullptr)
+                    throw std::invalid_argument("Data cannot be null");
+                if (maxDelta < 0 || maxDelta > 32)
+                    throw std::invalid_argument("Invalid maximum delta");
+                this->data = data;
+                this->length = length;
+                this->maxDelta = maxDelta;
+                precomputed = Common::MemoryAccount::allocateCurrent<double>(maxDelta + 1);
+                Common::Kernels::get().autocorrelate(data, length, maxDelta, precomputed);
+            }
+
+            FastDotProduct::~FastDotProduct() {
+                Common::MemoryAccount::deallocate(precomputed);
+            }
+
+            double FastDotProduct::dotProduct(uint_fast32_t off0, uint_fast32_t off1, uint_fast32_t len) const {
+                if (off0 > off1)
+                    std::swap(off0, off1);
+                uint_fast32_t delta = off1 - off0;
+                if (delta > (uint_fast32_t)maxDelta || off1 > length || len > length - off1)
+                    throw std::invalid_argument("Dot product range out of bounds");
+
+                // Start with the full autocorrelation, then subtract the head and tail terms outside the range
+                double result = precomputed[delta];
+                for (uint_fast32_t i = 0; i < off0; i++)
+                    result -= (double)data[i] * data[i + delta];
+                for (uint_fast32_t i = off0 + len; i + delta < length; i++)
+                    result -= (double)data[i] * data[i + delta];
+                return result;
+            }
+        }
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#ifndef NAYUKI_FASTDOTPRODUCT_H
+#define NAYUKI_FASTDOTPRODUCT_H
+
+#include <cstdint>
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Encode {
+            /**
+             * Computes dot products of a sample array with shifted versions of itself, reusing precomputed
+             * autocorrelation sums so that each query only costs time proportional to the shift instead of the array
+             * length. Used for setting up the least squares problem of linear predictive coding.
+             */
+            class FastDotProduct final {
+            private:
+                /**
+                 * The samples, not owned by this object.
+                 */
+                const int_fast64_t *data;
+
+                /**
+                 * The number of samples in `data`.
+                 */
+                uint_fast32_t length;
+
+                /**
+                 * The highest difference between the two offsets of a dot product.
+                 */
+                int_fast32_t maxDelta;
+
+                /**
+                 * `precomputed[i]` is the dot product of `data[0 : length - i]` with `data[i : length]`.
+                 */
+                double *precomputed;
+
+            public:
+                /**
+                 * Precomputes the autocorrelation sums of the given array. The array is not copied, so it must stay
+                 * alive and unchanged for the lifetime of this object.
+                 * @param[in] data     the samples to compute dot products of (not `null`)
+                 * @param[in] length   the number of samples
+                 * @param[in] maxDelta the highest offset difference that will be queried, in the range [0, 32]
+                 */
+                FastDotProduct(const int_fast64_t data[], uint_fast32_t length, int_fast32_t maxDelta);
+
+                ~FastDotProduct();
+
+                FastDotProduct(const FastDotProduct &) = delete;
+
+                FastDotProduct &operator=(const FastDotProduct &) = delete;
+
+                /**
+                 * Returns the dot product of `data[off0 : off0 + len]` with `data[off1 : off1 + len]`. The offsets
+                 * must differ by at most `maxDelta`, and both ranges must lie within the array.
+                 * @param[in] off0 the start of the first range
+                 * @param[in] off1 the start of the second range
+                 * @param[in] len  the length of both ranges
+                 * @return the dot product of both ranges
+                 */
+                double dotProduct(uint_fast32_t off0, uint_fast32_t off1, uint_fast32_t len) const;
+            };
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#include "FixedPredictionEncoder.h"
+
+#include <stdexcept>
+
+#include "LinearPredictiveEncoder.h"
+#include "RiceEncoder.h"
+
+#include "../common/MemoryAccount.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Encode {
+            const int_fast32_t FixedPredictionEncoder::COEFFICIENTS[5][4] = {
+                {},
+                {1},
+                {2, -1},
+                {3, -3, 1},
+                {4, -6, 4, -1}
+            };
+
+            SizeEstimate<SubframeEncoder>
+            FixedPredictionEncoder::computeBest(const int_fast64_t samples[], uint_fast32_t numSamples,
+                                                int_fast32_t shift, int_fast32_t depth, int_fast32_t order,
+                                                int_fast32_t maxRiceOrder, EncoderStats *stats) {
+                auto *enc = new FixedPredictionEncoder(numSamples, shift, depth, order);
+                EncoderStats::StageTimer residualTimer(stats, EncoderStats::Stage::RESIDUAL);
+                int_fast64_t *residuals = shiftRight(samples, numSamples, shift);
+                LinearPredictiveEncoder::applyLpc(residuals, numSamples, COEFFICIENTS[order], order, 0, depth - shift);
+                residualTimer.stop();
+                EncoderStats::StageTimer riceTimer(stats, EncoderStats::Stage::RICE);
+                uint_fast64_t temp = RiceEncoder::computeBestSizeAndOrder(residuals, numSamples, order, maxRiceOrder);
+                riceTimer.stop();
+                Common::MemoryAccount::deallocate(residuals);
+                enc->riceOrder = (int_fast32_t)(temp & 0xF);
+                uint_fast64_t size = 1 + 6 + 1 + shift + (uint_fast64_t)order * (depth - shift) + (temp >> 4);
+                return SizeEstimate<SubframeEncoder>(size, enc);
+            }
+
+            FixedPredictionEncoder::FixedPredictionEncoder(uint_fast32_t numSamples, int_fast32_t shift,
+                                                           int_fast32_t depth, int_fast32_t order)
+                    : SubframeEncoder(shift, depth) {
+                if (order < 0 || order > 4 || numSamples < (uint_fast32_t)order)
+                    throw std::invalid_argument("Invalid prediction order");
+                this->order = order;
+                riceOrder = -1;
+            }
+
+            void FixedPredictionEncoder::encode(const int_fast64_t samples[], uint_fast32_t numSamples,
+                                                BitOutputStream *out) {
+                int_fast64_t *residuals = shiftRight(samples, numSamples, sampleShift);
+                writeTypeAndShift(8 + order, out);
+                for (int_fast32_t i = 0; i < order; i++)  // Warmup
+                    writeRawSample(residuals[i], sampleDepth - sampleShift, out);
+                LinearPredictiveEncoder::applyLpc(residuals, numSamples, COEFFICIENTS[order], order, 0,
+                                                  sampleDepth - sampleShift);
+                RiceEncoder::encode(residuals, numSamples, order, riceOrder, out);
+                Common::MemoryAccount::deallocate(residuals);
+            }
+
+            int_fast32_t FixedPredictionEncoder::getType() const {
+                return 8 + order;
+            }
+
+            int_fast32_t FixedPredictionEncoder::getRiceOrder() const {
+                return riceOrder;
+            }
+        }
+    }
+}
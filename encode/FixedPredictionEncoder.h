@@ -0,0 +1,90 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#ifndef NAYUKI_FIXEDPREDICTIONENCODER_H
+#define NAYUKI_FIXEDPREDICTIONENCODER_H
+
+#include "SubframeEncoder.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Encode {
+            /**
+             * Under the fixed prediction coding mode of some order, a subframe is encoded as `order` raw warm-up
+             * samples followed by the Rice-coded residuals of one of the fixed polynomial predictors.
+             */
+            class FixedPredictionEncoder final : public SubframeEncoder {
+            private:
+                /**
+                 * The coefficients of the fixed predictors, indexed by order.
+                 */
+                static const int_fast32_t COEFFICIENTS[5][4];
+
+                /**
+                 * The prediction order, in the range [0, 4].
+                 */
+                int_fast32_t order;
+
+            public:
+                /**
+                 * The Rice partition order to encode the residuals with, in the range [0, 15].
+                 */
+                int_fast32_t riceOrder;
+
+                /**
+                 * Returns the size estimate of encoding the given samples with the fixed predictor of the given order.
+                 * @param[in] samples      the samples of one channel (not `null`)
+                 * @param[in] numSamples   the number of samples, at least `order`
+                 * @param[in] shift        the number of wasted bits
+                 * @param[in] depth        the bit depth of the samples, in the range [1, 33]
+                 * @param[in] order        the prediction order, in the range [0, 4]
+                 * @param[in] maxRiceOrder the highest Rice partition order to try
+                 * @param[in] stats        the sink to add stage timings to, or `null`
+                 * @return the size estimate with a new fixed prediction encoder
+                 */
+                static SizeEstimate<SubframeEncoder>
+                computeBest(const int_fast64_t samples[], uint_fast32_t numSamples, int_fast32_t shift,
+                            int_fast32_t depth, int_fast32_t order, int_fast32_t maxRiceOrder,
+                            EncoderStats *stats = nullptr);
+
+                /**
+                 * Constructs a fixed prediction encoder of the given order.
+                 * @param[in] numSamples the number of samples that will be encoded, at least `order`
+                 * @param[in] shift      the number of wasted bits
+                 * @param[in] depth      the bit depth of the samples, in the range [1, 33]
+                 * @param[in] order      the prediction order, in the range [0, 4]
+                 */
+                FixedPredictionEncoder(uint_fast32_t numSamples, int_fast32_t shift, int_fast32_t depth,
+                                       int_fast32_t order);
+
+                virtual void encode(const int_fast64_t samples[], uint_fast32_t numSamples, BitOutputStream *out);
+
+                virtual int_fast32_t getType() const;
+
+                virtual int_fast32_t getRiceOrder() const;
+            };
+        }
+    }
+}
+
+#endif
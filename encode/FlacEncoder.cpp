@@ -0,0 +1,322 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#include "FlacEncoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FrameEncoder.h"
+
+#include "../common/FrameArena.h"
+#include "../common/MemoryAccount.h"
+#include "../common/PlanarBuffer.h"
+#include "../common/Probes.h"
+#include "../common/SpscRing.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Encode {
+            namespace {
+                /**
+                 * Returns the initial size of the arena serving a frame's scratch memory: the mid/side and residual
+                 * candidates and the encoder objects, with headroom for the search's smaller temporaries.
+                 */
+                size_t getArenaSize(int_fast32_t numChannels, int_fast32_t blockSize) {
+                    return (size_t)(numChannels + 10) * blockSize * sizeof(int_fast64_t) + 65536;
+                }
+
+                /**
+                 * The state of one frame in flight while encoding in parallel, passed from stage to stage. Every slot
+                 * has its own memory account, statistics and output buffer, so the tasks share nothing mutable.
+                 */
+                class FrameSlot final {
+                public:
+                    /**
+                     * The account charged with the slot's memory.
+                     */
+                    Common::MemoryAccount memory;
+
+                    /**
+                     * The samples of the frame, widened.
+                     */
+                    Common::PlanarBuffer<int_fast64_t> subsamples;
+
+                    /**
+                     * Serves the frame's scratch memory.
+                     */
+                    Common::FrameArena arena;
+
+                    /**
+                     * The encoded frame.
+                     */
+                    std::ostringstream bytes;
+
+                    /**
+                     * The statistics of the frame, merged into the caller's sink in frame order.
+                     */
+                    EncoderStats stats;
+
+                    /**
+                     * The offset of the frame's first sample in the stream.
+                     */
+                    uint_fast64_t position;
+
+                    /**
+                     * The number of samples per channel of the frame.
+                     */
+                    int_fast32_t numSamples;
+
+                    /**
+                     * Whether `bytes` holds the encoded frame (or `error` is set), released by the encoding task.
+                     */
+                    std::atomic<bool> encoded;
+
+                    /**
+                     * The exception thrown while encoding the frame, or `null`.
+                     */
+                    std::exception_ptr error;
+
+                    FrameSlot(int_fast32_t numChannels, int_fast32_t blockSize) :
+                            subsamples(&memory, numChannels, (size_t)blockSize),
+                            arena(getArenaSize(numChannels, blockSize), &memory),
+                            bytes(std::ios::out | std::ios::binary) {
+                        position = 0;
+                        numSamples = 0;
+                        encoded = false;
+                    }
+                };
+            }
+
+            FlacEncoder::FlacEncoder(Common::StreamInfo *info, int_fast32_t *samples[], uint_fast64_t numSamples,
+                                     int_fast32_t blockSize, const SubframeEncoder::SearchOptions &opt,
+                                     BitOutputStream *out, EncoderStats *stats, Common::ThreadPool *pool) {
+                if (info == nullptr || samples == nullptr || out == nullptr)
+                    throw std::invalid_argument("Stream info, samples and output stream cannot be null");
+                if (blockSize < 16 || blockSize > 65535)
+                    throw std::invalid_argument("Invalid block size");
+                info->minBlockSize = blockSize;
+                info->maxBlockSize = blockSize;
+                info->minFrameSize = 0;
+                info->maxFrameSize = 0;
+                if (pool == nullptr || numSamples == 0)  // Without frames there is nothing to spread over the pool
+                    encodeSerial(info, samples, numSamples, blockSize, opt, out, stats);
+                else
+                    encodeParallel(info, samples, numSamples, blockSize, opt, out, stats, pool);
+            }
+
+            void FlacEncoder::encodeSerial(Common::StreamInfo *info, int_fast32_t *samples[], uint_fast64_t numSamples,
+                                           int_fast32_t blockSize, const SubframeEncoder::SearchOptions &opt,
+                                           BitOutputStream *out, EncoderStats *stats) {
+                Common::MemoryAccount::Scope scope(&memory);
+                Common::PlanarBuffer<int_fast64_t> subsamples(&memory, info->numChannels, (size_t)blockSize);
+                Common::FrameArena arena(getArenaSize(info->numChannels, blockSize), &memory);
+                Common::FrameArena::Scope arenaScope(&arena);
+
+                for (uint_fast64_t pos = 0; pos < numSamples; ) {
+                    auto n = (int_fast32_t)std::min(numSamples - pos, (uint_fast64_t)blockSize);
+                    NAYUKI_PROBE2(encode_frame_start, pos, n);
+                    EncoderStats::StageTimer analysisTimer(stats, EncoderStats::Stage::ANALYSIS);
+                    getRange(samples, info->numChannels, pos, n, subsamples.getChannels());
+                    analysisTimer.stop();
+                    SizeEstimate<FrameEncoder> est = FrameEncoder::computeBest(
+                            pos, subsamples.getChannels(), info->numChannels, n, info->sampleDepth, info->sampleRate,
+                            opt, stats);
+                    uint_fast64_t startByte = out->getByteCount();
+                    EncoderStats::StageTimer serializationTimer(stats, EncoderStats::Stage::SERIALIZATION);
+                    est.encoder->encode(subsamples.getChannels(), out);
+                    serializationTimer.stop();
+
+                    uint_fast64_t frameSize = out->getByteCount() - startByte;
+                    NAYUKI_PROBE3(encode_frame_done, pos, n, frameSize);
+                    if (stats != nullptr)
+                        stats->endFrame(est.encoder, frameSize);
+                    delete est.encoder;
+                    updateFrameSizes(info, frameSize);
+                    pos += n;
+                    arena.reset();
+                }
+            }
+
+            void FlacEncoder::encodeParallel(Common::StreamInfo *info, int_fast32_t *samples[],
+                                             uint_fast64_t numSamples, int_fast32_t blockSize,
+                                             const SubframeEncoder::SearchOptions &opt, BitOutputStream *out,
+                                             EncoderStats *stats, Common::ThreadPool *pool) {
+                // Enough frames in flight to keep every worker busy while the oldest frame is being written
+                uint_fast64_t numFrames = (numSamples + blockSize - 1) / blockSize;
+                auto numSlots = (size_t)std::min((uint_fast64_t)pool->getSize() * 2 + 2, numFrames);
+                std::vector<std::unique_ptr<FrameSlot>> slots;
+                Common::SpscRing<FrameSlot> emptySlots(numSlots);
+                Common::SpscRing<FrameSlot> encodingSlots(numSlots);
+                for (size_t i = 0; i < numSlots; i++) {
+                    slots.emplace_back(new FrameSlot(info->numChannels, blockSize));
+                    emptySlots.push(slots.back().get());
+                }
+                auto pcmBytesPerSample = (uint_fast64_t)info->numChannels * ((info->sampleDepth + 7) / 8);
+
+                // The output stage writes the frames in order and hands their slots back for reuse
+                std::exception_ptr outputError;
+                std::thread outputThread([&] {
+                    try {
+                        while (true) {
+                            std::chrono::steady_clock::duration waited(0);
+                            FrameSlot *slot = encodingSlots.pop(&waited);
+                            if (slot == nullptr)
+                                break;
+                            if (!slot->encoded.load(std::memory_order_acquire)) {
+                                auto start = std::chrono::steady_clock::now();
+                                Common::Backoff backoff;
+                                while (!slot->encoded.load(std::memory_order_acquire))
+                                    backoff.pause();
+                                waited += std::chrono::steady_clock::now() - start;
+                            }
+                            pipelineStats.addStall(Common::PipelineStats::Stage::OUTPUT, waited);
+                            if (slot->error != nullptr)
+                                std::rethrow_exception(slot->error);
+
+                            auto start = std::chrono::steady_clock::now();
+                            std::string bytes = slot->bytes.str();
+                            out->writeBytes(reinterpret_cast<const uint_fast8_t *>(bytes.data()), bytes.size());
+                            updateFrameSizes(info, bytes.size());
+                            if (stats != nullptr) {
+                                stats->add(slot->stats);
+                                slot->stats.reset();
+                            }
+                            pipelineStats.addWork(Common::PipelineStats::Stage::OUTPUT, bytes.size(),
+                                                  std::chrono::steady_clock::now() - start);
+                            emptySlots.push(slot);
+                        }
+                    } catch (...) {
+                        outputError = std::current_exception();
+                        emptySlots.close();
+                    }
+                });
+
+                // This thread is the input stage, handing out blocks of samples to encoding tasks
+                try {
+                    Common::ThreadPool::TaskGroup group(pool);
+                    for (uint_fast64_t pos = 0; pos < numSamples; pos += blockSize) {
+                        std::chrono::steady_clock::duration waited(0);
+                        FrameSlot *slot = emptySlots.pop(&waited);
+                        pipelineStats.addStall(Common::PipelineStats::Stage::INPUT, waited);
+                        if (slot == nullptr)
+                            break;  // The output stage failed
+                        auto start = std::chrono::steady_clock::now();
+                        auto n = (int_fast32_t)std::min(numSamples - pos, (uint_fast64_t)blockSize);
+                        slot->position = pos;
+                        slot->numSamples = n;
+                        EncoderStats::StageTimer analysisTimer(stats != nullptr ? &slot->stats : nullptr,
+                                                               EncoderStats::Stage::ANALYSIS);
+                        getRange(samples, info->numChannels, pos, n, slot->subsamples.getChannels());
+                        analysisTimer.stop();
+                        pipelineStats.addWork(Common::PipelineStats::Stage::INPUT, n * pcmBytesPerSample,
+                                              std::chrono::steady_clock::now() - start);
+
+                        slot->encoded.store(false, std::memory_order_relaxed);
+                        group.run([=, &opt] {
+                            try {
+                                auto taskStart = std::chrono::steady_clock::now();
+                                EncoderStats *frameStats = stats != nullptr ? &slot->stats : nullptr;
+                                Common::MemoryAccount::Scope scope(&slot->memory);
+                                Common::FrameArena::Scope arenaScope(&slot->arena);
+                                NAYUKI_PROBE2(encode_frame_start, slot->position, slot->numSamples);
+                                SizeEstimate<FrameEncoder> est = FrameEncoder::computeBest(
+                                        slot->position, slot->subsamples.getChannels(), info->numChannels,
+                                        slot->numSamples, info->sampleDepth, info->sampleRate, opt, frameStats);
+                                slot->bytes.str(std::string());
+                                BitOutputStream frameOut(&slot->bytes);
+                                EncoderStats::StageTimer serializationTimer(frameStats,
+                                                                            EncoderStats::Stage::SERIALIZATION);
+                                est.encoder->encode(slot->subsamples.getChannels(), &frameOut);
+                                frameOut.flush();
+                                serializationTimer.stop();
+
+                                uint_fast64_t frameSize = frameOut.getByteCount();
+                                NAYUKI_PROBE3(encode_frame_done, slot->position, slot->numSamples, frameSize);
+                                if (frameStats != nullptr)
+                                    frameStats->endFrame(est.encoder, frameSize);
+                                delete est.encoder;
+                                slot->arena.reset();
+                                pipelineStats.addWork(Common::PipelineStats::Stage::CODEC, frameSize,
+                                                      std::chrono::steady_clock::now() - taskStart);
+                            } catch (...) {
+                                slot->error = std::current_exception();
+                            }
+                            slot->encoded.store(true, std::memory_order_release);
+                        });
+                        encodingSlots.push(slot);
+                    }
+                    encodingSlots.close();
+                    group.wait();
+                } catch (...) {
+                    encodingSlots.close();
+                    outputThread.join();
+                    throw;
+                }
+                outputThread.join();
+                if (outputError != nullptr)
+                    std::rethrow_exception(outputError);
+
+                // The slots' accounts cannot have this encoder's as parent, since accounts are not thread-safe
+                uint_fast64_t peak = 0;
+                for (const std::unique_ptr<FrameSlot> &slot : slots)
+                    peak += slot->memory.getPeakBytes();
+                memory.charge(peak);
+                memory.release(peak);
+            }
+
+            const Common::PipelineStats &FlacEncoder::getPipelineStats() const {
+                return pipelineStats;
+            }
+
+            const Common::MemoryAccount &FlacEncoder::getMemory() const {
+                return memory;
+            }
+
+            void FlacEncoder::getRange(int_fast32_t *array[], int_fast32_t numChannels, uint_fast64_t off,
+                                       int_fast32_t len, int_fast64_t *result[]) {
+                for (int_fast32_t i = 0; i < numChannels; i++) {
+                    int_fast32_t *src = array[i];
+                    int_fast64_t *dest = result[i];
+                    for (int_fast32_t j = 0; j < len; j++)
+                        dest[j] = src[off + j];
+                }
+            }
+
+            void FlacEncoder::updateFrameSizes(Common::StreamInfo *info, uint_fast64_t frameSize) {
+                if (info->minFrameSize == 0 || frameSize < info->minFrameSize)
+                    info->minFrameSize = (uint_fast32_t)frameSize;
+                if (frameSize > info->maxFrameSize)
+                    info->maxFrameSize = (uint_fast32_t)frameSize;
+            }
+        }
+    }
+}
@@ -0,0 +1,128 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#ifndef NAYUKI_FLACENCODER_H
+#define NAYUKI_FLACENCODER_H
+
+#include <cstdint>
+
+#include "BitOutputStream.h"
+#include "EncoderStats.h"
+#include "SubframeEncoder.h"
+
+#include "../common/MemoryAccount.h"
+#include "../common/PipelineStats.h"
+#include "../common/StreamInfo.h"
+#include "../common/ThreadPool.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Encode {
+            /**
+             * Encodes a whole audio stream as a sequence of FLAC frames with a constant block size. The caller is
+             * responsible for writing the magic string and the metadata blocks before the frames.
+             */
+            class FlacEncoder final {
+            private:
+                /**
+                 * The account all memory used while encoding is charged to.
+                 */
+                Common::MemoryAccount memory;
+
+                /**
+                 * The counters of the pipeline stages when encoding in parallel.
+                 */
+                Common::PipelineStats pipelineStats;
+
+                /**
+                 * Copies a range of samples from every channel into the given arrays of a wider type.
+                 * @param[in]  array       the samples, where each subarray is a channel (all not `null`)
+                 * @param[in]  numChannels the number of channels
+                 * @param[in]  off         the offset of the first sample to copy
+                 * @param[in]  len         the number of samples per channel to copy
+                 * @param[out] result      the arrays to copy into, one per channel with room for `len` samples
+                 */
+                static void getRange(int_fast32_t *array[], int_fast32_t numChannels, uint_fast64_t off,
+                                     int_fast32_t len, int_fast64_t *result[]);
+
+                /**
+                 * Encodes the frames one after another on the calling thread. See the constructor for the parameters.
+                 */
+                void encodeSerial(Common::StreamInfo *info, int_fast32_t *samples[], uint_fast64_t numSamples,
+                                  int_fast32_t blockSize, const SubframeEncoder::SearchOptions &opt,
+                                  BitOutputStream *out, EncoderStats *stats);
+
+                /**
+                 * Encodes the frames as a pipeline: the calling thread copies the samples of each frame into a slot,
+                 * the pool encodes every slot into its own buffer, and an output thread writes the buffers in order
+                 * and hands the slots back. The slots are passed between the stages through lock-free rings. See the
+                 * constructor for the parameters.
+                 */
+                void encodeParallel(Common::StreamInfo *info, int_fast32_t *samples[], uint_fast64_t numSamples,
+                                    int_fast32_t blockSize, const SubframeEncoder::SearchOptions &opt,
+                                    BitOutputStream *out, EncoderStats *stats, Common::ThreadPool *pool);
+
+                /**
+                 * Includes a frame of the given size in the minimum and maximum frame sizes of the given stream info.
+                 * @param[in,out] info      the stream info to update (not `null`)
+                 * @param[in]     frameSize the size of the frame in bytes
+                 */
+                static void updateFrameSizes(Common::StreamInfo *info, uint_fast64_t frameSize);
+
+            public:
+                /**
+                 * Encodes all the given samples as frames to the given output stream, and updates the block size and
+                 * frame size fields of the given stream info to describe the encoded frames. The stream info's sample
+                 * rate, number of channels and sample depth must already be set.
+                 * @param[in,out] info       the stream info of the stream being encoded (not `null`)
+                 * @param[in]     samples    the samples, where each subarray is a channel (all not `null`)
+                 * @param[in]     numSamples the number of samples per channel
+                 * @param[in]     blockSize  the number of samples per channel in each frame, in the range [16, 65535]
+                 * @param[in]     opt        the search options to use
+                 * @param[in,out] out        the output stream to write to (not `null`)
+                 * @param[in,out] stats      the sink to record per-frame timings and decisions into, or `null`
+                 * @param[in,out] pool       the pool to encode frames on in parallel, or `null` to encode on the
+                 * calling thread; the output is the same either way
+                 */
+                FlacEncoder(Common::StreamInfo *info, int_fast32_t *samples[], uint_fast64_t numSamples,
+                            int_fast32_t blockSize, const SubframeEncoder::SearchOptions &opt,
+                            BitOutputStream *out, EncoderStats *stats = nullptr, Common::ThreadPool *pool = nullptr);
+
+                /**
+                 * Returns the heap usage of the encoding, whose peak tells how much scratch memory the search needed.
+                 * When encoding in parallel, the peak is the sum of the peaks of all frames in flight.
+                 * @return the memory account of this encoder
+                 */
+                const Common::MemoryAccount &getMemory() const;
+
+                /**
+                 * Returns the per-stage counters of the encoding, which are all zero unless it ran on a pool.
+                 * @return the pipeline counters
+                 */
+                const Common::PipelineStats &getPipelineStats() const;
+            };
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,183 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#include "FrameEncoder.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "../common/PlanarBuffer.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Encode {
+            SizeEstimate<FrameEncoder>
+            FrameEncoder::computeBest(uint_fast64_t sampleOffset, int_fast64_t *samples[], int_fast32_t numChannels,
+                                      int_fast32_t blockSize, int_fast32_t sampleDepth, int_fast32_t sampleRate,
+                                      const SubframeEncoder::SearchOptions &opt, EncoderStats *stats) {
+                auto *enc = new FrameEncoder(sampleOffset, numChannels, blockSize, sampleDepth, sampleRate);
+                uint_fast64_t size = 0;
+                if (numChannels != 2) {
+                    enc->metadata.channelAssignment = numChannels - 1;
+                    for (int_fast32_t i = 0; i < numChannels; i++) {
+                        SizeEstimate<SubframeEncoder> temp =
+                                SubframeEncoder::computeBest(samples[i], blockSize, sampleDepth, opt, stats);
+                        enc->subEncoders[i] = temp.encoder;
+                        size += temp.sizeEstimate;
+                    }
+                } else {  // Explore the 4 stereo encoding modes
+                    int_fast64_t *left  = samples[0];
+                    int_fast64_t *right = samples[1];
+                    EncoderStats::StageTimer timer(stats, EncoderStats::Stage::ANALYSIS);
+                    Common::PlanarBuffer<int_fast64_t> midSide(nullptr, 2, (size_t)blockSize);
+                    int_fast64_t *mid  = midSide.getChannel(0);
+                    int_fast64_t *side = midSide.getChannel(1);
+                    for (int_fast32_t i = 0; i < blockSize; i++) {
+                        mid[i] = (left[i] + right[i]) >> 1;
+                        side[i] = left[i] - right[i];
+                    }
+                    timer.stop();
+                    SizeEstimate<SubframeEncoder> leftInfo  = SubframeEncoder::computeBest(left , blockSize, sampleDepth, opt, stats);
+                    SizeEstimate<SubframeEncoder> rightInfo = SubframeEncoder::computeBest(right, blockSize, sampleDepth, opt, stats);
+                    SizeEstimate<SubframeEncoder> midInfo   = SubframeEncoder::computeBest(mid  , blockSize, sampleDepth, opt, stats);
+                    SizeEstimate<SubframeEncoder> sideInfo  = SubframeEncoder::computeBest(side , blockSize, sampleDepth + 1, opt, stats);
+                    uint_fast64_t mode1Size  = leftInfo.sizeEstimate + rightInfo.sizeEstimate;
+                    uint_fast64_t mode8Size  = leftInfo.sizeEstimate + sideInfo.sizeEstimate;
+                    uint_fast64_t mode9Size  = rightInfo.sizeEstimate + sideInfo.sizeEstimate;
+                    uint_fast64_t mode10Size = midInfo.sizeEstimate + sideInfo.sizeEstimate;
+                    uint_fast64_t minimum = std::min(std::min(mode1Size, mode8Size), std::min(mode9Size, mode10Size));
+                    SubframeEncoder *unused[2];
+                    if (mode1Size == minimum) {
+                        enc->metadata.channelAssignment = 1;
+                        enc->subEncoders[0] = leftInfo.encoder;
+                        enc->subEncoders[1] = rightInfo.encoder;
+                        unused[0] = midInfo.encoder;
+                        unused[1] = sideInfo.encoder;
+                    } else if (mode8Size == minimum) {
+                        enc->metadata.channelAssignment = 8;
+                        enc->subEncoders[0] = leftInfo.encoder;
+                        enc->subEncoders[1] = sideInfo.encoder;
+                        unused[0] = midInfo.encoder;
+                        unused[1] = rightInfo.encoder;
+                    } else if (mode9Size == minimum) {
+                        enc->metadata.channelAssignment = 9;
+                        enc->subEncoders[0] = sideInfo.encoder;
+                        enc->subEncoders[1] = rightInfo.encoder;
+                        unused[0] = midInfo.encoder;
+                        unused[1] = leftInfo.encoder;
+                    } else {
+                        enc->metadata.channelAssignment = 10;
+                        enc->subEncoders[0] = midInfo.encoder;
+                        enc->subEncoders[1] = sideInfo.encoder;
+                        unused[0] = leftInfo.encoder;
+                        unused[1] = rightInfo.encoder;
+                    }
+                    delete unused[0];
+                    delete unused[1];
+                    size = minimum;
+                }
+
+                // Count length of header (always in whole bytes)
+                EncoderStats::StageTimer timer(stats, EncoderStats::Stage::SERIALIZATION);
+                BitOutputStream bitout(nullptr);
+                enc->metadata.writeHeader(&bitout);
+                size += bitout.getByteCount() * 8;
+
+                // Count padding and footer
+                size = (size + 7) / 8;  // Round up to nearest byte
+                size += 2;  // CRC-16
+                return SizeEstimate<FrameEncoder>(size, enc);
+            }
+
+            FrameEncoder::FrameEncoder(uint_fast64_t sampleOffset, int_fast32_t numChannels, int_fast32_t blockSize,
+                                       int_fast32_t sampleDepth, int_fast32_t sampleRate) {
+                if (numChannels < 1 || numChannels > 8)
+                    throw std::invalid_argument("Invalid number of channels");
+                if (blockSize < 1 || blockSize > 65536)
+                    throw std::invalid_argument("Invalid block size");
+                metadata.sampleOffset = sampleOffset;
+                metadata.numChannels = numChannels;
+                metadata.channelAssignment = numChannels - 1;
+                metadata.blockSize = blockSize;
+                metadata.sampleDepth = sampleDepth;
+                metadata.sampleRate = sampleRate;
+                std::fill(subEncoders, subEncoders + 8, nullptr);
+            }
+
+            FrameEncoder::~FrameEncoder() {
+                for (SubframeEncoder *subEnc : subEncoders)
+                    delete subEnc;
+            }
+
+            const Common::FrameInfo &FrameEncoder::getMetadata() const {
+                return metadata;
+            }
+
+            const SubframeEncoder *FrameEncoder::getSubframeEncoder(int_fast32_t index) const {
+                if (index < 0 || index >= metadata.numChannels)
+                    throw std::out_of_range("Subframe index out of range");
+                return subEncoders[index];
+            }
+
+            void FrameEncoder::encode(int_fast64_t *samples[], BitOutputStream *out) {
+                // Check arguments
+                if (samples == nullptr)
+                    throw std::invalid_argument("Samples cannot be null");
+                if (out == nullptr)
+                    throw std::invalid_argument("Output stream cannot be null");
+
+                metadata.writeHeader(out);
+
+                int_fast32_t chanAsgn = metadata.channelAssignment;
+                int_fast32_t blockSize = metadata.blockSize;
+                if (0 <= chanAsgn && chanAsgn <= 7) {
+                    for (int_fast32_t i = 0; i < metadata.numChannels; i++)
+                        subEncoders[i]->encode(samples[i], blockSize, out);
+                } else if (8 <= chanAsgn && chanAsgn <= 10) {
+                    int_fast64_t *left  = samples[0];
+                    int_fast64_t *right = samples[1];
+                    Common::PlanarBuffer<int_fast64_t> midSide(nullptr, 2, (size_t)blockSize);
+                    int_fast64_t *mid  = midSide.getChannel(0);
+                    int_fast64_t *side = midSide.getChannel(1);
+                    for (int_fast32_t i = 0; i < blockSize; i++) {
+                        mid[i] = (left[i] + right[i]) >> 1;
+                        side[i] = left[i] - right[i];
+                    }
+                    if (chanAsgn == 8) {
+                        subEncoders[0]->encode(left, blockSize, out);
+                        subEncoders[1]->encode(side, blockSize, out);
+                    } else if (chanAsgn == 9) {
+                        subEncoders[0]->encode(side, blockSize, out);
+                        subEncoders[1]->encode(right, blockSize, out);
+                    } else {
+                        subEncoders[0]->encode(mid, blockSize, out);
+                        subEncoders[1]->encode(side, blockSize, out);
+                    }
+                } else
+                    throw std::logic_error("Invalid channel assignment");
+                out->alignToByte();
+                out->writeInt(16, out->getCrc16());
+            }
+        }
+    }
+}
@@ -0,0 +1,136 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#ifndef NAYUKI_FRAMEENCODER_H
+#define NAYUKI_FRAMEENCODER_H
+
+#include <cstdint>
+
+#include "BitOutputStream.h"
+#include "EncoderStats.h"
+#include "SizeEstimate.h"
+#include "SubframeEncoder.h"
+
+#include "../common/FrameInfo.h"
+#include "../common/MemoryAccount.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Encode {
+            /**
+             * Encodes a whole frame (i.e. one block of samples for every channel), choosing the stereo decorrelation
+             * mode and the subframe encoders which result in the smallest size.
+             */
+            class FrameEncoder final {
+            private:
+                /**
+                 * The frame header fields to write.
+                 */
+                Common::FrameInfo metadata;
+
+                /**
+                 * One subframe encoder per channel (in the order they are written), owned by this object.
+                 */
+                SubframeEncoder *subEncoders[8];
+
+            public:
+                /**
+                 * Computes the best way to encode the given block of samples, returning the frame encoder and the
+                 * estimated frame size in bytes (including header and footer). The returned encoder must be deleted
+                 * by the caller.
+                 * @param[in] sampleOffset the offset of the first sample of this block in the stream
+                 * @param[in] samples      the samples, where each subarray is a channel (all not `null`)
+                 * @param[in] numChannels  the number of channels, in the range [1, 8]
+                 * @param[in] blockSize    the number of samples per channel, in the range [1, 65536]
+                 * @param[in] sampleDepth  the bit depth of the samples, in the range [1, 32]
+                 * @param[in] sampleRate   the sample rate in hertz
+                 * @param[in] opt          the search options to use
+                 * @param[in] stats        the sink to add stage timings to, or `null`
+                 * @return the best size estimate found
+                 */
+                static SizeEstimate<FrameEncoder>
+                computeBest(uint_fast64_t sampleOffset, int_fast64_t *samples[], int_fast32_t numChannels,
+                            int_fast32_t blockSize, int_fast32_t sampleDepth, int_fast32_t sampleRate,
+                            const SubframeEncoder::SearchOptions &opt, EncoderStats *stats = nullptr);
+
+                /**
+                 * Constructs a frame encoder with the given header fields and no subframe encoders yet.
+                 * @param[in] sampleOffset the offset of the first sample of this block in the stream
+                 * @param[in] numChannels  the number of channels, in the range [1, 8]
+                 * @param[in] blockSize    the number of samples per channel, in the range [1, 65536]
+                 * @param[in] sampleDepth  the bit depth of the samples, in the range [1, 32]
+                 * @param[in] sampleRate   the sample rate in hertz
+                 */
+                FrameEncoder(uint_fast64_t sampleOffset, int_fast32_t numChannels, int_fast32_t blockSize,
+                             int_fast32_t sampleDepth, int_fast32_t sampleRate);
+
+                ~FrameEncoder();
+
+                FrameEncoder(const FrameEncoder &) = delete;
+
+                FrameEncoder &operator=(const FrameEncoder &) = delete;
+
+                /**
+                 * Allocates frame encoders through the accounting allocator, charging the account current on the calling
+                 * thread (see `Common::MemoryAccount::Scope`).
+                 * @param[in] size the size of the object
+                 * @return the memory for the object
+                 */
+                static void *operator new(size_t size) {
+                    return Common::MemoryAccount::allocateObject(size);
+                }
+
+                /**
+                 * Frees an object allocated by `operator new`.
+                 * @param[in] p the object's memory, or `null`
+                 */
+                static void operator delete(void *p) {
+                    Common::MemoryAccount::deallocate(p);
+                }
+
+                /**
+                 * Returns the frame header fields, in particular the chosen channel assignment.
+                 * @return the frame metadata
+                 */
+                const Common::FrameInfo &getMetadata() const;
+
+                /**
+                 * Returns the encoder of the subframe at the given index, in the order the subframes are written.
+                 * @param[in] index the subframe index, in the range [0, `getMetadata().numChannels`)
+                 * @return the subframe encoder (not `null`)
+                 */
+                const SubframeEncoder *getSubframeEncoder(int_fast32_t index) const;
+
+                /**
+                 * Writes the given samples (which must be the same ones this encoder was computed from) as a whole
+                 * frame to the given output stream, which must be aligned to a byte boundary.
+                 * @param[in]     samples the samples, where each subarray is a channel (all not `null`)
+                 * @param[in,out] out     the output stream to write to (not `null`)
+                 */
+                void encode(int_fast64_t *samples[], BitOutputStream *out);
+            };
+        }
+    }
+}
+
+#endif
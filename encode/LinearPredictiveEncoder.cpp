@@ -0,0 +1,230 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#include "LinearPredictiveEncoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "RiceEncoder.h"
+
+#include "../common/Kernels.h"
+#include "../common/MemoryAccount.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Encode {
+            SizeEstimate<SubframeEncoder>
+            LinearPredictiveEncoder::computeBest(const int_fast64_t samples[], uint_fast32_t numSamples,
+                                                 int_fast32_t shift, int_fast32_t depth, int_fast32_t order,
+                                                 int_fast32_t roundVars, const FastDotProduct *fdp,
+                                                 int_fast32_t maxRiceOrder, EncoderStats *stats) {
+                if (roundVars < 0 || roundVars > order || roundVars > 30)
+                    throw std::invalid_argument("Invalid number of rounding variables");
+
+                EncoderStats::StageTimer searchTimer(stats, EncoderStats::Stage::SEARCH);
+                auto *enc = new LinearPredictiveEncoder(numSamples, shift, depth, order, fdp);
+                searchTimer.stop();
+                int_fast64_t *shifted = shiftRight(samples, numSamples, shift);
+                auto *residuals = Common::MemoryAccount::allocateCurrent<int_fast64_t>(numSamples);
+                uint_fast64_t best = enc->computeResidualSize(shifted, residuals, numSamples, maxRiceOrder, stats);
+
+                if (roundVars > 0) {
+                    // Pick the coefficients whose scaled values are nearest to halfway between two integers
+                    double scaled[32];
+                    int_fast32_t indexes[32];
+                    for (int_fast32_t i = 0; i < order; i++) {
+                        scaled[i] = enc->realCoefficients[i] * (1 << enc->coefShift);
+                        indexes[i] = i;
+                    }
+                    std::sort(indexes, indexes + order, [&scaled](int_fast32_t x, int_fast32_t y) {
+                        return std::abs(scaled[x] - std::floor(scaled[x]) - 0.5) <
+                               std::abs(scaled[y] - std::floor(scaled[y]) - 0.5);
+                    });
+
+                    // Try every combination of rounding directions, keeping the best coefficients
+                    int_fast32_t bestCoefs[32];
+                    std::memcpy(bestCoefs, enc->coefficients, sizeof(bestCoefs));
+                    const int_fast32_t limit = 1 << (COEFFICIENT_DEPTH - 1);
+                    for (uint_fast32_t mask = 0; mask < ((uint_fast32_t)1 << roundVars); mask++) {
+                        for (int_fast32_t j = 0; j < roundVars; j++) {
+                            int_fast32_t k = indexes[j];
+                            auto val = (int_fast32_t)std::floor(scaled[k]) + (int_fast32_t)((mask >> j) & 1);
+                            enc->coefficients[k] = std::max(std::min(val, limit - 1), -limit);
+                        }
+                        uint_fast64_t temp = enc->computeResidualSize(shifted, residuals, numSamples, maxRiceOrder,
+                                                                      stats);
+                        if ((temp >> 4) < (best >> 4)) {
+                            best = temp;
+                            std::memcpy(bestCoefs, enc->coefficients, sizeof(bestCoefs));
+                        }
+                    }
+                    std::memcpy(enc->coefficients, bestCoefs, sizeof(bestCoefs));
+                }
+                Common::MemoryAccount::deallocate(shifted);
+                Common::MemoryAccount::deallocate(residuals);
+
+                enc->riceOrder = (int_fast32_t)(best & 0xF);
+                uint_fast64_t size = 1 + 6 + 1 + shift + (uint_fast64_t)order * (depth - shift) + 4 + 5 +
+                                     (uint_fast64_t)order * COEFFICIENT_DEPTH + (best >> 4);
+                return SizeEstimate<SubframeEncoder>(size, enc);
+            }
+
+            LinearPredictiveEncoder::LinearPredictiveEncoder(uint_fast32_t numSamples, int_fast32_t shift,
+                                                             int_fast32_t depth, int_fast32_t order,
+                                                             const FastDotProduct *fdp)
+                    : SubframeEncoder(shift, depth) {
+                if (order < 1 || order > 32 || numSamples <= (uint_fast32_t)order)
+                    throw std::invalid_argument("Invalid prediction order");
+                if (fdp == nullptr)
+                    throw std::invalid_argument("Dot products cannot be null");
+                this->order = order;
+                riceOrder = -1;
+
+                // Set up the normal equations of the linear least squares problem, where row/column `i` belongs to
+                // the sample `i + 1` positions before the predicted one
+                auto *matrix = Common::MemoryAccount::allocateCurrent<double>(order * (order + 1));
+                uint_fast32_t len = numSamples - order;
+                for (int_fast32_t r = 0; r < order; r++) {
+                    for (int_fast32_t c = 0; c < order; c++) {
+                        if (c < r)
+                            matrix[r * (order + 1) + c] = matrix[c * (order + 1) + r];
+                        else
+                            matrix[r * (order + 1) + c] = fdp->dotProduct(order - 1 - r, order - 1 - c, len);
+                    }
+                    matrix[r * (order + 1) + order] = fdp->dotProduct(order - 1 - r, order, len);
+                }
+
+                // Solve matrix, then examine range of coefficients
+                solveMatrix(matrix, order, realCoefficients);
+                Common::MemoryAccount::deallocate(matrix);
+                double maxCoef = 0;
+                for (int_fast32_t i = 0; i < order; i++)
+                    maxCoef = std::max(std::abs(realCoefficients[i]), maxCoef);
+                int_fast32_t wholeBits = maxCoef >= 1 ? (int_fast32_t)std::floor(std::log2(maxCoef)) + 1 : 0;
+
+                // Quantize and store the coefficients
+                coefShift = std::max(std::min(COEFFICIENT_DEPTH - 1 - wholeBits, (int_fast32_t)15), (int_fast32_t)0);
+                const int_fast32_t limit = 1 << (COEFFICIENT_DEPTH - 1);
+                for (int_fast32_t i = 0; i < order; i++) {
+                    double val = std::round(realCoefficients[i] * (1 << coefShift));
+                    coefficients[i] = (int_fast32_t)std::max(std::min(val, (double)(limit - 1)), (double)-limit);
+                }
+                for (int_fast32_t i = order; i < 32; i++) {
+                    realCoefficients[i] = 0;
+                    coefficients[i] = 0;
+                }
+            }
+
+            uint_fast64_t LinearPredictiveEncoder::computeResidualSize(const int_fast64_t samples[],
+                                                                       int_fast64_t residuals[],
+                                                                       uint_fast32_t numSamples,
+                                                                       int_fast32_t maxRiceOrder,
+                                                                       EncoderStats *stats) {
+                {
+                    EncoderStats::StageTimer timer(stats, EncoderStats::Stage::RESIDUAL);
+                    std::memcpy(residuals, samples, numSamples * sizeof(int_fast64_t));
+                    applyLpc(residuals, numSamples, coefficients, order, coefShift, sampleDepth - sampleShift);
+                }
+                EncoderStats::StageTimer timer(stats, EncoderStats::Stage::RICE);
+                return RiceEncoder::computeBestSizeAndOrder(residuals, numSamples, order, maxRiceOrder);
+            }
+
+            void LinearPredictiveEncoder::encode(const int_fast64_t samples[], uint_fast32_t numSamples,
+                                                 BitOutputStream *out) {
+                int_fast64_t *residuals = shiftRight(samples, numSamples, sampleShift);
+                writeTypeAndShift(32 + order - 1, out);
+                for (int_fast32_t i = 0; i < order; i++)  // Warmup
+                    writeRawSample(residuals[i], sampleDepth - sampleShift, out);
+                out->writeInt(4, COEFFICIENT_DEPTH - 1);
+                out->writeInt(5, coefShift);
+                for (int_fast32_t i = 0; i < order; i++)
+                    out->writeInt(COEFFICIENT_DEPTH, coefficients[i]);
+                applyLpc(residuals, numSamples, coefficients, order, coefShift, sampleDepth - sampleShift);
+                RiceEncoder::encode(residuals, numSamples, order, riceOrder, out);
+                Common::MemoryAccount::deallocate(residuals);
+            }
+
+            void LinearPredictiveEncoder::solveMatrix(double *mat, int_fast32_t n, double result[]) {
+                int_fast32_t cols = n + 1;
+                double scale = 0;
+                for (int_fast32_t i = 0; i < n; i++)
+                    scale = std::max(std::abs(mat[i * cols + i]), scale);
+                double epsilon = scale * 1e-12;
+
+                // Gauss-Jordan elimination with partial pivoting, skipping columns without a usable pivot
+                auto *pivotRows = Common::MemoryAccount::allocateCurrent<int_fast32_t>(n);
+                for (int_fast32_t col = 0, row = 0; col < n; col++) {
+                    pivotRows[col] = -1;
+                    if (row >= n)
+                        continue;
+                    int_fast32_t pivot = row;
+                    for (int_fast32_t i = row + 1; i < n; i++) {
+                        if (std::abs(mat[i * cols + col]) > std::abs(mat[pivot * cols + col]))
+                            pivot = i;
+                    }
+                    if (!(std::abs(mat[pivot * cols + col]) > epsilon))
+                        continue;
+                    for (int_fast32_t j = 0; j < cols; j++)
+                        std::swap(mat[row * cols + j], mat[pivot * cols + j]);
+
+                    double div = mat[row * cols + col];
+                    for (int_fast32_t j = 0; j < cols; j++)
+                        mat[row * cols + j] /= div;
+                    for (int_fast32_t i = 0; i < n; i++) {
+                        double factor = mat[i * cols + col];
+                        if (i == row || factor == 0)
+                            continue;
+                        for (int_fast32_t j = 0; j < cols; j++)
+                            mat[i * cols + j] -= factor * mat[row * cols + j];
+                    }
+                    pivotRows[col] = row;
+                    row++;
+                }
+
+                for (int_fast32_t i = 0; i < n; i++) {
+                    result[i] = pivotRows[i] == -1 ? 0 : mat[pivotRows[i] * cols + n];
+                    if (!std::isfinite(result[i]))
+                        result[i] = 0;
+                }
+                Common::MemoryAccount::deallocate(pivotRows);
+            }
+
+            void LinearPredictiveEncoder::applyLpc(int_fast64_t data[], uint_fast32_t numSamples,
+                                                   const int_fast32_t coefs[], int_fast32_t order,
+                                                   int_fast32_t shift, int_fast32_t depth) {
+                Common::Kernels::get().computeLpcResidual(data, numSamples, coefs, order, shift, depth);
+            }
+
+            int_fast32_t LinearPredictiveEncoder::getType() const {
+                return 32 + order - 1;
+            }
+
+            int_fast32_t LinearPredictiveEncoder::getRiceOrder() const {
+                return riceOrder;
+            }
+        }
+    }
+}
@@ -0,0 +1,151 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#ifndef NAYUKI_LINEARPREDICTIVEENCODER_H
+#define NAYUKI_LINEARPREDICTIVEENCODER_H
+
+#include "FastDotProduct.h"
+#include "SubframeEncoder.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Encode {
+            /**
+             * Under the linear predictive coding mode of some order, a subframe is encoded as `order` raw warm-up
+             * samples, the quantized predictor coefficients, and the Rice-coded residuals of that predictor. The
+             * coefficients are found by solving the least squares problem over the whole block.
+             */
+            class LinearPredictiveEncoder final : public SubframeEncoder {
+            private:
+                /**
+                 * The bit precision of the quantized coefficients. This is the highest value allowed by the format.
+                 */
+                static const int_fast32_t COEFFICIENT_DEPTH = 15;
+
+                /**
+                 * The prediction order, in the range [1, 32].
+                 */
+                int_fast32_t order;
+
+                /**
+                 * The unquantized least squares coefficients, where `realCoefficients[i]` is the weight of the sample
+                 * that lies `i + 1` positions before the predicted one.
+                 */
+                double realCoefficients[32];
+
+                /**
+                 * The quantized coefficients, in the same order as the real ones.
+                 */
+                int_fast32_t coefficients[32];
+
+                /**
+                 * The number of fractional bits of the quantized coefficients, in the range [0, 15].
+                 */
+                int_fast32_t coefShift;
+
+                /**
+                 * Solves the given `n * (n+1)` augmented matrix (where the last column holds the constants) with
+                 * Gauss-Jordan elimination. Variables that are not determined by the system are set to zero.
+                 * @param[in,out] mat    the augmented matrix in row-major order, destroyed in the process
+                 * @param[in]     n      the number of variables
+                 * @param[out]    result the array of length `n` to store the solution into
+                 */
+                static void solveMatrix(double *mat, int_fast32_t n, double result[]);
+
+                /**
+                 * Computes the residuals of the current quantized coefficients and returns their best Rice size, packed
+                 * like `RiceEncoder::computeBestSizeAndOrder()`.
+                 * @param[in]     samples      the shifted samples (not `null`)
+                 * @param[in,out] residuals    the scratch array to store the residuals into (not `null`)
+                 * @param[in]     numSamples   the number of samples
+                 * @param[in]     maxRiceOrder the highest Rice partition order to try
+                 * @param[in]     stats        the sink to add stage timings to, or `null`
+                 * @return the packed Rice size and partition order
+                 */
+                uint_fast64_t computeResidualSize(const int_fast64_t samples[], int_fast64_t residuals[],
+                                                  uint_fast32_t numSamples, int_fast32_t maxRiceOrder,
+                                                  EncoderStats *stats);
+
+            public:
+                /**
+                 * The Rice partition order to encode the residuals with, in the range [0, 15].
+                 */
+                int_fast32_t riceOrder;
+
+                /**
+                 * Returns the size estimate of encoding the given samples with linear prediction of the given order.
+                 * When `roundVars` is positive, the rounding direction of that many coefficients (the ones closest to
+                 * halfway between two integers) is chosen by trying all combinations.
+                 * @param[in] samples      the samples of one channel (not `null`)
+                 * @param[in] numSamples   the number of samples, more than `order`
+                 * @param[in] shift        the number of wasted bits
+                 * @param[in] depth        the bit depth of the samples, in the range [1, 33]
+                 * @param[in] order        the prediction order, in the range [1, 32]
+                 * @param[in] roundVars    the number of coefficients to round both ways, in the range [0, `order`]
+                 * @param[in] fdp          the dot products of the samples after removing wasted bits (not `null`)
+                 * @param[in] maxRiceOrder the highest Rice partition order to try
+                 * @param[in] stats        the sink to add stage timings to, or `null`
+                 * @return the size estimate with a new linear predictive encoder
+                 */
+                static SizeEstimate<SubframeEncoder>
+                computeBest(const int_fast64_t samples[], uint_fast32_t numSamples, int_fast32_t shift,
+                            int_fast32_t depth, int_fast32_t order, int_fast32_t roundVars, const FastDotProduct *fdp,
+                            int_fast32_t maxRiceOrder, EncoderStats *stats = nullptr);
+
+                /**
+                 * Constructs a linear predictive encoder of the given order, computing and quantizing its coefficients
+                 * from the given dot products.
+                 * @param[in] numSamples the number of samples that will be encoded, more than `order`
+                 * @param[in] shift      the number of wasted bits
+                 * @param[in] depth      the bit depth of the samples, in the range [1, 33]
+                 * @param[in] order      the prediction order, in the range [1, 32]
+                 * @param[in] fdp        the dot products of the samples after removing wasted bits (not `null`)
+                 */
+                LinearPredictiveEncoder(uint_fast32_t numSamples, int_fast32_t shift, int_fast32_t depth,
+                                        int_fast32_t order, const FastDotProduct *fdp);
+
+                virtual void encode(const int_fast64_t samples[], uint_fast32_t numSamples, BitOutputStream *out);
+
+                virtual int_fast32_t getType() const;
+
+                virtual int_fast32_t getRiceOrder() const;
+
+                /**
+                 * Replaces the given samples with their prediction residuals in place, where
+                 * `data[i] -= (sum of data[i - 1 - j] * coefs[j]) >> shift` for every `i >= order`. The first `order`
+                 * entries are left unchanged as warm-up samples.
+                 * @param[in,out] data       the samples to transform (not `null`)
+                 * @param[in]     numSamples the number of samples
+                 * @param[in]     coefs      the predictor coefficients (not `null`)
+                 * @param[in]     order      the number of coefficients
+                 * @param[in]     shift      the number of fractional bits of the coefficients
+                 * @param[in]     depth      the bit depth of the samples, in the range [1, 33]
+                 */
+                static void applyLpc(int_fast64_t data[], uint_fast32_t numSamples, const int_fast32_t coefs[],
+                                     int_fast32_t order, int_fast32_t shift, int_fast32_t depth);
+            };
+        }
+    }
+}
+
+#endif
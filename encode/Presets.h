@@ -0,0 +1,68 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef NAYUKI_PRESETS_H
+#define NAYUKI_PRESETS_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "SubframeEncoder.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Encode {
+            /**
+             * Returns every encoder search preset together with its command line name, ordered from fastest to
+             * slowest.
+             * @return the list of (name, options) pairs
+             */
+            inline const std::vector<std::pair<std::string, SubframeEncoder::SearchOptions>> &getPresets() {
+                using Options = SubframeEncoder::SearchOptions;
+                static const std::vector<std::pair<std::string, Options>> presets = {
+                    {"subset-only-fixed", Options::SUBSET_ONLY_FIXED},
+                    {"subset-medium",     Options::SUBSET_MEDIUM},
+                    {"subset-best",       Options::SUBSET_BEST},
+                    {"subset-insane",     Options::SUBSET_INSANE},
+                    {"lax-medium",        Options::LAX_MEDIUM},
+                    {"lax-best",          Options::LAX_BEST},
+                    {"lax-insane",        Options::LAX_INSANE}
+                };
+                return presets;
+            }
+
+            /**
+             * Looks up an encoder search preset by its command line name.
+             * @param[in] name the name of the preset
+             * @return the preset's search options, or `null` if there is no preset with that name
+             */
+            inline const SubframeEncoder::SearchOptions *findPreset(const std::string &name) {
+                for (const auto &preset : getPresets()) {
+                    if (preset.first == name)
+                        return &preset.second;
+                }
+                return nullptr;
+            }
+        }
+    }
+}
+
+#endif
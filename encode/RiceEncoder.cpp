@@ -0,0 +1,186 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#include "RiceEncoder.h"
+
+#include <cassert>
+#include <stdexcept>
+
+#include "../common/MemoryAccount.h"
+#include "../common/Utilities.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Encode {
+            void RiceEncoder::summarize(const int_fast64_t data[], uint_fast32_t numSamples, uint_fast32_t warmup,
+                                        int_fast32_t order, Partition result[]) {
+                uint_fast32_t partSize = numSamples >> order;
+                for (uint_fast32_t i = 0, p = 0; p < ((uint_fast32_t)1 << order); p++) {
+                    Partition &part = result[p];
+                    part.count = 0;
+                    part.sum = 0;
+                    part.bits = 0;
+                    if (p == 0)
+                        i = warmup;
+                    for (uint_fast32_t end = (p + 1) * partSize; i < end; i++) {
+                        int_fast64_t val = data[i];
+                        uint_fast64_t u = ((uint_fast64_t)val << 1) ^ (uint_fast64_t)(val >> 63);
+                        part.count++;
+                        part.sum += u;
+                        part.bits |= u;
+                    }
+                }
+            }
+
+            int_fast32_t RiceEncoder::getEscapeBits(const Partition &part) {
+                return 64 - Common::numberOfLeadingZeros((uint64_t)part.bits);
+            }
+
+            uint_fast64_t RiceEncoder::computeBestParam(const Partition &part, int_fast32_t *param) {
+                // The size of escaped binary, if representable at all
+                uint_fast64_t bestSize = UINT64_MAX;
+                int_fast32_t bestParam = -1;
+                int_fast32_t escapeBits = getEscapeBits(part);
+                if (escapeBits <= MAX_ESCAPE_BITS)
+                    bestSize = 5 + (uint_fast64_t)part.count * escapeBits;
+
+                // Each Rice code takes one stop bit, `param` low bits, and a unary quotient
+                for (int_fast32_t p = 0; p <= MAX_PARAM; p++) {
+                    uint_fast64_t size = (uint_fast64_t)part.count * (p + 1) + (part.sum >> p);
+                    if (size < bestSize) {
+                        bestSize = size;
+                        bestParam = p;
+                    }
+                    if ((part.sum >> p) == 0)
+                        break;  // Larger parameters only add more low bits
+                }
+                assert(bestSize != UINT64_MAX);
+                *param = bestParam;
+                return bestSize;
+            }
+
+            uint_fast64_t RiceEncoder::computeBestSizeAndOrder(const int_fast64_t data[], uint_fast32_t numSamples,
+                                                               uint_fast32_t warmup, int_fast32_t maxPartOrder) {
+                if (data == nullptr)
+                    throw std::invalid_argument("Data cannot be null");
+                if (warmup > numSamples)
+                    throw std::invalid_argument("Warmup exceeds number of samples");
+                if (maxPartOrder < 0 || maxPartOrder > 15)
+                    throw std::invalid_argument("Invalid partition order");
+
+                // Find the highest usable order, where every partition is whole and the first one holds the warmup
+                int_fast32_t order = maxPartOrder;
+                while (order > 0 && ((numSamples >> order) << order != numSamples || (numSamples >> order) < warmup))
+                    order--;
+
+                // Summarize the finest partitioning, then derive coarser ones by merging neighbors
+                auto *parts = Common::MemoryAccount::allocateCurrent<Partition>((size_t)1 << order);
+                summarize(data, numSamples, warmup, order, parts);
+                uint_fast64_t bestSize = UINT64_MAX;
+                int_fast32_t bestOrder = -1;
+                for (bool finest = true; order >= 0; order--, finest = false) {
+                    uint_fast32_t numPartitions = (uint_fast32_t)1 << order;
+                    if (!finest) {
+                        for (uint_fast32_t i = 0; i < numPartitions; i++) {
+                            Partition &a = parts[i * 2];
+                            Partition &b = parts[i * 2 + 1];
+                            parts[i].count = a.count + b.count;
+                            parts[i].sum = a.sum + b.sum;
+                            parts[i].bits = a.bits | b.bits;
+                        }
+                    }
+                    uint_fast64_t size = 0;
+                    bool needs5BitParams = false;
+                    for (uint_fast32_t i = 0; i < numPartitions; i++) {
+                        int_fast32_t param;
+                        size += computeBestParam(parts[i], &param);
+                        needs5BitParams |= param > MAX_PARAM_4BIT;
+                    }
+                    size += 2 + 4 + (uint_fast64_t)numPartitions * (needs5BitParams ? 5 : 4);
+                    if (size < bestSize) {
+                        bestSize = size;
+                        bestOrder = order;
+                    }
+                }
+                Common::MemoryAccount::deallocate(parts);
+                assert(0 <= bestOrder && bestOrder <= 15);
+                return bestSize << 4 | (uint_fast64_t)bestOrder;
+            }
+
+            void RiceEncoder::encode(const int_fast64_t data[], uint_fast32_t numSamples, uint_fast32_t warmup,
+                                     int_fast32_t order, BitOutputStream *out) {
+                if (data == nullptr || out == nullptr)
+                    throw std::invalid_argument("Data and output stream cannot be null");
+                if (order < 0 || order > 15 || (numSamples >> order) << order != numSamples ||
+                    (numSamples >> order) < warmup)
+                    throw std::invalid_argument("Invalid partition order");
+
+                // Choose the parameter of each partition
+                uint_fast32_t numPartitions = (uint_fast32_t)1 << order;
+                auto *parts = Common::MemoryAccount::allocateCurrent<Partition>(numPartitions);
+                auto *params = Common::MemoryAccount::allocateCurrent<int_fast32_t>(numPartitions);
+                summarize(data, numSamples, warmup, order, parts);
+                bool needs5BitParams = false;
+                for (uint_fast32_t i = 0; i < numPartitions; i++) {
+                    computeBestParam(parts[i], &params[i]);
+                    needs5BitParams |= params[i] > MAX_PARAM_4BIT;
+                }
+                int_fast8_t paramBits = needs5BitParams ? 5 : 4;
+                int_fast32_t escapeParam = needs5BitParams ? 0x1F : 0xF;
+
+                // Write the residuals
+                out->writeInt(2, needs5BitParams ? 1 : 0);
+                out->writeInt(4, order);
+                uint_fast32_t partSize = numSamples >> order;
+                for (uint_fast32_t p = 0, i = warmup; p < numPartitions; p++) {
+                    uint_fast32_t end = (p + 1) * partSize;
+                    int_fast32_t param = params[p];
+                    if (param == -1) {
+                        int_fast32_t numBits = getEscapeBits(parts[p]);
+                        out->writeInt(paramBits, escapeParam);
+                        out->writeInt(5, numBits);
+                        for (; i < end; i++)
+                            out->writeInt((int_fast8_t)numBits, (int_fast32_t)data[i]);
+                    } else {
+                        out->writeInt(paramBits, param);
+                        for (; i < end; i++)
+                            writeRiceSignedInt(data[i], param, out);
+                    }
+                }
+                Common::MemoryAccount::deallocate(parts);
+                Common::MemoryAccount::deallocate(params);
+            }
+
+            void RiceEncoder::writeRiceSignedInt(int_fast64_t val, int_fast32_t param, BitOutputStream *out) {
+                assert(0 <= param && param <= MAX_PARAM);
+                uint_fast64_t u = ((uint_fast64_t)val << 1) ^ (uint_fast64_t)(val >> 63);
+                for (uint_fast64_t q = u >> param; q > 0; ) {
+                    auto n = (int_fast8_t)(q < 32 ? q : 32);
+                    out->writeInt(n, 0);
+                    q -= n;
+                }
+                out->writeInt((int_fast8_t)(param + 1), (int_fast32_t)((1 << param) | (u & ((1U << param) - 1))));
+            }
+        }
+    }
+}
@@ -0,0 +1,142 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#ifndef NAYUKI_RICEENCODER_H
+#define NAYUKI_RICEENCODER_H
+
+#include <cstdint>
+
+#include "BitOutputStream.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Encode {
+            /**
+             * Calculates the best Rice partitioning and parameters for a sequence of residuals, and writes them to an
+             * output stream. Partitions whose residuals are too large for Rice coding to pay off are stored with the
+             * escape code as fixed-width binary instead.
+             */
+            class RiceEncoder final {
+            private:
+                /**
+                 * The highest Rice parameter that can be written with the 5-bit parameter coding method.
+                 */
+                static const int_fast32_t MAX_PARAM = 30;
+
+                /**
+                 * The highest Rice parameter that can be written with the 4-bit parameter coding method.
+                 */
+                static const int_fast32_t MAX_PARAM_4BIT = 14;
+
+                /**
+                 * The highest number of bits per sample that an escaped partition can use.
+                 */
+                static const int_fast32_t MAX_ESCAPE_BITS = 31;
+
+                /**
+                 * Summary of the residuals in one partition, from which the best parameter can be determined.
+                 */
+                class Partition final {
+                public:
+                    /**
+                     * The number of residuals in this partition.
+                     */
+                    uint_fast32_t count;
+
+                    /**
+                     * The sum of all residuals after mapping them to unsigned values (zigzag encoding).
+                     */
+                    uint_fast64_t sum;
+
+                    /**
+                     * The bitwise OR of all residuals after mapping them to unsigned values (zigzag encoding).
+                     */
+                    uint_fast64_t bits;
+                };
+
+                /**
+                 * Summarizes the residuals for every partition of the given partition order.
+                 * @param[in]  data       the residuals, where the first `warmup` entries are ignored (not `null`)
+                 * @param[in]  numSamples the number of entries in `data`, divisible by `2^order`
+                 * @param[in]  warmup     the number of leading entries that are not residuals
+                 * @param[in]  order      the partition order
+                 * @param[out] result     an array of at least `2^order` partitions to fill (not `null`)
+                 */
+                static void summarize(const int_fast64_t data[], uint_fast32_t numSamples, uint_fast32_t warmup,
+                                      int_fast32_t order, Partition result[]);
+
+                /**
+                 * Finds the cheapest parameter for a partition, returning its size in bits (excluding the parameter
+                 * field) and storing the parameter, or -1 for the escape code.
+                 * @param[in]  part  the summary of the partition
+                 * @param[out] param the best Rice parameter, or -1 for escaped binary
+                 * @return the estimated size of the partition's data in bits
+                 */
+                static uint_fast64_t computeBestParam(const Partition &part, int_fast32_t *param);
+
+                /**
+                 * Returns the number of bits needed to store each residual of an escaped partition.
+                 * @param[in] part the summary of the partition
+                 * @return the number of bits per residual
+                 */
+                static int_fast32_t getEscapeBits(const Partition &part);
+
+                /**
+                 * Writes the given signed value as a Rice code with the given parameter.
+                 * @param[in]     val   the value to write
+                 * @param[in]     param the Rice parameter, in the range [0, 30]
+                 * @param[in,out] out   the output stream to write to (not `null`)
+                 */
+                static void writeRiceSignedInt(int_fast64_t val, int_fast32_t param, BitOutputStream *out);
+
+            public:
+                /**
+                 * Computes the partition order up to the given maximum that results in the smallest encoding of the
+                 * given residuals. The returned value is `(size << 4) | order`, where the size is in bits and includes
+                 * the coding method and partition order fields.
+                 * @param[in] data         the residuals, where the first `warmup` entries are ignored (not `null`)
+                 * @param[in] numSamples   the number of entries in `data`
+                 * @param[in] warmup       the number of leading entries that are not residuals
+                 * @param[in] maxPartOrder the highest partition order to try, in the range [0, 15]
+                 * @return the best size and partition order, packed together
+                 */
+                static uint_fast64_t computeBestSizeAndOrder(const int_fast64_t data[], uint_fast32_t numSamples,
+                                                             uint_fast32_t warmup, int_fast32_t maxPartOrder);
+
+                /**
+                 * Writes the given residuals with the given partition order to the output stream, including the coding
+                 * method and partition order fields.
+                 * @param[in]     data       the residuals, where the first `warmup` entries are ignored (not `null`)
+                 * @param[in]     numSamples the number of entries in `data`, divisible by `2^order`
+                 * @param[in]     warmup     the number of leading entries that are not residuals
+                 * @param[in]     order      the partition order, as returned by `computeBestSizeAndOrder()`
+                 * @param[in,out] out        the output stream to write to (not `null`)
+                 */
+                static void encode(const int_fast64_t data[], uint_fast32_t numSamples, uint_fast32_t warmup,
+                                   int_fast32_t order, BitOutputStream *out);
+            };
+        }
+    }
+}
+
+#endif
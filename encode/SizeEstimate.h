@@ -0,0 +1,84 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#ifndef NAYUKI_SIZEESTIMATE_H
+#define NAYUKI_SIZEESTIMATE_H
+
+#include <cstdint>
+#include <stdexcept>
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Encode {
+            /**
+             * Pairs an encoder with an estimate of the number of bits it will write. Immutable structure, but it holds
+             * ownership of the encoder object, which must be deleted by whoever ends up using the estimate.
+             * @tparam E the type of the encoder
+             */
+            template<typename E>
+            class SizeEstimate final {
+            public:
+                /**
+                 * The estimated size of the encoded data, in bits. Always non-negative.
+                 */
+                uint_fast64_t sizeEstimate;
+
+                /**
+                 * The encoder which achieves the estimated size (not `null`).
+                 */
+                E *encoder;
+
+                /**
+                 * Constructs a size estimate for the given encoder.
+                 * @param[in] size the estimated size in bits
+                 * @param[in] enc  the encoder to take ownership of (not `null`)
+                 */
+                SizeEstimate(uint_fast64_t size, E *enc) {
+                    if (enc == nullptr)
+                        throw std::invalid_argument("Encoder cannot be null");
+                    sizeEstimate = size;
+                    encoder = enc;
+                }
+
+                /**
+                 * Returns whichever of this estimate or the given estimate has the smaller size, preferring this one
+                 * on ties. The encoder of the estimate which is not returned gets deleted, so neither argument may be
+                 * used afterwards other than through the returned value.
+                 * @param[in] other the estimate to compare with
+                 * @return the estimate with the smaller size
+                 */
+                SizeEstimate<E> minimum(SizeEstimate<E> other) {
+                    if (sizeEstimate <= other.sizeEstimate) {
+                        delete other.encoder;
+                        return *this;
+                    } else {
+                        delete encoder;
+                        return other;
+                    }
+                }
+            };
+        }
+    }
+}
+
+#endif
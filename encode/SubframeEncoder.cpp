@@ -0,0 +1,177 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#include "SubframeEncoder.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "ConstantEncoder.h"
+#include "FastDotProduct.h"
+#include "FixedPredictionEncoder.h"
+#include "LinearPredictiveEncoder.h"
+#include "VerbatimEncoder.h"
+
+#include "../common/MemoryAccount.h"
+#include "../common/Utilities.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Encode {
+            SubframeEncoder::SearchOptions::SearchOptions(int_fast32_t minFixedOrder, int_fast32_t maxFixedOrder,
+                                                          int_fast32_t minLpcOrder, int_fast32_t maxLpcOrder,
+                                                          int_fast32_t lpcRoundVars, int_fast32_t maxRiceOrder) {
+                if ((minFixedOrder != -1 || maxFixedOrder != -1) &&
+                    !(0 <= minFixedOrder && minFixedOrder <= maxFixedOrder && maxFixedOrder <= 4))
+                    throw std::invalid_argument("Invalid fixed prediction orders");
+                if ((minLpcOrder != -1 || maxLpcOrder != -1) &&
+                    !(1 <= minLpcOrder && minLpcOrder <= maxLpcOrder && maxLpcOrder <= 32))
+                    throw std::invalid_argument("Invalid LPC orders");
+                if (lpcRoundVars < 0 || lpcRoundVars > 30)
+                    throw std::invalid_argument("Invalid number of LPC rounding variables");
+                if (maxRiceOrder < 0 || maxRiceOrder > 15)
+                    throw std::invalid_argument("Invalid Rice partition order");
+                this->minFixedOrder = minFixedOrder;
+                this->maxFixedOrder = maxFixedOrder;
+                this->minLpcOrder = minLpcOrder;
+                this->maxLpcOrder = maxLpcOrder;
+                this->lpcRoundVariables = lpcRoundVars;
+                this->maxRiceOrder = maxRiceOrder;
+            }
+
+            const SubframeEncoder::SearchOptions SubframeEncoder::SearchOptions::SUBSET_ONLY_FIXED(0, 4, -1, -1, 0, 8);
+            const SubframeEncoder::SearchOptions SubframeEncoder::SearchOptions::SUBSET_MEDIUM(0, 1, 2, 8, 0, 5);
+            const SubframeEncoder::SearchOptions SubframeEncoder::SearchOptions::SUBSET_BEST(0, 1, 2, 12, 0, 8);
+            const SubframeEncoder::SearchOptions SubframeEncoder::SearchOptions::SUBSET_INSANE(0, 4, 1, 12, 4, 8);
+            const SubframeEncoder::SearchOptions SubframeEncoder::SearchOptions::LAX_MEDIUM(0, 1, 2, 22, 0, 15);
+            const SubframeEncoder::SearchOptions SubframeEncoder::SearchOptions::LAX_BEST(0, 1, 2, 32, 0, 15);
+            const SubframeEncoder::SearchOptions SubframeEncoder::SearchOptions::LAX_INSANE(0, 1, 2, 32, 4, 15);
+
+            SizeEstimate<SubframeEncoder>
+            SubframeEncoder::computeBest(const int_fast64_t samples[], uint_fast32_t numSamples,
+                                         int_fast32_t sampleDepth, const SearchOptions &opt, EncoderStats *stats) {
+                // Check arguments
+                if (samples == nullptr)
+                    throw std::invalid_argument("Samples cannot be null");
+                if (numSamples == 0)
+                    throw std::invalid_argument("Empty subframe");
+                if (sampleDepth < 1 || sampleDepth > 33)
+                    throw std::invalid_argument("Invalid sample depth");
+
+                int_fast32_t shift;
+                {
+                    EncoderStats::StageTimer timer(stats, EncoderStats::Stage::ANALYSIS);
+
+                    // Encode with constant if possible
+                    if (ConstantEncoder::isConstant(samples, numSamples))
+                        return ConstantEncoder::computeBest(samples, numSamples, 0, sampleDepth);
+
+                    // Detect number of trailing zero bits
+                    uint_fast64_t accumulator = 0;
+                    for (uint_fast32_t i = 0; i < numSamples; i++)
+                        accumulator |= (uint_fast64_t)samples[i];
+                    shift = std::min(Common::numberOfTrailingZeros((uint64_t)accumulator), sampleDepth);
+                }
+
+                // Start with verbatim as fallback
+                SizeEstimate<SubframeEncoder> result =
+                        VerbatimEncoder::computeBest(samples, numSamples, shift, sampleDepth);
+
+                // Try fixed prediction encoding
+                for (int_fast32_t order = opt.minFixedOrder;
+                     0 <= order && order <= std::min(opt.maxFixedOrder, (int_fast32_t)numSamples); order++) {
+                    result = result.minimum(FixedPredictionEncoder::computeBest(
+                            samples, numSamples, shift, sampleDepth, order, opt.maxRiceOrder, stats));
+                }
+
+                // Try linear predictive coding
+                if (opt.minLpcOrder != -1 && (int_fast32_t)numSamples > opt.minLpcOrder) {
+                    EncoderStats::StageTimer timer(stats, EncoderStats::Stage::ANALYSIS);
+                    int_fast64_t *shifted = shiftRight(samples, numSamples, shift);
+                    FastDotProduct fdp(shifted, numSamples, opt.maxLpcOrder);
+                    timer.stop();
+                    for (int_fast32_t order = opt.minLpcOrder;
+                         order <= std::min(opt.maxLpcOrder, (int_fast32_t)numSamples - 1); order++) {
+                        result = result.minimum(LinearPredictiveEncoder::computeBest(
+                                samples, numSamples, shift, sampleDepth, order,
+                                std::min(opt.lpcRoundVariables, order), &fdp, opt.maxRiceOrder, stats));
+                    }
+                    Common::MemoryAccount::deallocate(shifted);
+                }
+
+                // Return the encoder found with the lowest bit length
+                return result;
+            }
+
+            SubframeEncoder::SubframeEncoder(int_fast32_t shift, int_fast32_t depth) {
+                if (depth < 1 || depth > 33 || shift < 0 || shift > depth)
+                    throw std::invalid_argument("Invalid sample shift or depth");
+                sampleShift = shift;
+                sampleDepth = depth;
+            }
+
+            void SubframeEncoder::writeTypeAndShift(int_fast32_t type, BitOutputStream *out) {
+                // Check arguments
+                if (((uint_fast32_t)type >> 6) != 0)
+                    throw std::invalid_argument("Invalid subframe type");
+                if (out == nullptr)
+                    throw std::invalid_argument("Output stream cannot be null");
+
+                // Write some fields
+                out->writeInt(1, 0);
+                out->writeInt(6, type);
+                if (sampleShift == 0)
+                    out->writeInt(1, 0);
+                else {
+                    out->writeInt(1, 1);
+                    for (int_fast32_t i = 0; i < sampleShift - 1; i++)
+                        out->writeInt(1, 0);
+                    out->writeInt(1, 1);
+                }
+            }
+
+            void SubframeEncoder::writeRawSample(int_fast64_t val, int_fast32_t depth, BitOutputStream *out) {
+                if (depth < 1 || depth > 33)
+                    throw std::invalid_argument("Invalid sample depth");
+                if ((val >> (depth - 1)) != (val >> depth))
+                    throw std::invalid_argument("Value does not fit into the given sample depth");
+                if (depth <= 32)
+                    out->writeInt((int_fast8_t)depth, (int_fast32_t)val);
+                else {  // depth == 33
+                    out->writeInt(1, (int_fast32_t)((uint_fast64_t)val >> 32));
+                    out->writeInt(32, (int_fast32_t)val);
+                }
+            }
+
+            int_fast64_t *SubframeEncoder::shiftRight(const int_fast64_t samples[], uint_fast32_t numSamples,
+                                                      int_fast32_t shift) {
+                if (shift < 0 || shift > 63)
+                    throw std::invalid_argument("Invalid shift amount");
+                auto *result = Common::MemoryAccount::allocateCurrent<int_fast64_t>(numSamples);
+                for (uint_fast32_t i = 0; i < numSamples; i++)
+                    result[i] = samples[i] >> shift;
+                return result;
+            }
+        }
+    }
+}
@@ -0,0 +1,238 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#ifndef NAYUKI_SUBFRAMEENCODER_H
+#define NAYUKI_SUBFRAMEENCODER_H
+
+#include <cstdint>
+
+#include "BitOutputStream.h"
+#include "EncoderStats.h"
+#include "SizeEstimate.h"
+
+#include "../common/MemoryAccount.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Encode {
+            /**
+             * Calculates/estimates the encoded size of a subframe of audio sample data, and also performs the encoding
+             * to an output stream. Every concrete subclass represents one of the FLAC subframe types (constant,
+             * verbatim, fixed prediction and linear predictive coding).
+             */
+            class SubframeEncoder {
+            public:
+                /**
+                 * Describes which encoding methods and parameters the subframe search is allowed to explore. Immutable
+                 * structure. A pair of orders set to -1 disables the corresponding prediction method.
+                 */
+                class SearchOptions final {
+                public:
+                    /**
+                     * The lowest fixed prediction order to try, in the range [0, 4], or -1 to disable.
+                     */
+                    int_fast32_t minFixedOrder;
+
+                    /**
+                     * The highest fixed prediction order to try, in the range [`minFixedOrder`, 4], or -1 to disable.
+                     */
+                    int_fast32_t maxFixedOrder;
+
+                    /**
+                     * The lowest LPC order to try, in the range [1, 32], or -1 to disable.
+                     */
+                    int_fast32_t minLpcOrder;
+
+                    /**
+                     * The highest LPC order to try, in the range [`minLpcOrder`, 32], or -1 to disable.
+                     */
+                    int_fast32_t maxLpcOrder;
+
+                    /**
+                     * The number of quantized LPC coefficients whose rounding direction is searched exhaustively, in
+                     * the range [0, 30]. Each extra variable doubles the LPC search time.
+                     */
+                    int_fast32_t lpcRoundVariables;
+
+                    /**
+                     * The highest Rice partition order to try, in the range [0, 15].
+                     */
+                    int_fast32_t maxRiceOrder;
+
+                    /**
+                     * Constructs a set of search options, checking all values for validity.
+                     * @param[in] minFixedOrder the lowest fixed prediction order, or -1
+                     * @param[in] maxFixedOrder the highest fixed prediction order, or -1
+                     * @param[in] minLpcOrder   the lowest LPC order, or -1
+                     * @param[in] maxLpcOrder   the highest LPC order, or -1
+                     * @param[in] lpcRoundVars  the number of LPC coefficients to round in both directions
+                     * @param[in] maxRiceOrder  the highest Rice partition order
+                     */
+                    SearchOptions(int_fast32_t minFixedOrder, int_fast32_t maxFixedOrder, int_fast32_t minLpcOrder,
+                                  int_fast32_t maxLpcOrder, int_fast32_t lpcRoundVars, int_fast32_t maxRiceOrder);
+
+                    /**
+                     * Only fixed prediction, staying within the FLAC subset.
+                     */
+                    static const SearchOptions SUBSET_ONLY_FIXED;
+
+                    /**
+                     * Fast LPC search, staying within the FLAC subset.
+                     */
+                    static const SearchOptions SUBSET_MEDIUM;
+
+                    /**
+                     * Thorough LPC search, staying within the FLAC subset.
+                     */
+                    static const SearchOptions SUBSET_BEST;
+
+                    /**
+                     * Exhaustive search including coefficient rounding, staying within the FLAC subset.
+                     */
+                    static const SearchOptions SUBSET_INSANE;
+
+                    /**
+                     * Fast LPC search, allowing orders and Rice partitions outside the FLAC subset.
+                     */
+                    static const SearchOptions LAX_MEDIUM;
+
+                    /**
+                     * Thorough LPC search, allowing orders and Rice partitions outside the FLAC subset.
+                     */
+                    static const SearchOptions LAX_BEST;
+
+                    /**
+                     * Exhaustive search including coefficient rounding, outside the FLAC subset.
+                     */
+                    static const SearchOptions LAX_INSANE;
+                };
+
+                /**
+                 * Computes a good way to encode the given subframe of samples, returning the encoder with the smallest
+                 * estimated size among all the methods allowed by the search options. The returned encoder must be
+                 * deleted by the caller.
+                 * @param[in] samples     the samples of one channel (not `null`)
+                 * @param[in] numSamples  the number of samples, in the range [1, 65536]
+                 * @param[in] sampleDepth the bit depth of the samples, in the range [1, 33]
+                 * @param[in] opt         the search options to use
+                 * @param[in] stats       the sink to add stage timings to, or `null`
+                 * @return the best size estimate found
+                 */
+                static SizeEstimate<SubframeEncoder>
+                computeBest(const int_fast64_t samples[], uint_fast32_t numSamples, int_fast32_t sampleDepth,
+                            const SearchOptions &opt, EncoderStats *stats = nullptr);
+
+                virtual ~SubframeEncoder() = default;
+
+                /**
+                 * Allocates subframe encoders through the accounting allocator, charging the account current on the calling
+                 * thread (see `Common::MemoryAccount::Scope`).
+                 * @param[in] size the size of the object
+                 * @return the memory for the object
+                 */
+                static void *operator new(size_t size) {
+                    return Common::MemoryAccount::allocateObject(size);
+                }
+
+                /**
+                 * Frees an object allocated by `operator new`.
+                 * @param[in] p the object's memory, or `null`
+                 */
+                static void operator delete(void *p) {
+                    Common::MemoryAccount::deallocate(p);
+                }
+
+                /**
+                 * Encodes the given samples (which must be the same ones this encoder was computed from) as a subframe
+                 * to the given output stream.
+                 * @param[in]     samples    the samples of one channel (not `null`)
+                 * @param[in]     numSamples the number of samples
+                 * @param[in,out] out        the output stream to write to (not `null`)
+                 */
+                virtual void encode(const int_fast64_t samples[], uint_fast32_t numSamples, BitOutputStream *out) = 0;
+
+                /**
+                 * Returns the `uint6` subframe type code this encoder writes, which identifies both the prediction
+                 * method and its order.
+                 * @return the subframe type code
+                 */
+                virtual int_fast32_t getType() const = 0;
+
+                /**
+                 * Returns the Rice partition order of the residuals, or -1 if this encoder does not write residuals.
+                 * @return the Rice partition order, or -1
+                 */
+                virtual int_fast32_t getRiceOrder() const {
+                    return -1;
+                }
+
+            protected:
+                /**
+                 * The number of wasted bits, i.e. trailing zero bits common to every sample. At least 0.
+                 */
+                int_fast32_t sampleShift;
+
+                /**
+                 * The bit depth of the samples before removing wasted bits, in the range [1, 33].
+                 */
+                int_fast32_t sampleDepth;
+
+                /**
+                 * Constructs a subframe encoder with the given wasted bits and bit depth.
+                 * @param[in] shift the number of wasted bits, in the range [0, `depth`]
+                 * @param[in] depth the bit depth of the samples, in the range [1, 33]
+                 */
+                SubframeEncoder(int_fast32_t shift, int_fast32_t depth);
+
+                /**
+                 * Writes the subframe header, i.e. the zero padding bit, the given subframe type and the wasted bits
+                 * field in unary coding.
+                 * @param[in]     type the `uint6` subframe type
+                 * @param[in,out] out  the output stream to write to (not `null`)
+                 */
+                void writeTypeAndShift(int_fast32_t type, BitOutputStream *out);
+
+                /**
+                 * Writes the given value as a signed integer of the given bit depth.
+                 * @param[in]     val   the value to write, which must fit into a signed `depth`-bit integer
+                 * @param[in]     depth the number of bits to write, in the range [1, 33]
+                 * @param[in,out] out   the output stream to write to (not `null`)
+                 */
+                static void writeRawSample(int_fast64_t val, int_fast32_t depth, BitOutputStream *out);
+
+                /**
+                 * Returns a new array containing the given samples arithmetically shifted right by the given amount.
+                 * The returned array must be deleted by the caller.
+                 * @param[in] samples    the samples to shift (not `null`)
+                 * @param[in] numSamples the number of samples
+                 * @param[in] shift      the number of bits to shift by, in the range [0, 63]
+                 * @return a new array with the shifted samples
+                 */
+                static int_fast64_t *shiftRight(const int_fast64_t samples[], uint_fast32_t numSamples,
+                                                int_fast32_t shift);
+            };
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#include "VerbatimEncoder.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Encode {
+            SizeEstimate<SubframeEncoder>
+            VerbatimEncoder::computeBest(const int_fast64_t samples[], uint_fast32_t numSamples, int_fast32_t shift,
+                                         int_fast32_t depth) {
+                (void)samples;
+                uint_fast64_t size = 1 + 6 + 1 + shift + (uint_fast64_t)numSamples * (depth - shift);
+                return SizeEstimate<SubframeEncoder>(size, new VerbatimEncoder(shift, depth));
+            }
+
+            VerbatimEncoder::VerbatimEncoder(int_fast32_t shift, int_fast32_t depth) : SubframeEncoder(shift, depth) {
+                // Nothing extra to do
+            }
+
+            void VerbatimEncoder::encode(const int_fast64_t samples[], uint_fast32_t numSamples, BitOutputStream *out) {
+                writeTypeAndShift(1, out);
+                for (uint_fast32_t i = 0; i < numSamples; i++)
+                    writeRawSample(samples[i] >> sampleShift, sampleDepth - sampleShift, out);
+            }
+
+            int_fast32_t VerbatimEncoder::getType() const {
+                return 1;
+            }
+        }
+    }
+}
@@ -0,0 +1,65 @@
+/*
+ * Nayuki++ is a FLAC encoding library aiming for better compression than
+ * the reference implementation by Xiph.Org.
+ *
+ * Copyright (C) 2019 Michael Armbruster
+ * Copyright (C) Project Nayuki
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The following code is a derivative work of the code from the Nayuki project,
+ * which is licensed under the terms of the LGPLv3.
+ */
+#ifndef NAYUKI_VERBATIMENCODER_H
+#define NAYUKI_VERBATIMENCODER_H
+
+#include "SubframeEncoder.h"
+
+namespace Nayuki {
+    namespace FLAC {
+        namespace Encode {
+            /**
+             * Under the verbatim coding mode, a subframe is encoded as every raw sample value without any compression
+             * (apart from removing wasted bits). This always works but is usually the largest encoding.
+             */
+            class VerbatimEncoder final : public SubframeEncoder {
+            public:
+                /**
+                 * Returns the size estimate of encoding the given samples in verbatim mode.
+                 * @param[in] samples    the samples of one channel (not `null`)
+                 * @param[in] numSamples the number of samples
+                 * @param[in] shift      the number of wasted bits
+                 * @param[in] depth      the bit depth of the samples, in the range [1, 33]
+                 * @return the size estimate with a new verbatim encoder
+                 */
+                static SizeEstimate<SubframeEncoder>
+                computeBest(const int_fast64_t samples[], uint_fast32_t numSamples, int_fast32_t shift,
+                            int_fast32_t depth);
+
+                /**
+                 * Constructs a verbatim encoder with the given wasted bits and bit depth.
+                 * @param[in] shift the number of wasted bits
+                 * @param[in] depth the bit depth of the samples, in the range [1, 33]
+                 */
+                VerbatimEncoder(int_fast32_t shift, int_fast32_t depth);
+
+                virtual void encode(const int_fast64_t samples[], uint_fast32_t numSamples, BitOutputStream *out);
+
+                virtual int_fast32_t getType() const;
+            };
+        }
+    }
+}
+
+#endif